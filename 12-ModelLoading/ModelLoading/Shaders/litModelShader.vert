@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+out vec3 FragPos; // World space location of the fragment.
+out vec2 TexCoords;
+out mat3 TBN; // Takes the normal map's tangent space normals to world space.
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat3 normalMatrix = mat3(transpose(inverse(model))); // Note: best to calculate this on CPU then send to GPU.
+    TBN = mat3(normalize(normalMatrix * aTangent), normalize(normalMatrix * aBitangent), normalize(normalMatrix * aNormal));
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#version 330 core
+out vec4 FragColor;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+in vec3 FragPos;
+in vec2 TexCoords;
+in mat3 TBN;
+
+// Packed by the MaterialPacker tool: the diffuse map's alpha holds the specular intensity.
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_normal1;
+
+uniform vec3 viewPos; // The position from which the camera is viewing the fragment.
+uniform float shininess;
+uniform DirLight dirLight;
+
+void main()
+{
+    // Two samples where the unpacked maps take three.
+    vec4 diffuseSpecular = texture(texture_diffuse1, TexCoords);
+    vec3 albedo = diffuseSpecular.rgb;
+    float specularIntensity = diffuseSpecular.a;
+    vec2 normalXY = texture(texture_normal1, TexCoords).rg * 2.0 - 1.0;
+
+    vec3 normal = normalize(TBN * vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
+    vec3 lightDir = normalize(-dirLight.direction);
+    vec3 halfwayDir = normalize(lightDir + normalize(viewPos - FragPos));
+
+    vec3 ambient = dirLight.ambient * albedo;
+    vec3 diffuse = dirLight.diffuse * max(dot(normal, lightDir), 0.0) * albedo;
+    vec3 specular = dirLight.specular * pow(max(dot(normal, halfwayDir), 0.0), shininess) * specularIntensity;
+    FragColor = vec4(ambient + diffuse + specular, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in float DiffuseLayer;
+flat in vec4 DiffuseTransform;
+
+uniform sampler2DArray texture_diffuse_array;
+
+void main()
+{
+    if(DiffuseLayer < 0.0)
+    {
+        FragColor = vec4(1.0);
+        return;
+    }
+
+    if(DiffuseTransform.x < 1.0 || DiffuseTransform.y < 1.0)
+    {
+        // A tile of an atlas page repeats within itself, kept half a texel in from its edges. The level is picked
+        // from the unwrapped coordinates so the wrap leaves no seam.
+        vec2 inset = 0.5 / (vec2(textureSize(texture_diffuse_array, 0).xy) * DiffuseTransform.xy);
+        vec2 uv = DiffuseTransform.zw + DiffuseTransform.xy * clamp(fract(TexCoords), inset, 1.0 - inset);
+        FragColor = textureGrad(texture_diffuse_array, vec3(uv, DiffuseLayer), dFdx(TexCoords) * DiffuseTransform.xy,
+                                dFdy(TexCoords) * DiffuseTransform.xy);
+        return;
+    }
+    FragColor = texture(texture_diffuse_array, vec3(TexCoords, DiffuseLayer));
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec4 aMaterialLayers;      // Layer of each class of texture, -1 for none. Set per mesh.
+layout (location = 6) in vec4 aDiffuseTransform;    // Scale and offset of the diffuse map in its layer.
+
+out vec2 TexCoords;
+flat out float DiffuseLayer;
+flat out vec4 DiffuseTransform;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    DiffuseLayer = aMaterialLayers.x;
+    DiffuseTransform = aDiffuseTransform;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// The diffuse map's indirection texture, a texel per page of each level: where the page is in the page cache, or the
+// finest page above it that is, as the slot's x and y, the level it holds, and the virtual texture's ID.
+uniform sampler2D texture_diffuse1;
+uniform sampler2D virtualTextureCache;
+// Page size and border in texels, the page cache's size in texels, and the bias levels are picked with.
+uniform vec4 virtualTextureLayout;
+// The feedback pass writes the page each fragment wants rather than its colour.
+uniform bool virtualTextureFeedback;
+
+void main()
+{
+    vec2 pages = vec2(textureSize(texture_diffuse1, 0));
+    float pageSize = virtualTextureLayout.x;
+    float border = virtualTextureLayout.y;
+
+    // The level the hardware would pick, from how far apart neighbouring fragments are in the finest level's texels.
+    vec2 texels = TexCoords * pages * pageSize;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float coarsest = log2(min(pages.x, pages.y));
+    float level = clamp(floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + virtualTextureLayout.w), 0.0, coarsest);
+
+    vec2 uv = fract(TexCoords);
+    vec2 page = floor(uv * pages / exp2(level));
+    vec4 entry = floor(texelFetch(texture_diffuse1, ivec2(page), int(level)) * 255.0 + 0.5);
+    if(virtualTextureFeedback)
+    {
+        FragColor = vec4(page, level, entry.a) / 255.0;
+        return;
+    }
+
+    // Where the fragment falls in the page that's resident, which may be coarser than the one wanted. The page's
+    // border keeps bilinear filtering from reaching into its neighbours in the cache.
+    vec2 inPage = fract(uv * pages / exp2(entry.b));
+    vec2 cacheTexel = entry.xy * (pageSize + 2.0 * border) + border + inPage * pageSize;
+    FragColor = textureLod(virtualTextureCache, cacheTexel / virtualTextureLayout.z, 0.0);
+}
\ No newline at end of file
@@ -5,7 +5,12 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
 
 // Utility code to create and control a camera.
 #include <Camera/camera.h>
@@ -15,6 +20,18 @@
 
 // Utility code to load models.
 #include <Model/model.h>
+
+// Utility code to stream models in without blocking frames.
+#include <ModelStreamer/modelstreamer.h>
+
+// Utility code to keep texture mip levels within a memory budget.
+#include <TextureResidency/textureresidency.h>
+
+// Utility code to stream pages of tiled textures as the frame asks for them.
+#include <VirtualTexture/virtualtexture.h>
+
+// Utility code to create primitive shapes, for the placeholder box.
+#include <Geometry/geometry.h>
 #include "main.h"
 
 // Window size.
@@ -34,6 +51,29 @@ float lastFrame = 0.0f;
 
 bool isWireframe = false;
 
+// GL work spent each frame on uploading models that are streaming in.
+StreamingBudget uploadBudget;
+
+// Colour of the box drawn in place of a model until it's resident.
+const glm::vec3 PLACEHOLDER_COLOUR(0.4f, 0.4f, 0.45f);
+
+// The directional light the model is lit by with --lit.
+const glm::vec3 LIGHT_DIRECTION(-0.3f, -0.5f, -1.0f);
+const glm::vec3 LIGHT_AMBIENT(0.15f, 0.15f, 0.15f);
+const glm::vec3 LIGHT_DIFFUSE(0.8f, 0.8f, 0.8f);
+const glm::vec3 LIGHT_SPECULAR(1.0f, 1.0f, 1.0f);
+const float MODEL_SHININESS = 32.0f;
+
+// Material layouts litPackedShader reads, by the names the MaterialPacker tool records. Models packed with any other
+// layout are lit with litShader.
+const char* const LIT_PACKED_LAYOUTS[] = { "diffuse_specular", "diffuse_specular_normal_height" };
+
+// How often the texture residency and virtual texture cache are reported, in seconds.
+const double RESIDENCY_REPORT_INTERVAL = 5.0;
+
+// Pack built by the AssetCooker tool. Assets it holds are read from it rather than from the loose files.
+const char* ASSET_PACK_PATH = "assets.pack";
+
 ///
 /// Process all input by querying GLFW whether relevant keys are pressed/released
 /// this frame and react accordingly.
@@ -146,7 +186,75 @@ static void ErrorCallback(int error, const char* description)
     fputs(description, stderr);
 }
 
-int main()
+///
+/// Draws a 100 x 100 field of the model and reports triangle throughput, first with every instance at full resolution
+/// and then with each instance's LOD picked by screen-space error.
+///
+/// \param window - the active GLFW Window.
+/// \param shader - the shader to draw with.
+/// \param ourModel - the model to fill the field with.
+///
+void RunLodBenchmark(GLFWwindow* window, Shader& shader, Model& ourModel)
+{
+    const int FIELD_SIZE = 100;
+    const float SPACING = 3.0f;
+    const float MODEL_SCALE = 0.2f;
+    const int FRAMES = 100;
+
+    // Don't let vsync cap the measurement.
+    glfwSwapInterval(0);
+
+    // Look across the field from just outside one corner.
+    glm::vec3 eye(-10.0f, 15.0f, -10.0f);
+    glm::vec3 centre(FIELD_SIZE * SPACING * 0.5f, 0.0f, FIELD_SIZE * SPACING * 0.5f);
+    glm::mat4 view = glm::lookAt(eye, centre, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(ZOOM), ( float) SCR_WIDTH / ( float) SCR_HEIGHT, 0.1f, 1000.0f);
+    float projectionScale = SCR_HEIGHT / (2.0f * tan(glm::radians(ZOOM) * 0.5f));
+    shader.SetUniformMat4("projection", projection);
+    shader.SetUniformMat4("view", view);
+
+    std::vector<unsigned int> lodState(FIELD_SIZE * FIELD_SIZE, 0);
+    for(int pass = 0; pass < 2; pass++)
+    {
+        bool useLods = pass == 1;
+        unsigned long long triangles = 0;
+        size_t binds = SharedTextureArrayBindings().binds;
+
+        glFinish();
+        double start = glfwGetTime();
+        for(int frame = 0; frame < FRAMES && !glfwWindowShouldClose(window); frame++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for(int i = 0; i < FIELD_SIZE * FIELD_SIZE; i++)
+            {
+                glm::vec3 position((i % FIELD_SIZE) * SPACING, 0.0f, (i / FIELD_SIZE) * SPACING);
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+                model = glm::scale(model, glm::vec3(MODEL_SCALE));
+
+                unsigned int lod = 0;
+                if(useLods)
+                {
+                    // LOD errors are in model units, so measure the distance in them too.
+                    float distance = glm::length(position - eye) / MODEL_SCALE;
+                    lod = lodState[i] = ourModel.SelectLod(distance, projectionScale, lodState[i]);
+                }
+                triangles += ourModel.DrawLod(shader, lod, model);
+            }
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        double seconds = glfwGetTime() - start;
+
+        std::cout << "LOD BENCHMARK:: " << (useLods ? "screen-space LOD" : "full resolution") << ": "
+                  << seconds * 1000.0 / FRAMES << " ms/frame, "
+                  << triangles / FRAMES << " triangles/frame, "
+                  << triangles / seconds / 1000000.0 << " Mtriangles/s, "
+                  << ( double) (SharedTextureArrayBindings().binds - binds) / FRAMES << " array binds/frame" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
 {
     glfwSetErrorCallback(ErrorCallback);
 
@@ -188,6 +296,12 @@ int main()
     // Enable depth testing.
     glEnable(GL_DEPTH_TEST);
 
+    // Mount the asset pack if it has been cooked, otherwise everything is loaded from the loose files.
+    if(MountAssetPack(ASSET_PACK_PATH))
+    {
+        std::cout << "Mounted asset pack " << ASSET_PACK_PATH << std::endl;
+    }
+
     // Build and compile shaders.
     Shader unlitShader("Shaders/unlitShader.vert", "Shaders/unlitShader.frag");
     if(unlitShader.ProgramID() == 0)
@@ -196,14 +310,110 @@ int main()
         exit(1);
     }
 
-    glUseProgram(unlitShader.ProgramID());
+    Shader placeholderShader("Shaders/placeholderShader.vert", "Shaders/placeholderShader.frag");
+    if(placeholderShader.ProgramID() == 0)
+    {
+        std::cout << "Failed to load shaders." << std::endl;
+        exit(1);
+    }
 
-    // Load models.
-    Model ourModel("Models/nanosuit/nanosuit.obj");
+    // Samples the diffuse maps from the arrays the model's textures are batched into, see BatchModelTextures.
+    Shader unlitArrayShader("Shaders/unlitArrayShader.vert", "Shaders/unlitArrayShader.frag");
+    if(unlitArrayShader.ProgramID() == 0)
+    {
+        std::cout << "Failed to load shaders." << std::endl;
+        exit(1);
+    }
+    glUseProgram(unlitArrayShader.ProgramID());
+    unlitArrayShader.SetUniformInt("texture_diffuse_array", 0);
+
+    // Samples the diffuse maps through the virtual texture page cache, see VirtualTextureSystem.
+    Shader virtualTextureShader("Shaders/unlitShader.vert", "Shaders/virtualTextureShader.frag");
+    if(virtualTextureShader.ProgramID() == 0)
+    {
+        std::cout << "Failed to load shaders." << std::endl;
+        exit(1);
+    }
+
+    // Lights the model from its diffuse, specular and normal maps, and from the maps the MaterialPacker tool packs them
+    // into. Both of the tool's layouts keep specular intensity in the diffuse map's alpha, see LIT_PACKED_LAYOUTS.
+    Shader litShader("Shaders/litModelShader.vert", "Shaders/litModelShader.frag");
+    Shader litPackedShader("Shaders/litModelShader.vert", "Shaders/litPackedModelShader.frag");
+    if(litShader.ProgramID() == 0 || litPackedShader.ProgramID() == 0)
+    {
+        std::cout << "Failed to load shaders." << std::endl;
+        exit(1);
+    }
+    for(Shader* shader : { &litShader, &litPackedShader })
+    {
+        glUseProgram(shader->ProgramID());
+        shader->SetUniformFloat("shininess", MODEL_SHININESS);
+        shader->SetUniformVec3("dirLight.direction", LIGHT_DIRECTION);
+        shader->SetUniformVec3("dirLight.ambient", LIGHT_AMBIENT);
+        shader->SetUniformVec3("dirLight.diffuse", LIGHT_DIFFUSE);
+        shader->SetUniformVec3("dirLight.specular", LIGHT_SPECULAR);
+    }
+
+    // Stream models in. Loading happens on worker threads and a few uploads a frame, so the first frame doesn't
+    // wait for it; a placeholder box is drawn in each model's place until it's resident.
+    ModelStreamer streamer;
+    ModelHandle ourModel = streamer.Load("Models/nanosuit/nanosuit.obj");
+
+    // Run with --texture-budget <MB> to stream the model's mip levels within that much memory.
+    uint64_t textureBudget = 0;
+
+    // Run with --virtual-texturing to stream the diffuse maps a page at a time from the tiles the TextureTiler tool
+    // writes next to them.
+    std::unique_ptr<VirtualTextureSystem> virtualTextures;
+
+    // Run with --lit to light the model rather than draw its diffuse maps as they are.
+    bool lit = false;
+
+    // Run with --lod-benchmark to measure a field of 10k nanosuits instead of the interactive scene.
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+        {
+            textureBudget = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        }
+        else if(strcmp(argv[i], "--virtual-texturing") == 0)
+        {
+            virtualTextures.reset(new VirtualTextureSystem());
+        }
+        else if(strcmp(argv[i], "--lit") == 0)
+        {
+            lit = true;
+        }
+        else if(strcmp(argv[i], "--lod-benchmark") == 0)
+        {
+            streamer.WaitUntilResident(ourModel);
+            Shader& benchmarkShader = BatchModelTextures({ &ourModel->model }) ? unlitArrayShader : unlitShader;
+            glUseProgram(benchmarkShader.ProgramID());
+            RunLodBenchmark(window, benchmarkShader, ourModel->model);
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            exit(0);
+        }
+    }
 
     // Sets the (background) colour for each time the frame-buffer (colour buffer) is cleared
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 
+    // Report how long the first frame and the model took to appear.
+    bool firstFramePresented = false;
+    bool modelResidentReported = false;
+    unsigned int frames = 0;
+
+    // The model's textures are batched into arrays once it's resident, where the context can. With a texture budget
+    // they're tracked by the residency manager instead, as the arrays would hold copies of every level. Virtual texturing
+    // takes the place of both, swapping the diffuse maps for virtual textures. Lit models aren't batched, as the arrays
+    // only hold diffuse maps, and virtual texturing takes precedence over lighting for the same reason.
+    bool batchTried = false;
+    Shader* modelShader = &unlitShader;
+    TextureResidency residency(textureBudget);
+    double lastResidencyReport = 0.0;
+    double lastVirtualTextureReport = 0.0;
+
     // The event loop, runs until the window is closed.
     // Each iteration redraws the window contents and checks for new events.
     // Windows are double buffered, so need to swap buffers.
@@ -216,6 +426,9 @@ int main()
 
         ProcessInput(window);
 
+        // Make this frame's share of the uploads.
+        streamer.Update(uploadBudget);
+
         // Clear the previous pixels we have drawn to the colour buffer (display buffer)
         // and depth buffer. Called each frame so we don't draw over the top of everything previous.
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -223,19 +436,141 @@ int main()
         // View/Projection transformations.
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        unlitShader.SetUniformMat4("projection", projection);
-        unlitShader.SetUniformMat4("view", view);
 
         // Render the loaded model.
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene.
         model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down.
-        unlitShader.SetUniformMat4("model", model);
 
-        ourModel.Draw(unlitShader);
+        if(ourModel->IsResident())
+        {
+            if(!batchTried)
+            {
+                if(virtualTextures && !virtualTextures->VirtualiseModel(ourModel->model))
+                {
+                    std::cout << "ERROR::VIRTUAL_TEXTURE:: the model's diffuse maps haven't all been tiled, run TextureTiler" << std::endl;
+                    virtualTextures.reset();
+                }
+
+                if(virtualTextures)
+                {
+                    modelShader = &virtualTextureShader;
+                    textureBudget = 0;
+                }
+                else if(textureBudget > 0)
+                {
+                    residency.TrackModel(ourModel->model);
+                }
+                else if(!lit && BatchModelTextures({ &ourModel->model }))
+                {
+                    modelShader = &unlitArrayShader;
+                }
+
+                if(lit && !virtualTextures)
+                {
+                    const std::string& layout = ourModel->model.materialLayout;
+                    bool packed = std::find(std::begin(LIT_PACKED_LAYOUTS), std::end(LIT_PACKED_LAYOUTS), layout) != std::end(LIT_PACKED_LAYOUTS);
+                    modelShader = packed ? &litPackedShader : &litShader;
+                    if(!packed && !layout.empty())
+                    {
+                        std::cout << "ERROR::SHADER:: no lit shader reads the " << layout << " material layout, using the unpacked one" << std::endl;
+                    }
+                }
+                batchTried = true;
+            }
+            glUseProgram(modelShader->ProgramID());
+            modelShader->SetUniformMat4("projection", projection);
+            modelShader->SetUniformMat4("view", view);
+            if(modelShader == &litShader || modelShader == &litPackedShader)
+            {
+                modelShader->SetUniformVec3("viewPos", camera.Position);
+            }
+
+            // The feedback pass draws the same clusters into a small target, writing the pages they want.
+            if(virtualTextures)
+            {
+                // Sized from the framebuffer, like the viewport, which differs from the window after a resize or on
+                // high DPI displays.
+                int framebufferWidth, framebufferHeight;
+                glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+                virtualTextures->BeginFeedback(framebufferWidth, framebufferHeight);
+                virtualTextures->Bind(*modelShader, true);
+                ourModel->model.DrawClusters(*modelShader, projection, view, model);
+                virtualTextures->EndFeedback();
+                virtualTextures->Bind(*modelShader, false);
+            }
+
+            // Only clusters inside the frustum and facing the camera are drawn. Each node of the model is drawn with
+            // its own transform on top of the model matrix.
+            ourModel->model.DrawClusters(*modelShader, projection, view, model);
+
+            if(virtualTextures)
+            {
+                virtualTextures->Update(uploadBudget);
+            }
+
+            if(textureBudget > 0)
+            {
+                float projectionScale = SCR_HEIGHT / (2.0f * tan(glm::radians(camera.Zoom) * 0.5f));
+                residency.RequestModel(ourModel->model, model, camera.Position, projectionScale);
+                residency.Update(uploadBudget);
+            }
+        }
+        else if(ourModel->State() != STREAMING_FAILED)
+        {
+            // A unit box until the model has been read, then its bounding box.
+            glm::vec3 minimum(-0.5f);
+            glm::vec3 maximum(0.5f);
+            ourModel->GetBounds(minimum, maximum);
+            glm::mat4 box = glm::translate(model, (minimum + maximum) * 0.5f);
+            box = glm::scale(box, maximum - minimum);
+
+            glUseProgram(placeholderShader.ProgramID());
+            placeholderShader.SetUniformMat4("projection", projection);
+            placeholderShader.SetUniformMat4("view", view);
+            placeholderShader.SetUniformMat4("model", box);
+            placeholderShader.SetUniformVec3("colour", PLACEHOLDER_COLOUR);
+            GetPrimitive(PRIMITIVE_CUBE).Draw();
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        frames++;
+        if(!firstFramePresented)
+        {
+            std::cout << "First frame presented after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            firstFramePresented = true;
+        }
+        if(!modelResidentReported && ourModel->IsResident())
+        {
+            std::cout << "Model resident after " << glfwGetTime() * 1000.0 << " ms, " << frames << " frames" << std::endl;
+            TextureCacheStats cache = SharedTextureCacheStats();
+            std::cout << "TEXTURE::CACHE:: " << cache.uploads << " uploaded, " << cache.pathHits << " path hits, " << cache.contentHits
+                      << " content hits, " << cache.live << " live in " << cache.liveBytes / 1024 << " KB, " << cache.savedBytes / 1024
+                      << " KB not duplicated" << std::endl;
+            modelResidentReported = true;
+        }
+        if(textureBudget > 0 && glfwGetTime() - lastResidencyReport >= RESIDENCY_REPORT_INTERVAL)
+        {
+            TextureResidencyStats stats = residency.Stats();
+            std::cout << "TEXTURE::RESIDENCY:: " << stats.residentBytes / 1024 << " of " << stats.budgetBytes / 1024 << " KB resident, "
+                      << stats.wantedBytes / 1024 << " KB wanted, " << stats.fullBytes / 1024 << " KB at full resolution, " << stats.starved
+                      << " of " << stats.textures << " textures waiting on " << stats.pendingReads << " reads, " << stats.levelsLoaded
+                      << " levels loaded, " << stats.levelsEvicted << " evicted" << std::endl;
+            lastResidencyReport = glfwGetTime();
+        }
+        if(virtualTextures && glfwGetTime() - lastVirtualTextureReport >= RESIDENCY_REPORT_INTERVAL)
+        {
+            VirtualTextureStats stats = virtualTextures->Stats();
+            std::cout << "TEXTURE::VIRTUAL:: " << stats.residentPages << " of " << stats.cachePages << " pages resident for " << stats.textures
+                      << " textures, " << stats.missingPages << " of " << stats.requestedPages << " wanted pages missing, " << stats.pendingReads
+                      << " reads pending, " << stats.pagesLoaded << " loaded, " << stats.pagesEvicted << " evicted, " << stats.cacheFull
+                      << " dropped with the cache full, " << stats.feedbackSkipped << " of " << stats.feedbackReadbacks + stats.feedbackSkipped
+                      << " feedback passes skipped, " << stats.readMilliseconds << " ms reading, " << stats.updateMilliseconds << " ms updating"
+                      << std::endl;
+            lastVirtualTextureReport = glfwGetTime();
+        }
     }
 
     // Clean up
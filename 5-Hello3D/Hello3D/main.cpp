@@ -10,22 +10,17 @@
 // Utility code to load and compile GLSL shader programs.
 #include <Shader/shader.h>
 
+// Shared primitive meshes.
+#include <Geometry/geometry.h>
+
 // Utility to load in images.
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-#define VALS_PER_VERT 3
-#define VALS_PER_COLOUR 4
-#define VALS_PER_TEX_COORD 2
-#define NUM_VERTS 3
-
 // Window size.
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-// Handle to our rectangle VAOs.
-unsigned int rectangleVertexVaoHandle;
-
 // Handle to our shader program.
 Shader shader = Shader();
 
@@ -87,142 +82,13 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 }
 
 ///
-/// Sets the shader uniforms and rectangle vertex data. This happens ONCE only, before any frames are rendered.
+/// Loads the cube's textures and binds them to the shader's samplers. This happens ONCE only, before any frames are rendered.
+/// The cube geometry itself is shared, see GetPrimitive.
 ///
 /// \return - 0 for success, error otherwise
 ///
-int SetCubeVertexData()
+int SetCubeTextures()
 {
-    // Set of 6 faces of a cube.
-    float vertices[] =
-    {
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f
-    };
-
-    // Texture coordinates for each vertex.
-    float texCoords[] = {
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         1.0f, 0.0f,
-         1.0f, 0.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f
-    };
-
-    // Generate storage on the GPU for our triangle and make it current.
-    // A VAO is a set of data buffers on the GPU.
-    glGenVertexArrays(1, &rectangleVertexVaoHandle);
-    glBindVertexArray(rectangleVertexVaoHandle);
-
-    // Generate 2 new buffers in our VAO to store per-vertex attributes.
-    // One buffer to store vertex positions.
-    // One buffer to store the texture coordinates.
-    unsigned int vertexBuffer;
-    unsigned int textureBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(1, &textureBuffer);
-
-    // --- VERTEX DATA
-
-    // Allocate GPU memory for our vertices and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 0)
-    // and how it is formatted (floating point, 3 values per vertex).
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, VALS_PER_VERT, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // --- TEXTURE DATA
-
-    // - Texture Coordinates
-
-    // Allocate GPU memory for our vertices and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, textureBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
-    
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 2)
-    // and how it is formatted (floating point, 2 values per vertex).
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, VALS_PER_TEX_COORD, GL_FLOAT, GL_FALSE, 0, 0);
-
     // - Texture 1
 
     // Generate a texture buffer in our VAO to store texture data.
@@ -244,8 +110,7 @@ int SetCubeVertexData()
     int height;
     int numberOfChannels;
 
-    // Tell stb_image.h to flip loaded texture's on the y-axis.
-    stbi_set_flip_vertically_on_load(true);
+    // The shared cube's texture coordinates already put the first image row at the top of each face, so no flip is needed.
     unsigned char* imageData1 = stbi_load("Textures/container.jpg", &width, &height, &numberOfChannels, 0);
     if(imageData1)
     {
@@ -294,13 +159,6 @@ int SetCubeVertexData()
     // Bind uniform to texture.
     shader.SetUniformInt("inputTexture2", 1);
 
-    // An argument of zero unbinds all VAO's and stops us
-    // from accidentally changing the VAO state.
-    glBindVertexArray(0);
-
-    // The same is true for buffers, so we unbind it too.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
     return 0;	// Return success.
 }
 
@@ -335,7 +193,7 @@ void ApplyTransformAndDraw()
 
         shader.SetUniformMat4("model", model);
 
-        glDrawArrays(GL_TRIANGLES, 0, 36); // 36 vertices per cube. 2 tris per face, 3 verts per tri.
+        GetPrimitive(PRIMITIVE_CUBE).Draw();
     }
 }
 
@@ -351,9 +209,6 @@ void Render()
     // Specify the shader program we want to use.
     glUseProgram(shader.ProgramID());
 
-    // Make the VAO with our vertex data buffer current.
-    glBindVertexArray(rectangleVertexVaoHandle);
-
     // Apply rotation, scale and/or translation send command to GPU to draw the data in the current VAO.
     ApplyTransformAndDraw();
 
@@ -423,10 +278,10 @@ int main(int argc, char** argv)
 
     glUseProgram(shader.ProgramID());
 
-    // Set the vertex data for a rectangle.
-    if(SetCubeVertexData() != 0)
+    // Set the textures for the cubes.
+    if(SetCubeTextures() != 0)
     {
-        std::cout << "Failed to set vertex data." << std::endl;
+        std::cout << "Failed to set cube textures." << std::endl;
         exit(1);
     }
 
@@ -1,7 +1,7 @@
 #version 330
 
 layout (location=0) in vec3 a_vertex;
-layout (location=1) in vec2 a_tex_coord;
+layout (location=2) in vec2 a_tex_coord;
 
 out vec2 tex_coord;
 
@@ -13,22 +13,17 @@
 // Utility code to load and compile GLSL shader programs.
 #include <Shader/shader.h>
 
+// Shared primitive meshes.
+#include <Geometry/geometry.h>
+
 // Utility to load in images.
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-#define VALS_PER_VERT 3
-#define VALS_PER_COLOUR 4
-#define VALS_PER_NORMAL 3
-#define NUM_VERTS 3
-
 // Window size.
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-// Handle to our rectangle VAOs.
-unsigned int rectangleVertexVaoHandle;
-
 // Handle to our shader program.
 Shader shaderIDCube = Shader();
 Shader shaderIDLight = Shader();
@@ -123,151 +118,6 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-///
-/// Sets the shader uniforms and rectangle vertex data. This happens ONCE only, before any frames are rendered.
-///
-/// \return - 0 for success, error otherwise
-///
-int SetCubeVertexData()
-{
-    // Set of 6 faces of a cube.
-    float vertices[] =
-    {
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f
-    };
-
-    // Texture coordinates for each vertex.
-    float normals[] = {
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f
-    };
-
-    // Generate storage on the GPU for our triangle and make it current.
-    // A VAO is a set of data buffers on the GPU.
-    glGenVertexArrays(1, &rectangleVertexVaoHandle);
-    glBindVertexArray(rectangleVertexVaoHandle);
-
-    // Generate 2 new buffers in our VAO to store per-vertex attributes.
-    // One buffer to store vertex positions.
-    // One buffer to store normal data.
-    unsigned int vertexBuffer;
-    unsigned int normalBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(1, &normalBuffer);
-
-    // --- VERTEX DATA
-
-    // Allocate GPU memory for our vertices and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 0)
-    // and how it is formatted (floating point, 3 values per vertex).
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, VALS_PER_VERT, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // --- NORMAL DATA
-
-    // Allocate GPU memory for our normals and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 1)
-    // and how it is formatted (floating point, 3 values per vertex).
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, VALS_PER_NORMAL, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // An argument of zero unbinds all VAO's and stops us
-    // from accidentally changing the VAO state.
-    glBindVertexArray(0);
-
-    // The same is true for buffers, so we unbind it too.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    return 0;	// Return success.
-}
-
 ///
 /// Sends the camera details to the shader.
 ///
@@ -299,9 +149,6 @@ void Render()
     // Specify the shader program we want to use.
     glUseProgram(shaderIDCube.ProgramID());
 
-    // Make the VAO with our vertex data buffer current.
-    glBindVertexArray(rectangleVertexVaoHandle);
-
     SendCameraDetails(shaderIDCube);
 
     // Set light colour.
@@ -324,16 +171,13 @@ void Render()
     model = glm::rotate(model, glm::radians(73.0f), glm::vec3(1.0f, 0.3f, 0.5f));
     shaderIDCube.SetUniformMat4("model", model);
 
-    glDrawArrays(GL_TRIANGLES, 0, 36); // 36 vertices per cube. 2 tris per face, 3 verts per tri.
+    GetPrimitive(PRIMITIVE_CUBE).Draw();
 
     // --- DRAW LIGHT
 
     // Specify the shader program we want to use.
     glUseProgram(shaderIDLight.ProgramID());
 
-    // Make the VAO with our vertex data buffer current.
-    glBindVertexArray(rectangleVertexVaoHandle);
-
     SendCameraDetails(shaderIDLight);
 
     // Set light obj colour
@@ -346,7 +190,7 @@ void Render()
     model = glm::scale(model, glm::vec3(0.23f, 0.23f, 0.23f));
     shaderIDLight.SetUniformMat4("model", model);
 
-    glDrawArrays(GL_TRIANGLES, 0, 36); // 36 vertices per cube. 2 tris per face, 3 verts per tri.
+    GetPrimitive(PRIMITIVE_CUBE).Draw();
 
     glFlush();	// Guarantees previous commands have been completed before continuing.
 }
@@ -422,13 +266,6 @@ int main(int argc, char** argv)
 
     //glUseProgram(shaderIDCube);
 
-    // Set the vertex data for a rectangle.
-    if(SetCubeVertexData() != 0)
-    {
-        std::cout << "Failed to set vertex data." << std::endl;
-        exit(1);
-    }
-
     // Callbacks for camera control.
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -13,27 +13,24 @@
 // Utility code to load and compile GLSL shader programs.
 #include <Shader/shader.h>
 
-// Utility to load in images.
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
+// Shared primitive meshes.
+#include <Geometry/geometry.h>
 
-#define VALS_PER_VERT 3
-#define VALS_PER_COLOUR 4
-#define VALS_PER_NORMAL 3
-#define VALS_PER_TEX_COORD 2
-#define NUM_VERTS 3
+// Utility to decode images on worker threads and upload them.
+#include <TextureStreamer/texturestreamer.h>
 
 // Window size.
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-// Handle to our rectangle VAOs.
-unsigned int rectangleVertexVaoHandle;
-
 // Handle to our shader program.
 Shader shaderIDCube = Shader();
 Shader shaderIDLight = Shader();
 
+// The cube's diffuse and specular maps, kept for as long as they're drawn.
+TextureHandle cubeDiffuseMap;
+TextureHandle cubeSpecularMap;
+
 Camera camera;
 
 // General camera variables.
@@ -125,308 +122,45 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 }
 
 ///
-/// Sets the shader uniforms and rectangle vertex data. This happens ONCE only, before any frames are rendered.
+/// Loads the cube's diffuse and specular maps and binds them to the shader's samplers. This happens ONCE only, before any frames are rendered.
+/// The cube geometry itself is shared, see GetPrimitive.
 ///
 /// \return - 0 for success, error otherwise
 ///
-int SetCubeVertexData()
+int SetCubeTextures()
 {
-    // Set of 6 faces of a cube.
-    float vertices[] =
-    {
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f, -0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f,  0.5f,
-        -0.5f, -0.5f, -0.5f,
-
-        -0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-         0.5f,  0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f, -0.5f
-    };
-
-    // Texture coordinates for each vertex.
-    float normals[] = {
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-        0.0f,  0.0f, -1.0f,
-
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-        0.0f,  0.0f, 1.0f,
-
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-        -1.0f,  0.0f,  0.0f,
-
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-        1.0f,  0.0f,  0.0f,
-
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-        0.0f, -1.0f,  0.0f,
-
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f,
-        0.0f,  1.0f,  0.0f
-    };
-
-    // Texture coordinates for each vertex.
-    float texCoords[] = {
-        0.0f, 0.0f, 
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f,
-
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f,
-
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f,
-
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f,
-
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f,
-
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f,
-        1.0f, 1.0f,
-        0.0f, 1.0f,
-        0.0f, 0.0f
-    };
-
-    // Generate storage on the GPU for our triangle and make it current.
-    // A VAO is a set of data buffers on the GPU.
-    glGenVertexArrays(1, &rectangleVertexVaoHandle);
-    glBindVertexArray(rectangleVertexVaoHandle);
-
-    // Generate 2 new buffers in our VAO to store per-vertex attributes.
-    // One buffer to store vertex positions.
-    // One buffer to store normal data.
-    unsigned int vertexBuffer;
-    unsigned int normalBuffer;
-    unsigned int textureBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(1, &normalBuffer);
-    glGenBuffers(1, &textureBuffer);
-
-    // --- VERTEX DATA
-
-    // Allocate GPU memory for our vertices and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 0)
-    // and how it is formatted (floating point, 3 values per vertex).
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, VALS_PER_VERT, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // --- NORMAL DATA
-
-    // Allocate GPU memory for our normals and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 1)
-    // and how it is formatted (floating point, 3 values per vertex).
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, VALS_PER_NORMAL, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // --- TEXTURE DATA
-
-    // Allocate GPU memory for our vertices and copy them over.
-    glBindBuffer(GL_ARRAY_BUFFER, textureBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
-
-    // Enable buffer and tell OpenGL how to interpret the data we just gave it.
-    // Tell OpenGL what shader variable it corresponds to (location = 2)
-    // and how it is formatted (floating point, 2 values per vertex).
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, VALS_PER_TEX_COORD, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // - Texture Diffuse
-
-    // Load and generate the first texture.
-    int width;
-    int height;
-    int numberOfChannels;
-    glUseProgram(shaderIDCube.ProgramID());
-
-    // Generate a texture buffer in our VAO to store texture data.
-    unsigned int texture1;
-    glGenTextures(1, &texture1);
-
-    // Allocate GPU memory for texture data to texture unit 0.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-
-    // Set the texture wrapping/filtering options (on the currently bound texture object).
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Tell stb_image.h to flip loaded texture's on the y-axis.
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* imageData1 = stbi_load("Textures/container2.png", &width, &height, &numberOfChannels, 0);
-    if(imageData1)
-    {
-        GLenum format = GL_RGB;
-        if(numberOfChannels == 1)
-        {
-            format = GL_RED;
-        }
-        else if(numberOfChannels == 3)
-        {
-            format = GL_RGB;
-        }
-        else if(numberOfChannels == 4)
-        {
-            format = GL_RGBA;
-        }
-
-        // If successfully read in texture data pass it to the buffer and generate mipmaps.
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, imageData1);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
+    // Both maps are decoded at once on worker threads, flipped on the y-axis as they're decoded rather than through
+    // stb_image's global flag, and uploaded through pixel unpack buffers.
+    auto start = std::chrono::high_resolution_clock::now();
+    TextureStreamer textureStreamer;
+    cubeDiffuseMap = textureStreamer.Load("Textures/container2.png", TEXTURE_LOAD_FLIP_VERTICALLY);
+    cubeSpecularMap = textureStreamer.Load("Textures/container2_specular.png", TEXTURE_LOAD_FLIP_VERTICALLY);
+    textureStreamer.WaitUntilResident(cubeDiffuseMap);
+    textureStreamer.WaitUntilResident(cubeSpecularMap);
+    if(!cubeDiffuseMap->IsResident() || !cubeSpecularMap->IsResident())
     {
         std::cout << "Failed to load texture" << std::endl;
     }
 
-    stbi_image_free(imageData1);
-
-    // Bind uniform to texture.
-    shaderIDCube.SetUniformInt("material.diffuse", 0);
+    TextureStreamingStats stats = textureStreamer.Stats();
+    std::cout << "TEXTURE::STREAM:: " << stats.textures << " textures decoded in " << stats.decodeMilliseconds
+              << " ms on workers, uploaded in " << stats.uploadMilliseconds << " ms, loaded after "
+              << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+    TextureCacheStats cache = SharedTextureCacheStats();
+    std::cout << "TEXTURE::CACHE:: " << cache.uploads << " uploaded, " << cache.pathHits << " path hits, " << cache.contentHits
+              << " content hits, " << cache.live << " live in " << cache.liveBytes / 1024 << " KB, " << cache.savedBytes / 1024 << " KB not duplicated"
+              << std::endl;
 
-    // - Texture Specular
-
-    // Generate a texture buffer in our VAO to store texture data.
-    unsigned int texture2;
-    glGenTextures(1, &texture2);
-
-    // Allocate GPU memory for texture data to texture unit 1.
+    // Diffuse map on texture unit 0, specular map on texture unit 1.
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, cubeDiffuseMap->ID());
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glBindTexture(GL_TEXTURE_2D, cubeSpecularMap->ID());
 
-    // Set the texture wrapping/filtering options (on the currently bound texture object).
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    unsigned char* imageData2 = stbi_load("Textures/container2_specular.png", &width, &height, &numberOfChannels, 0);
-    if(imageData2)
-    {
-        GLenum format = GL_RGB;
-        if(numberOfChannels == 1)
-        {
-            format = GL_RED;
-        }
-        else if(numberOfChannels == 3)
-        {
-            format = GL_RGB;
-        }
-        else if(numberOfChannels == 4)
-        {
-            format = GL_RGBA;
-        }
-
-        // If successfully read in texture data pass it to the buffer and generate mipmaps.
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, imageData2);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-
-    stbi_image_free(imageData2);
-
-    // Bind uniform to texture.
+    // Bind uniforms to textures.
+    shaderIDCube.SetUniformInt("material.diffuse", 0);
     shaderIDCube.SetUniformInt("material.specular", 1);
 
-    // An argument of zero unbinds all VAO's and stops us
-    // from accidentally changing the VAO state.
-    glBindVertexArray(0);
-
-    // The same is true for buffers, so we unbind it too.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
     return 0;	// Return success.
 }
 
@@ -461,9 +195,6 @@ void Render()
     // Specify the shader program we want to use.
     glUseProgram(shaderIDCube.ProgramID());
 
-    // Make the VAO with our vertex data buffer current.
-    glBindVertexArray(rectangleVertexVaoHandle);
-
     SendCameraDetails(shaderIDCube);
 
     // Set light position.
@@ -488,16 +219,13 @@ void Render()
     model = glm::rotate(model, (float) glm::radians(73.0f * sin(glfwGetTime() * 0.6f)), glm::vec3(1.0f, 0.3f, 0.5f));
     shaderIDCube.SetUniformMat4("model", model);
 
-    glDrawArrays(GL_TRIANGLES, 0, 36); // 36 vertices per cube. 2 tris per face, 3 verts per tri.
+    GetPrimitive(PRIMITIVE_CUBE).Draw();
 
     // --- DRAW LIGHT
 
     // Specify the shader program we want to use.
     glUseProgram(shaderIDLight.ProgramID());
 
-    // Make the VAO with our vertex data buffer current.
-    glBindVertexArray(rectangleVertexVaoHandle);
-
     SendCameraDetails(shaderIDLight);
 
     // Set light obj colour
@@ -509,7 +237,7 @@ void Render()
     model = glm::scale(model, glm::vec3(0.23f, 0.23f, 0.23f));
     shaderIDLight.SetUniformMat4("model", model);
 
-    glDrawArrays(GL_TRIANGLES, 0, 36); // 36 vertices per cube. 2 tris per face, 3 verts per tri.
+    GetPrimitive(PRIMITIVE_CUBE).Draw();
 
     glFlush();	// Guarantees previous commands have been completed before continuing.
 }
@@ -583,10 +311,10 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    // Set the vertex data for a rectangle.
-    if(SetCubeVertexData() != 0)
+    // Set the textures for the cubes.
+    if(SetCubeTextures() != 0)
     {
-        std::cout << "Failed to set vertex data." << std::endl;
+        std::cout << "Failed to set cube textures." << std::endl;
         exit(1);
     }
 
@@ -615,7 +343,9 @@ int main(int argc, char** argv)
         glfwPollEvents();
     }
 
-    // Clean up
+    // Clean up, freeing the textures while their context is still current.
+    cubeDiffuseMap.reset();
+    cubeSpecularMap.reset();
     glfwDestroyWindow(window);
     glfwTerminate();
     exit(0);
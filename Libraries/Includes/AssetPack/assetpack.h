@@ -0,0 +1,321 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <AtomicFile/atomicfile.h>
+#include <Compression/lz4.h>
+#include <FileMapping/filemapping.h>
+#include <Hash/hash.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Asset packs start with "APAK" followed by the format version.
+const uint32_t ASSET_PACK_MAGIC = 0x4B415041;
+const uint32_t ASSET_PACK_VERSION = 1;
+
+// Every entry starts on this boundary, so stored entries such as cooked models keep their own alignment in the mapping.
+const uint64_t ASSET_PACK_ALIGNMENT = 16;
+
+// Entry flags.
+const uint32_t ASSET_FLAG_LZ4 = 1;              // Stored LZ4 compressed, see Compression/lz4.h.
+const uint32_t ASSET_FLAG_DECODED_TEXTURE = 2;  // An image decoded by the cooker, a DecodedTextureHeader then the pixels.
+
+// Compression is only kept when it saves at least an eighth of the entry, below that reading it whole is cheaper.
+const uint64_t ASSET_PACK_MIN_SAVING = 8;
+
+// Compressed entries claiming to decode to more than this many times the pack's size are treated as damaged, so a bad
+// pack can't ask for an absurd allocation. LZ4 can't expand anything past 255 to 1.
+const uint64_t ASSET_PACK_MAX_DECODED_RATIO = 256;
+
+///
+/// File header. The sorted index follows it, then the name block, then the entries' data.
+///
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t nameBytes;
+    uint64_t fileSize;
+};
+
+///
+/// One index entry. Entries are sorted by hash so a lookup is a binary search.
+///
+struct AssetPackEntry
+{
+    uint64_t hash;          // HashBytes of the normalised name.
+    uint64_t offset;        // From the start of the file.
+    uint64_t storedSize;    // Size in the file, compressed or not.
+    uint64_t size;          // Size once read.
+    uint32_t nameOffset;    // Into the name block, names are compared to tell hash collisions apart.
+    uint32_t nameLength;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+///
+/// Start of an ASSET_FLAG_DECODED_TEXTURE entry. Rows of 8 bit pixels follow, top row first, as stbi_load
+/// returns them without flipping.
+///
+struct DecodedTextureHeader
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t components;
+    uint32_t reserved;
+};
+
+///
+/// A file to pack.
+///
+struct AssetPackSource
+{
+    std::string name;
+    std::vector<unsigned char> data;
+    uint32_t flags = 0;         // ASSET_FLAG_DECODED_TEXTURE if applicable. ASSET_FLAG_LZ4 is decided by the writer.
+    bool compressible = true;   // False for entries that are used straight from the mapping.
+};
+
+///
+/// Normalises a path for use as an entry name: forward slashes, no "./" components and no repeated separators,
+/// so that the different spellings the code uses for one file find the same entry.
+///
+inline std::string NormaliseAssetPath(const std::string& path)
+{
+    std::string normalised;
+    normalised.reserve(path.size());
+    for(size_t i = 0; i < path.size(); i++)
+    {
+        char c = path[i] == '\\' ? '/' : path[i];
+        bool atComponentStart = normalised.empty() || normalised.back() == '/';
+        if(c == '/' && atComponentStart && !normalised.empty())
+        {
+            continue;
+        }
+        if(c == '.' && atComponentStart && (i + 1 == path.size() || path[i + 1] == '/' || path[i + 1] == '\\'))
+        {
+            i++;
+            continue;
+        }
+        normalised += c;
+    }
+    return normalised;
+}
+
+///
+/// Hash an entry is indexed by.
+///
+inline uint64_t AssetNameHash(const std::string& normalisedName)
+{
+    return HashBytes(normalisedName.data(), normalisedName.size());
+}
+
+///
+/// Writes an asset pack. Entries are compressed where it pays off, sorted by name hash and aligned. The file is
+/// written with WriteFileAtomically, the same as cooked models.
+/// \param packPath - the file to write.
+/// \param sources - the files to pack, names are normalised by the writer.
+/// \param compress - allow LZ4 compression of compressible entries.
+/// \return - true on success.
+///
+inline bool WriteAssetPack(const std::string& packPath, const std::vector<AssetPackSource>& sources, bool compress)
+{
+    // Compress and name the entries.
+    std::vector<AssetPackEntry> entries(sources.size());
+    std::vector<std::vector<unsigned char>> compressed(sources.size());
+    std::string names;
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        const AssetPackSource& source = sources[i];
+        std::string name = NormaliseAssetPath(source.name);
+        AssetPackEntry& entry = entries[i];
+        entry.hash = AssetNameHash(name);
+        entry.size = source.data.size();
+        entry.storedSize = entry.size;
+        entry.nameOffset = ( uint32_t) names.size();
+        entry.nameLength = ( uint32_t) name.size();
+        entry.flags = source.flags & ~ASSET_FLAG_LZ4;
+        entry.reserved = ( uint32_t) i; // Source index until the data is written.
+        names += name;
+
+        if(compress && source.compressible && !source.data.empty())
+        {
+            compressed[i].resize(Lz4CompressBound(source.data.size()));
+            size_t compressedSize = Lz4Compress(source.data.data(), source.data.size(), compressed[i].data(), compressed[i].size());
+            if(compressedSize != 0 && compressedSize <= entry.size - entry.size / ASSET_PACK_MIN_SAVING)
+            {
+                compressed[i].resize(compressedSize);
+                entry.storedSize = compressedSize;
+                entry.flags |= ASSET_FLAG_LZ4;
+            }
+            else
+            {
+                compressed[i].clear();
+            }
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const AssetPackEntry& a, const AssetPackEntry& b) { return a.hash < b.hash; });
+
+    // Lay out the data.
+    AssetPackHeader header;
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = ( uint32_t) entries.size();
+    header.nameBytes = ( uint32_t) names.size();
+    uint64_t offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry) + names.size();
+    for(AssetPackEntry& entry : entries)
+    {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+    header.fileSize = offset;
+
+    std::vector<FileChunk> chunks;
+    uint64_t written = 0;
+    auto write = [&](const void* data, uint64_t size)
+    {
+        chunks.push_back(FileChunk{ data, ( size_t) size });
+        written += size;
+    };
+
+    write(&header, sizeof(header));
+    std::vector<AssetPackEntry> index = entries;
+    for(AssetPackEntry& entry : index)
+    {
+        entry.reserved = 0;
+    }
+    write(index.data(), index.size() * sizeof(AssetPackEntry));
+    write(names.data(), names.size());
+    static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+    for(const AssetPackEntry& entry : entries)
+    {
+        write(zeros, entry.offset - written);
+        const std::vector<unsigned char>& data = entry.flags & ASSET_FLAG_LZ4 ? compressed[entry.reserved] : sources[entry.reserved].data;
+        write(data.data(), data.size());
+    }
+    return WriteFileAtomically(packPath, chunks);
+}
+
+///
+/// A mapped asset pack. The index is searched in place, and stored entries can be used straight from the mapping.
+///
+class AssetPack
+{
+public:
+    AssetPack()
+    {
+    }
+
+    // A pack owns its mapping.
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    ///
+    /// Maps a pack and checks its header, index and entry bounds.
+    /// \param path - the pack file.
+    /// \return - false if the file is missing, from another version or damaged.
+    ///
+    bool Open(const std::string& path)
+    {
+        entries = NULL;
+        names = NULL;
+        entryCount = 0;
+        if(!mapping.Open(path) || mapping.Size() < sizeof(AssetPackHeader))
+        {
+            mapping.Close();
+            return false;
+        }
+
+        AssetPackHeader header;
+        std::memcpy(&header, mapping.Data(), sizeof(header));
+        const uint64_t size = mapping.Size();
+        const uint64_t nameBlock = sizeof(AssetPackHeader) + ( uint64_t) header.entryCount * sizeof(AssetPackEntry);
+        if(header.magic != ASSET_PACK_MAGIC || header.version != ASSET_PACK_VERSION || header.fileSize != size || nameBlock + header.nameBytes > size)
+        {
+            mapping.Close();
+            return false;
+        }
+
+        const AssetPackEntry* index = reinterpret_cast<const AssetPackEntry*>(mapping.Data() + sizeof(AssetPackHeader));
+        for(uint32_t i = 0; i < header.entryCount; i++)
+        {
+            const AssetPackEntry& entry = index[i];
+            if(entry.offset > size || entry.storedSize > size - entry.offset || ( uint64_t) entry.nameOffset + entry.nameLength > header.nameBytes
+               || (!(entry.flags & ASSET_FLAG_LZ4) && entry.storedSize != entry.size) || entry.size > size * ASSET_PACK_MAX_DECODED_RATIO
+               || (i > 0 && index[i - 1].hash > entry.hash))
+            {
+                mapping.Close();
+                return false;
+            }
+        }
+
+        entries = index;
+        names = reinterpret_cast<const char*>(mapping.Data() + nameBlock);
+        entryCount = header.entryCount;
+        return true;
+    }
+
+    bool IsOpen() const
+    {
+        return mapping.IsOpen();
+    }
+
+    ///
+    /// Looks an entry up by name.
+    /// \param path - the asset's path, normalised before the lookup.
+    /// \return - the entry, or NULL if the pack doesn't hold the asset.
+    ///
+    const AssetPackEntry* Find(const std::string& path) const
+    {
+        std::string name = NormaliseAssetPath(path);
+        uint64_t hash = AssetNameHash(name);
+        const AssetPackEntry* end = entries + entryCount;
+        const AssetPackEntry* entry = std::lower_bound(entries, end, hash, [](const AssetPackEntry& a, uint64_t h) { return a.hash < h; });
+        for(; entry != end && entry->hash == hash; entry++)
+        {
+            if(entry->nameLength == name.size() && std::memcmp(names + entry->nameOffset, name.data(), name.size()) == 0)
+            {
+                return entry;
+            }
+        }
+        return NULL;
+    }
+
+    ///
+    /// The entry's bytes as stored in the mapping. Only usable as they are if the entry isn't compressed.
+    ///
+    const unsigned char* Stored(const AssetPackEntry& entry) const
+    {
+        return mapping.Data() + entry.offset;
+    }
+
+    ///
+    /// Reads an entry, decompressing it if needed.
+    /// \param entry - an entry of this pack.
+    /// \param data - receives the entry's bytes.
+    /// \return - false if the entry is damaged.
+    ///
+    bool Read(const AssetPackEntry& entry, std::vector<unsigned char>& data) const
+    {
+        data.resize(( size_t) entry.size);
+        if(entry.flags & ASSET_FLAG_LZ4)
+        {
+            return Lz4Decompress(Stored(entry), ( size_t) entry.storedSize, data.data(), data.size());
+        }
+        std::memcpy(data.data(), Stored(entry), data.size());
+        return true;
+    }
+
+private:
+    FileMapping mapping;
+    const AssetPackEntry* entries = NULL;
+    const char* names = NULL;
+    uint32_t entryCount = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writing files that are read back on later runs, such as caches and cooked assets, so that a crash or a full disc
+// part way through never leaves a truncated file where a reader would take it for a whole one.
+
+// Extension of the temporary file a file is written to before it's renamed into place.
+const char* const ATOMIC_FILE_EXTENSION = ".tmp";
+
+///
+/// A run of bytes to write; a file is written as its chunks one after another.
+///
+struct FileChunk
+{
+    const void* data;
+    size_t size;
+};
+
+///
+/// Writes a file under a temporary name and renames it into place. If writing fails the temporary file is removed
+/// and any old file is left as it was.
+/// \param path - the file to write.
+/// \param chunks - the file's contents, in order.
+/// \return - true on success.
+///
+inline bool WriteFileAtomically(const std::string& path, const std::vector<FileChunk>& chunks)
+{
+    std::string temporaryPath = path + ATOMIC_FILE_EXTENSION;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        for(size_t i = 0; file && i < chunks.size(); i++)
+        {
+            file.write(static_cast<const char*>(chunks[i].data), ( std::streamsize) chunks[i].size);
+        }
+        // Closing flushes what's still buffered, which can fail too.
+        file.close();
+        if(!file)
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    // Replaces the old file in one step, so a reader or a crash sees either the old file or the new one. rename does
+    // that on POSIX, but fails on Windows if the file exists. Paths are narrow, as in FileMapping.
+#ifdef _WIN32
+    bool renamed = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+    if(!renamed)
+    {
+        std::remove(temporaryPath.c_str());
+    }
+    return renamed;
+}
+
+#endif
\ No newline at end of file
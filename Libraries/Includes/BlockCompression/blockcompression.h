@@ -0,0 +1,1033 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// CPU encoders and decoders for the BCn block compressed texture formats. Every format stores 4x4 pixel blocks in a
+// fixed number of bytes, so the GPU samples them directly at a quarter or an eighth of the memory and bandwidth of 8
+// bit pixels. The encoders fit each block's endpoints along the principal axis of its pixels, then refine them with
+// least squares against the chosen indices. Index selection runs four pixels at a time with SSE2 where it's there,
+// and whole images are compressed a row of blocks per work item across the worker threads. BC7 images transcode to
+// BC1 or BC3 without being fitted again, for contexts that can't sample BC7.
+
+enum BlockFormat
+{
+    BLOCK_FORMAT_BC1,   // RGB at 4 bits a pixel, for opaque colour maps.
+    BLOCK_FORMAT_BC3,   // RGBA at 8 bits a pixel, BC1 colour with a BC4 block for alpha.
+    BLOCK_FORMAT_BC4,   // One channel at 4 bits a pixel, for specular and other grey maps.
+    BLOCK_FORMAT_BC5,   // Two channels at 8 bits a pixel, for the X and Y of tangent space normal maps.
+    BLOCK_FORMAT_BC7    // RGBA at 8 bits a pixel, for colour maps that need more quality. Only mode 6 is written.
+};
+
+// Interpolation weights of BC7's 4 bit indices, out of 64.
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+///
+/// Bytes each 4x4 block takes in a format.
+///
+inline size_t BlockFormatBytes(BlockFormat format)
+{
+    return format == BLOCK_FORMAT_BC1 || format == BLOCK_FORMAT_BC4 ? 8 : 16;
+}
+
+///
+/// Size of an image compressed in a format. Partial blocks at the right and bottom edges take a whole block.
+///
+inline size_t CompressedImageSize(BlockFormat format, int width, int height)
+{
+    return (( size_t) (width + 3) / 4) * (( size_t) (height + 3) / 4) * BlockFormatBytes(format);
+}
+
+// A block's pixels, one plane of 16 values per channel so four pixels load into one register.
+struct BlockPixels
+{
+    alignas(16) float channels[4][16];
+};
+
+///
+/// Gathers the 4x4 block at a block position of an RGBA image. Blocks over the right or bottom edge repeat the last
+/// column or row, which keeps the padding from pulling the endpoints away from the pixels that are seen.
+///
+inline void LoadBlockPixels(const unsigned char* rgba, int width, int height, int blockX, int blockY, BlockPixels& pixels)
+{
+    for(int y = 0; y < 4; y++)
+    {
+        int row = std::min(blockY * 4 + y, height - 1);
+        for(int x = 0; x < 4; x++)
+        {
+            int column = std::min(blockX * 4 + x, width - 1);
+            const unsigned char* pixel = rgba + (( size_t) row * width + column) * 4;
+            for(int c = 0; c < 4; c++)
+            {
+                pixels.channels[c][y * 4 + x] = pixel[c];
+            }
+        }
+    }
+}
+
+///
+/// Picks the nearest palette entry for every pixel of a block.
+/// \param pixels - the block.
+/// \param firstChannel - first channel compared.
+/// \param channelCount - number of channels compared, from firstChannel on.
+/// \param palette - the colours the block's indices can select, channels from firstChannel on.
+/// \param paletteSize - number of palette entries.
+/// \param indices - receives each pixel's palette index.
+/// \return - the total squared error of the selection.
+///
+inline float SelectBlockIndices(const BlockPixels& pixels, int firstChannel, int channelCount, const float palette[][4], int paletteSize,
+                                unsigned char indices[16])
+{
+    float error = 0.0f;
+#ifdef BLOCK_COMPRESSION_SSE2
+    for(int group = 0; group < 16; group += 4)
+    {
+        __m128 values[4];
+        for(int c = 0; c < channelCount; c++)
+        {
+            values[c] = _mm_load_ps(&pixels.channels[firstChannel + c][group]);
+        }
+        __m128 best = _mm_set1_ps(INFINITY);
+        __m128 bestIndex = _mm_setzero_ps();
+        for(int entry = 0; entry < paletteSize; entry++)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for(int c = 0; c < channelCount; c++)
+            {
+                __m128 difference = _mm_sub_ps(values[c], _mm_set1_ps(palette[entry][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+            }
+            __m128 closer = _mm_cmplt_ps(distance, best);
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(( float) entry)), _mm_andnot_ps(closer, bestIndex));
+        }
+
+        alignas(16) float lanes[4];
+        alignas(16) float chosen[4];
+        _mm_store_ps(lanes, best);
+        _mm_store_ps(chosen, bestIndex);
+        for(int lane = 0; lane < 4; lane++)
+        {
+            indices[group + lane] = ( unsigned char) chosen[lane];
+            error += lanes[lane];
+        }
+    }
+#else
+    for(int i = 0; i < 16; i++)
+    {
+        float best = INFINITY;
+        for(int entry = 0; entry < paletteSize; entry++)
+        {
+            float distance = 0.0f;
+            for(int c = 0; c < channelCount; c++)
+            {
+                float difference = pixels.channels[firstChannel + c][i] - palette[entry][c];
+                distance += difference * difference;
+            }
+            if(distance < best)
+            {
+                best = distance;
+                indices[i] = ( unsigned char) entry;
+            }
+        }
+        error += best;
+    }
+#endif
+    return error;
+}
+
+///
+/// Finds the line through a block's pixels that fits them best, by power iteration on their covariance, and the
+/// extent of the pixels along it.
+/// \param pixels - the block.
+/// \param channelCount - number of channels fitted, from the first.
+/// \param start - receives the line's end where the projections are smallest.
+/// \param end - receives the line's end where the projections are largest.
+///
+inline void FitBlockEndpoints(const BlockPixels& pixels, int channelCount, float start[4], float end[4])
+{
+    float mean[4] = {};
+    for(int c = 0; c < channelCount; c++)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            mean[c] += pixels.channels[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for(int a = 0; a < channelCount; a++)
+    {
+        for(int b = a; b < channelCount; b++)
+        {
+            float sum = 0.0f;
+            for(int i = 0; i < 16; i++)
+            {
+                sum += (pixels.channels[a][i] - mean[a]) * (pixels.channels[b][i] - mean[b]);
+            }
+            covariance[a][b] = sum;
+            covariance[b][a] = sum;
+        }
+    }
+
+    // The diagonal of the bounding box is a good first guess, and a few iterations settle on the main axis.
+    float axis[4] = {};
+    for(int c = 0; c < channelCount; c++)
+    {
+        float minimum = *std::min_element(pixels.channels[c], pixels.channels[c] + 16);
+        float maximum = *std::max_element(pixels.channels[c], pixels.channels[c] + 16);
+        axis[c] = maximum - minimum;
+    }
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for(int a = 0; a < channelCount; a++)
+        {
+            for(int b = 0; b < channelCount; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if(length == 0.0f)
+        {
+            break;
+        }
+        for(int c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float lengthSquared = 0.0f;
+    for(int c = 0; c < channelCount; c++)
+    {
+        lengthSquared += axis[c] * axis[c];
+    }
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    if(lengthSquared > 0.0f)
+    {
+        lowest = INFINITY;
+        highest = -INFINITY;
+        for(int i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+            for(int c = 0; c < channelCount; c++)
+            {
+                projection += (pixels.channels[c][i] - mean[c]) * axis[c];
+            }
+            lowest = std::min(lowest, projection);
+            highest = std::max(highest, projection);
+        }
+        lowest /= lengthSquared;
+        highest /= lengthSquared;
+    }
+    for(int c = 0; c < channelCount; c++)
+    {
+        start[c] = std::min(std::max(mean[c] + axis[c] * lowest, 0.0f), 255.0f);
+        end[c] = std::min(std::max(mean[c] + axis[c] * highest, 0.0f), 255.0f);
+    }
+}
+
+///
+/// Solves for the two endpoints that best reproduce a block's pixels, given how far along from the first endpoint
+/// to the second each pixel's index puts it.
+/// \param weights - each pixel's position between the endpoints, 0 at the first and 1 at the second.
+/// \return - false if the indices don't pin down two endpoints, e.g. all pixels use the same one.
+///
+inline bool SolveBlockEndpoints(const BlockPixels& pixels, int firstChannel, int channelCount, const float weights[16], float start[4], float end[4])
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for(int i = 0; i < 16; i++)
+    {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(int c = 0; c < channelCount; c++)
+        {
+            ax[c] += a * pixels.channels[firstChannel + c][i];
+            bx[c] += b * pixels.channels[firstChannel + c][i];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if(std::fabs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+    for(int c = 0; c < channelCount; c++)
+    {
+        start[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+        end[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+// Packs and unpacks BC1's 5:6:5 endpoint colours.
+inline uint16_t PackRgb565(const float colour[3])
+{
+    uint32_t r = ( uint32_t) std::lround(colour[0] * 31.0f / 255.0f);
+    uint32_t g = ( uint32_t) std::lround(colour[1] * 63.0f / 255.0f);
+    uint32_t b = ( uint32_t) std::lround(colour[2] * 31.0f / 255.0f);
+    return ( uint16_t) (r << 11 | g << 5 | b);
+}
+
+inline void UnpackRgb565(uint16_t packed, int colour[3])
+{
+    int r = packed >> 11;
+    int g = (packed >> 5) & 0x3F;
+    int b = packed & 0x1F;
+    colour[0] = r << 3 | r >> 2;
+    colour[1] = g << 2 | g >> 4;
+    colour[2] = b << 3 | b >> 2;
+}
+
+// Palette of a four colour BC1 block, in index order.
+inline void Bc1Palette(uint16_t colour0, uint16_t colour1, float palette[4][4])
+{
+    int a[3];
+    int b[3];
+    UnpackRgb565(colour0, a);
+    UnpackRgb565(colour1, b);
+    for(int c = 0; c < 3; c++)
+    {
+        palette[0][c] = ( float) a[c];
+        palette[1][c] = ( float) b[c];
+        palette[2][c] = ( float) ((2 * a[c] + b[c]) / 3);
+        palette[3][c] = ( float) ((a[c] + 2 * b[c]) / 3);
+    }
+}
+
+///
+/// Encodes a block's RGB as a four colour BC1 block. Alpha is ignored, BC1 is only written for opaque images.
+/// \param pixels - the block.
+/// \param block - receives the 8 byte block.
+/// \return - the block's total squared error.
+///
+inline float EncodeBc1Block(const BlockPixels& pixels, unsigned char block[8])
+{
+    // Position of each BC1 index between colour0 and colour1.
+    static const float INDEX_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float start[4];
+    float end[4];
+    FitBlockEndpoints(pixels, 3, start, end);
+
+    uint16_t bestColours[2] = { 0, 0 };
+    unsigned char bestIndices[16] = {};
+    float bestError = INFINITY;
+    for(int iteration = 0; iteration < 3; iteration++)
+    {
+        // The four colour mode needs colour0 above colour1. Equal colours fall into the three colour mode, where
+        // index 0 is still colour0, so such a block keeps every index at 0.
+        uint16_t colour0 = PackRgb565(end);
+        uint16_t colour1 = PackRgb565(start);
+        if(colour0 < colour1)
+        {
+            std::swap(colour0, colour1);
+        }
+
+        unsigned char indices[16] = {};
+        float error = 0.0f;
+        float palette[4][4];
+        Bc1Palette(colour0, colour1, palette);
+        if(colour0 == colour1)
+        {
+            error = SelectBlockIndices(pixels, 0, 3, palette, 1, indices);
+        }
+        else
+        {
+            error = SelectBlockIndices(pixels, 0, 3, palette, 4, indices);
+        }
+        if(error < bestError)
+        {
+            bestError = error;
+            bestColours[0] = colour0;
+            bestColours[1] = colour1;
+            std::memcpy(bestIndices, indices, 16);
+        }
+
+        float weights[16];
+        for(int i = 0; i < 16; i++)
+        {
+            weights[i] = INDEX_WEIGHTS[indices[i]];
+        }
+        if(bestError == 0.0f || !SolveBlockEndpoints(pixels, 0, 3, weights, end, start))
+        {
+            break;
+        }
+    }
+
+    block[0] = ( unsigned char) bestColours[0];
+    block[1] = ( unsigned char) (bestColours[0] >> 8);
+    block[2] = ( unsigned char) bestColours[1];
+    block[3] = ( unsigned char) (bestColours[1] >> 8);
+    uint32_t packed = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        packed |= ( uint32_t) bestIndices[i] << (2 * i);
+    }
+    for(int b = 0; b < 4; b++)
+    {
+        block[4 + b] = ( unsigned char) (packed >> (8 * b));
+    }
+    return bestError;
+}
+
+// Palette of an eight value BC4 block, in index order.
+inline void Bc4Palette(int value0, int value1, float palette[8][4])
+{
+    palette[0][0] = ( float) value0;
+    palette[1][0] = ( float) value1;
+    for(int i = 2; i < 8; i++)
+    {
+        palette[i][0] = ( float) (((8 - i) * value0 + (i - 1) * value1) / 7);
+    }
+}
+
+// Packs a BC4 block's endpoints and 3 bit indices.
+inline void PackBc4Block(int value0, int value1, const unsigned char indices[16], unsigned char block[8])
+{
+    block[0] = ( unsigned char) value0;
+    block[1] = ( unsigned char) value1;
+    uint64_t packed = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        packed |= ( uint64_t) indices[i] << (3 * i);
+    }
+    for(int b = 0; b < 6; b++)
+    {
+        block[2 + b] = ( unsigned char) (packed >> (8 * b));
+    }
+}
+
+///
+/// Encodes one channel of a block as a BC4 block, using the eight value mode.
+/// \param pixels - the block.
+/// \param channel - the channel to encode.
+/// \param block - receives the 8 byte block.
+/// \return - the block's total squared error.
+///
+inline float EncodeBc4Block(const BlockPixels& pixels, int channel, unsigned char block[8])
+{
+    // Position of each BC4 index between value0 and value1.
+    static const float INDEX_WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+    float start = *std::min_element(pixels.channels[channel], pixels.channels[channel] + 16);
+    float end = *std::max_element(pixels.channels[channel], pixels.channels[channel] + 16);
+
+    int bestValues[2] = { ( int) end, ( int) end };
+    unsigned char bestIndices[16] = {};
+    float bestError = INFINITY;
+    for(int iteration = 0; iteration < 2 && end > start; iteration++)
+    {
+        // The eight value mode needs value0 above value1.
+        int value0 = ( int) std::lround(end);
+        int value1 = ( int) std::lround(start);
+        if(value0 <= value1)
+        {
+            break;
+        }
+
+        float palette[8][4];
+        Bc4Palette(value0, value1, palette);
+        unsigned char indices[16];
+        float error = SelectBlockIndices(pixels, channel, 1, palette, 8, indices);
+        if(error < bestError)
+        {
+            bestError = error;
+            bestValues[0] = value0;
+            bestValues[1] = value1;
+            std::memcpy(bestIndices, indices, 16);
+        }
+
+        float weights[16];
+        for(int i = 0; i < 16; i++)
+        {
+            weights[i] = INDEX_WEIGHTS[indices[i]];
+        }
+        float refinedEnd[4];
+        float refinedStart[4];
+        if(bestError == 0.0f || !SolveBlockEndpoints(pixels, channel, 1, weights, refinedEnd, refinedStart))
+        {
+            break;
+        }
+        end = refinedEnd[0];
+        start = refinedStart[0];
+    }
+
+    // Flat blocks, and ones whose range rounds away, are a single value.
+    if(bestError == INFINITY)
+    {
+        bestError = 0.0f;
+        for(int i = 0; i < 16; i++)
+        {
+            float difference = pixels.channels[channel][i] - bestValues[0];
+            bestError += difference * difference;
+        }
+    }
+    PackBc4Block(bestValues[0], bestValues[1], bestIndices, block);
+    return bestError;
+}
+
+// Quantises a BC7 mode 6 endpoint to 7 bits a channel and the shared low bit that gets closest to it.
+inline void QuantiseBc7Endpoint(const float endpoint[4], int quantised[4], int& pBit)
+{
+    float bestError = INFINITY;
+    for(int p = 0; p < 2; p++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for(int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::min(std::max(( int) std::lround((endpoint[c] - p) / 2.0f), 0), 127);
+            float difference = ( float) (candidate[c] << 1 | p) - endpoint[c];
+            error += difference * difference;
+        }
+        if(error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::memcpy(quantised, candidate, sizeof(candidate));
+        }
+    }
+}
+
+// The fields of a BC7 mode 6 block.
+struct Bc7Mode6Block
+{
+    int endpoints[2][4];        // 7 bits a channel.
+    int pBits[2];               // Low bit shared by each endpoint's channels.
+    unsigned char indices[16];  // 4 bits each.
+};
+
+// Palette of a BC7 mode 6 block, in index order.
+inline void Bc7Palette(const Bc7Mode6Block& fields, float palette[16][4])
+{
+    for(int c = 0; c < 4; c++)
+    {
+        int value0 = fields.endpoints[0][c] << 1 | fields.pBits[0];
+        int value1 = fields.endpoints[1][c] << 1 | fields.pBits[1];
+        for(int i = 0; i < 16; i++)
+        {
+            palette[i][c] = ( float) (((64 - BC7_WEIGHTS[i]) * value0 + BC7_WEIGHTS[i] * value1 + 32) >> 6);
+        }
+    }
+}
+
+///
+/// Packs the fields of a mode 6 block. The first index is stored without its top bit, which is implied to be clear,
+/// so the endpoints swap and the indices invert when it would be set.
+///
+inline void PackBc7Block(const Bc7Mode6Block& fields, unsigned char block[16])
+{
+    bool swap = fields.indices[0] >= 8;
+    int first = swap ? 1 : 0;
+    uint64_t low = 1 << 6;
+    for(int c = 0; c < 4; c++)
+    {
+        low |= ( uint64_t) fields.endpoints[first][c] << (7 + c * 14);
+        low |= ( uint64_t) fields.endpoints[1 - first][c] << (14 + c * 14);
+    }
+    low |= ( uint64_t) fields.pBits[first] << 63;
+    uint64_t high = ( uint64_t) fields.pBits[1 - first];
+    unsigned int flip = swap ? 15 : 0;
+    high |= ( uint64_t) (fields.indices[0] ^ flip) << 1;
+    for(int i = 1; i < 16; i++)
+    {
+        high |= ( uint64_t) (fields.indices[i] ^ flip) << (i * 4);
+    }
+    for(int b = 0; b < 8; b++)
+    {
+        block[b] = ( unsigned char) (low >> (8 * b));
+        block[8 + b] = ( unsigned char) (high >> (8 * b));
+    }
+}
+
+///
+/// Unpacks the fields of a mode 6 block.
+/// \return - false for blocks in any other mode, which the encoder never writes.
+///
+inline bool UnpackBc7Block(const unsigned char block[16], Bc7Mode6Block& fields)
+{
+    if((block[0] & 0x7F) != 1 << 6)
+    {
+        return false;
+    }
+    uint64_t low = 0;
+    uint64_t high = 0;
+    for(int b = 0; b < 8; b++)
+    {
+        low |= ( uint64_t) block[b] << (8 * b);
+        high |= ( uint64_t) block[8 + b] << (8 * b);
+    }
+    for(int c = 0; c < 4; c++)
+    {
+        fields.endpoints[0][c] = ( int) (low >> (7 + c * 14)) & 0x7F;
+        fields.endpoints[1][c] = ( int) (low >> (14 + c * 14)) & 0x7F;
+    }
+    fields.pBits[0] = ( int) (low >> 63);
+    fields.pBits[1] = ( int) high & 1;
+    fields.indices[0] = ( unsigned char) ((high >> 1) & 7);
+    for(int i = 1; i < 16; i++)
+    {
+        fields.indices[i] = ( unsigned char) ((high >> (i * 4)) & 15);
+    }
+    return true;
+}
+
+///
+/// Encodes a block as a BC7 mode 6 block: one RGBA line with 7 bit endpoints, a low bit each and 16 steps.
+/// \param pixels - the block.
+/// \param block - receives the 16 byte block.
+/// \return - the block's total squared error.
+///
+inline float EncodeBc7Block(const BlockPixels& pixels, unsigned char block[16])
+{
+    float start[4];
+    float end[4];
+    FitBlockEndpoints(pixels, 4, start, end);
+
+    Bc7Mode6Block best = {};
+    float bestError = INFINITY;
+    for(int iteration = 0; iteration < 3; iteration++)
+    {
+        Bc7Mode6Block fields;
+        QuantiseBc7Endpoint(start, fields.endpoints[0], fields.pBits[0]);
+        QuantiseBc7Endpoint(end, fields.endpoints[1], fields.pBits[1]);
+
+        float palette[16][4];
+        Bc7Palette(fields, palette);
+        float error = SelectBlockIndices(pixels, 0, 4, palette, 16, fields.indices);
+        if(error < bestError)
+        {
+            bestError = error;
+            best = fields;
+        }
+
+        float weights[16];
+        for(int i = 0; i < 16; i++)
+        {
+            weights[i] = BC7_WEIGHTS[fields.indices[i]] / 64.0f;
+        }
+        if(bestError == 0.0f || !SolveBlockEndpoints(pixels, 0, 4, weights, start, end))
+        {
+            break;
+        }
+    }
+    PackBc7Block(best, block);
+    return bestError;
+}
+
+///
+/// Tries a neighbouring block's endpoints for a BC7 block, keeping them if the indices they need cost no more than
+/// the tolerance in extra error. Blocks that repeat their neighbour's endpoints take next to nothing once the image
+/// is supercompressed.
+/// \param pixels - the block.
+/// \param neighbour - the encoded block whose endpoints are tried.
+/// \param error - the block's error as it's encoded now.
+/// \param tolerance - the extra total squared error allowed.
+/// \param block - the encoded block, replaced if the endpoints are reused.
+/// \return - the block's error after the choice.
+///
+inline float ReuseBc7Endpoints(const BlockPixels& pixels, const unsigned char neighbour[16], float error, float tolerance, unsigned char block[16])
+{
+    Bc7Mode6Block fields;
+    if(!UnpackBc7Block(neighbour, fields))
+    {
+        return error;
+    }
+    float palette[16][4];
+    Bc7Palette(fields, palette);
+    float reusedError = SelectBlockIndices(pixels, 0, 4, palette, 16, fields.indices);
+    if(reusedError > error + tolerance)
+    {
+        return error;
+    }
+    PackBc7Block(fields, block);
+    return reusedError;
+}
+
+///
+/// Tries a neighbouring block's endpoints for a BC4 block, as ReuseBc7Endpoints does for BC7.
+///
+inline float ReuseBc4Endpoints(const BlockPixels& pixels, int channel, const unsigned char neighbour[8], float error, float tolerance,
+                               unsigned char block[8])
+{
+    // Only the eight value mode is written, or a single value for flat blocks.
+    if(neighbour[0] < neighbour[1])
+    {
+        return error;
+    }
+    float palette[8][4];
+    Bc4Palette(neighbour[0], neighbour[1], palette);
+    unsigned char indices[16];
+    float reusedError = SelectBlockIndices(pixels, channel, 1, palette, neighbour[0] == neighbour[1] ? 1 : 8, indices);
+    if(reusedError > error + tolerance)
+    {
+        return error;
+    }
+    PackBc4Block(neighbour[0], neighbour[1], indices, block);
+    return reusedError;
+}
+
+///
+/// Decodes a BC1 block into 4x4 RGBA pixels, in either of its modes.
+///
+inline void DecodeBc1Block(const unsigned char block[8], unsigned char rgba[64], bool forceFourColours = false)
+{
+    uint16_t colour0 = ( uint16_t) (block[0] | block[1] << 8);
+    uint16_t colour1 = ( uint16_t) (block[2] | block[3] << 8);
+    int a[3];
+    int b[3];
+    UnpackRgb565(colour0, a);
+    UnpackRgb565(colour1, b);
+
+    unsigned char palette[4][4];
+    for(int c = 0; c < 3; c++)
+    {
+        palette[0][c] = ( unsigned char) a[c];
+        palette[1][c] = ( unsigned char) b[c];
+        if(colour0 > colour1 || forceFourColours)
+        {
+            palette[2][c] = ( unsigned char) ((2 * a[c] + b[c]) / 3);
+            palette[3][c] = ( unsigned char) ((a[c] + 2 * b[c]) / 3);
+        }
+        else
+        {
+            palette[2][c] = ( unsigned char) ((a[c] + b[c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = colour0 > colour1 || forceFourColours ? 255 : 0;
+
+    uint32_t indices = ( uint32_t) block[4] | ( uint32_t) block[5] << 8 | ( uint32_t) block[6] << 16 | ( uint32_t) block[7] << 24;
+    for(int i = 0; i < 16; i++)
+    {
+        std::memcpy(rgba + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+    }
+}
+
+///
+/// Decodes a BC4 block into one channel of 16 pixels, in either of its modes.
+/// \param stride - distance in bytes between the pixels' values.
+///
+inline void DecodeBc4Block(const unsigned char block[8], unsigned char* values, int stride)
+{
+    int value0 = block[0];
+    int value1 = block[1];
+    unsigned char palette[8];
+    palette[0] = ( unsigned char) value0;
+    palette[1] = ( unsigned char) value1;
+    if(value0 > value1)
+    {
+        for(int i = 2; i < 8; i++)
+        {
+            palette[i] = ( unsigned char) (((8 - i) * value0 + (i - 1) * value1) / 7);
+        }
+    }
+    else
+    {
+        for(int i = 2; i < 6; i++)
+        {
+            palette[i] = ( unsigned char) (((6 - i) * value0 + (i - 1) * value1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for(int b = 0; b < 6; b++)
+    {
+        indices |= ( uint64_t) block[2 + b] << (8 * b);
+    }
+    for(int i = 0; i < 16; i++)
+    {
+        values[i * stride] = palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+///
+/// Decodes a BC7 block into 4x4 RGBA pixels.
+/// \return - false for blocks in any mode but 6, which is all the encoder writes.
+///
+inline bool DecodeBc7Block(const unsigned char block[16], unsigned char rgba[64])
+{
+    Bc7Mode6Block fields;
+    if(!UnpackBc7Block(block, fields))
+    {
+        return false;
+    }
+    float palette[16][4];
+    Bc7Palette(fields, palette);
+    for(int i = 0; i < 16; i++)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            rgba[i * 4 + c] = ( unsigned char) palette[fields.indices[i]][c];
+        }
+    }
+    return true;
+}
+
+///
+/// Compresses an RGBA image, spread across the worker threads a row of blocks at a time.
+/// \param rgba - the image, 8 bit RGBA pixels, top row first.
+/// \param format - the format to compress to. BC4 takes red and BC5 red and green.
+/// \param blocks - receives the blocks, CompressedImageSize bytes, in rows from the top.
+/// \param reuseTolerance - extra squared error a channel of a pixel may take on for a BC4 or BC7 block to reuse the
+/// endpoints of the block on its left, which makes the image supercompress better. 0 keeps every block's own fit.
+///
+inline void CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* blocks, float reuseTolerance = 0.0f)
+{
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    size_t blockBytes = BlockFormatBytes(format);
+    ParallelFor(( size_t) blocksHigh, [&](size_t blockY)
+    {
+        BlockPixels pixels;
+        for(int blockX = 0; blockX < blocksWide; blockX++)
+        {
+            unsigned char* block = blocks + (blockY * blocksWide + blockX) * blockBytes;
+            const unsigned char* left = blockX > 0 && reuseTolerance > 0.0f ? block - blockBytes : NULL;
+            LoadBlockPixels(rgba, width, height, blockX, ( int) blockY, pixels);
+            switch(format)
+            {
+            case BLOCK_FORMAT_BC1:
+                EncodeBc1Block(pixels, block);
+                break;
+            case BLOCK_FORMAT_BC3:
+            {
+                float error = EncodeBc4Block(pixels, 3, block);
+                if(left)
+                {
+                    ReuseBc4Endpoints(pixels, 3, left, error, reuseTolerance * 16.0f, block);
+                }
+                EncodeBc1Block(pixels, block + 8);
+                break;
+            }
+            case BLOCK_FORMAT_BC4:
+            case BLOCK_FORMAT_BC5:
+                for(int channel = 0; channel < (format == BLOCK_FORMAT_BC5 ? 2 : 1); channel++)
+                {
+                    float error = EncodeBc4Block(pixels, channel, block + channel * 8);
+                    if(left)
+                    {
+                        ReuseBc4Endpoints(pixels, channel, left + channel * 8, error, reuseTolerance * 16.0f, block + channel * 8);
+                    }
+                }
+                break;
+            case BLOCK_FORMAT_BC7:
+            {
+                float error = EncodeBc7Block(pixels, block);
+                if(left)
+                {
+                    ReuseBc7Endpoints(pixels, left, error, reuseTolerance * 64.0f, block);
+                }
+                break;
+            }
+            }
+        }
+    });
+}
+
+///
+/// Decompresses an image to RGBA, e.g. to measure the encoder's error or for contexts without the format. Channels a
+/// format doesn't store come back as 0, and alpha as 255.
+/// \param blocks - the compressed image.
+/// \param format - its format.
+/// \param rgba - receives the image, 8 bit RGBA pixels, top row first.
+/// \return - false if a BC7 block isn't in mode 6.
+///
+inline bool DecompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba)
+{
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    size_t blockBytes = BlockFormatBytes(format);
+    bool decoded = true;
+    for(int blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        for(int blockX = 0; blockX < blocksWide; blockX++)
+        {
+            const unsigned char* block = blocks + (( size_t) blockY * blocksWide + blockX) * blockBytes;
+            unsigned char pixels[64] = {};
+            switch(format)
+            {
+            case BLOCK_FORMAT_BC1:
+                DecodeBc1Block(block, pixels);
+                break;
+            case BLOCK_FORMAT_BC3:
+                DecodeBc1Block(block + 8, pixels, true);
+                DecodeBc4Block(block, pixels + 3, 4);
+                break;
+            case BLOCK_FORMAT_BC4:
+                DecodeBc4Block(block, pixels, 4);
+                break;
+            case BLOCK_FORMAT_BC5:
+                DecodeBc4Block(block, pixels, 4);
+                DecodeBc4Block(block + 8, pixels + 1, 4);
+                break;
+            case BLOCK_FORMAT_BC7:
+                decoded = DecodeBc7Block(block, pixels) && decoded;
+                break;
+            }
+            if(format == BLOCK_FORMAT_BC4 || format == BLOCK_FORMAT_BC5)
+            {
+                for(int i = 0; i < 16; i++)
+                {
+                    pixels[i * 4 + 3] = 255;
+                }
+            }
+
+            for(int y = 0; y < 4 && blockY * 4 + y < height; y++)
+            {
+                for(int x = 0; x < 4 && blockX * 4 + x < width; x++)
+                {
+                    std::memcpy(rgba + ((( size_t) blockY * 4 + y) * width + blockX * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+    return decoded;
+}
+
+///
+/// Transcodes a BC7 mode 6 block to BC1, or to BC3 keeping its alpha, without fitting it again. Mode 6 pixels all lie
+/// on the line between the endpoints, so the new endpoints are the ends of the stretch of the line the block uses and
+/// each index maps to the nearest step of the new block along it.
+/// \param bc7 - the block.
+/// \param format - BLOCK_FORMAT_BC1 or BLOCK_FORMAT_BC3.
+/// \param block - receives the transcoded block.
+/// \return - false for blocks in any mode but 6.
+///
+inline bool TranscodeBc7Block(const unsigned char bc7[16], BlockFormat format, unsigned char* block)
+{
+    Bc7Mode6Block fields;
+    if(!UnpackBc7Block(bc7, fields))
+    {
+        return false;
+    }
+    float palette[16][4];
+    Bc7Palette(fields, palette);
+    int lowest = *std::min_element(fields.indices, fields.indices + 16);
+    int highest = *std::max_element(fields.indices, fields.indices + 16);
+    int range = BC7_WEIGHTS[highest] - BC7_WEIGHTS[lowest];
+
+    unsigned char* colourBlock = block;
+    if(format == BLOCK_FORMAT_BC3)
+    {
+        // The eight value mode needs value0 above value1; its steps from value0 are indices 0, 7, 6, ..., 2, 1.
+        static const unsigned char ALPHA_STEPS[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        int value0 = ( int) std::max(palette[lowest][3], palette[highest][3]);
+        int value1 = ( int) std::min(palette[lowest][3], palette[highest][3]);
+        unsigned char indices[16] = {};
+        if(value0 > value1)
+        {
+            for(int i = 0; i < 16; i++)
+            {
+                int step = ((( int) palette[fields.indices[i]][3] - value1) * 14 + (value0 - value1)) / (2 * (value0 - value1));
+                indices[i] = ALPHA_STEPS[step];
+            }
+        }
+        PackBc4Block(value0, value1, indices, block);
+        colourBlock = block + 8;
+    }
+
+    // BC1 indices 0, 2, 3 and 1 step from colour0 to colour1.
+    static const unsigned char COLOUR_STEPS[4] = { 0, 2, 3, 1 };
+    uint16_t colour0 = PackRgb565(palette[lowest]);
+    uint16_t colour1 = PackRgb565(palette[highest]);
+    bool swap = colour0 < colour1;
+    if(swap)
+    {
+        std::swap(colour0, colour1);
+    }
+    uint32_t packed = 0;
+    if(colour0 != colour1)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            int step = ((BC7_WEIGHTS[fields.indices[i]] - BC7_WEIGHTS[lowest]) * 6 + range) / (2 * range);
+            packed |= ( uint32_t) COLOUR_STEPS[swap ? 3 - step : step] << (2 * i);
+        }
+    }
+    colourBlock[0] = ( unsigned char) colour0;
+    colourBlock[1] = ( unsigned char) (colour0 >> 8);
+    colourBlock[2] = ( unsigned char) colour1;
+    colourBlock[3] = ( unsigned char) (colour1 >> 8);
+    for(int b = 0; b < 4; b++)
+    {
+        colourBlock[4 + b] = ( unsigned char) (packed >> (8 * b));
+    }
+    return true;
+}
+
+///
+/// Returns true if every pixel of a BC7 image is opaque, so it can be transcoded to BC1 rather than BC3.
+///
+inline bool IsBc7ImageOpaque(const unsigned char* blocks, int width, int height)
+{
+    size_t blockCount = (( size_t) (width + 3) / 4) * (( size_t) (height + 3) / 4);
+    for(size_t b = 0; b < blockCount; b++)
+    {
+        Bc7Mode6Block fields;
+        if(!UnpackBc7Block(blocks + b * 16, fields) || fields.endpoints[0][3] != 127 || fields.endpoints[1][3] != 127
+           || fields.pBits[0] != 1 || fields.pBits[1] != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+/// Transcodes a BC7 image to BC1 or BC3 for contexts that can't sample BC7, spread across the worker threads a row
+/// of blocks at a time.
+/// \param blocks - the BC7 image.
+/// \param format - BLOCK_FORMAT_BC1 or BLOCK_FORMAT_BC3.
+/// \param transcoded - receives the image, CompressedImageSize bytes.
+/// \return - false if a block isn't in mode 6.
+///
+inline bool TranscodeBc7Image(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* transcoded)
+{
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    size_t blockBytes = BlockFormatBytes(format);
+    std::atomic<bool> succeeded(true);
+    ParallelFor(( size_t) blocksHigh, [&](size_t blockY)
+    {
+        for(int blockX = 0; blockX < blocksWide; blockX++)
+        {
+            size_t block = blockY * blocksWide + blockX;
+            if(!TranscodeBc7Block(blocks + block * 16, format, transcoded + block * blockBytes))
+            {
+                succeeded = false;
+            }
+        }
+    });
+    return succeeded;
+}
+
+#endif
\ No newline at end of file
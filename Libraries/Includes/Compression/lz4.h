@@ -0,0 +1,245 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compressor and decompressor for the LZ4 block format: a stream of sequences, each a token byte, a run of literal
+// bytes and a back reference of at least four bytes into the last 64KB of output. Decompression is a handful of
+// copies per sequence, which keeps it far faster than reading the uncompressed bytes from disk.
+
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_MAX_OFFSET = 65535;
+const size_t LZ4_LAST_LITERALS = 5;     // The block must end with at least this many literals.
+const size_t LZ4_MATCH_FIND_LIMIT = 12; // No match may start within this many bytes of the end.
+const unsigned int LZ4_HASH_BITS = 16;
+
+///
+/// Largest compressed size of a block of the given size, for sizing the destination buffer.
+///
+inline size_t Lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+///
+/// Writes a literal or match length's continuation bytes, the part of the length not held by the token.
+///
+inline bool WriteLz4Length(size_t length, unsigned char* destination, size_t capacity, size_t& out)
+{
+    for(; length >= 255; length -= 255)
+    {
+        if(out >= capacity)
+        {
+            return false;
+        }
+        destination[out++] = 255;
+    }
+    if(out >= capacity)
+    {
+        return false;
+    }
+    destination[out++] = ( unsigned char) length;
+    return true;
+}
+
+///
+/// Writes one sequence: the literals from anchor up to the match, then the match itself. A match length of zero
+/// writes the final literal only sequence.
+///
+inline bool WriteLz4Sequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength,
+                             unsigned char* destination, size_t capacity, size_t& out)
+{
+    if(out >= capacity)
+    {
+        return false;
+    }
+    size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+    destination[out++] = ( unsigned char) ((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+    if(literalLength >= 15 && !WriteLz4Length(literalLength - 15, destination, capacity, out))
+    {
+        return false;
+    }
+    if(literalLength > capacity - out)
+    {
+        return false;
+    }
+    std::memcpy(destination + out, literals, literalLength);
+    out += literalLength;
+
+    if(matchLength == 0)
+    {
+        return true;
+    }
+    if(capacity - out < 2)
+    {
+        return false;
+    }
+    destination[out++] = ( unsigned char) (offset & 0xFF);
+    destination[out++] = ( unsigned char) (offset >> 8);
+    return matchCode < 15 || WriteLz4Length(matchCode - 15, destination, capacity, out);
+}
+
+///
+/// Compresses a block with a single pass greedy match finder that remembers the last position of every hashed
+/// four byte sequence.
+/// \param source - the bytes to compress.
+/// \param size - number of bytes to compress.
+/// \param destination - receives the compressed block.
+/// \param capacity - size of destination, see Lz4CompressBound.
+/// \return - the compressed size, or 0 if it didn't fit.
+///
+inline size_t Lz4Compress(const unsigned char* source, size_t size, unsigned char* destination, size_t capacity)
+{
+    size_t out = 0;
+    size_t anchor = 0;
+
+    if(size > LZ4_MATCH_FIND_LIMIT)
+    {
+        std::vector<uint32_t> table(( size_t) 1 << LZ4_HASH_BITS, 0);
+        const size_t matchLimit = size - LZ4_LAST_LITERALS;
+        const size_t searchEnd = size - LZ4_MATCH_FIND_LIMIT;
+        size_t position = 0;
+        while(position <= searchEnd)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, source + position, sizeof(sequence));
+            uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            size_t candidate = table[hash];
+            table[hash] = ( uint32_t) position;
+
+            uint32_t candidateSequence;
+            std::memcpy(&candidateSequence, source + candidate, sizeof(candidateSequence));
+            if(candidate >= position || position - candidate > LZ4_MAX_OFFSET || candidateSequence != sequence)
+            {
+                // Step further the longer nothing has matched, so incompressible data is skipped through quickly.
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+
+            // Grow the match backwards over literals, then forwards as far as the block's tail allows.
+            while(position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+            {
+                position--;
+                candidate--;
+            }
+            size_t length = LZ4_MIN_MATCH;
+            while(position + length < matchLimit && source[candidate + length] == source[position + length])
+            {
+                length++;
+            }
+
+            if(!WriteLz4Sequence(source + anchor, position - anchor, position - candidate, length, destination, capacity, out))
+            {
+                return 0;
+            }
+            position += length;
+            anchor = position;
+        }
+    }
+
+    if(!WriteLz4Sequence(source + anchor, size - anchor, 0, 0, destination, capacity, out))
+    {
+        return 0;
+    }
+    return out;
+}
+
+///
+/// Decompresses a block. Every length and offset is checked against both buffers, so damaged data fails rather
+/// than reading or writing out of bounds.
+/// \param source - the compressed block.
+/// \param size - size of the compressed block.
+/// \param destination - receives the decompressed bytes.
+/// \param decompressedSize - the exact size the block decompresses to.
+/// \return - true if the block decompressed to exactly decompressedSize bytes.
+///
+inline bool Lz4Decompress(const unsigned char* source, size_t size, unsigned char* destination, size_t decompressedSize)
+{
+    size_t in = 0;
+    size_t out = 0;
+    while(in < size)
+    {
+        const unsigned char token = source[in++];
+
+        // Literals.
+        size_t literalLength = token >> 4;
+        if(literalLength == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if(in >= size)
+                {
+                    return false;
+                }
+                extra = source[in++];
+                literalLength += extra;
+            } while(extra == 255);
+        }
+        if(literalLength > size - in || literalLength > decompressedSize - out)
+        {
+            return false;
+        }
+        std::memcpy(destination + out, source + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        // The last sequence has no match.
+        if(in == size)
+        {
+            break;
+        }
+
+        // Match.
+        if(size - in < 2)
+        {
+            return false;
+        }
+        const size_t offset = source[in] | ( size_t) source[in + 1] << 8;
+        in += 2;
+        if(offset == 0 || offset > out)
+        {
+            return false;
+        }
+        size_t matchLength = token & 15;
+        if(matchLength == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if(in >= size)
+                {
+                    return false;
+                }
+                extra = source[in++];
+                matchLength += extra;
+            } while(extra == 255);
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if(matchLength > decompressedSize - out)
+        {
+            return false;
+        }
+
+        // Matches may overlap the bytes they produce, which repeats a pattern, so those are copied byte by byte.
+        const unsigned char* match = destination + out - offset;
+        if(offset >= matchLength)
+        {
+            std::memcpy(destination + out, match, matchLength);
+        }
+        else
+        {
+            for(size_t i = 0; i < matchLength; i++)
+            {
+                destination[out + i] = match[i];
+            }
+        }
+        out += matchLength;
+    }
+    return out == decompressedSize;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,420 @@
+#ifndef RANS_H
+#define RANS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// The AVX2 decoder is compiled for every x64 target and only run where the CPU has it.
+#if defined(__x86_64__) || defined(_M_X64)
+#define RANS_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RANS_TARGET_AVX2
+#else
+#define RANS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Order-0 entropy coder for byte streams: range asymmetric numeral systems with a static frequency table. Each byte
+// costs close to its information content under the stream's own byte histogram, which is what filtered data such as
+// delta encoded vertex attributes needs, where most bytes are one of a few small values.
+//
+// Byte i is coded by state i % RANS_STATES, and states are renormalised sixteen bits at a time, at most once a byte,
+// with the words stored in the order the bytes are decoded. That lets a decoder with eight states to a register take
+// eight bytes in one step: a gather does the table lookups, and the states that need a word take the next ones in
+// order through a permutation picked by which states they are. With thirty two states the four registers' dependency
+// chains overlap, and the scalar decoder, which reads the same stream, still has plenty to run alongside each other.
+
+const unsigned int RANS_PROBABILITY_BITS = 12;
+const uint32_t RANS_PROBABILITY_SCALE = 1u << RANS_PROBABILITY_BITS;
+const uint32_t RANS_LOWER_BOUND = 1u << 16;    // States are renormalised a word at a time to stay in [L, 65536L).
+const unsigned int RANS_STATES = 32;
+const unsigned int RANS_STATES_PER_REGISTER = 8;
+
+///
+/// Largest compressed size of a block of the given size, for sizing the destination buffer. A byte never costs more
+/// than RANS_PROBABILITY_BITS bits and a word, and the table is at most a bitmap and two bytes per symbol.
+///
+inline size_t RansCompressBound(size_t size)
+{
+    return size * 2 + 32 + 256 * 2 + RANS_STATES * 4;
+}
+
+#ifdef RANS_AVX2
+///
+/// Whether the CPU and OS support AVX2, checked once.
+///
+inline bool RansCpuHasAvx2()
+{
+    static const bool hasAvx2 = []()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int registers[4];
+        __cpuid(registers, 0);
+        if(registers[0] < 7)
+        {
+            return false;
+        }
+        // OSXSAVE and AVX, the OS saving the YMM registers, then AVX2 itself.
+        __cpuid(registers, 1);
+        if((registers[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(registers, 7, 0);
+        return (registers[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }();
+    return hasAvx2;
+}
+#endif
+
+///
+/// Scales a byte histogram so the frequencies sum to RANS_PROBABILITY_SCALE, keeping every symbol that occurs at
+/// one or more.
+///
+inline void NormaliseRansFrequencies(const uint64_t counts[256], uint64_t total, uint32_t frequencies[256])
+{
+    uint32_t sum = 0;
+    for(int s = 0; s < 256; s++)
+    {
+        frequencies[s] = 0;
+        if(counts[s] > 0)
+        {
+            uint64_t scaled = counts[s] * RANS_PROBABILITY_SCALE / total;
+            frequencies[s] = scaled > 0 ? ( uint32_t) scaled : 1;
+            sum += frequencies[s];
+        }
+    }
+
+    // Rounding down leaves some of the range over, which goes to the most frequent symbol. Rounding rare symbols up
+    // to one can overshoot instead, which is taken back from the most frequent symbols that can spare it.
+    int largest = 0;
+    for(int s = 1; s < 256; s++)
+    {
+        largest = frequencies[s] > frequencies[largest] ? s : largest;
+    }
+    if(sum < RANS_PROBABILITY_SCALE)
+    {
+        frequencies[largest] += RANS_PROBABILITY_SCALE - sum;
+        return;
+    }
+    while(sum > RANS_PROBABILITY_SCALE)
+    {
+        largest = 0;
+        for(int s = 1; s < 256; s++)
+        {
+            largest = frequencies[s] > frequencies[largest] ? s : largest;
+        }
+        frequencies[largest]--;
+        sum--;
+    }
+}
+
+///
+/// Compresses a block. The block starts with the frequency table: a bitmap of the symbols that occur and each one's
+/// frequency less one, seven bits a byte. The final states follow, then the renormalisation words in decode order.
+/// \param source - the bytes to compress.
+/// \param size - number of bytes to compress, at least one.
+/// \param destination - receives the compressed block.
+/// \param capacity - size of destination, see RansCompressBound.
+/// \return - the compressed size, or 0 if it didn't fit.
+///
+inline size_t RansCompress(const unsigned char* source, size_t size, unsigned char* destination, size_t capacity)
+{
+    if(size == 0)
+    {
+        return 0;
+    }
+
+    uint64_t counts[256] = {};
+    for(size_t i = 0; i < size; i++)
+    {
+        counts[source[i]]++;
+    }
+    uint32_t frequencies[256];
+    uint32_t cumulative[256];
+    NormaliseRansFrequencies(counts, size, frequencies);
+    uint32_t running = 0;
+    for(int s = 0; s < 256; s++)
+    {
+        cumulative[s] = running;
+        running += frequencies[s];
+    }
+
+    // Table.
+    unsigned char table[32 + 256 * 2] = {};
+    size_t tableSize = 32;
+    for(int s = 0; s < 256; s++)
+    {
+        if(frequencies[s] == 0)
+        {
+            continue;
+        }
+        table[s >> 3] |= ( unsigned char) (1 << (s & 7));
+        uint32_t value = frequencies[s] - 1;
+        if(value >= 0x80)
+        {
+            table[tableSize++] = ( unsigned char) (0x80 | (value & 0x7F));
+            value >>= 7;
+        }
+        table[tableSize++] = ( unsigned char) value;
+    }
+
+    // Encoding runs backwards, so the words are written from the end of the scratch space towards its start.
+    std::vector<unsigned char> scratch(size * 2 + RANS_STATES * 4 + 16);
+    unsigned char* end = scratch.data() + scratch.size();
+    unsigned char* out = end;
+    uint32_t states[RANS_STATES];
+    for(uint32_t& state : states)
+    {
+        state = RANS_LOWER_BOUND;
+    }
+    for(size_t i = size; i > 0; i--)
+    {
+        unsigned char symbol = source[i - 1];
+        uint32_t& state = states[(i - 1) % RANS_STATES];
+        uint32_t frequency = frequencies[symbol];
+        // A symbol with the whole range never moves the state, and its limit wouldn't fit 32 bits.
+        uint64_t limit = ( uint64_t) ((RANS_LOWER_BOUND >> RANS_PROBABILITY_BITS) << 16) * frequency;
+        if(state >= limit)
+        {
+            if(out - scratch.data() < 2)
+            {
+                return 0;
+            }
+            out -= 2;
+            out[0] = ( unsigned char) state;
+            out[1] = ( unsigned char) (state >> 8);
+            state >>= 16;
+        }
+        state = ((state / frequency) << RANS_PROBABILITY_BITS) + state % frequency + cumulative[symbol];
+    }
+
+    // The decoder reads the first state first.
+    for(unsigned int s = RANS_STATES; s > 0; s--)
+    {
+        if(out - scratch.data() < 4)
+        {
+            return 0;
+        }
+        out -= 4;
+        for(int b = 0; b < 4; b++)
+        {
+            out[b] = ( unsigned char) (states[s - 1] >> (8 * b));
+        }
+    }
+
+    size_t streamSize = ( size_t) (end - out);
+    if(tableSize + streamSize > capacity)
+    {
+        return 0;
+    }
+    std::memcpy(destination, table, tableSize);
+    std::memcpy(destination + tableSize, out, streamSize);
+    return tableSize + streamSize;
+}
+
+#ifdef RANS_AVX2
+///
+/// For each mask of the states in a register that need a word, which of the next words each state takes, and how
+/// many words that is.
+///
+struct RansWordPermutations
+{
+    unsigned char lanes[256][RANS_STATES_PER_REGISTER];
+    unsigned char counts[256];
+
+    RansWordPermutations()
+    {
+        for(unsigned int mask = 0; mask < 256; mask++)
+        {
+            unsigned char taken = 0;
+            for(unsigned int lane = 0; lane < RANS_STATES_PER_REGISTER; lane++)
+            {
+                lanes[mask][lane] = (mask >> lane) & 1 ? taken++ : 0;
+            }
+            counts[mask] = taken;
+        }
+    }
+};
+
+///
+/// Decodes whole rounds of RANS_STATES bytes with AVX2, eight states to a register, for as long as the reads can go
+/// unchecked. The states and the read position are left where the scalar decoder carries on from.
+/// \return - the number of bytes decoded.
+///
+RANS_TARGET_AVX2 inline size_t RansDecodeRoundsAvx2(const uint32_t* slots, uint32_t* states, const unsigned char*& in,
+                                                    const unsigned char* end, unsigned char* destination, size_t decompressedSize)
+{
+    static const RansWordPermutations permutations;
+    const unsigned int registers = RANS_STATES / RANS_STATES_PER_REGISTER;
+    const __m256i slotMask = _mm256_set1_epi32(RANS_PROBABILITY_SCALE - 1);
+    const __m256i frequencyMask = _mm256_set1_epi32(0xFFF);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i one = _mm256_set1_epi32(1);
+    // Gathers the low dword of each 128 bit half, where the packs leave each half's four symbols.
+    const __m256i symbolOrder = _mm256_set_epi32(7, 6, 5, 3, 2, 1, 4, 0);
+    __m256i x[RANS_STATES / RANS_STATES_PER_REGISTER];
+    for(unsigned int r = 0; r < registers; r++)
+    {
+        x[r] = _mm256_loadu_si256(( const __m256i*) (states + r * RANS_STATES_PER_REGISTER));
+    }
+
+    // Each register loads the next eight words whichever it takes, so a round needs that many spare.
+    size_t i = 0;
+    for(; i + RANS_STATES <= decompressedSize && end - in >= ( ptrdiff_t) (2 * (RANS_STATES + RANS_STATES_PER_REGISTER));
+        i += RANS_STATES)
+    {
+        for(unsigned int r = 0; r < registers; r++)
+        {
+            __m256i slot = _mm256_i32gather_epi32(( const int*) slots, _mm256_and_si256(x[r], slotMask), 4);
+            __m256i frequency = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(slot, 8), frequencyMask), one);
+            __m256i state = _mm256_add_epi32(_mm256_mullo_epi32(frequency, _mm256_srli_epi32(x[r], RANS_PROBABILITY_BITS)),
+                                             _mm256_srli_epi32(slot, 20));
+
+            __m256i symbols = _mm256_and_si256(slot, byteMask);
+            symbols = _mm256_packus_epi32(symbols, symbols);
+            symbols = _mm256_packus_epi16(symbols, symbols);
+            symbols = _mm256_permutevar8x32_epi32(symbols, symbolOrder);
+            _mm_storel_epi64(( __m128i*) (destination + i + r * RANS_STATES_PER_REGISTER), _mm256_castsi256_si128(symbols));
+
+            __m256i renormalise = _mm256_cmpeq_epi32(_mm256_srli_epi32(state, 16), _mm256_setzero_si256());
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(renormalise));
+            __m256i words = _mm256_cvtepu16_epi32(_mm_loadu_si128(( const __m128i*) in));
+            words = _mm256_permutevar8x32_epi32(words, _mm256_cvtepu8_epi32(_mm_loadl_epi64(( const __m128i*) permutations.lanes[mask])));
+            x[r] = _mm256_blendv_epi8(state, _mm256_or_si256(_mm256_slli_epi32(state, 16), words), renormalise);
+            in += 2 * permutations.counts[mask];
+        }
+    }
+
+    for(unsigned int r = 0; r < registers; r++)
+    {
+        _mm256_storeu_si256(( __m256i*) (states + r * RANS_STATES_PER_REGISTER), x[r]);
+    }
+    return i;
+}
+#endif
+
+///
+/// Decompresses a block. Reads are checked against the block and the final states must come back to where encoding
+/// started, so damaged data fails rather than reading out of bounds or decoding garbage silently.
+/// \param source - the compressed block.
+/// \param size - size of the compressed block.
+/// \param destination - receives the decompressed bytes.
+/// \param decompressedSize - the exact size the block decompresses to.
+/// \return - true if the block decompressed to exactly decompressedSize bytes.
+///
+inline bool RansDecompress(const unsigned char* source, size_t size, unsigned char* destination, size_t decompressedSize)
+{
+    const unsigned char* in = source;
+    const unsigned char* end = source + size;
+    if(size < 32)
+    {
+        return false;
+    }
+
+    // One entry per slot of the range: the symbol in the low byte, then its frequency less one, then the slot's
+    // distance from the start of the symbol's range, so a decode step is a single lookup.
+    uint32_t slots[RANS_PROBABILITY_SCALE];
+    const unsigned char* bitmap = in;
+    in += 32;
+    uint32_t running = 0;
+    for(uint32_t s = 0; s < 256; s++)
+    {
+        if(!(bitmap[s >> 3] & (1 << (s & 7))))
+        {
+            continue;
+        }
+        if(in == end)
+        {
+            return false;
+        }
+        uint32_t value = *in++;
+        if(value & 0x80)
+        {
+            if(in == end)
+            {
+                return false;
+            }
+            value = (value & 0x7F) | ( uint32_t) *in++ << 7;
+        }
+        uint32_t frequency = value + 1;
+        if(frequency > RANS_PROBABILITY_SCALE - running)
+        {
+            return false;
+        }
+        for(uint32_t slot = 0; slot < frequency; slot++)
+        {
+            slots[running + slot] = s | value << 8 | slot << 20;
+        }
+        running += frequency;
+    }
+    if(running != RANS_PROBABILITY_SCALE || end - in < ( ptrdiff_t) (RANS_STATES * 4))
+    {
+        return false;
+    }
+
+    uint32_t states[RANS_STATES];
+    for(unsigned int s = 0; s < RANS_STATES; s++)
+    {
+        states[s] = ( uint32_t) in[0] | ( uint32_t) in[1] << 8 | ( uint32_t) in[2] << 16 | ( uint32_t) in[3] << 24;
+        in += 4;
+    }
+
+    // While a round's words are certainly in the block the reads go unchecked: a state takes at most one word a byte.
+    size_t i = 0;
+#ifdef RANS_AVX2
+    if(RansCpuHasAvx2())
+    {
+        i = RansDecodeRoundsAvx2(slots, states, in, end, destination, decompressedSize);
+    }
+#endif
+    for(; i + RANS_STATES <= decompressedSize && end - in >= ( ptrdiff_t) (2 * RANS_STATES); i += RANS_STATES)
+    {
+        unsigned char* out = destination + i;
+        for(uint32_t& state : states)
+        {
+            uint32_t slot = slots[state & (RANS_PROBABILITY_SCALE - 1)];
+            state = (((slot >> 8) & 0xFFF) + 1) * (state >> RANS_PROBABILITY_BITS) + (slot >> 20);
+            *out++ = ( unsigned char) slot;
+            if(state < RANS_LOWER_BOUND)
+            {
+                state = state << 16 | ( uint32_t) in[0] | ( uint32_t) in[1] << 8;
+                in += 2;
+            }
+        }
+    }
+    for(; i < decompressedSize; i++)
+    {
+        uint32_t& state = states[i % RANS_STATES];
+        uint32_t slot = slots[state & (RANS_PROBABILITY_SCALE - 1)];
+        state = (((slot >> 8) & 0xFFF) + 1) * (state >> RANS_PROBABILITY_BITS) + (slot >> 20);
+        destination[i] = ( unsigned char) slot;
+        if(state < RANS_LOWER_BOUND)
+        {
+            if(end - in < 2)
+            {
+                return false;
+            }
+            state = state << 16 | ( uint32_t) in[0] | ( uint32_t) in[1] << 8;
+            in += 2;
+        }
+    }
+
+    for(unsigned int s = 0; s < RANS_STATES; s++)
+    {
+        if(states[s] != RANS_LOWER_BOUND)
+        {
+            return false;
+        }
+    }
+    return in == end;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef FILEMAPPING_H
+#define FILEMAPPING_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <string>
+
+///
+/// Read only view of a whole file mapped into memory. The operating system pages the file in on demand and shares
+/// the pages with its file cache, so reading through the mapping costs no copies.
+///
+class FileMapping
+{
+public:
+    ///
+    /// Default empty constructor, nothing is mapped.
+    ///
+    FileMapping()
+    {
+    }
+
+    ///
+    /// Maps the given file, check IsOpen for success.
+    ///
+    explicit FileMapping(const std::string& path)
+    {
+        Open(path);
+    }
+
+    ~FileMapping()
+    {
+        Close();
+    }
+
+    // A mapping has a single owner.
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    ///
+    /// Maps the given file, unmapping any previous one.
+    /// \param path - the file to map.
+    /// \return - true if the file exists, is not empty and could be mapped.
+    ///
+    bool Open(const std::string& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if(data == NULL)
+        {
+            Close();
+            return false;
+        }
+        size = ( size_t) fileSize.QuadPart;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if(file < 0)
+        {
+            return false;
+        }
+
+        struct stat status;
+        if(fstat(file, &status) != 0 || status.st_size == 0)
+        {
+            close(file);
+            return false;
+        }
+
+        void* view = mmap(NULL, ( size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if(view == MAP_FAILED)
+        {
+            return false;
+        }
+        data = static_cast<const unsigned char*>(view);
+        size = ( size_t) status.st_size;
+#endif
+        return true;
+    }
+
+    ///
+    /// Unmaps the file. Pointers into the mapping are invalid afterwards.
+    ///
+    void Close()
+    {
+#ifdef _WIN32
+        if(data != NULL)
+        {
+            UnmapViewOfFile(data);
+        }
+        if(mapping != NULL)
+        {
+            CloseHandle(mapping);
+        }
+        if(file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(data != NULL)
+        {
+            munmap(const_cast<unsigned char*>(data), size);
+        }
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return data != NULL;
+    }
+
+    const unsigned char* Data() const
+    {
+        return data;
+    }
+
+    size_t Size() const
+    {
+        return size;
+    }
+
+private:
+    const unsigned char* data = NULL;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,381 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Attribute locations used by every primitive. Shaders drawing primitives declare their inputs at these locations.
+const unsigned int PRIMITIVE_POSITION_LOCATION = 0;
+const unsigned int PRIMITIVE_NORMAL_LOCATION = 1;
+const unsigned int PRIMITIVE_TEX_COORD_LOCATION = 2;
+
+// Default tessellation of the curved primitives.
+const unsigned int PRIMITIVE_SEGMENTS = 32;
+const unsigned int PRIMITIVE_RINGS = 16;
+const unsigned int PRIMITIVE_ICOSPHERE_SUBDIVISIONS = 2;
+
+///
+/// Interleaved per vertex data of a primitive.
+///
+struct PrimitiveVertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+///
+/// CPU side indexed geometry of a primitive. All primitives fit in a unit cube centred on the origin,
+/// and are wound counter-clockwise when seen from outside.
+///
+struct PrimitiveData
+{
+    std::vector<PrimitiveVertex> vertices;
+    std::vector<unsigned short> indices;
+};
+
+///
+/// Shapes available from GetPrimitive.
+///
+enum PrimitiveShape
+{
+    PRIMITIVE_CUBE,
+    PRIMITIVE_UV_SPHERE,
+    PRIMITIVE_ICOSPHERE,
+    PRIMITIVE_PLANE,
+    PRIMITIVE_CYLINDER
+};
+
+///
+/// Cube with 4 vertices per face, so every face gets its own normal and a full 0-1 texture.
+///
+inline PrimitiveData BuildCube()
+{
+    // Corners of each face, with the texture coordinate pattern used throughout the lighting chapters.
+    const glm::vec3 corners[6][4] =
+    {
+        { { -0.5f, -0.5f, -0.5f }, {  0.5f, -0.5f, -0.5f }, {  0.5f,  0.5f, -0.5f }, { -0.5f,  0.5f, -0.5f } },   // Back.
+        { { -0.5f, -0.5f,  0.5f }, {  0.5f, -0.5f,  0.5f }, {  0.5f,  0.5f,  0.5f }, { -0.5f,  0.5f,  0.5f } },   // Front.
+        { { -0.5f,  0.5f,  0.5f }, { -0.5f,  0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f }, { -0.5f, -0.5f,  0.5f } },   // Left.
+        { {  0.5f,  0.5f,  0.5f }, {  0.5f,  0.5f, -0.5f }, {  0.5f, -0.5f, -0.5f }, {  0.5f, -0.5f,  0.5f } },   // Right.
+        { { -0.5f, -0.5f, -0.5f }, {  0.5f, -0.5f, -0.5f }, {  0.5f, -0.5f,  0.5f }, { -0.5f, -0.5f,  0.5f } },   // Bottom.
+        { { -0.5f,  0.5f, -0.5f }, {  0.5f,  0.5f, -0.5f }, {  0.5f,  0.5f,  0.5f }, { -0.5f,  0.5f,  0.5f } }    // Top.
+    };
+    const glm::vec3 normals[6] =
+    {
+        { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }
+    };
+    const glm::vec2 texCoords[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+    PrimitiveData data;
+    for(unsigned short face = 0; face < 6; face++)
+    {
+        unsigned short first = ( unsigned short) data.vertices.size();
+        for(unsigned int corner = 0; corner < 4; corner++)
+        {
+            data.vertices.push_back({ corners[face][corner], normals[face], texCoords[corner] });
+        }
+
+        // Two triangles per face, flipped where needed so they face outwards.
+        glm::vec3 facing = glm::cross(corners[face][1] - corners[face][0], corners[face][2] - corners[face][0]);
+        if(glm::dot(facing, normals[face]) > 0.0f)
+        {
+            data.indices.insert(data.indices.end(), { first, ( unsigned short) (first + 1), ( unsigned short) (first + 2),
+                                                      ( unsigned short) (first + 2), ( unsigned short) (first + 3), first });
+        }
+        else
+        {
+            data.indices.insert(data.indices.end(), { first, ( unsigned short) (first + 2), ( unsigned short) (first + 1),
+                                                      ( unsigned short) (first + 2), first, ( unsigned short) (first + 3) });
+        }
+    }
+    return data;
+}
+
+///
+/// Sphere of latitude rings and longitude segments. The seam column and the pole rows are duplicated so the
+/// texture wraps once around without stretching across the seam.
+///
+inline PrimitiveData BuildUVSphere(unsigned int segments = PRIMITIVE_SEGMENTS, unsigned int rings = PRIMITIVE_RINGS)
+{
+    PrimitiveData data;
+    for(unsigned int ring = 0; ring <= rings; ring++)
+    {
+        float v = ( float) ring / rings;
+        float phi = v * glm::pi<float>();
+        for(unsigned int segment = 0; segment <= segments; segment++)
+        {
+            float u = ( float) segment / segments;
+            float theta = u * glm::two_pi<float>();
+            glm::vec3 normal(std::sin(phi) * std::cos(theta), -std::cos(phi), -std::sin(phi) * std::sin(theta));
+            data.vertices.push_back({ normal * 0.5f, normal, glm::vec2(u, v) });
+        }
+    }
+
+    for(unsigned int ring = 0; ring < rings; ring++)
+    {
+        for(unsigned int segment = 0; segment < segments; segment++)
+        {
+            unsigned short a = ( unsigned short) (ring * (segments + 1) + segment);
+            unsigned short b = ( unsigned short) (a + segments + 1);
+
+            // The triangles touching the poles would be degenerate.
+            if(ring != 0)
+            {
+                data.indices.insert(data.indices.end(), { a, ( unsigned short) (a + 1), b });
+            }
+            if(ring != rings - 1)
+            {
+                data.indices.insert(data.indices.end(), { ( unsigned short) (a + 1), ( unsigned short) (b + 1), b });
+            }
+        }
+    }
+    return data;
+}
+
+///
+/// Sphere made by repeatedly subdividing an icosahedron, giving evenly sized triangles.
+/// Texture coordinates are spherical, so they pinch at the poles and wrap across a seam; prefer the UV sphere when
+/// texturing matters.
+///
+inline PrimitiveData BuildIcosphere(unsigned int subdivisions = PRIMITIVE_ICOSPHERE_SUBDIVISIONS)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    std::vector<glm::vec3> points =
+    {
+        { -1.0f,  t, 0.0f }, { 1.0f,  t, 0.0f }, { -1.0f, -t, 0.0f }, { 1.0f, -t, 0.0f },
+        { 0.0f, -1.0f,  t }, { 0.0f, 1.0f,  t }, { 0.0f, -1.0f, -t }, { 0.0f, 1.0f, -t },
+        {  t, 0.0f, -1.0f }, {  t, 0.0f, 1.0f }, { -t, 0.0f, -1.0f }, { -t, 0.0f, 1.0f }
+    };
+    std::vector<unsigned short> indices =
+    {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+    };
+    for(glm::vec3& point : points)
+    {
+        point = glm::normalize(point);
+    }
+
+    // Split every triangle into four, sharing the new edge midpoints between neighbouring triangles.
+    for(unsigned int level = 0; level < subdivisions; level++)
+    {
+        std::map<std::pair<unsigned short, unsigned short>, unsigned short> midpoints;
+        auto midpoint = [&](unsigned short a, unsigned short b)
+        {
+            std::pair<unsigned short, unsigned short> key(std::min(a, b), std::max(a, b));
+            auto found = midpoints.find(key);
+            if(found != midpoints.end())
+            {
+                return found->second;
+            }
+            unsigned short index = ( unsigned short) points.size();
+            points.push_back(glm::normalize(points[a] + points[b]));
+            midpoints[key] = index;
+            return index;
+        };
+
+        std::vector<unsigned short> subdivided;
+        subdivided.reserve(indices.size() * 4);
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            unsigned short a = indices[i + 0];
+            unsigned short b = indices[i + 1];
+            unsigned short c = indices[i + 2];
+            unsigned short ab = midpoint(a, b);
+            unsigned short bc = midpoint(b, c);
+            unsigned short ca = midpoint(c, a);
+            subdivided.insert(subdivided.end(), { a, ab, ca,   b, bc, ab,   c, ca, bc,   ab, bc, ca });
+        }
+        indices.swap(subdivided);
+    }
+
+    PrimitiveData data;
+    data.indices = indices;
+    for(const glm::vec3& normal : points)
+    {
+        glm::vec2 texCoords(0.5f + std::atan2(-normal.z, normal.x) / glm::two_pi<float>(), std::acos(-normal.y) / glm::pi<float>());
+        data.vertices.push_back({ normal * 0.5f, normal, texCoords });
+    }
+    return data;
+}
+
+///
+/// Flat square in the XZ plane facing up, split into a grid of quads.
+///
+inline PrimitiveData BuildPlane(unsigned int subdivisions = 1)
+{
+    PrimitiveData data;
+    for(unsigned int z = 0; z <= subdivisions; z++)
+    {
+        for(unsigned int x = 0; x <= subdivisions; x++)
+        {
+            glm::vec2 texCoords(( float) x / subdivisions, ( float) z / subdivisions);
+            data.vertices.push_back({ glm::vec3(texCoords.x - 0.5f, 0.0f, 0.5f - texCoords.y), glm::vec3(0.0f, 1.0f, 0.0f), texCoords });
+        }
+    }
+
+    for(unsigned int z = 0; z < subdivisions; z++)
+    {
+        for(unsigned int x = 0; x < subdivisions; x++)
+        {
+            unsigned short a = ( unsigned short) (z * (subdivisions + 1) + x);
+            unsigned short b = ( unsigned short) (a + subdivisions + 1);
+            data.indices.insert(data.indices.end(), { a, ( unsigned short) (a + 1), ( unsigned short) (b + 1),
+                                                      ( unsigned short) (b + 1), b, a });
+        }
+    }
+    return data;
+}
+
+///
+/// Capped cylinder along the Y axis. The side and the caps have separate vertices so the rim stays sharp.
+///
+inline PrimitiveData BuildCylinder(unsigned int segments = PRIMITIVE_SEGMENTS)
+{
+    PrimitiveData data;
+
+    // Side, with a duplicated seam column so the texture wraps once around.
+    for(unsigned int segment = 0; segment <= segments; segment++)
+    {
+        float u = ( float) segment / segments;
+        float theta = u * glm::two_pi<float>();
+        glm::vec3 normal(std::cos(theta), 0.0f, -std::sin(theta));
+        data.vertices.push_back({ normal * 0.5f + glm::vec3(0.0f, -0.5f, 0.0f), normal, glm::vec2(u, 0.0f) });
+        data.vertices.push_back({ normal * 0.5f + glm::vec3(0.0f, 0.5f, 0.0f), normal, glm::vec2(u, 1.0f) });
+    }
+    for(unsigned int segment = 0; segment < segments; segment++)
+    {
+        unsigned short a = ( unsigned short) (segment * 2);
+        data.indices.insert(data.indices.end(), { a, ( unsigned short) (a + 2), ( unsigned short) (a + 3),
+                                                  ( unsigned short) (a + 3), ( unsigned short) (a + 1), a });
+    }
+
+    // Caps, as fans around a centre vertex.
+    for(int side = -1; side <= 1; side += 2)
+    {
+        glm::vec3 normal(0.0f, ( float) side, 0.0f);
+        unsigned short centre = ( unsigned short) data.vertices.size();
+        data.vertices.push_back({ normal * 0.5f, normal, glm::vec2(0.5f, 0.5f) });
+        for(unsigned int segment = 0; segment <= segments; segment++)
+        {
+            float theta = ( float) segment / segments * glm::two_pi<float>();
+            glm::vec2 circle(std::cos(theta), -std::sin(theta));
+            data.vertices.push_back({ glm::vec3(circle.x * 0.5f, side * 0.5f, circle.y * 0.5f), normal, circle * 0.5f + 0.5f });
+        }
+        for(unsigned int segment = 0; segment < segments; segment++)
+        {
+            unsigned short a = ( unsigned short) (centre + 1 + segment);
+            if(side > 0)
+            {
+                data.indices.insert(data.indices.end(), { centre, a, ( unsigned short) (a + 1) });
+            }
+            else
+            {
+                data.indices.insert(data.indices.end(), { centre, ( unsigned short) (a + 1), a });
+            }
+        }
+    }
+    return data;
+}
+
+///
+/// GPU copy of a primitive: one interleaved vertex buffer and one index buffer behind a VAO.
+///
+class Primitive
+{
+public:
+    unsigned int VAO = 0;
+    unsigned int indexCount = 0;
+
+    ///
+    /// Default empty constructor.
+    ///
+    Primitive()
+    {
+    }
+
+    ///
+    /// Uploads the primitive's geometry. Needs a current GL context.
+    ///
+    explicit Primitive(const PrimitiveData& data)
+    {
+        indexCount = ( unsigned int) data.indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(PrimitiveVertex), &data.vertices[0], GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned short), &data.indices[0], GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(PRIMITIVE_POSITION_LOCATION);
+        glVertexAttribPointer(PRIMITIVE_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PrimitiveVertex), ( void*) offsetof(PrimitiveVertex, Position));
+
+        glEnableVertexAttribArray(PRIMITIVE_NORMAL_LOCATION);
+        glVertexAttribPointer(PRIMITIVE_NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PrimitiveVertex), ( void*) offsetof(PrimitiveVertex, Normal));
+
+        glEnableVertexAttribArray(PRIMITIVE_TEX_COORD_LOCATION);
+        glVertexAttribPointer(PRIMITIVE_TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(PrimitiveVertex), ( void*) offsetof(PrimitiveVertex, TexCoords));
+
+        glBindVertexArray(0);
+    }
+
+    ///
+    /// Draws the primitive with whichever program is in use.
+    ///
+    void Draw() const
+    {
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, 0);
+        glBindVertexArray(0);
+    }
+
+private:
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+};
+
+///
+/// Returns the shared GPU copy of a primitive, building and uploading it on first use.
+/// The VAO doesn't depend on any program, so every program in the application draws through the same copy.
+///
+inline const Primitive& GetPrimitive(PrimitiveShape shape)
+{
+    static std::map<PrimitiveShape, Primitive> primitives;
+
+    auto found = primitives.find(shape);
+    if(found != primitives.end())
+    {
+        return found->second;
+    }
+
+    PrimitiveData data;
+    switch(shape)
+    {
+        case PRIMITIVE_CUBE:        data = BuildCube(); break;
+        case PRIMITIVE_UV_SPHERE:   data = BuildUVSphere(); break;
+        case PRIMITIVE_ICOSPHERE:   data = BuildIcosphere(); break;
+        case PRIMITIVE_PLANE:       data = BuildPlane(); break;
+        case PRIMITIVE_CYLINDER:    data = BuildCylinder(); break;
+    }
+    return primitives.emplace(shape, Primitive(data)).first->second;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,568 @@
+#ifndef GLTFLOADER_H
+#define GLTFLOADER_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <FileMapping/filemapping.h>
+#include <Json/json.h>
+#include <SceneGraph/scenegraph.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary glTF files start with "glTF" and the container version, then a JSON chunk and an optional binary chunk.
+const uint32_t GLB_MAGIC = 0x46546C67;
+const uint32_t GLB_VERSION = 2;
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+// Accessor component types. The values are the matching GL type enums, so they're passed to GL as they are.
+const uint32_t GLTF_BYTE = 5120;
+const uint32_t GLTF_UNSIGNED_BYTE = 5121;
+const uint32_t GLTF_SHORT = 5122;
+const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+const uint32_t GLTF_UNSIGNED_INT = 5125;
+const uint32_t GLTF_FLOAT = 5126;
+
+// The only primitive mode drawn.
+const int64_t GLTF_TRIANGLES = 4;
+
+// Nodes visited when flattening the hierarchy before it's treated as damaged, which also stops cycles.
+const size_t GLTF_MAX_NODE_VISITS = 1 << 20;
+
+///
+/// The vertex attributes read, in the order of the shader locations they're bound to. These match the locations of
+/// the Model utility's Vertex layout; glTF has no bitangents, so location 4 is left unbound.
+///
+enum GltfAttribute
+{
+    GLTF_POSITION,
+    GLTF_NORMAL,
+    GLTF_TEXCOORD_0,
+    GLTF_TANGENT,
+    GLTF_ATTRIBUTE_COUNT
+};
+
+const char* const GLTF_ATTRIBUTE_NAMES[GLTF_ATTRIBUTE_COUNT] = { "POSITION", "NORMAL", "TEXCOORD_0", "TANGENT" };
+const uint32_t GLTF_ATTRIBUTE_COMPONENTS[GLTF_ATTRIBUTE_COUNT] = { 3, 3, 2, 4 };
+
+///
+/// A range of the binary chunk.
+///
+struct GltfBufferView
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint32_t byteStride;    // 0 for tightly packed.
+};
+
+///
+/// A typed view of a buffer view: count elements of componentCount components each.
+///
+struct GltfAccessor
+{
+    int32_t bufferView;
+    uint64_t byteOffset;    // From the start of the buffer view.
+    uint32_t componentType;
+    uint32_t componentCount;
+    uint64_t count;
+    bool normalized;
+};
+
+///
+/// One draw of a mesh: accessors of its attributes and indices, -1 where it has none.
+///
+struct GltfPrimitive
+{
+    int32_t attributes[GLTF_ATTRIBUTE_COUNT];
+    int32_t indices;
+    int32_t material;
+};
+
+///
+/// A material's texture maps as image indices, -1 where it has none.
+///
+struct GltfMaterial
+{
+    int32_t baseColorImage = -1;
+    int32_t normalImage = -1;
+};
+
+///
+/// An image, either a file relative to the asset or a buffer view of the binary chunk.
+///
+struct GltfImage
+{
+    std::string uri;
+    int32_t bufferView = -1;
+};
+
+///
+/// A mapped binary glTF file. Everything points into the mapping, so nothing is copied until it's uploaded.
+///
+struct GltfAsset
+{
+    FileMapping mapping;
+    const unsigned char* binary = NULL;
+    uint64_t binarySize = 0;
+    bool quantized = false;     // Uses KHR_mesh_quantization.
+    std::vector<GltfBufferView> bufferViews;
+    std::vector<GltfAccessor> accessors;
+    std::vector<GltfPrimitive> primitives;  // Every mesh's primitives, each mesh's together.
+    std::vector<GltfMaterial> materials;
+    std::vector<GltfImage> images;
+    std::vector<SceneNodeSource> nodes;     // Depth first, each drawing its mesh's primitives.
+};
+
+///
+/// Size in bytes of one component of an accessor type, 0 for unknown types.
+///
+inline uint32_t GltfComponentSize(uint32_t componentType)
+{
+    switch(componentType)
+    {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+///
+/// Components of an accessor element type, 0 for unknown types.
+///
+inline uint32_t GltfTypeComponents(const std::string& type)
+{
+    if(type == "SCALAR")
+    {
+        return 1;
+    }
+    if(type.size() == 4 && type.compare(0, 3, "VEC") == 0 && type[3] >= '2' && type[3] <= '4')
+    {
+        return ( uint32_t) (type[3] - '0');
+    }
+    if(type == "MAT2" || type == "MAT3" || type == "MAT4")
+    {
+        return ( uint32_t) (type[3] - '0') * ( uint32_t) (type[3] - '0');
+    }
+    return 0;
+}
+
+///
+/// Distance between an accessor's elements in its buffer view.
+///
+inline uint64_t GltfAccessorStride(const GltfAsset& asset, const GltfAccessor& accessor)
+{
+    uint32_t stride = asset.bufferViews[accessor.bufferView].byteStride;
+    return stride != 0 ? stride : ( uint64_t) GltfComponentSize(accessor.componentType) * accessor.componentCount;
+}
+
+///
+/// Returns true if an accessor's component type can feed an attribute. Floats always can, and with
+/// KHR_mesh_quantization so can the integer types the extension allows, which GL converts as it fetches them.
+///
+inline bool IsGltfAttributeType(GltfAttribute attribute, const GltfAccessor& accessor)
+{
+    if(accessor.componentType == GLTF_FLOAT)
+    {
+        return true;
+    }
+    switch(attribute)
+    {
+    case GLTF_POSITION:
+    case GLTF_TEXCOORD_0:
+        return accessor.componentType == GLTF_BYTE || accessor.componentType == GLTF_UNSIGNED_BYTE
+               || accessor.componentType == GLTF_SHORT || accessor.componentType == GLTF_UNSIGNED_SHORT;
+    case GLTF_NORMAL:
+    case GLTF_TANGENT:
+        return accessor.normalized && (accessor.componentType == GLTF_BYTE || accessor.componentType == GLTF_SHORT);
+    default:
+        return false;
+    }
+}
+
+///
+/// Reads a node's transform, from its matrix or from its translation, rotation and scale.
+///
+inline glm::mat4 ReadGltfNodeTransform(const JsonValue& node)
+{
+    const JsonValue* matrix = node.Find("matrix");
+    if(matrix != NULL && matrix->type == JSON_ARRAY && matrix->Size() == 16)
+    {
+        // Column major, the same as glm.
+        float values[16];
+        for(size_t i = 0; i < 16; i++)
+        {
+            values[i] = ( float) (*matrix)[i].number;
+        }
+        return glm::make_mat4(values);
+    }
+
+    auto vector = [&](const char* name, size_t size, const glm::vec4& fallback)
+    {
+        glm::vec4 result = fallback;
+        const JsonValue* value = node.Find(name);
+        if(value != NULL && value->type == JSON_ARRAY && value->Size() == size)
+        {
+            for(size_t i = 0; i < size; i++)
+            {
+                result[( glm::length_t) i] = ( float) (*value)[i].number;
+            }
+        }
+        return result;
+    };
+    glm::vec4 translation = vector("translation", 3, glm::vec4(0.0f));
+    glm::vec4 rotation = vector("rotation", 4, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    glm::vec4 scale = vector("scale", 3, glm::vec4(1.0f));
+
+    // glTF quaternions are x, y, z, w.
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(translation));
+    transform *= glm::mat4_cast(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+    return glm::scale(transform, glm::vec3(scale));
+}
+
+///
+/// Flattens the default scene's node trees depth first under a single identity root, which is node 0.
+/// \param json - the document.
+/// \param meshPrimitives - the first primitive and primitive count of each mesh.
+/// \param nodes - receives the nodes.
+/// \return - false if the hierarchy refers to missing nodes or meshes, or isn't a forest.
+///
+inline bool FlattenGltfNodes(const JsonValue& json, const std::vector<std::pair<uint32_t, uint32_t>>& meshPrimitives,
+                             std::vector<SceneNodeSource>& nodes)
+{
+    nodes.assign(1, { -1, 0, 0, 0, glm::mat4(1.0f) });
+    const JsonValue* jsonNodes = json.Find("nodes");
+    if(jsonNodes == NULL)
+    {
+        return true;
+    }
+
+    // The default scene's roots, or if there are no scenes every node without a parent.
+    std::vector<int64_t> roots;
+    const JsonValue* scenes = json.Find("scenes");
+    int64_t scene = json.Integer("scene", 0);
+    if(scenes != NULL && scenes->type == JSON_ARRAY && scene >= 0 && ( size_t) scene < scenes->Size())
+    {
+        const JsonValue* sceneNodes = (*scenes)[( size_t) scene].Find("nodes");
+        for(size_t i = 0; sceneNodes != NULL && i < sceneNodes->Size(); i++)
+        {
+            roots.push_back(( int64_t) (*sceneNodes)[i].number);
+        }
+    }
+    else
+    {
+        std::vector<bool> isChild(jsonNodes->Size(), false);
+        for(size_t i = 0; i < jsonNodes->Size(); i++)
+        {
+            const JsonValue* children = (*jsonNodes)[i].Find("children");
+            for(size_t c = 0; children != NULL && c < children->Size(); c++)
+            {
+                int64_t child = ( int64_t) (*children)[c].number;
+                if(child >= 0 && ( size_t) child < isChild.size())
+                {
+                    isChild[( size_t) child] = true;
+                }
+            }
+        }
+        for(size_t i = 0; i < jsonNodes->Size(); i++)
+        {
+            if(!isChild[i])
+            {
+                roots.push_back(( int64_t) i);
+            }
+        }
+    }
+
+    // Children are pushed in reverse so the first child is visited next.
+    std::vector<std::pair<int64_t, int32_t>> stack;
+    for(size_t i = roots.size(); i > 0; i--)
+    {
+        stack.push_back({ roots[i - 1], 0 });
+    }
+    while(!stack.empty())
+    {
+        int64_t index = stack.back().first;
+        int32_t parent = stack.back().second;
+        stack.pop_back();
+        if(index < 0 || ( size_t) index >= jsonNodes->Size() || nodes.size() > GLTF_MAX_NODE_VISITS)
+        {
+            return false;
+        }
+
+        const JsonValue& jsonNode = (*jsonNodes)[( size_t) index];
+        SceneNodeSource node = { parent, 0, 0, 0, ReadGltfNodeTransform(jsonNode) };
+        int64_t mesh = jsonNode.Integer("mesh", -1);
+        if(mesh >= ( int64_t) meshPrimitives.size())
+        {
+            return false;
+        }
+        if(mesh >= 0)
+        {
+            node.firstMesh = meshPrimitives[( size_t) mesh].first;
+            node.meshCount = meshPrimitives[( size_t) mesh].second;
+        }
+        nodes.push_back(node);
+
+        const JsonValue* children = jsonNode.Find("children");
+        for(size_t c = children != NULL ? children->Size() : 0; c > 0; c--)
+        {
+            stack.push_back({ ( int64_t) (*children)[c - 1].number, ( int32_t) nodes.size() - 1 });
+        }
+    }
+    return true;
+}
+
+///
+/// Maps a binary glTF file and reads its JSON chunk. Accessors, buffer views and the node hierarchy are checked
+/// against the binary chunk, so everything in the asset can be used without further checks. Only what the file
+/// embeds is supported: buffers must be the binary chunk and images either files or buffer views.
+/// \param path - the .glb file.
+/// \param asset - receives the asset.
+/// \return - false, after reporting why, if the file can't be read or uses something unsupported.
+///
+inline bool LoadGlb(const std::string& path, GltfAsset& asset)
+{
+    auto fail = [&](const char* reason)
+    {
+        std::cout << "ERROR::GLTF:: " << path << ": " << reason << std::endl;
+        asset.mapping.Close();
+        return false;
+    };
+
+    if(!asset.mapping.Open(path))
+    {
+        return fail("couldn't map the file");
+    }
+    const unsigned char* data = asset.mapping.Data();
+    const uint64_t size = asset.mapping.Size();
+    uint32_t header[3];
+    if(size < sizeof(header) + 8)
+    {
+        return fail("too small to be a binary glTF file");
+    }
+    std::memcpy(header, data, sizeof(header));
+    if(header[0] != GLB_MAGIC || header[1] != GLB_VERSION || header[2] > size)
+    {
+        return fail("not a version 2 binary glTF file");
+    }
+
+    // The JSON chunk comes first, the binary chunk after it if there is one. Unknown chunks are skipped.
+    const char* jsonText = NULL;
+    uint64_t jsonSize = 0;
+    for(uint64_t offset = sizeof(header); offset + 8 <= header[2];)
+    {
+        uint32_t chunk[2];
+        std::memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if(chunk[0] > header[2] - offset)
+        {
+            return fail("chunk runs past the end of the file");
+        }
+        if(chunk[1] == GLB_CHUNK_JSON && jsonText == NULL)
+        {
+            jsonText = reinterpret_cast<const char*>(data + offset);
+            jsonSize = chunk[0];
+        }
+        else if(chunk[1] == GLB_CHUNK_BIN && asset.binary == NULL)
+        {
+            asset.binary = data + offset;
+            asset.binarySize = chunk[0];
+        }
+        offset += (chunk[0] + 3) & ~3ull;
+    }
+
+    JsonValue json;
+    if(jsonText == NULL || !ParseJson(jsonText, jsonText + jsonSize, json) || json.type != JSON_OBJECT)
+    {
+        return fail("missing or malformed JSON chunk");
+    }
+
+    const JsonValue* required = json.Find("extensionsRequired");
+    for(size_t i = 0; required != NULL && i < required->Size(); i++)
+    {
+        if((*required)[i].string != "KHR_mesh_quantization")
+        {
+            return fail(("requires unsupported extension " + (*required)[i].string).c_str());
+        }
+    }
+    const JsonValue* used = json.Find("extensionsUsed");
+    for(size_t i = 0; used != NULL && i < used->Size(); i++)
+    {
+        asset.quantized = asset.quantized || (*used)[i].string == "KHR_mesh_quantization";
+    }
+
+    const JsonValue* buffers = json.Find("buffers");
+    if(buffers != NULL && (buffers->Size() > 1 || (buffers->Size() == 1 && (*buffers)[0].Find("uri") != NULL)))
+    {
+        return fail("external buffers aren't supported, only the binary chunk");
+    }
+    if(buffers != NULL && buffers->Size() == 1 && ( uint64_t) (*buffers)[0].Integer("byteLength", -1) > asset.binarySize)
+    {
+        return fail("buffer is larger than the binary chunk");
+    }
+
+    const JsonValue* views = json.Find("bufferViews");
+    for(size_t i = 0; views != NULL && i < views->Size(); i++)
+    {
+        const JsonValue& view = (*views)[i];
+        GltfBufferView bufferView;
+        int64_t byteOffset = view.Integer("byteOffset", 0);
+        int64_t byteLength = view.Integer("byteLength", -1);
+        int64_t byteStride = view.Integer("byteStride", 0);
+        if(view.Integer("buffer", -1) != 0 || byteOffset < 0 || byteLength < 0 || ( uint64_t) byteOffset > asset.binarySize
+           || ( uint64_t) byteLength > asset.binarySize - ( uint64_t) byteOffset || byteStride < 0 || byteStride > 252)
+        {
+            return fail("buffer view outside the binary chunk");
+        }
+        bufferView.byteOffset = ( uint64_t) byteOffset;
+        bufferView.byteLength = ( uint64_t) byteLength;
+        bufferView.byteStride = ( uint32_t) byteStride;
+        asset.bufferViews.push_back(bufferView);
+    }
+
+    const JsonValue* accessors = json.Find("accessors");
+    for(size_t i = 0; accessors != NULL && i < accessors->Size(); i++)
+    {
+        const JsonValue& jsonAccessor = (*accessors)[i];
+        if(jsonAccessor.Find("sparse") != NULL)
+        {
+            return fail("sparse accessors aren't supported");
+        }
+
+        GltfAccessor accessor;
+        int64_t bufferView = jsonAccessor.Integer("bufferView", -1);
+        int64_t byteOffset = jsonAccessor.Integer("byteOffset", 0);
+        int64_t count = jsonAccessor.Integer("count", -1);
+        accessor.componentType = ( uint32_t) jsonAccessor.Integer("componentType", 0);
+        accessor.componentCount = GltfTypeComponents(jsonAccessor.String("type"));
+        accessor.normalized = jsonAccessor.Boolean("normalized", false);
+        uint32_t componentSize = GltfComponentSize(accessor.componentType);
+        if(bufferView < 0 || ( size_t) bufferView >= asset.bufferViews.size() || byteOffset < 0 || count < 0
+           || componentSize == 0 || accessor.componentCount == 0 || byteOffset % componentSize != 0)
+        {
+            return fail("accessor without data or of an unknown type");
+        }
+        accessor.bufferView = ( int32_t) bufferView;
+        accessor.byteOffset = ( uint64_t) byteOffset;
+        accessor.count = ( uint64_t) count;
+
+        // The last element has to end inside the view.
+        const GltfBufferView& view = asset.bufferViews[accessor.bufferView];
+        uint64_t elementSize = ( uint64_t) componentSize * accessor.componentCount;
+        uint64_t stride = GltfAccessorStride(asset, accessor);
+        if(accessor.count > 0 && (accessor.byteOffset > view.byteLength || (accessor.count - 1) > (view.byteLength - accessor.byteOffset) / stride
+                                  || accessor.byteOffset + (accessor.count - 1) * stride + elementSize > view.byteLength))
+        {
+            return fail("accessor runs past the end of its buffer view");
+        }
+        asset.accessors.push_back(accessor);
+    }
+
+    const JsonValue* images = json.Find("images");
+    for(size_t i = 0; images != NULL && i < images->Size(); i++)
+    {
+        GltfImage image;
+        image.uri = (*images)[i].String("uri");
+        image.bufferView = ( int32_t) (*images)[i].Integer("bufferView", -1);
+        if(image.bufferView >= ( int32_t) asset.bufferViews.size() || (image.uri.empty() && image.bufferView < 0))
+        {
+            return fail("image without data");
+        }
+        asset.images.push_back(image);
+    }
+
+    // Materials refer to textures, which refer to images.
+    const JsonValue* textures = json.Find("textures");
+    auto textureImage = [&](const JsonValue* info)
+    {
+        int64_t texture = info != NULL ? info->Integer("index", -1) : -1;
+        if(textures == NULL || texture < 0 || ( size_t) texture >= textures->Size())
+        {
+            return -1;
+        }
+        int64_t image = (*textures)[( size_t) texture].Integer("source", -1);
+        return image >= 0 && ( size_t) image < asset.images.size() ? ( int32_t) image : -1;
+    };
+    const JsonValue* materials = json.Find("materials");
+    for(size_t i = 0; materials != NULL && i < materials->Size(); i++)
+    {
+        const JsonValue& jsonMaterial = (*materials)[i];
+        GltfMaterial material;
+        const JsonValue* pbr = jsonMaterial.Find("pbrMetallicRoughness");
+        material.baseColorImage = textureImage(pbr != NULL ? pbr->Find("baseColorTexture") : NULL);
+        material.normalImage = textureImage(jsonMaterial.Find("normalTexture"));
+        asset.materials.push_back(material);
+    }
+
+    // Each mesh's triangle primitives, with attributes the upload can bind as they are.
+    std::vector<std::pair<uint32_t, uint32_t>> meshPrimitives;
+    const JsonValue* meshes = json.Find("meshes");
+    for(size_t m = 0; meshes != NULL && m < meshes->Size(); m++)
+    {
+        uint32_t first = ( uint32_t) asset.primitives.size();
+        const JsonValue* primitives = (*meshes)[m].Find("primitives");
+        for(size_t p = 0; primitives != NULL && p < primitives->Size(); p++)
+        {
+            const JsonValue& jsonPrimitive = (*primitives)[p];
+            if(jsonPrimitive.Integer("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES)
+            {
+                continue;
+            }
+
+            GltfPrimitive primitive;
+            const JsonValue* attributes = jsonPrimitive.Find("attributes");
+            for(int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++)
+            {
+                int64_t accessor = attributes != NULL ? attributes->Integer(GLTF_ATTRIBUTE_NAMES[a], -1) : -1;
+                primitive.attributes[a] = -1;
+                if(accessor >= 0 && ( size_t) accessor < asset.accessors.size()
+                   && asset.accessors[( size_t) accessor].componentCount == GLTF_ATTRIBUTE_COMPONENTS[a]
+                   && IsGltfAttributeType(( GltfAttribute) a, asset.accessors[( size_t) accessor]))
+                {
+                    primitive.attributes[a] = ( int32_t) accessor;
+                }
+            }
+            int64_t indices = jsonPrimitive.Integer("indices", -1);
+            int64_t material = jsonPrimitive.Integer("material", -1);
+            primitive.indices = indices >= 0 && ( size_t) indices < asset.accessors.size() ? ( int32_t) indices : -1;
+            primitive.material = material >= 0 && ( size_t) material < asset.materials.size() ? ( int32_t) material : -1;
+            if(primitive.attributes[GLTF_POSITION] < 0)
+            {
+                return fail("primitive without usable positions");
+            }
+            if(primitive.indices >= 0)
+            {
+                const GltfAccessor& accessor = asset.accessors[primitive.indices];
+                if(accessor.componentCount != 1 || accessor.componentType == GLTF_BYTE || accessor.componentType == GLTF_SHORT
+                   || accessor.componentType == GLTF_FLOAT || asset.bufferViews[accessor.bufferView].byteStride != 0)
+                {
+                    return fail("indices must be tightly packed unsigned integers");
+                }
+            }
+            asset.primitives.push_back(primitive);
+        }
+        meshPrimitives.push_back({ first, ( uint32_t) asset.primitives.size() - first });
+    }
+
+    if(!FlattenGltfNodes(json, meshPrimitives, asset.nodes))
+    {
+        return fail("damaged node hierarchy");
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
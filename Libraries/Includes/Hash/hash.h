@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a, 64 bit.
+const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t HASH_PRIME = 1099511628211ull;
+
+///
+/// Continues an FNV-1a hash over the given bytes.
+///
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * HASH_PRIME;
+    }
+    return hash;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <AtomicFile/atomicfile.h>
+#include <FileMapping/filemapping.h>
+#include <Hash/hash.h>
+#include <PixelCodec/pixelcodec.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Decoded copies of images, kept next to them so later runs skip decoding PNG or JPEG files. The pixels are stored
+// with the pixel codec, see PixelCodec. Each cache is keyed by the size and modification time of the image it was
+// decoded from, so a warm run doesn't read the image at all, and a cache of an edited image isn't used.
+const uint32_t IMAGE_CACHE_MAGIC = 0x474D4944;    // "DIMG"
+const uint32_t IMAGE_CACHE_VERSION = 2;
+
+// Extension appended to the image's path to name its cache.
+const char* const IMAGE_CACHE_EXTENSION = ".decoded";
+
+// Start of a cache file, followed by the encoded pixels.
+struct ImageCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;               // See ImageCacheKey.
+    uint32_t width;
+    uint32_t height;
+    uint32_t components;        // Bytes per pixel, as the image decoded.
+    uint32_t reserved;
+    uint64_t encodedSize;       // Bytes of encoded pixels following the header.
+};
+
+///
+/// Builds the key a cache is stored under from everything that determines its contents: the image file's size and
+/// modification time, the format version and the codec's band size. Only the file's metadata is read.
+/// \param imagePath - the image file.
+/// \param key - receives the key.
+/// \return - false if the file can't be found.
+///
+inline bool ImageCacheKey(const std::string& imagePath, uint64_t& key)
+{
+#ifdef _WIN32
+    struct _stat64 status;
+    if(_stat64(imagePath.c_str(), &status) != 0)
+#else
+    struct stat status;
+    if(stat(imagePath.c_str(), &status) != 0)
+#endif
+    {
+        return false;
+    }
+    uint64_t layout[4] = { ( uint64_t) status.st_size, ( uint64_t) status.st_mtime, IMAGE_CACHE_VERSION, PIXEL_CODEC_BAND_ROWS };
+    key = HashBytes(layout, sizeof(layout));
+    return true;
+}
+
+///
+/// Writes a decoded image's cache, see WriteFileAtomically.
+/// \param cachePath - the file to write.
+/// \param key - see ImageCacheKey.
+/// \param pixels - the pixels, rows tightly packed.
+/// \param width, height, components - the image's size and bytes per pixel.
+/// \return - true on success.
+///
+inline bool WriteImageCache(const std::string& cachePath, uint64_t key, const unsigned char* pixels, int width, int height, int components)
+{
+    std::vector<unsigned char> encoded;
+    EncodePixelImage(pixels, width, height, components, encoded);
+    ImageCacheHeader header = { IMAGE_CACHE_MAGIC, IMAGE_CACHE_VERSION, key, ( uint32_t) width, ( uint32_t) height, ( uint32_t) components, 0,
+                                ( uint64_t) encoded.size() };
+    return WriteFileAtomically(cachePath, { { &header, sizeof(header) }, { encoded.data(), encoded.size() } });
+}
+
+///
+/// Reads a decoded image's cache, if there is one written with the given key.
+/// \param cachePath - the cache file.
+/// \param key - the key the cache must have been written with, see ImageCacheKey.
+/// \param width, height, components - receive the image's size and bytes per pixel.
+/// \param pixels - receives the pixels.
+/// \return - false if there's no cache, it's stale or it's damaged.
+///
+inline bool ReadImageCache(const std::string& cachePath, uint64_t key, int& width, int& height, int& components, std::vector<unsigned char>& pixels)
+{
+    FileMapping file;
+    ImageCacheHeader header;
+    if(!file.Open(cachePath) || file.Size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if(header.magic != IMAGE_CACHE_MAGIC || header.version != IMAGE_CACHE_VERSION || header.key != key || header.width == 0
+       || header.height == 0 || header.width > 65536 || header.height > 65536 || header.components == 0 || header.components > 4
+       || header.encodedSize != file.Size() - sizeof(header))
+    {
+        return false;
+    }
+
+    pixels.resize(( size_t) header.width * header.height * header.components);
+    if(!DecodePixelImage(file.Data() + sizeof(header), ( size_t) header.encodedSize, ( int) header.width, ( int) header.height,
+                         ( int) header.components, pixels.data()))
+    {
+        pixels.clear();
+        return false;
+    }
+    width = ( int) header.width;
+    height = ( int) header.height;
+    components = ( int) header.components;
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,446 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Nesting allowed before a document is rejected, so a hostile file can't exhaust the stack.
+const int JSON_MAX_DEPTH = 256;
+
+enum JsonType
+{
+    JSON_NULL,
+    JSON_BOOLEAN,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+///
+/// A parsed JSON value. Arrays and objects keep their elements in document order, objects with the member names
+/// alongside. Lookups of members are linear, which suits the small objects of asset formats such as glTF.
+///
+struct JsonValue
+{
+    JsonType type = JSON_NULL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements;    // Array elements, or object member values.
+    std::vector<std::string> names;     // Object member names, one per element.
+
+    ///
+    /// Looks an object member up.
+    /// \param name - the member's name.
+    /// \return - the member, or NULL if this isn't an object or has no such member.
+    ///
+    const JsonValue* Find(const char* name) const
+    {
+        for(size_t i = 0; i < names.size(); i++)
+        {
+            if(names[i] == name)
+            {
+                return &elements[i];
+            }
+        }
+        return NULL;
+    }
+
+    ///
+    /// The number of array elements or object members.
+    ///
+    size_t Size() const
+    {
+        return elements.size();
+    }
+
+    const JsonValue& operator[](size_t index) const
+    {
+        return elements[index];
+    }
+
+    ///
+    /// The member's value as a number, or the fallback if it's missing or not a number.
+    ///
+    double Number(const char* name, double fallback) const
+    {
+        const JsonValue* member = Find(name);
+        return member != NULL && member->type == JSON_NUMBER ? member->number : fallback;
+    }
+
+    ///
+    /// The member's value as an integer, or the fallback if it's missing, not a number or not a whole number
+    /// that fits.
+    ///
+    int64_t Integer(const char* name, int64_t fallback) const
+    {
+        const JsonValue* member = Find(name);
+        if(member == NULL || member->type != JSON_NUMBER || member->number != ( double) ( int64_t) member->number)
+        {
+            return fallback;
+        }
+        return ( int64_t) member->number;
+    }
+
+    ///
+    /// The member's value as a boolean, or the fallback if it's missing or not a boolean.
+    ///
+    bool Boolean(const char* name, bool fallback) const
+    {
+        const JsonValue* member = Find(name);
+        return member != NULL && member->type == JSON_BOOLEAN ? member->boolean : fallback;
+    }
+
+    ///
+    /// The member's value as a string, or an empty string if it's missing or not a string.
+    ///
+    std::string String(const char* name) const
+    {
+        const JsonValue* member = Find(name);
+        return member != NULL && member->type == JSON_STRING ? member->string : std::string();
+    }
+};
+
+///
+/// Skips insignificant whitespace.
+///
+inline const char* SkipJsonSpaces(const char* cursor, const char* end)
+{
+    while(cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r'))
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+///
+/// Appends a code point to a string as UTF-8.
+///
+inline void AppendUtf8(std::string& text, uint32_t codePoint)
+{
+    if(codePoint < 0x80)
+    {
+        text += ( char) codePoint;
+    }
+    else if(codePoint < 0x800)
+    {
+        text += ( char) (0xC0 | (codePoint >> 6));
+        text += ( char) (0x80 | (codePoint & 0x3F));
+    }
+    else if(codePoint < 0x10000)
+    {
+        text += ( char) (0xE0 | (codePoint >> 12));
+        text += ( char) (0x80 | ((codePoint >> 6) & 0x3F));
+        text += ( char) (0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        text += ( char) (0xF0 | (codePoint >> 18));
+        text += ( char) (0x80 | ((codePoint >> 12) & 0x3F));
+        text += ( char) (0x80 | ((codePoint >> 6) & 0x3F));
+        text += ( char) (0x80 | (codePoint & 0x3F));
+    }
+}
+
+///
+/// Reads the four hex digits of a \u escape.
+/// \return - false if they aren't four hex digits.
+///
+inline bool ParseJsonHex(const char*& cursor, const char* end, uint32_t& value)
+{
+    if(end - cursor < 4)
+    {
+        return false;
+    }
+    value = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        char c = *cursor++;
+        uint32_t digit;
+        if(c >= '0' && c <= '9')
+        {
+            digit = ( uint32_t) (c - '0');
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            digit = ( uint32_t) (c - 'a' + 10);
+        }
+        else if(c >= 'A' && c <= 'F')
+        {
+            digit = ( uint32_t) (c - 'A' + 10);
+        }
+        else
+        {
+            return false;
+        }
+        value = value * 16 + digit;
+    }
+    return true;
+}
+
+///
+/// Reads a string, cursor at its opening quote, decoding escapes.
+/// \return - false if the string is malformed or unterminated.
+///
+inline bool ParseJsonString(const char*& cursor, const char* end, std::string& text)
+{
+    cursor++;
+    text.clear();
+    while(cursor < end)
+    {
+        // Copy the run up to the next quote or escape in one go.
+        const char* run = cursor;
+        while(cursor < end && *cursor != '"' && *cursor != '\\' && ( unsigned char) *cursor >= 0x20)
+        {
+            cursor++;
+        }
+        text.append(run, cursor);
+        if(cursor == end || ( unsigned char) *cursor < 0x20)
+        {
+            return false;
+        }
+        if(*cursor++ == '"')
+        {
+            return true;
+        }
+
+        if(cursor == end)
+        {
+            return false;
+        }
+        char escape = *cursor++;
+        switch(escape)
+        {
+        case '"': text += '"'; break;
+        case '\\': text += '\\'; break;
+        case '/': text += '/'; break;
+        case 'b': text += '\b'; break;
+        case 'f': text += '\f'; break;
+        case 'n': text += '\n'; break;
+        case 'r': text += '\r'; break;
+        case 't': text += '\t'; break;
+        case 'u':
+        {
+            uint32_t codePoint;
+            if(!ParseJsonHex(cursor, end, codePoint))
+            {
+                return false;
+            }
+            // Characters outside the basic plane are escaped as a surrogate pair.
+            if(codePoint >= 0xD800 && codePoint < 0xDC00)
+            {
+                uint32_t low;
+                if(end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u')
+                {
+                    return false;
+                }
+                cursor += 2;
+                if(!ParseJsonHex(cursor, end, low) || low < 0xDC00 || low >= 0xE000)
+                {
+                    return false;
+                }
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if(codePoint >= 0xDC00 && codePoint < 0xE000)
+            {
+                return false;
+            }
+            AppendUtf8(text, codePoint);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+///
+/// Reads a value and everything nested in it.
+/// \return - false if the value is malformed or nested deeper than JSON_MAX_DEPTH.
+///
+inline bool ParseJsonValue(const char*& cursor, const char* end, JsonValue& value, int depth)
+{
+    cursor = SkipJsonSpaces(cursor, end);
+    if(cursor == end || depth > JSON_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    auto literal = [&](const char* word, size_t length)
+    {
+        if(( size_t) (end - cursor) < length || std::memcmp(cursor, word, length) != 0)
+        {
+            return false;
+        }
+        cursor += length;
+        return true;
+    };
+
+    switch(*cursor)
+    {
+    case '{':
+    {
+        value.type = JSON_OBJECT;
+        cursor = SkipJsonSpaces(cursor + 1, end);
+        if(cursor < end && *cursor == '}')
+        {
+            cursor++;
+            return true;
+        }
+        while(true)
+        {
+            cursor = SkipJsonSpaces(cursor, end);
+            if(cursor == end || *cursor != '"')
+            {
+                return false;
+            }
+            value.names.emplace_back();
+            if(!ParseJsonString(cursor, end, value.names.back()))
+            {
+                return false;
+            }
+            cursor = SkipJsonSpaces(cursor, end);
+            if(cursor == end || *cursor++ != ':')
+            {
+                return false;
+            }
+            value.elements.emplace_back();
+            if(!ParseJsonValue(cursor, end, value.elements.back(), depth + 1))
+            {
+                return false;
+            }
+            cursor = SkipJsonSpaces(cursor, end);
+            if(cursor == end)
+            {
+                return false;
+            }
+            if(*cursor == '}')
+            {
+                cursor++;
+                return true;
+            }
+            if(*cursor++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+    case '[':
+    {
+        value.type = JSON_ARRAY;
+        cursor = SkipJsonSpaces(cursor + 1, end);
+        if(cursor < end && *cursor == ']')
+        {
+            cursor++;
+            return true;
+        }
+        while(true)
+        {
+            value.elements.emplace_back();
+            if(!ParseJsonValue(cursor, end, value.elements.back(), depth + 1))
+            {
+                return false;
+            }
+            cursor = SkipJsonSpaces(cursor, end);
+            if(cursor == end)
+            {
+                return false;
+            }
+            if(*cursor == ']')
+            {
+                cursor++;
+                return true;
+            }
+            if(*cursor++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+    case '"':
+        value.type = JSON_STRING;
+        return ParseJsonString(cursor, end, value.string);
+    case 't':
+        value.type = JSON_BOOLEAN;
+        value.boolean = true;
+        return literal("true", 4);
+    case 'f':
+        value.type = JSON_BOOLEAN;
+        value.boolean = false;
+        return literal("false", 5);
+    case 'n':
+        value.type = JSON_NULL;
+        return literal("null", 4);
+    default:
+    {
+        // from_chars takes no leading plus, which JSON doesn't allow either, but does allow "inf" and "nan".
+        if(*cursor != '-' && (*cursor < '0' || *cursor > '9'))
+        {
+            return false;
+        }
+        value.type = JSON_NUMBER;
+        std::from_chars_result result = std::from_chars(cursor, end, value.number);
+        if(result.ec != std::errc())
+        {
+            return false;
+        }
+        cursor = result.ptr;
+        return true;
+    }
+    }
+}
+
+///
+/// Parses a whole JSON document.
+/// \param begin - the document's first character.
+/// \param end - one past its last character.
+/// \param root - receives the document's value.
+/// \return - false if the document is malformed or has anything but whitespace after the value.
+///
+inline bool ParseJson(const char* begin, const char* end, JsonValue& root)
+{
+    root = JsonValue();
+    const char* cursor = begin;
+    if(!ParseJsonValue(cursor, end, root, 0))
+    {
+        return false;
+    }
+    return SkipJsonSpaces(cursor, end) == end;
+}
+
+///
+/// Appends a string to a document being written, quoted and with the characters JSON doesn't allow as they are
+/// escaped. Everything else, UTF-8 included, is written as it is.
+///
+inline void AppendJsonString(std::string& text, const std::string& value)
+{
+    static const char HEX[] = "0123456789abcdef";
+    text += '"';
+    for(unsigned char c : value)
+    {
+        if(c == '"' || c == '\\')
+        {
+            text += '\\';
+            text += ( char) c;
+        }
+        else if(c < 0x20)
+        {
+            text += "\\u00";
+            text += HEX[c >> 4];
+            text += HEX[c & 0xF];
+        }
+        else
+        {
+            text += ( char) c;
+        }
+    }
+    text += '"';
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,385 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <AtomicFile/atomicfile.h>
+#include <BlockCompression/blockcompression.h>
+#include <TextureCodec/texturecodec.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Reads and writes KTX2 containers of block compressed textures: a header, an index of the mip levels, the data
+// format descriptor every KTX2 file must carry, then the levels, smallest first as the specification recommends.
+// Only 2D textures are handled, which is what the texture cooker writes. Their levels can be supercompressed with
+// the texture codec, under a scheme number from the range KTX2 leaves to vendors, which other readers will refuse.
+
+const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+const size_t KTX2_HEADER_SIZE = 80;         // Identifier, header and index.
+const size_t KTX2_LEVEL_INDEX_SIZE = 24;    // Offset, length and uncompressed length of a level.
+
+// Supercompression schemes. The block streams scheme is numbered anew whenever the mesh codec's stream format
+// changes, so files written with an older one are turned down rather than read as damaged.
+const uint32_t KTX_SUPERCOMPRESSION_NONE = 0;
+const uint32_t KTX_SUPERCOMPRESSION_BLOCK_STREAMS = 0x10001;   // Levels encoded by EncodeBlockImage.
+
+// The Vulkan formats of the block compressed textures, which is how KTX2 names formats.
+const uint32_t KTX_FORMAT_BC1_RGB_UNORM = 131;
+const uint32_t KTX_FORMAT_BC1_RGB_SRGB = 132;
+const uint32_t KTX_FORMAT_BC3_UNORM = 137;
+const uint32_t KTX_FORMAT_BC3_SRGB = 138;
+const uint32_t KTX_FORMAT_BC4_UNORM = 139;
+const uint32_t KTX_FORMAT_BC5_UNORM = 141;
+const uint32_t KTX_FORMAT_BC7_UNORM = 145;
+const uint32_t KTX_FORMAT_BC7_SRGB = 146;
+
+// Colour models of the data format descriptor's basic block for each block format.
+const uint8_t KTX_DF_MODEL_BC1A = 128;
+const uint8_t KTX_DF_MODEL_BC3 = 130;
+const uint8_t KTX_DF_MODEL_BC4 = 131;
+const uint8_t KTX_DF_MODEL_BC5 = 132;
+const uint8_t KTX_DF_MODEL_BC7 = 134;
+
+// One mip level, a range of the file.
+struct KtxLevel
+{
+    int width;
+    int height;
+    size_t offset;
+    size_t size;    // Stored size, which is CompressedImageSize unless the level is supercompressed.
+};
+
+// A KTX2 file that has been parsed. The levels point into the file's bytes, largest first.
+struct KtxTexture
+{
+    uint32_t format = 0;
+    BlockFormat blockFormat = BLOCK_FORMAT_BC1;
+    bool srgb = false;
+    uint32_t supercompression = KTX_SUPERCOMPRESSION_NONE;
+    int width = 0;
+    int height = 0;
+    std::vector<KtxLevel> levels;
+};
+
+///
+/// Finds the block format of a KTX format.
+/// \return - false for formats that aren't block compressed ones this loader handles.
+///
+inline bool KtxBlockFormat(uint32_t format, BlockFormat& blockFormat, bool& srgb)
+{
+    srgb = format == KTX_FORMAT_BC1_RGB_SRGB || format == KTX_FORMAT_BC3_SRGB || format == KTX_FORMAT_BC7_SRGB;
+    switch(format)
+    {
+    case KTX_FORMAT_BC1_RGB_UNORM:
+    case KTX_FORMAT_BC1_RGB_SRGB:
+        blockFormat = BLOCK_FORMAT_BC1;
+        return true;
+    case KTX_FORMAT_BC3_UNORM:
+    case KTX_FORMAT_BC3_SRGB:
+        blockFormat = BLOCK_FORMAT_BC3;
+        return true;
+    case KTX_FORMAT_BC4_UNORM:
+        blockFormat = BLOCK_FORMAT_BC4;
+        return true;
+    case KTX_FORMAT_BC5_UNORM:
+        blockFormat = BLOCK_FORMAT_BC5;
+        return true;
+    case KTX_FORMAT_BC7_UNORM:
+    case KTX_FORMAT_BC7_SRGB:
+        blockFormat = BLOCK_FORMAT_BC7;
+        return true;
+    }
+    return false;
+}
+
+///
+/// The KTX format of a block format.
+/// \param srgb - whether the colour channels are sRGB encoded. Ignored by BC4 and BC5, which have no sRGB forms.
+///
+inline uint32_t KtxFormat(BlockFormat blockFormat, bool srgb)
+{
+    switch(blockFormat)
+    {
+    case BLOCK_FORMAT_BC1:
+        return srgb ? KTX_FORMAT_BC1_RGB_SRGB : KTX_FORMAT_BC1_RGB_UNORM;
+    case BLOCK_FORMAT_BC3:
+        return srgb ? KTX_FORMAT_BC3_SRGB : KTX_FORMAT_BC3_UNORM;
+    case BLOCK_FORMAT_BC4:
+        return KTX_FORMAT_BC4_UNORM;
+    case BLOCK_FORMAT_BC5:
+        return KTX_FORMAT_BC5_UNORM;
+    case BLOCK_FORMAT_BC7:
+        return srgb ? KTX_FORMAT_BC7_SRGB : KTX_FORMAT_BC7_UNORM;
+    }
+    return 0;
+}
+
+// Little endian fields of the header and index.
+inline void WriteKtxField(std::vector<unsigned char>& out, uint64_t value, int bytes)
+{
+    for(int b = 0; b < bytes; b++)
+    {
+        out.push_back(( unsigned char) (value >> (8 * b)));
+    }
+}
+
+inline uint64_t ReadKtxField(const unsigned char* in, int bytes)
+{
+    uint64_t value = 0;
+    for(int b = 0; b < bytes; b++)
+    {
+        value |= ( uint64_t) in[b] << (8 * b);
+    }
+    return value;
+}
+
+///
+/// Builds the data format descriptor of a block format: one basic block with a sample per 64 bit half of the block
+/// that holds a separately compressed channel.
+///
+inline std::vector<unsigned char> KtxDataFormatDescriptor(BlockFormat blockFormat, bool srgb)
+{
+    struct Sample
+    {
+        uint32_t bitOffset;
+        uint32_t bitLength;
+        uint32_t channel;
+    };
+    std::vector<Sample> samples;
+    uint8_t model = 0;
+    switch(blockFormat)
+    {
+    case BLOCK_FORMAT_BC1:
+        model = KTX_DF_MODEL_BC1A;
+        samples.push_back({ 0, 64, 0 });
+        break;
+    case BLOCK_FORMAT_BC3:
+        model = KTX_DF_MODEL_BC3;
+        samples.push_back({ 0, 64, 15 });
+        samples.push_back({ 64, 64, 0 });
+        break;
+    case BLOCK_FORMAT_BC4:
+        model = KTX_DF_MODEL_BC4;
+        samples.push_back({ 0, 64, 0 });
+        break;
+    case BLOCK_FORMAT_BC5:
+        model = KTX_DF_MODEL_BC5;
+        samples.push_back({ 0, 64, 0 });
+        samples.push_back({ 64, 64, 1 });
+        break;
+    case BLOCK_FORMAT_BC7:
+        model = KTX_DF_MODEL_BC7;
+        samples.push_back({ 0, 128, 0 });
+        break;
+    }
+
+    std::vector<unsigned char> descriptor;
+    uint32_t blockSize = 24 + 16 * ( uint32_t) samples.size();
+    WriteKtxField(descriptor, 4 + blockSize, 4);                                // Total size.
+    WriteKtxField(descriptor, 0, 4);                                            // Khronos vendor, basic descriptor.
+    WriteKtxField(descriptor, 2, 2);                                            // Version.
+    WriteKtxField(descriptor, blockSize, 2);
+    WriteKtxField(descriptor, model, 1);
+    WriteKtxField(descriptor, 1, 1);                                            // BT.709 primaries.
+    WriteKtxField(descriptor, srgb ? 2 : 1, 1);                                 // sRGB or linear transfer.
+    WriteKtxField(descriptor, 0, 1);                                            // Straight alpha.
+    WriteKtxField(descriptor, 3 | 3 << 8, 4);                                   // 4x4 texel blocks, less one.
+    WriteKtxField(descriptor, BlockFormatBytes(blockFormat), 4);                // Bytes in plane 0.
+    WriteKtxField(descriptor, 0, 4);
+    for(const Sample& sample : samples)
+    {
+        WriteKtxField(descriptor, sample.bitOffset, 2);
+        WriteKtxField(descriptor, sample.bitLength - 1, 1);
+        WriteKtxField(descriptor, sample.channel, 1);
+        WriteKtxField(descriptor, 0, 4);                                        // Sample position.
+        WriteKtxField(descriptor, 0, 4);                                        // Lower.
+        WriteKtxField(descriptor, 0xFFFFFFFF, 4);                               // Upper.
+    }
+    return descriptor;
+}
+
+///
+/// Writes a block compressed texture and its mip chain as a KTX2 file. It's written to a temporary file that's
+/// renamed into place, so a reader never sees half of it.
+/// \param path - the file to write.
+/// \param blockFormat - the format of the levels.
+/// \param srgb - whether the colour channels are sRGB encoded.
+/// \param levels - the compressed levels, largest first, each half the size of the one before.
+/// \param supercompress - whether to store the levels encoded by EncodeBlockImage.
+/// \return - false if the file couldn't be written, or a level couldn't be encoded.
+///
+inline bool WriteKtx2(const std::string& path, BlockFormat blockFormat, bool srgb, int width, int height,
+                      const std::vector<std::vector<unsigned char>>& levels, bool supercompress = false)
+{
+    std::vector<std::vector<unsigned char>> encoded;
+    if(supercompress)
+    {
+        encoded.resize(levels.size());
+        for(size_t level = 0; level < levels.size(); level++)
+        {
+            if(!EncodeBlockImage(levels[level].data(), std::max(width >> level, 1), std::max(height >> level, 1), blockFormat, encoded[level]))
+            {
+                return false;
+            }
+        }
+    }
+    const std::vector<std::vector<unsigned char>>& stored = supercompress ? encoded : levels;
+
+    std::vector<unsigned char> descriptor = KtxDataFormatDescriptor(blockFormat, srgb);
+    size_t descriptorOffset = KTX2_HEADER_SIZE + levels.size() * KTX2_LEVEL_INDEX_SIZE;
+
+    // Levels go smallest first, each aligned to its block size unless they're supercompressed.
+    size_t alignment = supercompress ? 1 : BlockFormatBytes(blockFormat);
+    std::vector<size_t> offsets(levels.size());
+    size_t offset = descriptorOffset + descriptor.size();
+    for(size_t level = levels.size(); level > 0; level--)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        offsets[level - 1] = offset;
+        offset += stored[level - 1].size();
+    }
+
+    std::vector<unsigned char> file(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+    WriteKtxField(file, KtxFormat(blockFormat, srgb), 4);
+    WriteKtxField(file, 1, 4);                          // Type size, 1 for block compressed formats.
+    WriteKtxField(file, ( uint32_t) width, 4);
+    WriteKtxField(file, ( uint32_t) height, 4);
+    WriteKtxField(file, 0, 4);                          // Depth, layers.
+    WriteKtxField(file, 0, 4);
+    WriteKtxField(file, 1, 4);                          // Faces.
+    WriteKtxField(file, levels.size(), 4);
+    WriteKtxField(file, supercompress ? KTX_SUPERCOMPRESSION_BLOCK_STREAMS : KTX_SUPERCOMPRESSION_NONE, 4);
+    WriteKtxField(file, descriptorOffset, 4);
+    WriteKtxField(file, descriptor.size(), 4);
+    WriteKtxField(file, 0, 4);                          // No key/value data.
+    WriteKtxField(file, 0, 4);
+    WriteKtxField(file, 0, 8);                          // No supercompression global data.
+    WriteKtxField(file, 0, 8);
+    for(size_t level = 0; level < levels.size(); level++)
+    {
+        WriteKtxField(file, offsets[level], 8);
+        WriteKtxField(file, stored[level].size(), 8);
+        WriteKtxField(file, levels[level].size(), 8);
+    }
+    file.insert(file.end(), descriptor.begin(), descriptor.end());
+    for(size_t level = levels.size(); level > 0; level--)
+    {
+        file.resize(offsets[level - 1], 0);
+        file.insert(file.end(), stored[level - 1].begin(), stored[level - 1].end());
+    }
+
+    return WriteFileAtomically(path, { { file.data(), file.size() } });
+}
+
+///
+/// Parses a KTX2 file already in memory. Every level must lie inside the file and be exactly the size its
+/// dimensions and format call for once it's decompressed, so uploading them can't read past the end.
+/// \param data - the file.
+/// \param size - its size in bytes.
+/// \param texture - receives the format and where each level is.
+/// \return - false if the file is damaged or isn't a 2D block compressed texture, or its supercompression isn't
+/// one this reader knows.
+///
+inline bool ParseKtx2(const unsigned char* data, size_t size, KtxTexture& texture)
+{
+    if(size < KTX2_HEADER_SIZE || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    {
+        return false;
+    }
+
+    texture.format = ( uint32_t) ReadKtxField(data + 12, 4);
+    uint64_t width = ReadKtxField(data + 20, 4);
+    uint64_t height = ReadKtxField(data + 24, 4);
+    uint64_t depth = ReadKtxField(data + 28, 4);
+    uint64_t layers = ReadKtxField(data + 32, 4);
+    uint64_t faces = ReadKtxField(data + 36, 4);
+    uint64_t levelCount = ReadKtxField(data + 40, 4);
+    texture.supercompression = ( uint32_t) ReadKtxField(data + 44, 4);
+    if(!KtxBlockFormat(texture.format, texture.blockFormat, texture.srgb) || width == 0 || height == 0 || width > 65536
+       || height > 65536 || depth != 0 || layers != 0 || faces != 1
+       || (texture.supercompression != KTX_SUPERCOMPRESSION_NONE && texture.supercompression != KTX_SUPERCOMPRESSION_BLOCK_STREAMS))
+    {
+        return false;
+    }
+
+    // A level count of 0 asks for the mip chain to be generated, which block compressed data can't be.
+    levelCount = std::max<uint64_t>(levelCount, 1);
+    if(levelCount > 17 || size < KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_SIZE)
+    {
+        return false;
+    }
+
+    texture.width = ( int) width;
+    texture.height = ( int) height;
+    texture.levels.clear();
+    for(uint64_t level = 0; level < levelCount; level++)
+    {
+        const unsigned char* entry = data + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_SIZE;
+        KtxLevel parsed;
+        parsed.width = std::max(texture.width >> level, 1);
+        parsed.height = std::max(texture.height >> level, 1);
+        uint64_t offset = ReadKtxField(entry, 8);
+        uint64_t length = ReadKtxField(entry + 8, 8);
+        uint64_t uncompressedLength = ReadKtxField(entry + 16, 8);
+        if(uncompressedLength != CompressedImageSize(texture.blockFormat, parsed.width, parsed.height)
+           || (texture.supercompression == KTX_SUPERCOMPRESSION_NONE && length != uncompressedLength) || offset > size || length > size - offset)
+        {
+            return false;
+        }
+        parsed.offset = ( size_t) offset;
+        parsed.size = ( size_t) length;
+        texture.levels.push_back(parsed);
+    }
+    return true;
+}
+
+///
+/// Decompresses the levels of a supercompressed KTX2 file, the largest level across the worker threads and the
+/// rest alongside each other.
+/// \param data - the file.
+/// \param texture - the parsed file, changed to describe the decompressed levels.
+/// \param levels - receives the decompressed levels, which the texture's levels then point into.
+/// \return - false if a level is damaged.
+///
+inline bool DecompressKtx2Levels(const unsigned char* data, KtxTexture& texture, std::vector<unsigned char>& levels)
+{
+    std::vector<size_t> offsets(texture.levels.size());
+    size_t total = 0;
+    for(size_t level = 0; level < texture.levels.size(); level++)
+    {
+        offsets[level] = total;
+        total += CompressedImageSize(texture.blockFormat, texture.levels[level].width, texture.levels[level].height);
+    }
+    levels.resize(total);
+
+    std::atomic<bool> decoded(true);
+    auto decodeLevel = [&](size_t level)
+    {
+        std::vector<unsigned char> scratch;
+        const KtxLevel& stored = texture.levels[level];
+        if(!DecodeBlockImage(data + stored.offset, stored.size, stored.width, stored.height, texture.blockFormat, levels.data() + offsets[level],
+                             scratch))
+        {
+            decoded = false;
+        }
+    };
+    decodeLevel(0);
+    ParallelFor(texture.levels.size() - 1, [&](size_t level) { decodeLevel(level + 1); });
+    if(!decoded)
+    {
+        return false;
+    }
+
+    for(size_t level = 0; level < texture.levels.size(); level++)
+    {
+        texture.levels[level].offset = offsets[level];
+        texture.levels[level].size = CompressedImageSize(texture.blockFormat, texture.levels[level].width, texture.levels[level].height);
+    }
+    texture.supercompression = KTX_SUPERCOMPRESSION_NONE;
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,410 @@
+#ifndef MATERIALPACKING_H
+#define MATERIALPACKING_H
+
+#include <AtomicFile/atomicfile.h>
+#include <Json/json.h>
+#include <ModelCache/modelcache.h>
+#include <Threading/parallel.h>
+#include <VirtualFileSystem/virtualfilesystem.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Channel packing of material maps. A material layout declares maps that each take the place of one of a
+// material's maps and fill their four channels from channels of its others, such as specular intensity in the
+// diffuse map's alpha, or height in the blue of a normal map whose Z the shader rebuilds from X and Y. A packed map
+// keeps the type of the map it replaces, so meshes bind it under the same sampler name, and shaders written for the
+// layout sample one texture where they sampled several.
+//
+// The MaterialPacker tool writes each material's packed maps next to its textures as KTX2 files, and a packing file
+// next to the model listing the references each one replaces. LoadModelData applies it to the meshes' material
+// references, so nothing else needs to know the maps were packed.
+
+// The packing file the MaterialPacker tool writes for a model: the model's path with this added.
+const char* const MATERIAL_PACKING_EXTENSION = ".packing";
+
+// Maps a layout reads from and replaces, by their type without the "texture_".
+const int MATERIAL_MAP_COUNT = 4;
+const char* const MATERIAL_MAP_NAMES[MATERIAL_MAP_COUNT] = { "diffuse", "specular", "normal", "height" };
+
+// Channel selectors after a map's name: the four channels, then the Rec. 709 luminance of red, green and blue.
+const char* const MATERIAL_CHANNEL_NAMES[] = { "r", "g", "b", "a", "luminance" };
+const int MATERIAL_CHANNEL_LUMINANCE = 4;
+
+// Where one channel of a packed map comes from.
+struct MaterialChannelSource
+{
+    int map = -1;               // Index into MATERIAL_MAP_NAMES, or -1 for a constant.
+    int channel = 0;            // Index into MATERIAL_CHANNEL_NAMES.
+    unsigned char constant = 0; // The value, when there's no map.
+};
+
+// A map a layout packs, declared as { "base": "diffuse", "suffix": "_packed", "channels": [ "diffuse.r", ... ] }.
+// Channels are a map's name and channel, or "0" or "1".
+struct PackedMapLayout
+{
+    int base = 0;               // The map this one replaces, whose type it's bound under.
+    std::string suffix;         // Added to the base map's file name, before the .ktx2 extension, for the packed map's.
+    MaterialChannelSource channels[4];
+};
+
+// A layout, declared as { "name": "...", "maps": [ ... ] }. Each map may be read by one packed map only, and the
+// base of one can't be read by another, so every map a material has ends up in one place.
+struct MaterialLayout
+{
+    std::string name;           // Recorded in the packing file, for picking shaders that read the layout.
+    std::vector<PackedMapLayout> maps;
+};
+
+// One packed map of a model: the reference it's loaded through, and the references it takes the place of.
+struct PackedMaterialMap
+{
+    CookedTextureReference packed;
+    std::vector<CookedTextureReference> replaces;
+};
+
+// What the packing file of a model holds.
+struct MaterialPacking
+{
+    std::string layout;
+    std::vector<PackedMaterialMap> maps;
+};
+
+///
+/// The texture type a map is bound under.
+///
+inline std::string MaterialMapType(int map)
+{
+    return std::string("texture_") + MATERIAL_MAP_NAMES[map];
+}
+
+///
+/// Returns the index of a map's name in MATERIAL_MAP_NAMES, or -1 if it isn't one.
+///
+inline int FindMaterialMap(const std::string& name)
+{
+    for(int i = 0; i < MATERIAL_MAP_COUNT; i++)
+    {
+        if(name == MATERIAL_MAP_NAMES[i])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+///
+/// Parses one channel of a packed map: "diffuse.r", "specular.luminance", "0" or "1".
+/// \return - false if it's none of those.
+///
+inline bool ParseMaterialChannel(const std::string& text, MaterialChannelSource& source)
+{
+    source = MaterialChannelSource();
+    if(text == "0" || text == "1")
+    {
+        source.constant = text == "0" ? 0 : 255;
+        return true;
+    }
+    size_t dot = text.find('.');
+    if(dot == std::string::npos || (source.map = FindMaterialMap(text.substr(0, dot))) < 0)
+    {
+        return false;
+    }
+    for(int channel = 0; channel <= MATERIAL_CHANNEL_LUMINANCE; channel++)
+    {
+        if(text.compare(dot + 1, std::string::npos, MATERIAL_CHANNEL_NAMES[channel]) == 0)
+        {
+            source.channel = channel;
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Parses a material layout and checks every map it reads ends up in one place.
+/// \param text, size - the layout's JSON.
+/// \param layout - receives the layout.
+/// \param error - receives what's wrong with it, if anything.
+/// \return - false if it isn't a valid layout.
+///
+inline bool ParseMaterialLayout(const char* text, size_t size, MaterialLayout& layout, std::string& error)
+{
+    layout = MaterialLayout();
+    JsonValue root;
+    if(!ParseJson(text, text + size, root) || root.type != JSON_OBJECT)
+    {
+        error = "isn't a JSON object";
+        return false;
+    }
+    layout.name = root.String("name");
+    const JsonValue* maps = root.Find("maps");
+    if(layout.name.empty() || maps == NULL || maps->type != JSON_ARRAY || maps->Size() == 0)
+    {
+        error = "needs a name and at least one map";
+        return false;
+    }
+
+    // Which packed map reads each map, and which each replaces.
+    int readBy[MATERIAL_MAP_COUNT] = { -1, -1, -1, -1 };
+    int replacedBy[MATERIAL_MAP_COUNT] = { -1, -1, -1, -1 };
+    for(size_t i = 0; i < maps->Size(); i++)
+    {
+        const JsonValue& declared = (*maps)[i];
+        const JsonValue* channels = declared.Find("channels");
+        PackedMapLayout map;
+        map.base = FindMaterialMap(declared.String("base"));
+        map.suffix = declared.String("suffix");
+        if(map.base < 0 || map.suffix.empty() || channels == NULL || channels->type != JSON_ARRAY || channels->Size() != 4)
+        {
+            error = "map " + std::to_string(i) + " needs a base map, a suffix and four channels";
+            return false;
+        }
+        if(replacedBy[map.base] >= 0 || (readBy[map.base] >= 0 && readBy[map.base] != ( int) i))
+        {
+            error = std::string("the ") + MATERIAL_MAP_NAMES[map.base] + " map is packed into more than one map";
+            return false;
+        }
+        replacedBy[map.base] = ( int) i;
+        readBy[map.base] = ( int) i;
+        for(int c = 0; c < 4; c++)
+        {
+            const JsonValue& channel = (*channels)[c];
+            if(channel.type != JSON_STRING || !ParseMaterialChannel(channel.string, map.channels[c]))
+            {
+                error = "map " + std::to_string(i) + " has an unknown channel " + (channel.type == JSON_STRING ? channel.string : "");
+                return false;
+            }
+            int source = map.channels[c].map;
+            if(source >= 0 && ((readBy[source] >= 0 && readBy[source] != ( int) i) || (replacedBy[source] >= 0 && replacedBy[source] != ( int) i)))
+            {
+                error = std::string("the ") + MATERIAL_MAP_NAMES[source] + " map is packed into more than one map";
+                return false;
+            }
+            if(source >= 0)
+            {
+                readBy[source] = ( int) i;
+            }
+        }
+        layout.maps.push_back(map);
+    }
+    return true;
+}
+
+///
+/// Reads a material layout file.
+/// \return - false if there's no such file or it isn't a valid layout, which is reported.
+///
+inline bool ReadMaterialLayout(const std::string& path, MaterialLayout& layout)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cout << "ERROR::MATERIAL_LAYOUT:: can't open " << path << std::endl;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string error;
+    if(!ParseMaterialLayout(text.data(), text.size(), layout, error))
+    {
+        std::cout << "ERROR::MATERIAL_LAYOUT:: " << path << " " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+///
+/// Fills a packed map's pixels from a material's maps, a row per work item across the worker threads.
+/// \param layout - the packed map.
+/// \param maps - each map's pixels, four components each and all the same size, or NULL where the material doesn't
+///               have that map, whose channels read as 0.
+/// \param width, height - size of the maps.
+/// \param packed - receives width * height pixels of four components.
+///
+inline void PackMaterialMaps(const PackedMapLayout& layout, const unsigned char* const maps[MATERIAL_MAP_COUNT], int width, int height,
+                             unsigned char* packed)
+{
+    ParallelFor(( size_t) height, [&](size_t row)
+    {
+        size_t first = row * width;
+        for(int c = 0; c < 4; c++)
+        {
+            const MaterialChannelSource& source = layout.channels[c];
+            const unsigned char* map = source.map >= 0 ? maps[source.map] : NULL;
+            for(size_t i = first; i < first + width; i++)
+            {
+                unsigned char value = source.constant;
+                if(map != NULL && source.channel == MATERIAL_CHANNEL_LUMINANCE)
+                {
+                    const unsigned char* pixel = map + i * 4;
+                    value = ( unsigned char) ((54 * pixel[0] + 183 * pixel[1] + 19 * pixel[2] + 128) >> 8);
+                }
+                else if(map != NULL)
+                {
+                    value = map[i * 4 + source.channel];
+                }
+                packed[i * 4 + c] = value;
+            }
+        }
+    });
+}
+
+///
+/// Appends a texture reference to a packing file being written.
+///
+inline void AppendPackedReference(std::string& text, const CookedTextureReference& reference)
+{
+    text += "{ \"type\": ";
+    AppendJsonString(text, reference.type);
+    text += ", \"path\": ";
+    AppendJsonString(text, reference.path);
+    text += " }";
+}
+
+///
+/// Writes a model's packing file, see WriteFileAtomically.
+/// \return - false if it couldn't be written.
+///
+inline bool WriteMaterialPacking(const std::string& path, const MaterialPacking& packing)
+{
+    std::string text = "{\n    \"layout\": ";
+    AppendJsonString(text, packing.layout);
+    text += ",\n    \"maps\": [";
+    for(size_t i = 0; i < packing.maps.size(); i++)
+    {
+        text += i == 0 ? "\n        { \"packed\": " : ",\n        { \"packed\": ";
+        AppendPackedReference(text, packing.maps[i].packed);
+        text += ", \"replaces\": [ ";
+        for(size_t r = 0; r < packing.maps[i].replaces.size(); r++)
+        {
+            text += r == 0 ? "" : ", ";
+            AppendPackedReference(text, packing.maps[i].replaces[r]);
+        }
+        text += " ] }";
+    }
+    text += "\n    ]\n}\n";
+
+    return WriteFileAtomically(path, { { text.data(), text.size() } });
+}
+
+///
+/// Reads a texture reference from a packing file.
+///
+inline bool ParsePackedReference(const JsonValue& value, CookedTextureReference& reference)
+{
+    reference.type = value.String("type");
+    reference.path = value.String("path");
+    return !reference.type.empty() && !reference.path.empty();
+}
+
+///
+/// Reads a model's packing file, from a mounted asset pack or the file.
+/// \param path - the packing file, see MATERIAL_PACKING_EXTENSION.
+/// \param packing - receives what it holds.
+/// \return - false if there's no such file or it's damaged, which is reported.
+///
+inline bool ReadMaterialPacking(const std::string& path, MaterialPacking& packing)
+{
+    packing = MaterialPacking();
+    std::vector<unsigned char> file;
+    if(!ReadAsset(path, file))
+    {
+        return false;
+    }
+    JsonValue root;
+    const JsonValue* maps = NULL;
+    if(!ParseJson(( const char*) file.data(), ( const char*) file.data() + file.size(), root) || root.type != JSON_OBJECT
+       || (maps = root.Find("maps")) == NULL || maps->type != JSON_ARRAY)
+    {
+        std::cout << "ERROR::MATERIAL_PACKING:: " << path << " is damaged" << std::endl;
+        return false;
+    }
+    packing.layout = root.String("layout");
+    for(size_t i = 0; i < maps->Size(); i++)
+    {
+        PackedMaterialMap map;
+        const JsonValue* packed = (*maps)[i].Find("packed");
+        const JsonValue* replaces = (*maps)[i].Find("replaces");
+        bool valid = packed != NULL && ParsePackedReference(*packed, map.packed) && replaces != NULL && replaces->type == JSON_ARRAY
+                     && replaces->Size() > 0;
+        for(size_t r = 0; valid && r < replaces->Size(); r++)
+        {
+            map.replaces.push_back(CookedTextureReference());
+            valid = ParsePackedReference((*replaces)[r], map.replaces.back());
+        }
+        if(!valid)
+        {
+            std::cout << "ERROR::MATERIAL_PACKING:: " << path << " map " << i << " is damaged" << std::endl;
+            packing = MaterialPacking();
+            return false;
+        }
+        packing.maps.push_back(map);
+    }
+    return true;
+}
+
+///
+/// Swaps a mesh's material references for the packed maps that replace them. A packed map is used only where the
+/// mesh has every reference it replaces, and takes the place of the first of them.
+/// \param packing - the model's packing file.
+/// \param textures - the mesh's references.
+/// \return - the number of packed maps the mesh now uses.
+///
+inline size_t ApplyMaterialPacking(const MaterialPacking& packing, std::vector<CookedTextureReference>& textures)
+{
+    auto isReplaced = [](const PackedMaterialMap& map, const CookedTextureReference& texture)
+    {
+        for(const CookedTextureReference& replaced : map.replaces)
+        {
+            if(replaced.type == texture.type && replaced.path == texture.path)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t applied = 0;
+    for(const PackedMaterialMap& map : packing.maps)
+    {
+        size_t found = 0;
+        for(const CookedTextureReference& replaced : map.replaces)
+        {
+            for(const CookedTextureReference& texture : textures)
+            {
+                if(replaced.type == texture.type && replaced.path == texture.path)
+                {
+                    found++;
+                    break;
+                }
+            }
+        }
+        if(found != map.replaces.size())
+        {
+            continue;
+        }
+
+        std::vector<CookedTextureReference> packed;
+        bool placed = false;
+        for(const CookedTextureReference& texture : textures)
+        {
+            if(!isReplaced(map, texture))
+            {
+                packed.push_back(texture);
+            }
+            else if(!placed)
+            {
+                packed.push_back(map.packed);
+                placed = true;
+            }
+        }
+        textures.swap(packed);
+        applied++;
+    }
+    return applied;
+}
+
+#endif
\ No newline at end of file
@@ -6,31 +6,38 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <Meshlet/meshlet.h>
+#include <ModelData/modeldata.h>
+#include <ResourceRegistry/resourceregistry.h>
 #include <Shader/shader.h>
+#include <Simplifier/simplifier.h>
+#include <TextureArray/texturearray.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 using namespace std;
 
-// Stores per vertex data.
-struct Vertex
-{
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
-};
-
 // Stores per texture data.
 struct Texture
 {
     unsigned int id;
     string type;
     string path;
+    std::shared_ptr<GpuTexture> resource;   // Keeps the texture alive while it's used, empty for textures owned elsewhere.
+};
+
+// Layout of a single command in a GL_DRAW_INDIRECT_BUFFER for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
 };
 
 ///
@@ -43,16 +50,119 @@ class Mesh
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    vector<Meshlet> meshlets;
+    vector<MeshLod> lods;
     unsigned int VAO;
+    std::shared_ptr<GpuMeshBuffers> buffers;    // Shared by every copy of the mesh, freed with the last one.
+    GLenum indexType = GL_UNSIGNED_INT;         // Type of the index buffer's elements, 0 for a mesh drawn without one.
+    size_t indexByteOffset = 0;                 // Where the mesh's indices start in the index buffer.
+    MaterialLayers material;                    // The textures' layers once batched, see BatchModelTextures.
 
     // Functions.
-    Mesh(vector<Vertex> verts, vector<unsigned int> idxs, vector<Texture> txts)
+    Mesh(vector<Vertex> verts, vector<unsigned int> idxs, vector<Texture> txts,
+         vector<Meshlet> mshlts = vector<Meshlet>(), vector<MeshLod> ls = vector<MeshLod>())
     {
         vertices = verts;
         indices = idxs;
         textures = txts;
+        meshlets = mshlts;
+        lods = ls;
+
+        // Without a LOD chain the whole index buffer is LOD 0.
+        if(lods.empty())
+        {
+            lods.push_back({ 0, ( unsigned int) indices.size(), 0.0f });
+        }
+
+        SetupMesh(&vertices[0], vertices.size(), &indices[0], indices.size());
+    }
+
+    ///
+    /// Uploads vertex and index data straight from memory the mesh doesn't own, e.g. a mapped cache file,
+    /// without keeping a CPU copy of it.
+    ///
+    Mesh(const Vertex* verts, size_t vertexCount, const unsigned int* idxs, size_t indexCount, vector<Texture> txts,
+         vector<Meshlet> mshlts = vector<Meshlet>(), vector<MeshLod> ls = vector<MeshLod>())
+    {
+        textures = txts;
+        meshlets = mshlts;
+        lods = ls;
+
+        if(lods.empty())
+        {
+            lods.push_back({ 0, ( unsigned int) indexCount, 0.0f });
+        }
+
+        SetupMesh(verts, vertexCount, idxs, indexCount);
+    }
+
+    ///
+    /// Uses buffers that have already been uploaded, e.g. by another model loaded from the same file.
+    /// \param indexCount - number of indices the buffers hold for the mesh, its LOD 0 when no LOD chain is given.
+    ///
+    Mesh(std::shared_ptr<GpuMeshBuffers> shared, size_t indexCount, vector<Texture> txts, vector<Meshlet> mshlts = vector<Meshlet>(),
+         vector<MeshLod> ls = vector<MeshLod>())
+    {
+        textures = txts;
+        meshlets = mshlts;
+        lods = ls;
+
+        if(lods.empty())
+        {
+            lods.push_back({ 0, ( unsigned int) indexCount, 0.0f });
+        }
+
+        buffers = shared;
+        VAO = buffers->VAO;
+    }
+
+    ///
+    /// Uploads a mesh's vertex and index data into new buffers, with room for indirect draws of its meshlets.
+    /// \param meshletCount - number of meshlets the mesh will draw clusters of.
+    /// \return - the buffers, freed once the last mesh using them is gone.
+    ///
+    static std::shared_ptr<GpuMeshBuffers> UploadBuffers(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData,
+                                                         size_t indexCount, size_t meshletCount)
+    {
+        std::shared_ptr<GpuMeshBuffers> uploaded = std::make_shared<GpuMeshBuffers>();
+        glGenVertexArrays(1, &uploaded->VAO);
+        glGenBuffers(1, &uploaded->VBO);
+        glGenBuffers(1, &uploaded->EBO);
+
+        glBindVertexArray(uploaded->VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, uploaded->VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, uploaded->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
-        SetupMesh();
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) 0);
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, TexCoords));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Tangent));
+
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Bitangent));
+
+        glBindVertexArray(0);
+
+        // Room for one indirect command per meshlet, refilled with the visible ones each frame.
+        if(meshletCount > 0 && GLAD_GL_VERSION_4_3)
+        {
+            glGenBuffers(1, &uploaded->indirectBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, uploaded->indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, meshletCount * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        return uploaded;
     }
 
     ///
@@ -60,6 +170,125 @@ class Mesh
     /// \param shader - The shader to send texture data to and draw with.
     ///
     void Draw(Shader shader)
+    {
+        DrawLod(shader, 0);
+    }
+
+    ///
+    /// Grab texture data and draw one level of detail of the mesh.
+    /// \param shader - The shader to send texture data to and draw with.
+    /// \param lod - The level to draw, clamped to the coarsest level this mesh has.
+    /// \return - The number of triangles submitted.
+    ///
+    unsigned int DrawLod(Shader shader, unsigned int lod)
+    {
+        const MeshLod& level = lods[std::min(lod, ( unsigned int) lods.size() - 1)];
+        bindMaterial(shader);
+
+        // Draw mesh.
+        glBindVertexArray(VAO);
+        if(indexType == 0)
+        {
+            glDrawArrays(GL_TRIANGLES, level.indexOffset, level.indexCount);
+        }
+        else
+        {
+            size_t indexSize = indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+            glDrawElements(GL_TRIANGLES, level.indexCount, indexType, ( void*) (indexByteOffset + level.indexOffset * indexSize));
+        }
+        glBindVertexArray(0);
+
+        // Good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+        return level.indexCount / 3;
+    }
+
+    ///
+    /// Draws only the meshlets that are inside the frustum and not facing away from the camera.
+    /// Falls back to drawing the whole mesh if it has no meshlets.
+    /// \param shader - The shader to send texture data to and draw with.
+    /// \param cullingView - Frustum and camera position in this mesh's model space.
+    /// \return - The number of triangles submitted.
+    ///
+    unsigned int DrawClusters(Shader shader, const ClusterCullingView& cullingView)
+    {
+        if(meshlets.empty())
+        {
+            return DrawLod(shader, 0);
+        }
+
+        // Gather the visible clusters.
+        drawCommands.clear();
+        unsigned int triangles = 0;
+        for(unsigned int i = 0; i < meshlets.size(); i++)
+        {
+            if(IsMeshletVisible(meshlets[i], cullingView))
+            {
+                drawCommands.push_back({ meshlets[i].indexCount, 1, meshlets[i].indexOffset, 0, 0 });
+                triangles += meshlets[i].indexCount / 3;
+            }
+        }
+        if(drawCommands.empty())
+        {
+            return 0;
+        }
+
+        bindMaterial(shader);
+        glBindVertexArray(VAO);
+
+        if(buffers->indirectBuffer != 0)
+        {
+            // Whole set of visible clusters in a single indirect call.
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers->indirectBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawCommands.size() * sizeof(DrawElementsIndirectCommand), &drawCommands[0]);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, ( GLsizei) drawCommands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        else
+        {
+            // Contexts older than 4.3 take the same ranges through glMultiDrawElements.
+            drawCounts.resize(drawCommands.size());
+            drawOffsets.resize(drawCommands.size());
+            for(unsigned int i = 0; i < drawCommands.size(); i++)
+            {
+                drawCounts[i] = ( GLsizei) drawCommands[i].count;
+                drawOffsets[i] = ( const void*) (drawCommands[i].firstIndex * sizeof(unsigned int));
+            }
+            glMultiDrawElements(GL_TRIANGLES, &drawCounts[0], GL_UNSIGNED_INT, &drawOffsets[0], ( GLsizei) drawCommands.size());
+        }
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        return triangles;
+    }
+
+  private:
+
+    // Per frame scratch space for cluster draws, kept to avoid reallocating every frame.
+    vector<DrawElementsIndirectCommand> drawCommands;
+    vector<GLsizei> drawCounts;
+    vector<const void*> drawOffsets;
+
+    // Functions.
+
+    ///
+    /// Makes the mesh's textures current: its array layers once it's batched, otherwise its own textures.
+    ///
+    void bindMaterial(Shader shader)
+    {
+        if(material.batched)
+        {
+            BindMaterialLayers(material);
+            return;
+        }
+        BindTextures(shader);
+    }
+
+    ///
+    /// Binds each texture to its own unit and points the matching sampler uniform at it.
+    /// \param shader - The shader to send texture data to.
+    ///
+    void BindTextures(Shader shader)
     {
         // Bind appropriate textures.
         unsigned int diffuseNr = 1;
@@ -92,55 +321,15 @@ class Mesh
             glUniform1i(glGetUniformLocation(shader.ProgramID(), (name + number).c_str()), i);
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-
-        // Draw mesh.
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // Good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-  private:
-
-    unsigned int VBO, EBO;
-
-    // Functions.
-
     ///
     /// Creates buffer and stores vertex data in buffer.
     ///
-    void SetupMesh()
+    void SetupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount)
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) 0);
-
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Normal));
-
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, TexCoords));
-
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Tangent));
-
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), ( void*) offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        buffers = UploadBuffers(vertexData, vertexCount, indexData, indexCount, meshlets.size());
+        VAO = buffers->VAO;
     }
 };
 
@@ -0,0 +1,453 @@
+#ifndef MESHCODEC_H
+#define MESHCODEC_H
+
+#include <Compression/rans.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// SSE2 is part of every x64 target, so the vectorised decoder needs no runtime dispatch there.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_CODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Compact encoding of vertex and index buffers for storage, built from filters that turn the buffers into a few
+// highly repetitive byte streams and an entropy stage that squeezes those.
+//
+// Vertices are treated as rows of 32 bit words. Each word is replaced by its difference from the same word of the
+// previous vertex, zigzagged so small negative differences become small numbers too. Vertices in vertex fetch order
+// have neighbours with similar attributes, so most differences are small and their upper bytes zero. The bytes are
+// then split into one stream per byte of the vertex, grouping the bytes that behave alike, and each stream is
+// entropy coded on its own.
+//
+// Indices are replaced by their difference from the previous index, zigzagged and written as variable length
+// integers. Cache optimised index buffers refer to nearby vertices, so most indices take a single byte.
+//
+// Each stream is stored as a mode byte, its size as a variable length integer, the stored size too when it's
+// entropy coded, then its bytes. Streams the entropy stage wouldn't shrink by enough are kept as they are, since the
+// entropy stage is most of the decoding time even with rANS decoding eight states at once on AVX2 CPUs.
+
+const unsigned char MESH_CODEC_STREAM_RAW = 0;
+const unsigned char MESH_CODEC_STREAM_RANS = 1;
+
+// Streams shorter than this are stored raw, as the frequency table would outweigh what coding saves.
+const size_t MESH_CODEC_MIN_ENTROPY_BYTES = 256;
+// Entropy coded streams must come out at most this many eighths of their size. Decoding one costs about as long as
+// reading its bytes from a fast drive, so a stream that barely shrinks is quicker to load stored raw.
+const size_t MESH_CODEC_MAX_ENTROPY_EIGHTHS = 6;
+
+// Vertices up to this many sixteen byte groups wide are decoded with SIMD, wider ones by the scalar path.
+const size_t MESH_CODEC_MAX_SIMD_GROUPS = 16;
+
+///
+/// Appends an unsigned integer seven bits a byte, low bits first.
+///
+inline void WriteCodecVarint(std::vector<unsigned char>& out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back(( unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(( unsigned char) value);
+}
+
+///
+/// Reads an unsigned integer written by WriteCodecVarint.
+/// \return - false if it runs past the end or doesn't fit 64 bits.
+///
+inline bool ReadCodecVarint(const unsigned char*& in, const unsigned char* end, uint64_t& value)
+{
+    value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if(in == end)
+        {
+            return false;
+        }
+        unsigned char byte = *in++;
+        value |= ( uint64_t) (byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Appends a stream, entropy coded if that makes it enough smaller, see MESH_CODEC_MAX_ENTROPY_EIGHTHS.
+///
+inline void WriteCodecStream(std::vector<unsigned char>& out, const unsigned char* bytes, size_t size)
+{
+    if(size >= MESH_CODEC_MIN_ENTROPY_BYTES)
+    {
+        std::vector<unsigned char> coded(RansCompressBound(size));
+        size_t codedSize = RansCompress(bytes, size, coded.data(), coded.size());
+        if(codedSize > 0 && codedSize * 8 <= size * MESH_CODEC_MAX_ENTROPY_EIGHTHS)
+        {
+            out.push_back(MESH_CODEC_STREAM_RANS);
+            WriteCodecVarint(out, size);
+            WriteCodecVarint(out, codedSize);
+            out.insert(out.end(), coded.begin(), coded.begin() + codedSize);
+            return;
+        }
+    }
+    out.push_back(MESH_CODEC_STREAM_RAW);
+    WriteCodecVarint(out, size);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+///
+/// Reads a stream of a known size. Raw streams are used where they are; coded ones are decoded into the scratch
+/// space.
+/// \param in - the stream, moved past it.
+/// \param end - end of the encoded data.
+/// \param size - the size the stream must decode to.
+/// \param scratch - receives coded streams, at least size bytes.
+/// \param bytes - receives where the stream's bytes are.
+/// \return - false if the stream is damaged or not of the given size.
+///
+inline bool ReadCodecStream(const unsigned char*& in, const unsigned char* end, size_t size, unsigned char* scratch,
+                            const unsigned char*& bytes)
+{
+    if(in == end)
+    {
+        return false;
+    }
+    unsigned char mode = *in++;
+    uint64_t streamSize;
+    if(!ReadCodecVarint(in, end, streamSize) || streamSize != size)
+    {
+        return false;
+    }
+
+    if(mode == MESH_CODEC_STREAM_RAW)
+    {
+        if(( uint64_t) (end - in) < size)
+        {
+            return false;
+        }
+        bytes = in;
+        in += size;
+        return true;
+    }
+
+    uint64_t codedSize;
+    if(mode != MESH_CODEC_STREAM_RANS || !ReadCodecVarint(in, end, codedSize) || ( uint64_t) (end - in) < codedSize
+       || !RansDecompress(in, ( size_t) codedSize, scratch, size))
+    {
+        return false;
+    }
+    bytes = scratch;
+    in += codedSize;
+    return true;
+}
+
+///
+/// Moves past a stream without decoding it, so the streams that follow can be found and decoded alongside it.
+/// \return - false if the stream runs past the end.
+///
+inline bool SkipCodecStream(const unsigned char*& in, const unsigned char* end)
+{
+    if(in == end)
+    {
+        return false;
+    }
+    unsigned char mode = *in++;
+    uint64_t size;
+    if(!ReadCodecVarint(in, end, size) || (mode == MESH_CODEC_STREAM_RANS && !ReadCodecVarint(in, end, size)) || ( uint64_t) (end - in) < size)
+    {
+        return false;
+    }
+    in += size;
+    return true;
+}
+
+inline uint32_t ZigzagEncode(uint32_t value)
+{
+    return (value << 1) ^ ( uint32_t) (( int32_t) value >> 31);
+}
+
+inline uint32_t ZigzagDecode(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+///
+/// Encodes a vertex buffer.
+/// \param vertices - the vertices.
+/// \param vertexCount - number of vertices.
+/// \param vertexStride - size of one vertex, a multiple of four.
+/// \param out - receives the encoded vertices.
+/// \return - false if the stride isn't a multiple of four.
+///
+inline bool EncodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexStride, std::vector<unsigned char>& out)
+{
+    out.clear();
+    if(vertexStride == 0 || vertexStride % 4 != 0)
+    {
+        return false;
+    }
+
+    // Filter into byte streams, stream k holding byte k of every vertex.
+    const unsigned char* source = static_cast<const unsigned char*>(vertices);
+    std::vector<unsigned char> streams(vertexCount * vertexStride);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        for(size_t w = 0; w < vertexStride; w += 4)
+        {
+            uint32_t word, previous = 0;
+            std::memcpy(&word, source + v * vertexStride + w, 4);
+            if(v > 0)
+            {
+                std::memcpy(&previous, source + (v - 1) * vertexStride + w, 4);
+            }
+            uint32_t delta = ZigzagEncode(word - previous);
+            for(size_t b = 0; b < 4; b++)
+            {
+                streams[(w + b) * vertexCount + v] = ( unsigned char) (delta >> (8 * b));
+            }
+        }
+    }
+
+    for(size_t k = 0; k < vertexStride; k++)
+    {
+        WriteCodecStream(out, streams.data() + k * vertexCount, vertexCount);
+    }
+    return true;
+}
+
+///
+/// Undoes the filters for vertices [begin, end) one word at a time. Reads the vertex before begin, which must have
+/// been decoded already.
+///
+inline void UnfilterVerticesScalar(const unsigned char* const* streams, size_t begin, size_t end, size_t vertexStride, unsigned char* destination)
+{
+    for(size_t v = begin; v < end; v++)
+    {
+        for(size_t w = 0; w < vertexStride; w += 4)
+        {
+            uint32_t delta = ( uint32_t) streams[w][v] | ( uint32_t) streams[w + 1][v] << 8 | ( uint32_t) streams[w + 2][v] << 16
+                             | ( uint32_t) streams[w + 3][v] << 24;
+            uint32_t previous = 0;
+            if(v > 0)
+            {
+                std::memcpy(&previous, destination + (v - 1) * vertexStride + w, 4);
+            }
+            uint32_t word = previous + ZigzagDecode(delta);
+            std::memcpy(destination + v * vertexStride + w, &word, 4);
+        }
+    }
+}
+
+#ifdef MESH_CODEC_SSE2
+///
+/// Undoes the filters sixteen vertices and sixteen bytes of the vertex at a time. A 16x16 byte transpose turns
+/// sixteen streams back into sixteen vertex rows, which are unzigzagged and summed onto the previous row four words
+/// at once. A stride that isn't a multiple of sixteen is covered by a last group that overlaps the one before it,
+/// which writes the shared words twice with the same values. Vertices past the last whole block of sixteen are left
+/// to the scalar path.
+/// \param streams - the byte streams, one per byte of the vertex.
+/// \param blockEnd - number of vertices to decode, a multiple of sixteen.
+/// \param vertexStride - size of one vertex, from 16 to 16 * MESH_CODEC_MAX_SIMD_GROUPS bytes.
+/// \param destination - receives the vertices.
+///
+inline void UnfilterVerticesSse2(const unsigned char* const* streams, size_t blockEnd, size_t vertexStride, unsigned char* destination)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const size_t groupCount = (vertexStride + 15) / 16;
+    __m128i previous[MESH_CODEC_MAX_SIMD_GROUPS];
+    for(size_t g = 0; g < groupCount; g++)
+    {
+        previous[g] = _mm_setzero_si128();
+    }
+
+    // Whole vertices are finished a block at a time, so each output row is written while it's in cache.
+    for(size_t v = 0; v < blockEnd; v += 16)
+    {
+        for(size_t g = 0; g < groupCount; g++)
+        {
+            const size_t k = std::min(g * 16, vertexStride - 16);
+
+            // r[i]: byte k + i of vertices v to v + 15.
+            __m128i r[16];
+            for(int i = 0; i < 16; i++)
+            {
+                r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(streams[k + i] + v));
+            }
+
+            // t[8h + i]: vertices 8h to 8h + 7, bytes 2i and 2i + 1.
+            __m128i t[16];
+            for(int i = 0; i < 8; i++)
+            {
+                t[i] = _mm_unpacklo_epi8(r[2 * i], r[2 * i + 1]);
+                t[i + 8] = _mm_unpackhi_epi8(r[2 * i], r[2 * i + 1]);
+            }
+
+            // u[4m + q]: vertices 4m to 4m + 3, bytes 4q to 4q + 3.
+            __m128i u[16];
+            for(int h = 0; h < 2; h++)
+            {
+                for(int q = 0; q < 4; q++)
+                {
+                    u[8 * h + q] = _mm_unpacklo_epi16(t[8 * h + 2 * q], t[8 * h + 2 * q + 1]);
+                    u[8 * h + 4 + q] = _mm_unpackhi_epi16(t[8 * h + 2 * q], t[8 * h + 2 * q + 1]);
+                }
+            }
+
+            // w[4m + 2p]: vertices 4m and 4m + 1, bytes 8p to 8p + 7. w[4m + 2p + 1]: the same for 4m + 2 and 4m + 3.
+            __m128i w[16];
+            for(int m = 0; m < 4; m++)
+            {
+                for(int p = 0; p < 2; p++)
+                {
+                    w[4 * m + 2 * p] = _mm_unpacklo_epi32(u[4 * m + 2 * p], u[4 * m + 2 * p + 1]);
+                    w[4 * m + 2 * p + 1] = _mm_unpackhi_epi32(u[4 * m + 2 * p], u[4 * m + 2 * p + 1]);
+                }
+            }
+
+            __m128i sum = previous[g];
+            for(int m = 0; m < 4; m++)
+            {
+                __m128i rows[4] = { _mm_unpacklo_epi64(w[4 * m], w[4 * m + 2]), _mm_unpackhi_epi64(w[4 * m], w[4 * m + 2]),
+                                    _mm_unpacklo_epi64(w[4 * m + 1], w[4 * m + 3]), _mm_unpackhi_epi64(w[4 * m + 1], w[4 * m + 3]) };
+                for(int j = 0; j < 4; j++)
+                {
+                    __m128i delta = _mm_xor_si128(_mm_srli_epi32(rows[j], 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(rows[j], one)));
+                    sum = _mm_add_epi32(sum, delta);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + (v + 4 * m + j) * vertexStride + k), sum);
+                }
+            }
+            previous[g] = sum;
+        }
+    }
+}
+#endif
+
+///
+/// Decodes a vertex buffer written by EncodeVertexBuffer.
+/// \param encoded - the encoded vertices.
+/// \param size - size of the encoded vertices.
+/// \param vertexCount - number of vertices.
+/// \param vertexStride - size of one vertex, as encoded.
+/// \param destination - receives the vertices, vertexCount * vertexStride bytes.
+/// \param scratch - space for entropy coded streams, reused between calls.
+/// \return - false if the data is damaged or doesn't hold exactly this many vertices.
+///
+inline bool DecodeVertexBuffer(const unsigned char* encoded, size_t size, size_t vertexCount, size_t vertexStride, void* destination,
+                               std::vector<unsigned char>& scratch)
+{
+    if(vertexStride == 0 || vertexStride % 4 != 0)
+    {
+        return false;
+    }
+    scratch.resize(vertexCount * vertexStride);
+    std::vector<const unsigned char*> streams(vertexStride);
+    const unsigned char* in = encoded;
+    const unsigned char* end = encoded + size;
+    for(size_t k = 0; k < vertexStride; k++)
+    {
+        if(!ReadCodecStream(in, end, vertexCount, scratch.data() + k * vertexCount, streams[k]))
+        {
+            return false;
+        }
+    }
+    if(in != end)
+    {
+        return false;
+    }
+
+    unsigned char* vertices = static_cast<unsigned char*>(destination);
+    size_t blockEnd = 0;
+#ifdef MESH_CODEC_SSE2
+    if(vertexStride >= 16 && vertexStride <= 16 * MESH_CODEC_MAX_SIMD_GROUPS)
+    {
+        blockEnd = vertexCount & ~( size_t) 15;
+        UnfilterVerticesSse2(streams.data(), blockEnd, vertexStride, vertices);
+    }
+#endif
+    UnfilterVerticesScalar(streams.data(), blockEnd, vertexCount, vertexStride, vertices);
+    return true;
+}
+
+///
+/// Encodes an index buffer. Indices in vertex cache order compress best.
+/// \param indices - the indices.
+/// \param indexCount - number of indices.
+/// \param out - receives the encoded indices.
+///
+inline void EncodeIndexBuffer(const unsigned int* indices, size_t indexCount, std::vector<unsigned char>& out)
+{
+    std::vector<unsigned char> bytes;
+    bytes.reserve(indexCount + indexCount / 4);
+    uint32_t previous = 0;
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        WriteCodecVarint(bytes, ZigzagEncode(indices[i] - previous));
+        previous = indices[i];
+    }
+
+    out.clear();
+    WriteCodecVarint(out, bytes.size());
+    WriteCodecStream(out, bytes.data(), bytes.size());
+}
+
+///
+/// Decodes an index buffer written by EncodeIndexBuffer. Every index is checked against the vertex count, so a
+/// damaged buffer can't make a draw read past the vertices.
+/// \param encoded - the encoded indices.
+/// \param size - size of the encoded indices.
+/// \param indexCount - number of indices.
+/// \param vertexCount - number of vertices the indices refer to.
+/// \param destination - receives the indices.
+/// \param scratch - space for an entropy coded stream, reused between calls.
+/// \return - false if the data is damaged, refers past the vertices or doesn't hold exactly this many indices.
+///
+inline bool DecodeIndexBuffer(const unsigned char* encoded, size_t size, size_t indexCount, size_t vertexCount, unsigned int* destination,
+                              std::vector<unsigned char>& scratch)
+{
+    const unsigned char* in = encoded;
+    const unsigned char* end = encoded + size;
+    uint64_t byteCount;
+    if(!ReadCodecVarint(in, end, byteCount) || byteCount > ( uint64_t) indexCount * 5)
+    {
+        return false;
+    }
+    scratch.resize(( size_t) byteCount);
+    const unsigned char* bytes;
+    if(!ReadCodecStream(in, end, ( size_t) byteCount, scratch.data(), bytes) || in != end)
+    {
+        return false;
+    }
+
+    const unsigned char* byte = bytes;
+    const unsigned char* bytesEnd = bytes + byteCount;
+    uint32_t previous = 0;
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        // Nearly every index takes a single byte.
+        uint64_t value;
+        if(byte < bytesEnd && *byte < 0x80)
+        {
+            value = *byte++;
+        }
+        else if(!ReadCodecVarint(byte, bytesEnd, value) || value > UINT32_MAX)
+        {
+            return false;
+        }
+        previous += ZigzagDecode(( uint32_t) value);
+        if(previous >= vertexCount)
+        {
+            return false;
+        }
+        destination[i] = previous;
+    }
+    return byte == bytesEnd;
+}
+
+#endif
\ No newline at end of file
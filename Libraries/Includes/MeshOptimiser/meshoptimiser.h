@@ -0,0 +1,498 @@
+#ifndef MESHOPTIMISER_H
+#define MESHOPTIMISER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Size of the FIFO cache used when measuring ACMR/ATVR. Roughly matches the post-transform cache of current GPUs.
+const unsigned int ANALYSIS_CACHE_SIZE = 16;
+
+// Size of the LRU cache modelled by the Forsyth vertex cache optimiser.
+const unsigned int FORSYTH_CACHE_SIZE = 32;
+
+// Triangles in a cluster may be reordered for overdraw as long as the cluster's ACMR stays within this factor of the original.
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+///
+/// Results of simulating the post-transform vertex cache over an index buffer.
+///
+struct VertexCacheStatistics
+{
+    unsigned int transformed = 0;   // Number of vertex shader invocations (cache misses).
+    unsigned int triangles = 0;     // Number of triangles in the index buffer.
+    unsigned int vertices = 0;      // Number of unique vertices referenced by the index buffer.
+    float acmr = 0.0f;              // Average cache miss ratio, transformed vertices per triangle. 0.5 is ideal, 3 is worst.
+    float atvr = 0.0f;              // Average transformed vertex ratio, transformed vertices per unique vertex. 1 is ideal.
+};
+
+///
+/// Results of running the full optimisation pass over a single mesh.
+///
+struct MeshOptimisationReport
+{
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+    unsigned int degenerates = 0;   // Number of degenerate triangles removed.
+};
+
+///
+/// Simulates a FIFO post-transform cache over the index buffer.
+///
+/// \param indices - triangle list index buffer.
+/// \param vertexCount - number of vertices in the vertex buffer.
+/// \param cacheSize - number of entries in the simulated cache.
+/// \return - the cache statistics.
+///
+inline VertexCacheStatistics AnalyseVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = ANALYSIS_CACHE_SIZE)
+{
+    VertexCacheStatistics stats;
+    stats.triangles = ( unsigned int) (indices.size() / 3);
+
+    // A vertex is in the FIFO if fewer than cacheSize misses have happened since it was last inserted.
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int timestamp = cacheSize + 1;
+
+    for(unsigned int index : indices)
+    {
+        if(timestamp - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = timestamp++;
+            stats.transformed++;
+        }
+        if(!referenced[index])
+        {
+            referenced[index] = true;
+            stats.vertices++;
+        }
+    }
+
+    stats.acmr = stats.triangles == 0 ? 0.0f : ( float) stats.transformed / stats.triangles;
+    stats.atvr = stats.vertices == 0 ? 0.0f : ( float) stats.transformed / stats.vertices;
+    return stats;
+}
+
+///
+/// Removes triangles that reference the same vertex twice or have zero area.
+///
+/// \param indices - triangle list index buffer, modified in place.
+/// \param vertices - vertex buffer, vertices must have a glm::vec3 Position member.
+/// \return - the number of triangles removed.
+///
+template <typename VertexType>
+unsigned int RemoveDegenerateTriangles(std::vector<unsigned int>& indices, const std::vector<VertexType>& vertices)
+{
+    size_t write = 0;
+    for(size_t read = 0; read + 2 < indices.size(); read += 3)
+    {
+        unsigned int a = indices[read + 0];
+        unsigned int b = indices[read + 1];
+        unsigned int c = indices[read + 2];
+        if(a == b || b == c || c == a)
+        {
+            continue;
+        }
+
+        glm::vec3 normal = glm::cross(vertices[b].Position - vertices[a].Position, vertices[c].Position - vertices[a].Position);
+        if(normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f)
+        {
+            continue;
+        }
+
+        indices[write++] = a;
+        indices[write++] = b;
+        indices[write++] = c;
+    }
+
+    unsigned int removed = ( unsigned int) ((indices.size() - write) / 3);
+    indices.resize(write);
+    return removed;
+}
+
+///
+/// Score of a vertex as used by Forsyth's linear-speed vertex cache optimisation.
+/// Vertices used by the last triangle get a fixed score, other cached vertices score higher the more recently used
+/// they are, and vertices with few remaining triangles get a boost so they are finished off rather than left behind.
+///
+inline float ForsythVertexScore(int cachePosition, unsigned int liveTriangles)
+{
+    if(liveTriangles == 0)
+    {
+        // No triangle needs this vertex any more.
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cachePosition >= 0)
+    {
+        if(cachePosition < 3)
+        {
+            score = 0.75f;
+        }
+        else
+        {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+        }
+    }
+
+    score += 2.0f / std::sqrt(( float) liveTriangles);
+    return score;
+}
+
+///
+/// Reorders triangles to improve post-transform vertex cache hits using Forsyth's algorithm.
+/// Ties are broken by triangle order so the result only depends on the input.
+///
+/// \param indices - triangle list index buffer, reordered in place.
+/// \param vertexCount - number of vertices in the vertex buffer.
+///
+inline void OptimiseVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    // Build the vertex to triangle adjacency in a single flat array.
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        liveTriangles[indices[i]]++;
+    }
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+    }
+
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = ( unsigned int) (i / 3);
+    }
+
+    // Initial scores.
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    int best = -1;
+    float bestScore = -1.0f;
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if(triangleScore[t] > bestScore)
+        {
+            bestScore = triangleScore[t];
+            best = ( int) t;
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int cacheCount = 0;
+    size_t cursor = 0;
+
+    for(size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if(best < 0)
+        {
+            // Nothing in the cache has triangles left, continue with the next unemitted triangle in input order.
+            while(emitted[cursor])
+            {
+                cursor++;
+            }
+            best = ( int) cursor;
+        }
+
+        const unsigned int* triangle = &indices[best * 3];
+        output.push_back(triangle[0]);
+        output.push_back(triangle[1]);
+        output.push_back(triangle[2]);
+        emitted[best] = true;
+
+        // Remove the triangle from the adjacency of its vertices.
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + liveTriangles[v];
+            unsigned int* found = std::find(begin, end, ( unsigned int) best);
+            if(found != end)
+            {
+                *found = *(end - 1);
+                liveTriangles[v]--;
+            }
+        }
+
+        // Move the triangle's vertices to the front of the cache. Anything pushed past the end is evicted.
+        unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+        unsigned int newCount = 0;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            if(std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+            {
+                newCache[newCount++] = triangle[k];
+            }
+        }
+        unsigned int triangleVertices = newCount;
+        for(unsigned int i = 0; i < cacheCount; i++)
+        {
+            if(std::find(newCache, newCache + triangleVertices, cache[i]) == newCache + triangleVertices)
+            {
+                newCache[newCount++] = cache[i];
+            }
+        }
+
+        // Update vertex scores, and the scores of triangles that use them.
+        for(unsigned int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? ( int) i : -1;
+
+            float score = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for(unsigned int a = offsets[v]; a < offsets[v] + liveTriangles[v]; a++)
+            {
+                triangleScore[adjacency[a]] += delta;
+            }
+        }
+
+        cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // The next triangle is the best scoring one that touches the cache.
+        best = -1;
+        bestScore = -1.0f;
+        for(unsigned int i = 0; i < cacheCount; i++)
+        {
+            unsigned int v = cache[i];
+            for(unsigned int a = offsets[v]; a < offsets[v] + liveTriangles[v]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if(triangleScore[t] > bestScore || (triangleScore[t] == bestScore && ( int) t < best))
+                {
+                    bestScore = triangleScore[t];
+                    best = ( int) t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+///
+/// Reorders clusters of triangles so that triangles facing outwards from the mesh centre are drawn first,
+/// reducing overdraw, in the spirit of Tipsify. The index buffer should already be optimised for the vertex cache;
+/// it is split into clusters at points where the cache is cold anyway, so the sort costs little cache efficiency.
+///
+/// \param indices - triangle list index buffer, reordered in place.
+/// \param vertices - vertex buffer, vertices must have a glm::vec3 Position member.
+/// \param threshold - how much worse than the input ACMR a cluster may become.
+///
+template <typename VertexType>
+void OptimiseOverdraw(std::vector<unsigned int>& indices, const std::vector<VertexType>& vertices, float threshold = OVERDRAW_ACMR_THRESHOLD)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    // FIFO cache simulation shared by the boundary passes.
+    std::vector<unsigned int> insertedAt(vertices.size(), 0);
+    unsigned int timestamp = ANALYSIS_CACHE_SIZE + 1;
+    auto resetCache = [&]()
+    {
+        timestamp += ANALYSIS_CACHE_SIZE + 1;
+    };
+    auto triangleMisses = [&](size_t t)
+    {
+        unsigned int misses = 0;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            unsigned int index = indices[t * 3 + k];
+            if(timestamp - insertedAt[index] > ANALYSIS_CACHE_SIZE)
+            {
+                insertedAt[index] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    // Hard boundaries, where a triangle misses the cache on all three vertices.
+    std::vector<size_t> hardBoundaries;
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        if(triangleMisses(t) == 3)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Soft boundaries, splitting hard clusters further wherever the running ACMR is already within the threshold.
+    std::vector<size_t> clusters;
+    for(size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+    {
+        size_t start = hardBoundaries[h];
+        size_t end = hardBoundaries[h + 1];
+
+        resetCache();
+        unsigned int clusterMisses = 0;
+        for(size_t t = start; t < end; t++)
+        {
+            clusterMisses += triangleMisses(t);
+        }
+        float target = threshold * clusterMisses / (end - start);
+
+        resetCache();
+        clusters.push_back(start);
+        unsigned int misses = 0;
+        size_t clusterStart = start;
+        for(size_t t = start; t < end; t++)
+        {
+            misses += triangleMisses(t);
+            if(t + 1 < end && ( float) misses / (t + 1 - clusterStart) <= target)
+            {
+                clusters.push_back(t + 1);
+                clusterStart = t + 1;
+                misses = 0;
+                resetCache();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area weighted centroid of the whole mesh.
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCentroid += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if(meshArea > 0.0f)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    // Sort key for each cluster: how far it faces away from the mesh centre.
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKey(clusterCount);
+    for(size_t i = 0; i < clusterCount; i++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for(size_t t = clusters[i]; t < clusters[i + 1]; t++)
+        {
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            float faceArea = glm::length(faceNormal);
+            centroid += (a + b + c) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        if(area > 0.0f)
+        {
+            centroid /= area;
+        }
+        float length = glm::length(normal);
+        sortKey[i] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for(size_t i = 0; i < clusterCount; i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for(size_t cluster : order)
+    {
+        output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+    }
+    indices.swap(output);
+}
+
+///
+/// Reorders the vertex buffer into the order the index buffer first references them, so vertex fetch walks memory
+/// linearly. Unreferenced vertices are dropped.
+///
+/// \param indices - triangle list index buffer, remapped in place.
+/// \param vertices - vertex buffer, reordered in place.
+///
+template <typename VertexType>
+void OptimiseVertexFetch(std::vector<unsigned int>& indices, std::vector<VertexType>& vertices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<VertexType> output;
+    output.reserve(vertices.size());
+
+    for(unsigned int& index : indices)
+    {
+        if(remap[index] == unused)
+        {
+            remap[index] = ( unsigned int) output.size();
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(output);
+}
+
+///
+/// Runs the full load time optimisation pass over a mesh: degenerate removal, vertex cache, overdraw and vertex fetch.
+///
+/// \param vertices - vertex buffer, reordered in place.
+/// \param indices - triangle list index buffer, reordered in place.
+/// \return - vertex cache statistics before and after.
+///
+template <typename VertexType>
+MeshOptimisationReport OptimiseMesh(std::vector<VertexType>& vertices, std::vector<unsigned int>& indices)
+{
+    MeshOptimisationReport report;
+    report.before = AnalyseVertexCache(indices, vertices.size());
+
+    report.degenerates = RemoveDegenerateTriangles(indices, vertices);
+    OptimiseVertexCache(indices, vertices.size());
+    OptimiseOverdraw(indices, vertices);
+    OptimiseVertexFetch(indices, vertices);
+
+    report.after = AnalyseVertexCache(indices, vertices.size());
+    return report;
+}
+
+#endif
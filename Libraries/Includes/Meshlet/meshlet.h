@@ -0,0 +1,337 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <MeshOptimiser/meshoptimiser.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Limits for a single meshlet. Large enough that per cluster draw overhead stays small,
+// small enough that the bounds stay tight enough to be worth culling on their own.
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// When a meshlet runs out of connected triangles, this many of the next unused triangles are considered to continue it.
+const unsigned int MESHLET_FALLBACK_CANDIDATES = 32;
+
+///
+/// A small cluster of triangles stored as a contiguous range of a mesh's index buffer,
+/// together with the bounds needed to cull it on its own.
+///
+struct Meshlet
+{
+    unsigned int indexOffset;   // First index of the cluster in the mesh's index buffer.
+    unsigned int indexCount;    // Number of indices in the cluster, three per triangle.
+    glm::vec3 center;           // Bounding sphere.
+    float radius;
+    glm::vec3 coneAxis;         // Average facing direction of the triangles.
+    float coneCutoff;           // Sine of the normal cone's half angle, 1 if the cone is too wide to ever cull.
+};
+
+///
+/// Frustum planes and camera position, both in the model space of the mesh being culled.
+///
+struct ClusterCullingView
+{
+    glm::vec4 planes[6];
+    glm::vec3 cameraPosition;
+};
+
+///
+/// Builds the culling view for a mesh drawn with the given matrices.
+/// The planes come from the combined matrix (Gribb/Hartmann) so they are already in model space.
+///
+inline ClusterCullingView MakeClusterCullingView(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model)
+{
+    ClusterCullingView cullingView;
+    glm::mat4 m = glm::transpose(projection * view * model);
+    cullingView.planes[0] = m[3] + m[0];    // Left.
+    cullingView.planes[1] = m[3] - m[0];    // Right.
+    cullingView.planes[2] = m[3] + m[1];    // Bottom.
+    cullingView.planes[3] = m[3] - m[1];    // Top.
+    cullingView.planes[4] = m[3] + m[2];    // Near.
+    cullingView.planes[5] = m[3] - m[2];    // Far.
+    for(unsigned int i = 0; i < 6; i++)
+    {
+        cullingView.planes[i] /= glm::length(glm::vec3(cullingView.planes[i]));
+    }
+
+    cullingView.cameraPosition = glm::vec3(glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    return cullingView;
+}
+
+///
+/// Returns false if the meshlet is entirely outside the frustum, or every triangle in it faces away from the camera.
+///
+inline bool IsMeshletVisible(const Meshlet& meshlet, const ClusterCullingView& cullingView)
+{
+    for(unsigned int i = 0; i < 6; i++)
+    {
+        if(glm::dot(glm::vec3(cullingView.planes[i]), meshlet.center) + cullingView.planes[i].w < -meshlet.radius)
+        {
+            return false;
+        }
+    }
+
+    // Backface cone test against the whole bounding sphere, so it stays conservative for every point in the cluster.
+    glm::vec3 toCluster = meshlet.center - cullingView.cameraPosition;
+    return glm::dot(toCluster, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(toCluster) + meshlet.radius;
+}
+
+///
+/// Computes the bounding sphere and normal cone for the triangles in indices[offset, offset + count).
+///
+template <typename VertexType>
+Meshlet ComputeMeshletBounds(const std::vector<unsigned int>& indices, const std::vector<VertexType>& vertices, unsigned int offset, unsigned int count)
+{
+    Meshlet meshlet;
+    meshlet.indexOffset = offset;
+    meshlet.indexCount = count;
+
+    // Sphere around the centre of the bounding box.
+    glm::vec3 minimum(INFINITY);
+    glm::vec3 maximum(-INFINITY);
+    for(unsigned int i = offset; i < offset + count; i++)
+    {
+        minimum = glm::min(minimum, vertices[indices[i]].Position);
+        maximum = glm::max(maximum, vertices[indices[i]].Position);
+    }
+    meshlet.center = (minimum + maximum) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(unsigned int i = offset; i < offset + count; i++)
+    {
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+    }
+
+    // Cone around the average face normal, its half angle set by the normal furthest from the average.
+    std::vector<glm::vec3> normals;
+    normals.reserve(count / 3);
+    glm::vec3 axis(0.0f);
+    for(unsigned int i = offset; i + 2 < offset + count; i += 3)
+    {
+        const glm::vec3& a = vertices[indices[i + 0]].Position;
+        const glm::vec3& b = vertices[indices[i + 1]].Position;
+        const glm::vec3& c = vertices[indices[i + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if(length > 0.0f)
+        {
+            normals.push_back(normal / length);
+            axis += normal / length;
+        }
+    }
+
+    float axisLength = glm::length(axis);
+    meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    if(axisLength > 0.0f)
+    {
+        float minimumDot = 1.0f;
+        for(const glm::vec3& normal : normals)
+        {
+            minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+        }
+
+        // Cones wider than a hemisphere can't prove anything.
+        if(minimumDot > 0.0f)
+        {
+            meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        }
+    }
+
+    return meshlet;
+}
+
+///
+/// Splits a mesh into meshlets and reorders its index buffer so each meshlet is a contiguous range.
+/// Meshlets are grown greedily over shared vertices, preferring triangles that add the fewest new vertices and face
+/// the same way as the meshlet so the clusters stay compact and their normal cones narrow. The triangles of each
+/// finished meshlet are then reordered for the vertex cache.
+///
+/// \param vertices - vertex buffer, vertices must have a glm::vec3 Position member.
+/// \param indices - triangle list index buffer, reordered in place.
+/// \return - the meshlets, in index buffer order.
+///
+template <typename VertexType>
+std::vector<Meshlet> BuildMeshlets(const std::vector<VertexType>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<Meshlet> meshlets;
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+    {
+        return meshlets;
+    }
+
+    // Vertex to triangle adjacency.
+    std::vector<unsigned int> offsets(vertices.size() + 1, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for(size_t v = 0; v < vertices.size(); v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = ( unsigned int) (i / 3);
+    }
+
+    std::vector<bool> used(triangleCount, false);
+    std::vector<unsigned int> inMeshlet(vertices.size(), ~0u);
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    std::vector<glm::vec3> faceCentroids(triangleCount);
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        faceNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        faceCentroids[t] = (a + b + c) / 3.0f;
+    }
+
+    auto newVertexCount = [&](size_t triangle, unsigned int meshletIndex)
+    {
+        unsigned int count = 0;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            count += inMeshlet[indices[triangle * 3 + k]] != meshletIndex ? 1 : 0;
+        }
+        return count;
+    };
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    size_t seed = 0;
+    while(true)
+    {
+        while(seed < triangleCount && used[seed])
+        {
+            seed++;
+        }
+        if(seed == triangleCount)
+        {
+            break;
+        }
+
+        unsigned int meshletIndex = ( unsigned int) meshlets.size();
+        unsigned int offset = ( unsigned int) output.size();
+        std::vector<unsigned int> meshletVertices;
+        glm::vec3 normalSum(0.0f);
+        glm::vec3 centroidSum(0.0f);
+
+        size_t triangle = seed;
+        while(true)
+        {
+            // Add the triangle.
+            used[triangle] = true;
+            normalSum += faceNormals[triangle];
+            centroidSum += faceCentroids[triangle];
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[triangle * 3 + k];
+                output.push_back(v);
+                if(inMeshlet[v] != meshletIndex)
+                {
+                    inMeshlet[v] = meshletIndex;
+                    meshletVertices.push_back(v);
+                }
+            }
+
+            if((output.size() - offset) / 3 >= MESHLET_MAX_TRIANGLES)
+            {
+                break;
+            }
+
+            // Pick the best neighbouring triangle that still fits.
+            size_t best = triangleCount;
+            float bestScore = INFINITY;
+            for(unsigned int v : meshletVertices)
+            {
+                for(unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+                {
+                    unsigned int candidate = adjacency[a];
+                    if(used[candidate])
+                    {
+                        continue;
+                    }
+
+                    unsigned int newVertices = newVertexCount(candidate, meshletIndex);
+                    if(meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES)
+                    {
+                        continue;
+                    }
+
+                    float score = newVertices - glm::dot(faceNormals[candidate], normalSum) / glm::max(glm::length(normalSum), 1e-6f);
+                    if(score < bestScore || (score == bestScore && candidate < best))
+                    {
+                        bestScore = score;
+                        best = candidate;
+                    }
+                }
+            }
+
+            if(best == triangleCount)
+            {
+                // No connected triangle left, continue with the closest of the next few unused triangles instead.
+                // The input is in vertex cache order so these are usually nearby parts of the surface.
+                glm::vec3 center = centroidSum / ( float) ((output.size() - offset) / 3);
+                unsigned int considered = 0;
+                for(size_t candidate = seed; candidate < triangleCount && considered < MESHLET_FALLBACK_CANDIDATES; candidate++)
+                {
+                    if(used[candidate])
+                    {
+                        continue;
+                    }
+                    considered++;
+
+                    if(meshletVertices.size() + newVertexCount(candidate, meshletIndex) > MESHLET_MAX_VERTICES)
+                    {
+                        continue;
+                    }
+
+                    glm::vec3 offsetToCandidate = faceCentroids[candidate] - center;
+                    float score = glm::dot(offsetToCandidate, offsetToCandidate);
+                    if(score < bestScore)
+                    {
+                        bestScore = score;
+                        best = candidate;
+                    }
+                }
+            }
+
+            if(best == triangleCount)
+            {
+                break;
+            }
+            triangle = best;
+        }
+
+        // Reorder the meshlet's own triangles for the vertex cache, working on meshlet local indices.
+        std::vector<unsigned int> local(output.begin() + offset, output.end());
+        for(unsigned int& index : local)
+        {
+            index = ( unsigned int) (std::find(meshletVertices.begin(), meshletVertices.end(), index) - meshletVertices.begin());
+        }
+        OptimiseVertexCache(local, meshletVertices.size());
+        for(size_t i = 0; i < local.size(); i++)
+        {
+            output[offset + i] = meshletVertices[local[i]];
+        }
+
+        meshlets.push_back(ComputeMeshletBounds(output, vertices, offset, ( unsigned int) output.size() - offset));
+    }
+
+    indices.swap(output);
+    return meshlets;
+}
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef MIPCHAIN_H
+#define MIPCHAIN_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Builds an image's whole mip chain on the CPU, so it can be stored with the image and uploaded as it is rather than
+// generated by the driver. Each level is filtered from the one above it, kept in floating point the whole way down
+// so rounding doesn't build up. Colour maps are filtered in linear light, not on their sRGB encoded values, which
+// keeps bright detail from darkening as it shrinks, and normal maps are unit length again at every level. The filter
+// runs in two separable passes, each a row per work item across the worker threads, with a pixel's four channels
+// in one SSE2 register where it's there.
+
+enum MipFilter
+{
+    MIP_FILTER_BOX,     // Averages the pixels each smaller pixel covers. Cheap, but soft and prone to aliasing.
+    MIP_FILTER_KAISER   // A Kaiser windowed sinc. Keeps more detail without ringing much.
+};
+
+enum MipContent
+{
+    MIP_CONTENT_COLOUR, // sRGB encoded colour, filtered in linear light. Alpha is always linear.
+    MIP_CONTENT_DATA,   // Values stored as they are, such as specular or roughness maps.
+    MIP_CONTENT_NORMAL  // Tangent space normals in RGB, mapped from [-1, 1], renormalised at every level.
+};
+
+// Half the width of the Kaiser filter, in pixels of the smaller level, and the shape of its window.
+const float MIP_KAISER_RADIUS = 3.0f;
+const float MIP_KAISER_ALPHA = 4.0f;
+
+const float MIP_PI = 3.14159265358979f;
+
+// Which pixels of the larger level one axis of a smaller level's pixels is filtered from. Every pixel has the same
+// number of taps, padded with zero weights, and taps past the edge wrap around, as the textures repeat.
+struct MipFilterAxis
+{
+    int taps = 0;
+    std::vector<int> sources;   // taps entries per pixel: the larger level's pixel.
+    std::vector<float> weights; // taps entries per pixel, summing to one.
+};
+
+///
+/// Zeroth order modified Bessel function of the first kind, which shapes the Kaiser window.
+///
+inline float BesselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for(int k = 1; k < 32 && term > sum * 1e-8f; k++)
+    {
+        float half = x / (2.0f * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+
+///
+/// The Kaiser filter's weight at a distance from a smaller level's pixel, in its own pixels.
+///
+inline float KaiserWeight(float distance)
+{
+    float t = distance / MIP_KAISER_RADIUS;
+    if(t <= -1.0f || t >= 1.0f)
+    {
+        return 0.0f;
+    }
+    float sinc = distance == 0.0f ? 1.0f : std::sin(MIP_PI * distance) / (MIP_PI * distance);
+    return sinc * BesselI0(MIP_KAISER_ALPHA * std::sqrt(1.0f - t * t)) / BesselI0(MIP_KAISER_ALPHA);
+}
+
+///
+/// Works out the taps of one axis of a smaller level. It needn't be exactly half the larger one: odd sizes round down,
+/// and the pixel left over is shared out between its neighbours.
+/// \param sourceSize - the larger level's width or height.
+/// \param size - the smaller level's.
+///
+inline MipFilterAxis BuildMipFilterAxis(int sourceSize, int size, MipFilter filter)
+{
+    float scale = ( float) sourceSize / size;
+    float radius = filter == MIP_FILTER_BOX ? 0.5f * scale : MIP_KAISER_RADIUS * scale;
+
+    std::vector<std::vector<std::pair<int, float>>> pixels(size);
+    MipFilterAxis axis;
+    for(int i = 0; i < size; i++)
+    {
+        float centre = (i + 0.5f) * scale;
+        int first = ( int) std::floor(centre - radius);
+        int last = ( int) std::ceil(centre + radius);
+        float total = 0.0f;
+        for(int s = first; s < last; s++)
+        {
+            float weight;
+            if(filter == MIP_FILTER_BOX)
+            {
+                // How much of the source pixel the smaller pixel covers.
+                weight = std::max(std::min(( float) s + 1.0f, centre + radius) - std::max(( float) s, centre - radius), 0.0f);
+            }
+            else
+            {
+                weight = KaiserWeight((s + 0.5f - centre) / scale);
+            }
+            if(weight != 0.0f)
+            {
+                pixels[i].push_back(std::make_pair(((s % sourceSize) + sourceSize) % sourceSize, weight));
+                total += weight;
+            }
+        }
+        for(std::pair<int, float>& tap : pixels[i])
+        {
+            tap.second /= total;
+        }
+        axis.taps = std::max(axis.taps, ( int) pixels[i].size());
+    }
+
+    axis.sources.assign(( size_t) size * axis.taps, 0);
+    axis.weights.assign(( size_t) size * axis.taps, 0.0f);
+    for(int i = 0; i < size; i++)
+    {
+        for(size_t t = 0; t < pixels[i].size(); t++)
+        {
+            axis.sources[( size_t) i * axis.taps + t] = pixels[i][t].first;
+            axis.weights[( size_t) i * axis.taps + t] = pixels[i][t].second;
+        }
+    }
+    return axis;
+}
+
+///
+/// Linear light values of the 256 sRGB encoded ones.
+///
+inline const float* SrgbToLinearTable()
+{
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> values(256);
+        for(int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Steps of the table LinearToSrgb starts its search from. sRGB is steepest at black, where a step still spans less
+// than one encoded value.
+const int MIP_SRGB_GUESS_STEPS = 4096;
+
+///
+/// Encodes a linear light value as the nearest 8 bit sRGB value.
+///
+inline unsigned char LinearToSrgb(float value)
+{
+    struct Tables
+    {
+        float thresholds[256];  // The linear values halfway between neighbouring encoded ones, so rounding is exact.
+        unsigned char guesses[MIP_SRGB_GUESS_STEPS + 1];
+    };
+    static const Tables tables = []()
+    {
+        Tables t;
+        for(int i = 0; i < 255; i++)
+        {
+            float c = (i + 0.5f) / 255.0f;
+            t.thresholds[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        t.thresholds[255] = INFINITY;
+        for(int i = 0; i <= MIP_SRGB_GUESS_STEPS; i++)
+        {
+            t.guesses[i] = ( unsigned char) (std::upper_bound(t.thresholds, t.thresholds + 255, ( float) i / MIP_SRGB_GUESS_STEPS) - t.thresholds);
+        }
+        return t;
+    }();
+    int step = ( int) (std::min(std::max(value, 0.0f), 1.0f) * MIP_SRGB_GUESS_STEPS);
+    int encoded = tables.guesses[step];
+    while(value >= tables.thresholds[encoded])
+    {
+        encoded++;
+    }
+    return ( unsigned char) encoded;
+}
+
+///
+/// Scales a normal's XYZ back to unit length. Normals filtered down to nothing point straight out of the surface.
+///
+inline void RenormaliseMipNormal(float* pixel)
+{
+    float length = std::sqrt(pixel[0] * pixel[0] + pixel[1] * pixel[1] + pixel[2] * pixel[2]);
+    if(length < 1e-6f)
+    {
+        pixel[0] = 0.0f;
+        pixel[1] = 0.0f;
+        pixel[2] = 1.0f;
+        return;
+    }
+    pixel[0] /= length;
+    pixel[1] /= length;
+    pixel[2] /= length;
+}
+
+///
+/// Filters a level down to the next one.
+/// \param pixels - the larger level, four floats a pixel.
+/// \param width, height - its size.
+/// \param smallerWidth, smallerHeight - the smaller level's size.
+/// \return - the smaller level, four floats a pixel.
+///
+inline std::vector<float> DownsampleMipLevel(const std::vector<float>& pixels, int width, int height, int smallerWidth, int smallerHeight,
+                                             MipFilter filter)
+{
+    MipFilterAxis columns = BuildMipFilterAxis(width, smallerWidth, filter);
+    MipFilterAxis rows = BuildMipFilterAxis(height, smallerHeight, filter);
+
+    // Across each row first, then down the narrower image.
+    std::vector<float> narrow(( size_t) smallerWidth * height * 4);
+    ParallelFor(( size_t) height, [&](size_t y)
+    {
+        const float* row = pixels.data() + y * width * 4;
+        float* out = narrow.data() + y * smallerWidth * 4;
+        for(int x = 0; x < smallerWidth; x++)
+        {
+            const int* sources = columns.sources.data() + ( size_t) x * columns.taps;
+            const float* weights = columns.weights.data() + ( size_t) x * columns.taps;
+#ifdef MIP_CHAIN_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for(int t = 0; t < columns.taps; t++)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + ( size_t) sources[t] * 4), _mm_set1_ps(weights[t])));
+            }
+            _mm_storeu_ps(out + ( size_t) x * 4, sum);
+#else
+            float sum[4] = {};
+            for(int t = 0; t < columns.taps; t++)
+            {
+                for(int c = 0; c < 4; c++)
+                {
+                    sum[c] += row[( size_t) sources[t] * 4 + c] * weights[t];
+                }
+            }
+            std::copy(sum, sum + 4, out + ( size_t) x * 4);
+#endif
+        }
+    });
+
+    std::vector<float> smaller(( size_t) smallerWidth * smallerHeight * 4, 0.0f);
+    size_t rowFloats = ( size_t) smallerWidth * 4;
+    ParallelFor(( size_t) smallerHeight, [&](size_t y)
+    {
+        float* out = smaller.data() + y * rowFloats;
+        for(int t = 0; t < rows.taps; t++)
+        {
+            float weight = rows.weights[y * rows.taps + t];
+            if(weight == 0.0f)
+            {
+                continue;
+            }
+            const float* row = narrow.data() + ( size_t) rows.sources[y * rows.taps + t] * rowFloats;
+#ifdef MIP_CHAIN_SSE2
+            // Rows are a whole number of pixels, so four floats at a time covers them exactly.
+            __m128 scale = _mm_set1_ps(weight);
+            for(size_t i = 0; i < rowFloats; i += 4)
+            {
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), scale)));
+            }
+#else
+            for(size_t i = 0; i < rowFloats; i++)
+            {
+                out[i] += row[i] * weight;
+            }
+#endif
+        }
+    });
+    return smaller;
+}
+
+///
+/// Builds an image's mip chain, from the image itself down to 1x1.
+/// \param rgba - the image, four 8 bit components a pixel.
+/// \param width, height - its size.
+/// \param content - what the image holds, which decides the space it's filtered in.
+/// \param filter - the filter to shrink each level with.
+/// \return - every level, the image first, four 8 bit components a pixel. Each level is half the size of the one
+///           above it, rounded down, and at least 1.
+///
+inline std::vector<std::vector<unsigned char>> BuildMipChain(const unsigned char* rgba, int width, int height, MipContent content, MipFilter filter)
+{
+    const float* srgbToLinear = SrgbToLinearTable();
+    size_t pixelCount = ( size_t) width * height;
+    float colourScale = content == MIP_CONTENT_NORMAL ? 1.0f / 127.5f : 1.0f / 255.0f;
+    float colourBias = content == MIP_CONTENT_NORMAL ? -1.0f : 0.0f;
+    std::vector<float> level(pixelCount * 4);
+    for(size_t i = 0; i < pixelCount * 4; i += 4)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            level[i + c] = content == MIP_CONTENT_COLOUR ? srgbToLinear[rgba[i + c]] : rgba[i + c] * colourScale + colourBias;
+        }
+        level[i + 3] = rgba[i + 3] / 255.0f;
+    }
+
+    std::vector<std::vector<unsigned char>> levels;
+    levels.emplace_back(rgba, rgba + pixelCount * 4);
+    while(width > 1 || height > 1)
+    {
+        int smallerWidth = std::max(width / 2, 1);
+        int smallerHeight = std::max(height / 2, 1);
+        level = DownsampleMipLevel(level, width, height, smallerWidth, smallerHeight, filter);
+        width = smallerWidth;
+        height = smallerHeight;
+        pixelCount = ( size_t) width * height;
+
+        std::vector<unsigned char> encoded(pixelCount * 4);
+        ParallelFor(( size_t) height, [&](size_t y)
+        {
+            for(size_t i = y * width * 4; i < (y + 1) * width * 4; i += 4)
+            {
+                float* pixel = level.data() + i;
+                if(content == MIP_CONTENT_NORMAL)
+                {
+                    // The next level is filtered from the normals as they're stored.
+                    RenormaliseMipNormal(pixel);
+                }
+                for(int c = 0; c < 4; c++)
+                {
+                    float value = pixel[c];
+                    if(content == MIP_CONTENT_COLOUR && c < 3)
+                    {
+                        encoded[i + c] = LinearToSrgb(value);
+                        continue;
+                    }
+                    if(content == MIP_CONTENT_NORMAL && c < 3)
+                    {
+                        value = value * 0.5f + 0.5f;
+                    }
+                    encoded[i + c] = ( unsigned char) (std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        });
+        levels.push_back(std::move(encoded));
+    }
+    return levels;
+}
+
+#endif
\ No newline at end of file
@@ -5,21 +5,26 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
 
+#include <GltfLoader/gltfloader.h>
 #include <Mesh/mesh.h>
+#include <Meshlet/meshlet.h>
+#include <ModelData/modeldata.h>
+#include <ResourceRegistry/resourceregistry.h>
+#include <SceneGraph/scenegraph.h>
 #include <Shader/shader.h>
+#include <TextureStreamer/texturestreamer.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false)
@@ -27,44 +32,21 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if(data)
-    {
-        GLenum format = GL_RGB;
-        if(nrComponents == 1)
-        {
-            format = GL_RED;
-        }
-        else if(nrComponents == 3)
-        {
-            format = GL_RGB;
-        }
-        else if(nrComponents == 4)
-        {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+    DecodedTexture texture;
+    if(!DecodeTexture(filename, texture))
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
+    return UploadTexture(texture);
+}
 
-    return textureID;
+///
+/// Key a model and its meshes are shared under in the registry: the canonical path, see CanonicalAssetPath, and the
+/// import options. Packed models are found by their cooked entry.
+///
+inline string ModelResourceKey(const string& path, bool gamma)
+{
+    return CanonicalAssetPath(path, COOKED_MODEL_EXTENSION) + "|" + std::to_string(MODEL_IMPORT_FLAGS) + "|" + std::to_string(sizeof(Vertex)) + (gamma ? "|srgb" : "|linear");
 }
 
 class Model
@@ -72,10 +54,13 @@ class Model
 public:
     //  Model Data
 
-    // Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Texture> textures_loaded; 
+    // Every texture the model uses, each once. Textures are shared with other models through the registry.
+    vector<Texture> textures_loaded;
     vector<Mesh> meshes;
+    vector<float> lodErrors; // Error of each LOD of the whole model, the largest of its meshes' errors at that level.
+    SceneGraph nodes;        // The file's node hierarchy, each node drawing a range of the meshes with its world matrix.
     string directory;
+    string materialLayout;   // Layout the MaterialPacker tool packed the material maps with, empty if it hasn't.
     bool gammaCorrection;
 
     //  Functions
@@ -86,186 +71,469 @@ public:
         loadModel(path);
     }
 
-    // Draws the model, and thus all its meshes.
-    void Draw(Shader shader)
+    ///
+    /// Uploads a model that has already been read, see LoadModelData, so only the GL work is done here. Call on the
+    /// context's thread.
+    /// \param data - the model's data. Textures it has decoded are uploaded as they are, any others are loaded as
+    /// the meshes that use them are uploaded.
+    /// \param gamma - whether the model's textures are gamma corrected.
+    ///
+    explicit Model(const ModelData& data, bool gamma = false) : gammaCorrection(gamma)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
+        upload(data);
+    }
+
+    // Empty model, for ModelStreamer to fill in as a streamed model's uploads are made.
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    ///
+    /// Draws the model, and thus all its meshes, each with its node's transform. The shader must be in use, its
+    /// "model" uniform is set for every node.
+    /// \param shader - The shader to draw with.
+    /// \param modelMatrix - The instance's model matrix, applied on top of the node transforms.
+    ///
+    void Draw(Shader shader, const glm::mat4& modelMatrix)
+    {
+        nodes.UpdateWorld();
+        for(size_t node = 0; node < nodes.NodeCount(); node++)
+        {
+            if(nodes.MeshCount(node) == 0)
+            {
+                continue;
+            }
+            shader.SetUniformMat4("model", modelMatrix * nodes.World(node));
+            for(uint32_t i = nodes.FirstMesh(node); i < nodes.FirstMesh(node) + nodes.MeshCount(node); i++)
+            {
+                meshes[i].Draw(shader);
+            }
+        }
+    }
+
+    ///
+    /// Draws one level of detail of the model. Meshes with fewer levels draw their coarsest one. The shader must be in
+    /// use, its "model" uniform is set for every node.
+    /// \param shader - The shader to draw with.
+    /// \param lod - The level to draw.
+    /// \param modelMatrix - The instance's model matrix, applied on top of the node transforms.
+    /// \return - The number of triangles submitted.
+    ///
+    unsigned int DrawLod(Shader shader, unsigned int lod, const glm::mat4& modelMatrix)
+    {
+        nodes.UpdateWorld();
+        unsigned int triangles = 0;
+        for(size_t node = 0; node < nodes.NodeCount(); node++)
+        {
+            if(nodes.MeshCount(node) == 0)
+            {
+                continue;
+            }
+            shader.SetUniformMat4("model", modelMatrix * nodes.World(node));
+            for(uint32_t i = nodes.FirstMesh(node); i < nodes.FirstMesh(node) + nodes.MeshCount(node); i++)
+            {
+                triangles += meshes[i].DrawLod(shader, lod);
+            }
+        }
+        return triangles;
+    }
+
+    ///
+    /// Picks the level of detail to draw from its projected screen-space error.
+    /// \param distance - Distance from the camera to the model, in the model's own units (world distance / scale).
+    /// \param projectionScale - Pixels covered by one unit at distance one, screenHeight / (2 * tan(fovY / 2)).
+    /// \param current - The level used for this instance last frame, for hysteresis.
+    /// \return - The level to draw this frame.
+    ///
+    unsigned int SelectLod(float distance, float projectionScale, unsigned int current) const
+    {
+        return ::SelectLod(lodErrors, distance, projectionScale, current);
+    }
+
+    ///
+    /// Draws the model cluster by cluster, skipping meshlets outside the frustum or facing away from the camera.
+    /// Each node's meshlets are culled in that node's own space. The shader must be in use, its "model" uniform is
+    /// set for every node.
+    /// \param shader - The shader to draw with.
+    /// \param projection - The camera's projection matrix.
+    /// \param view - The camera's view matrix.
+    /// \param modelMatrix - The instance's model matrix, applied on top of the node transforms.
+    /// \return - The number of triangles submitted.
+    ///
+    unsigned int DrawClusters(Shader shader, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& modelMatrix)
+    {
+        nodes.UpdateWorld();
+        unsigned int triangles = 0;
+        for(size_t node = 0; node < nodes.NodeCount(); node++)
         {
-            meshes[i].Draw(shader);
+            if(nodes.MeshCount(node) == 0)
+            {
+                continue;
+            }
+            glm::mat4 world = modelMatrix * nodes.World(node);
+            shader.SetUniformMat4("model", world);
+            ClusterCullingView cullingView = MakeClusterCullingView(projection, view, world);
+            for(uint32_t i = nodes.FirstMesh(node); i < nodes.FirstMesh(node) + nodes.MeshCount(node); i++)
+            {
+                triangles += meshes[i].DrawClusters(shader, cullingView);
+            }
         }
+        return triangles;
     }
 
 private:
     //  Functions
     
-    // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // The streamer runs the loading steps itself, reading on its worker threads and uploading under a budget.
+    friend class ModelStreamer;
+
+    // Key the model's meshes are shared under, see ModelResourceKey.
+    string resourceKey;
+
+    // Loads a model from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
-        // Read file via ASSIMP.
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        
-        // Check for errors.
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is not Zero
+        // Retrieve the directory path of the filepath.
+        directory = path.substr(0, path.find_last_of('/'));
+        resourceKey = ModelResourceKey(path, gammaCorrection);
+
+        // Binary glTF is already laid out for the GPU, so it skips the import and is uploaded as it is.
+        string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+        if(extension == "glb")
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            loadGlb(path);
             return;
         }
 
-        // Retrieve the directory path of the filepath.
-        directory = path.substr(0, path.find_last_of('/'));
+        ModelData data;
+        if(!LoadModelData(path, data))
+        {
+            return;
+        }
+        upload(data);
+    }
+
+    // Loads a binary glTF file without converting it. Each buffer view a primitive reads is copied into a buffer of
+    // its own straight from the mapped file, and each primitive's vertex array points into those buffers with the
+    // accessors' own types, strides and offsets. Quantized attributes stay quantized, GL converts them as it fetches
+    // them and the node transforms carry the dequantization.
+    void loadGlb(string const& path)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        GltfAsset asset;
+        if(!LoadGlb(path, asset))
+        {
+            return;
+        }
+
+        // Buffers are made on first use, so none are made for primitives another model already holds.
+        vector<std::shared_ptr<GpuBuffer>> viewBuffers(asset.bufferViews.size());
+        size_t uploadedBytes = 0;
+        auto viewBuffer = [&](int32_t view)
+        {
+            if(!viewBuffers[view])
+            {
+                const GltfBufferView& source = asset.bufferViews[view];
+                unsigned int buffer;
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glBufferData(GL_ARRAY_BUFFER, source.byteLength, asset.binary + source.byteOffset, GL_STATIC_DRAW);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                viewBuffers[view] = std::make_shared<GpuBuffer>(buffer);
+                uploadedBytes += source.byteLength;
+            }
+            return viewBuffers[view];
+        };
+
+        string key = resourceKey + "|glb";
+        for(unsigned int i = 0; i < asset.primitives.size(); i++)
+        {
+            const GltfPrimitive& primitive = asset.primitives[i];
+            std::shared_ptr<GpuMeshBuffers> buffers = SharedMeshBuffers().Acquire(key + "#" + std::to_string(i), [&]()
+            {
+                std::shared_ptr<GpuMeshBuffers> uploaded = std::make_shared<GpuMeshBuffers>();
+                for(int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++)
+                {
+                    if(primitive.attributes[a] >= 0)
+                    {
+                        uploaded->sharedBuffers.push_back(viewBuffer(asset.accessors[primitive.attributes[a]].bufferView));
+                    }
+                }
+                if(primitive.indices >= 0)
+                {
+                    uploaded->sharedBuffers.push_back(viewBuffer(asset.accessors[primitive.indices].bufferView));
+                }
+
+                glGenVertexArrays(1, &uploaded->VAO);
+                glBindVertexArray(uploaded->VAO);
+                for(int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++)
+                {
+                    if(primitive.attributes[a] < 0)
+                    {
+                        continue;
+                    }
+                    const GltfAccessor& accessor = asset.accessors[primitive.attributes[a]];
+                    glBindBuffer(GL_ARRAY_BUFFER, viewBuffers[accessor.bufferView]->ID());
+                    glEnableVertexAttribArray(a);
+                    glVertexAttribPointer(a, accessor.componentCount, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE,
+                                          ( GLsizei) asset.bufferViews[accessor.bufferView].byteStride, ( void*) accessor.byteOffset);
+                }
+                if(primitive.indices >= 0)
+                {
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, viewBuffers[asset.accessors[primitive.indices].bufferView]->ID());
+                }
+                glBindVertexArray(0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                return uploaded;
+            });
+
+            vector<Texture> textures;
+            if(primitive.material >= 0)
+            {
+                const GltfMaterial& material = asset.materials[primitive.material];
+                if(material.baseColorImage >= 0)
+                {
+                    textures.push_back(loadGlbTexture(asset, path, material.baseColorImage, "texture_diffuse"));
+                }
+                if(material.normalImage >= 0)
+                {
+                    textures.push_back(loadGlbTexture(asset, path, material.normalImage, "texture_normal"));
+                }
+            }
 
-        // Process ASSIMP's root node recursively.
-        processNode(scene->mRootNode, scene);
+            // Without indices the positions are drawn in order.
+            const GltfAccessor& counted = asset.accessors[primitive.indices >= 0 ? primitive.indices : primitive.attributes[GLTF_POSITION]];
+            Mesh mesh(buffers, ( size_t) counted.count, textures);
+            mesh.indexType = primitive.indices >= 0 ? ( GLenum) counted.componentType : 0;
+            mesh.indexByteOffset = primitive.indices >= 0 ? ( size_t) counted.byteOffset : 0;
+            meshes.push_back(mesh);
+        }
+        computeLodErrors();
+        nodes.Build(asset.nodes);
+
+        cout << "MODEL::GLTF:: " << path << ": " << meshes.size() << " primitives, " << asset.nodes.size() << " nodes"
+             << (asset.quantized ? ", quantized" : "") << ", " << uploadedBytes / 1024 << " KB uploaded from the mapping in "
+             << MillisecondsSince(start) << " ms" << endl;
     }
 
-    // Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // Loads an image of a binary glTF file, unless any model has already loaded it. Images embedded in the file are
+    // decoded from the mapping, the others are files relative to the model.
+    Texture loadGlbTexture(const GltfAsset& asset, const string& path, int32_t index, const string& typeName)
     {
-        // Process each mesh located at the current node.
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        const GltfImage& image = asset.images[index];
+        if(image.bufferView < 0)
         {
-            // The node object only contains indices to index the actual objects in the scene. 
-            // The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            return loadTexture(image.uri.c_str(), typeName);
         }
 
-        // After we've processed all of the meshes (if any) we then recursively process each of the children nodes.
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        string name = "#image" + std::to_string(index);
+        Texture texture;
+        texture.resource = SharedTextures().Acquire(TextureResourceKey(path + name, gammaCorrection), [&]()
+        {
+            const GltfBufferView& view = asset.bufferViews[image.bufferView];
+            DecodedTexture decoded;
+            if(!DecodeTextureMemory(asset.binary + view.byteOffset, view.byteLength, decoded))
+            {
+                std::cout << "Texture failed to load at path: " << path << name << std::endl;
+            }
+            return ShareDecodedTexture(decoded, gammaCorrection);
+        });
+        texture.id = texture.resource->ID();
+        texture.type = typeName;
+        texture.path = name;
+        keepTexture(texture);
+        return texture;
+    }
+
+    // Creates the GL objects of a model that has been read.
+    void upload(const ModelData& data)
+    {
+        directory = data.directory;
+        materialLayout = data.materialLayout;
+        resourceKey = ModelResourceKey(data.path, gammaCorrection);
+        for(const ModelTexture& texture : data.textures)
+        {
+            uploadTexture(texture);
+        }
+        for(unsigned int i = 0; i < data.meshes.size(); i++)
         {
-            processNode(node->mChildren[i], scene);
+            uploadMesh(data.meshes[i]);
         }
+        computeLodErrors();
+        buildNodes(data.nodes, data.meshes.size());
+    }
 
+    // Creates a texture that was decoded ahead of time, unless any model has already loaded it. It's recorded as
+    // loaded, so uploading the meshes that use it finds it rather than reading it again.
+    void uploadTexture(const ModelTexture& decoded)
+    {
+        Texture texture;
+        texture.resource = SharedTextures().Acquire(TextureResourceKey(directory + '/' + decoded.reference.path, gammaCorrection), [&]()
+        {
+            return ShareDecodedTexture(decoded.decoded, gammaCorrection);
+        });
+        texture.id = texture.resource->ID();
+        texture.type = decoded.reference.type;
+        texture.path = decoded.reference.path;
+        textures_loaded.push_back(texture);
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // Creates one mesh's buffers, loading its material textures unless they're loaded already. The vertex and index
+    // data is uploaded straight from wherever the mesh was read into, unless another model loaded from the same file
+    // with the same options still holds the mesh's buffers, in which case they're shared.
+    void uploadMesh(const CookedMesh& mesh)
     {
-        // Data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
         vector<Texture> textures;
+        for(unsigned int t = 0; t < mesh.textures.size(); t++)
+        {
+            textures.push_back(loadTexture(mesh.textures[t].path.c_str(), mesh.textures[t].type));
+        }
 
-        // Walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        std::shared_ptr<GpuMeshBuffers> buffers = SharedMeshBuffers().Acquire(resourceKey + "#" + std::to_string(meshes.size()), [&]()
         {
-            Vertex vertex;
-            // Declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            glm::vec3 vector;
-
-            // Positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-
-            // Normals
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-
-            // Texture coordinates.
-            if(mesh->mTextureCoords[0]) // Does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
+            return Mesh::UploadBuffers(static_cast<const Vertex*>(mesh.vertices), mesh.vertexCount, mesh.indices, mesh.indexCount, mesh.meshletCount);
+        });
+        meshes.push_back(Mesh(buffers, mesh.indexCount, textures, vector<Meshlet>(mesh.meshlets, mesh.meshlets + mesh.meshletCount),
+                              vector<MeshLod>(mesh.lods, mesh.lods + mesh.lodCount)));
+    }
+
+    // Takes the node hierarchy the model was read with. A model without one is drawn by a single root node.
+    void buildNodes(const vector<SceneNodeSource>& sourceNodes, size_t meshCount)
+    {
+        if(sourceNodes.empty())
+        {
+            nodes.Build(vector<SceneNodeSource>(1, { -1, 0, ( uint32_t) meshCount, 0, glm::mat4(1.0f) }));
+            return;
+        }
+        nodes.Build(sourceNodes);
+    }
 
-                // A vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+    // Gathers the error of each level of the whole model from its meshes.
+    void computeLodErrors()
+    {
+        lodErrors.clear();
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            lodErrors.resize(std::max(lodErrors.size(), meshes[i].lods.size()), 0.0f);
+        }
+        for(unsigned int lod = 0; lod < lodErrors.size(); lod++)
+        {
+            for(unsigned int i = 0; i < meshes.size(); i++)
+            {
+                const vector<MeshLod>& lods = meshes[i].lods;
+                lodErrors[lod] = std::max(lodErrors[lod], lods[std::min(lod, ( unsigned int) lods.size() - 1)].error);
             }
-            else
+        }
+    }
+
+    // Loads the texture at the given path relative to the model, unless any model has already loaded it, under this
+    // path or, when its contents are the same, another.
+    Texture loadTexture(const char* path, string const& typeName)
+    {
+        // Textures are shared process wide through the registry, so one loaded by any model is reused.
+        Texture texture;
+        texture.resource = SharedTextures().Acquire(TextureResourceKey(directory + '/' + path, gammaCorrection), [&]()
+        {
+            DecodedTexture decoded;
+            if(!DecodeTexture(directory + '/' + path, decoded))
             {
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                std::cout << "Texture failed to load at path: " << path << std::endl;
             }
+            return ShareDecodedTexture(decoded, gammaCorrection);
+        });
+        texture.id = texture.resource->ID();
+        texture.type = typeName;
+        texture.path = path;
+
+        keepTexture(texture);
+        return texture;
+    }
 
-            // Tangent.
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            
-            // Bitangent.
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
-            vertices.push_back(vertex);
+    // Records each texture the model holds once.
+    void keepTexture(const Texture& texture)
+    {
+        if(std::none_of(textures_loaded.begin(), textures_loaded.end(), [&](const Texture& loaded) { return loaded.resource == texture.resource; }))
+        {
+            textures_loaded.push_back(texture);
         }
+    }
+};
 
-        // Now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+///
+/// Gathers the material textures of any number of models into shared array textures, see TextureArrayPacker, so their
+/// meshes draw with an array shader and bind each class of texture once rather than once a mesh. A mesh with two
+/// textures of one class keeps the first. Meshes are left binding their own textures if the context can't batch.
+/// \param models - the models to batch together. Models that are already batched are batched again.
+/// \return - false if the context can't copy between textures.
+///
+inline bool BatchModelTextures(const vector<Model*>& models)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    TextureArrayPacker packer;
+    vector<vector<size_t>> indices;
+    for(Model* model : models)
+    {
+        for(Mesh& mesh : model->meshes)
         {
-            aiFace face = mesh->mFaces[i];
-            
-            // Retrieve all indices of the face and store them in the indices vector.
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            indices.push_back(vector<size_t>(MATERIAL_CLASS_COUNT, SIZE_MAX));
+            for(const Texture& texture : mesh.textures)
+            {
+                int materialClass = MaterialClass(texture.type);
+                if(materialClass >= 0 && indices.back()[materialClass] == SIZE_MAX)
+                {
+                    indices.back()[materialClass] = packer.Add(texture.id);
+                }
+            }
         }
-
-        // Process materials.
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        
-        // Assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps.
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps.
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps.
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps.
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-        // Return a mesh object created from the extracted mesh data.
-        return Mesh(vertices, indices, textures);
+    }
+    if(!packer.Build())
+    {
+        cout << "ERROR::MODEL:: texture arrays need OpenGL 4.3, meshes bind their own textures" << endl;
+        return false;
     }
 
-    // Checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // The required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    size_t next = 0;
+    for(Model* model : models)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        for(Mesh& mesh : model->meshes)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-
-            // Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture.
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            const vector<size_t>& meshIndices = indices[next++];
+            mesh.material = MaterialLayers();
+            mesh.material.batched = true;
+            for(int c = 0; c < MATERIAL_CLASS_COUNT; c++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                if(meshIndices[c] != SIZE_MAX)
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // A texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    mesh.material.slots[c] = packer.Slot(meshIndices[c]);
                 }
             }
-            if(!skip)
-            {   
-                // If texture hasn't been loaded already, load it.
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // Store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
         }
-        return textures;
     }
-};
+    cout << "MODEL::BATCH:: " << models.size() << " models, " << next << " meshes: textures in " << packer.ArrayCount() << " arrays, "
+         << packer.AtlasTileCount() << " packed into atlas pages, " << packer.Bytes() / 1024 << " KB, in " << MillisecondsSince(start) << " ms" << endl;
+    return true;
+}
+
+///
+/// The process wide model registry, keyed by ModelResourceKey.
+///
+inline ResourceCache<Model>& SharedModels()
+{
+    static ResourceCache<Model> models;
+    return models;
+}
+
+///
+/// Loads a model once for any number of users. Every handle to the same file with the same options shares one copy
+/// of the model and its GPU memory, which is freed when the last handle is dropped.
+/// \param path - the model file.
+/// \param gamma - whether the model's textures are gamma corrected.
+/// \return - the shared model. Check its meshes to see whether it loaded.
+///
+inline std::shared_ptr<Model> LoadSharedModel(const string& path, bool gamma = false)
+{
+    return SharedModels().Acquire(ModelResourceKey(path, gamma), [&]() { return std::make_shared<Model>(path, gamma); });
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,452 @@
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include <AtomicFile/atomicfile.h>
+#include <FileMapping/filemapping.h>
+#include <Hash/hash.h>
+#include <MeshCodec/meshcodec.h>
+#include <Meshlet/meshlet.h>
+#include <SceneGraph/scenegraph.h>
+#include <Simplifier/simplifier.h>
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Cooked model files start with "CMDL" followed by the format version. Bump the version whenever the layout or
+// anything in the import pipeline that shapes the cooked data changes, so stale caches are rebuilt rather than loaded.
+const uint32_t COOKED_MODEL_MAGIC = 0x4C444D43;
+const uint32_t COOKED_MODEL_VERSION = 5;
+
+// The vertex and index blobs are stored with the mesh codec, see MeshCodec, and decoded on reading rather than used
+// from the mapping. Worth it where reading is slower than decoding, such as for shipped asset packs.
+const uint32_t COOKED_MODEL_FLAG_ENCODED_MESHES = 1;
+
+// Encoded meshes claiming to decode to more than this many times the file's size are treated as damaged, so a bad
+// file can't ask for an absurd allocation. Real meshes come nowhere near it.
+const uint64_t COOKED_MODEL_MAX_DECODED_RATIO = 1024;
+
+// Every blob starts on this boundary so it can be handed straight to glBufferData from the mapping.
+const uint64_t COOKED_MODEL_ALIGNMENT = 16;
+
+// Extension appended to the source path to name its cache.
+const char* const COOKED_MODEL_EXTENSION = ".cooked";
+
+///
+/// File header. All offsets are from the start of the file.
+///
+struct CookedModelHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;           // See CookedModelKey.
+    uint64_t fileSize;
+    uint32_t meshCount;     // CookedMeshEntry table follows the header.
+    uint32_t textureCount;  // CookedTextureEntry table follows the mesh table.
+    uint32_t stringBytes;   // Texture types and paths follow the texture table.
+    uint32_t nodeCount;     // SceneNodeSource table follows the strings, on the blob alignment.
+    uint32_t flags;         // COOKED_MODEL_FLAG_ENCODED_MESHES if applicable.
+    uint32_t reserved;
+};
+
+///
+/// One mesh's blobs.
+///
+struct CookedMeshEntry
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t meshletOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t lodCount;
+    uint32_t firstTexture;  // Range of the texture table used by this mesh.
+    uint32_t textureCount;
+    uint64_t vertexStoredSize;  // Size of the blobs as stored, which differs from their size when they're encoded.
+    uint64_t indexStoredSize;
+};
+
+///
+/// A texture reference, as offsets into the string block.
+///
+struct CookedTextureEntry
+{
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+///
+/// Material texture as stored in the cache: its sampler type and its path relative to the model.
+///
+struct CookedTextureReference
+{
+    std::string type;
+    std::string path;
+};
+
+///
+/// A mesh's data, either pointing into the vectors of a freshly imported mesh (for writing) or straight into the
+/// mapped cache file (after reading).
+///
+struct CookedMesh
+{
+    const void* vertices;
+    uint32_t vertexCount;
+    const unsigned int* indices;
+    uint32_t indexCount;
+    const Meshlet* meshlets;
+    uint32_t meshletCount;
+    const MeshLod* lods;
+    uint32_t lodCount;
+    std::vector<CookedTextureReference> textures;
+};
+
+///
+/// Builds the key a cache is stored under from everything that determines its contents: the source file's bytes,
+/// the import flags, the format version and the sizes of the stored structures.
+/// \param source - the mapped source model file.
+/// \param importFlags - the assimp post processing flags the model is imported with.
+/// \param vertexStride - size of one vertex.
+///
+inline uint64_t CookedModelKey(const FileMapping& source, unsigned int importFlags, uint32_t vertexStride)
+{
+    uint32_t layout[5] = { importFlags, COOKED_MODEL_VERSION, vertexStride, ( uint32_t) sizeof(Meshlet), ( uint32_t) sizeof(MeshLod) };
+    uint64_t hash = HashBytes(source.Data(), source.Size());
+    return HashBytes(layout, sizeof(layout), hash);
+}
+
+///
+/// Rounds an offset up to the blob alignment.
+///
+inline uint64_t AlignCookedOffset(uint64_t offset)
+{
+    return (offset + COOKED_MODEL_ALIGNMENT - 1) & ~(COOKED_MODEL_ALIGNMENT - 1);
+}
+
+///
+/// Writes a cooked model to a stream.
+/// \param file - the stream, written from its current position.
+/// \param key - see CookedModelKey.
+/// \param vertexStride - size of one vertex.
+/// \param meshes - the meshes to store.
+/// \param nodes - the model's node hierarchy, see SceneNodeSource.
+/// \param encodeMeshes - store the vertices and indices with the mesh codec, see COOKED_MODEL_FLAG_ENCODED_MESHES.
+/// \return - true on success.
+///
+inline bool WriteCookedModel(std::ostream& file, uint64_t key, uint32_t vertexStride, const std::vector<CookedMesh>& meshes,
+                             const std::vector<SceneNodeSource>& nodes, bool encodeMeshes)
+{
+    CookedModelHeader header = {};
+    header.magic = COOKED_MODEL_MAGIC;
+    header.version = COOKED_MODEL_VERSION;
+    header.key = key;
+    header.meshCount = ( uint32_t) meshes.size();
+    header.flags = encodeMeshes ? COOKED_MODEL_FLAG_ENCODED_MESHES : 0;
+
+    // Encoded blobs are needed up front for their sizes.
+    std::vector<std::vector<unsigned char>> encodedVertices(encodeMeshes ? meshes.size() : 0);
+    std::vector<std::vector<unsigned char>> encodedIndices(encodeMeshes ? meshes.size() : 0);
+    for(size_t i = 0; i < encodedVertices.size(); i++)
+    {
+        if(!EncodeVertexBuffer(meshes[i].vertices, meshes[i].vertexCount, vertexStride, encodedVertices[i]))
+        {
+            return false;
+        }
+        EncodeIndexBuffer(meshes[i].indices, meshes[i].indexCount, encodedIndices[i]);
+    }
+
+    // Tables and strings.
+    std::vector<CookedMeshEntry> meshEntries(meshes.size());
+    std::vector<CookedTextureEntry> textureEntries;
+    std::string strings;
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        meshEntries[i].firstTexture = ( uint32_t) textureEntries.size();
+        meshEntries[i].textureCount = ( uint32_t) meshes[i].textures.size();
+        for(const CookedTextureReference& texture : meshes[i].textures)
+        {
+            CookedTextureEntry entry;
+            entry.typeOffset = ( uint32_t) strings.size();
+            entry.typeLength = ( uint32_t) texture.type.size();
+            strings += texture.type;
+            entry.pathOffset = ( uint32_t) strings.size();
+            entry.pathLength = ( uint32_t) texture.path.size();
+            strings += texture.path;
+            textureEntries.push_back(entry);
+        }
+    }
+    header.textureCount = ( uint32_t) textureEntries.size();
+    header.stringBytes = ( uint32_t) strings.size();
+    header.nodeCount = ( uint32_t) nodes.size();
+
+    // Blob layout.
+    const uint64_t nodeOffset = AlignCookedOffset(sizeof(CookedModelHeader) + meshEntries.size() * sizeof(CookedMeshEntry)
+                                                  + textureEntries.size() * sizeof(CookedTextureEntry) + strings.size());
+    uint64_t offset = nodeOffset + nodes.size() * sizeof(SceneNodeSource);
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        CookedMeshEntry& entry = meshEntries[i];
+        entry.vertexCount = meshes[i].vertexCount;
+        entry.indexCount = meshes[i].indexCount;
+        entry.meshletCount = meshes[i].meshletCount;
+        entry.lodCount = meshes[i].lodCount;
+        entry.vertexStoredSize = encodeMeshes ? encodedVertices[i].size() : ( uint64_t) entry.vertexCount * vertexStride;
+        entry.indexStoredSize = encodeMeshes ? encodedIndices[i].size() : ( uint64_t) entry.indexCount * sizeof(unsigned int);
+
+        entry.vertexOffset = offset = AlignCookedOffset(offset);
+        offset += entry.vertexStoredSize;
+        entry.indexOffset = offset = AlignCookedOffset(offset);
+        offset += entry.indexStoredSize;
+        entry.meshletOffset = offset = AlignCookedOffset(offset);
+        offset += ( uint64_t) entry.meshletCount * sizeof(Meshlet);
+        entry.lodOffset = offset = AlignCookedOffset(offset);
+        offset += ( uint64_t) entry.lodCount * sizeof(MeshLod);
+    }
+    header.fileSize = offset;
+
+    uint64_t written = 0;
+    auto write = [&](const void* data, uint64_t size)
+    {
+        file.write(static_cast<const char*>(data), ( std::streamsize) size);
+        written += size;
+    };
+    auto pad = [&](uint64_t target)
+    {
+        const char zeros[COOKED_MODEL_ALIGNMENT] = {};
+        write(zeros, target - written);
+    };
+
+    write(&header, sizeof(header));
+    write(meshEntries.data(), meshEntries.size() * sizeof(CookedMeshEntry));
+    write(textureEntries.data(), textureEntries.size() * sizeof(CookedTextureEntry));
+    write(strings.data(), strings.size());
+    pad(nodeOffset);
+    write(nodes.data(), nodes.size() * sizeof(SceneNodeSource));
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        const CookedMeshEntry& entry = meshEntries[i];
+        pad(entry.vertexOffset);
+        write(encodeMeshes ? encodedVertices[i].data() : meshes[i].vertices, entry.vertexStoredSize);
+        pad(entry.indexOffset);
+        write(encodeMeshes ? static_cast<const void*>(encodedIndices[i].data()) : meshes[i].indices, entry.indexStoredSize);
+        pad(entry.meshletOffset);
+        write(meshes[i].meshlets, ( uint64_t) entry.meshletCount * sizeof(Meshlet));
+        pad(entry.lodOffset);
+        write(meshes[i].lods, ( uint64_t) entry.lodCount * sizeof(MeshLod));
+    }
+    return static_cast<bool>(file);
+}
+
+///
+/// Writes a cooked model's file, see WriteFileAtomically.
+/// \param cachePath - the file to write.
+/// \param key - see CookedModelKey.
+/// \param vertexStride - size of one vertex.
+/// \param meshes - the meshes to store.
+/// \param nodes - the model's node hierarchy, see SceneNodeSource.
+/// \param encodeMeshes - store the vertices and indices with the mesh codec, see COOKED_MODEL_FLAG_ENCODED_MESHES.
+/// \return - true on success.
+///
+inline bool WriteCookedModel(const std::string& cachePath, uint64_t key, uint32_t vertexStride, const std::vector<CookedMesh>& meshes,
+                             const std::vector<SceneNodeSource>& nodes, bool encodeMeshes = false)
+{
+    std::ostringstream cooked;
+    if(!WriteCookedModel(cooked, key, vertexStride, meshes, nodes, encodeMeshes))
+    {
+        return false;
+    }
+    const std::string bytes = cooked.str();
+    return WriteFileAtomically(cachePath, { { bytes.data(), bytes.size() } });
+}
+
+///
+/// Returns the key a cooked model was written with, or 0 if the data isn't a cooked model of this version.
+/// For cooked models that are trusted without their source, such as those an asset pack was built with.
+///
+inline uint64_t CookedModelKeyOf(const unsigned char* base, uint64_t size)
+{
+    CookedModelHeader header;
+    if(size < sizeof(header))
+    {
+        return 0;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    return header.magic == COOKED_MODEL_MAGIC && header.version == COOKED_MODEL_VERSION ? header.key : 0;
+}
+
+///
+/// Reads a cooked model from memory. The returned meshes point straight into that memory, so it must stay valid
+/// for as long as they're used. Encoded vertices and indices are decoded into the given storage instead, which must
+/// then stay valid too.
+/// \param base - the cooked model, aligned to COOKED_MODEL_ALIGNMENT.
+/// \param size - size of the cooked model.
+/// \param key - the key the cache must have been written with, see CookedModelKey.
+/// \param vertexStride - size of one vertex.
+/// \param meshes - filled with the meshes.
+/// \param nodes - filled with the node hierarchy.
+/// \param decoded - receives the vertices and indices of a cooked model with encoded meshes.
+/// \return - false if the cache is stale, from another version or damaged.
+///
+inline bool ReadCookedModel(const unsigned char* base, uint64_t size, uint64_t key, uint32_t vertexStride, std::vector<CookedMesh>& meshes,
+                            std::vector<SceneNodeSource>& nodes, std::vector<unsigned char>& decoded)
+{
+    meshes.clear();
+    nodes.clear();
+    if(size < sizeof(CookedModelHeader))
+    {
+        return false;
+    }
+
+    CookedModelHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if(header.magic != COOKED_MODEL_MAGIC || header.version != COOKED_MODEL_VERSION || header.key != key || header.fileSize != size
+       || (header.flags & ~COOKED_MODEL_FLAG_ENCODED_MESHES) != 0)
+    {
+        return false;
+    }
+    const bool encoded = (header.flags & COOKED_MODEL_FLAG_ENCODED_MESHES) != 0;
+
+    uint64_t meshTable = sizeof(CookedModelHeader);
+    uint64_t textureTable = meshTable + ( uint64_t) header.meshCount * sizeof(CookedMeshEntry);
+    uint64_t stringBlock = textureTable + ( uint64_t) header.textureCount * sizeof(CookedTextureEntry);
+    if(stringBlock + header.stringBytes > size)
+    {
+        return false;
+    }
+    const CookedMeshEntry* meshEntries = reinterpret_cast<const CookedMeshEntry*>(base + meshTable);
+    const CookedTextureEntry* textureEntries = reinterpret_cast<const CookedTextureEntry*>(base + textureTable);
+    const char* strings = reinterpret_cast<const char*>(base + stringBlock);
+
+    auto inFile = [&](uint64_t offset, uint64_t count, uint64_t stride)
+    {
+        return offset % COOKED_MODEL_ALIGNMENT == 0 && offset <= size && count * stride <= size - offset;
+    };
+
+    // Nodes must be depth first and only refer to meshes of the model.
+    uint64_t nodeOffset = AlignCookedOffset(stringBlock + header.stringBytes);
+    if(!inFile(nodeOffset, header.nodeCount, sizeof(SceneNodeSource)))
+    {
+        return false;
+    }
+    nodes.resize(header.nodeCount);
+    std::memcpy(nodes.data(), base + nodeOffset, nodes.size() * sizeof(SceneNodeSource));
+    for(uint32_t i = 0; i < header.nodeCount; i++)
+    {
+        if(nodes[i].parent >= ( int32_t) i || (i > 0 && nodes[i].parent < 0) || ( uint64_t) nodes[i].firstMesh + nodes[i].meshCount > header.meshCount)
+        {
+            nodes.clear();
+            return false;
+        }
+    }
+
+    // Decoded meshes are laid out in one allocation, on the blob alignment like the file's.
+    std::vector<uint64_t> decodedOffsets(encoded ? header.meshCount : 0);
+    uint64_t decodedSize = 0;
+    for(uint32_t i = 0; i < decodedOffsets.size(); i++)
+    {
+        decodedOffsets[i] = decodedSize;
+        decodedSize = AlignCookedOffset(decodedSize + ( uint64_t) meshEntries[i].vertexCount * vertexStride);
+        decodedSize = AlignCookedOffset(decodedSize + ( uint64_t) meshEntries[i].indexCount * sizeof(unsigned int));
+    }
+    if(decodedSize > size * COOKED_MODEL_MAX_DECODED_RATIO)
+    {
+        nodes.clear();
+        return false;
+    }
+    decoded.resize(( size_t) decodedSize);
+    std::vector<unsigned char> scratch;
+
+    meshes.resize(header.meshCount);
+    for(uint32_t i = 0; i < header.meshCount; i++)
+    {
+        const CookedMeshEntry& entry = meshEntries[i];
+        if(!inFile(entry.vertexOffset, entry.vertexStoredSize, 1) || !inFile(entry.indexOffset, entry.indexStoredSize, 1)
+           || (!encoded && (entry.vertexStoredSize != ( uint64_t) entry.vertexCount * vertexStride
+                            || entry.indexStoredSize != ( uint64_t) entry.indexCount * sizeof(unsigned int)))
+           || !inFile(entry.meshletOffset, entry.meshletCount, sizeof(Meshlet)) || !inFile(entry.lodOffset, entry.lodCount, sizeof(MeshLod))
+           || ( uint64_t) entry.firstTexture + entry.textureCount > header.textureCount)
+        {
+            meshes.clear();
+            nodes.clear();
+            return false;
+        }
+
+        CookedMesh& mesh = meshes[i];
+        mesh.vertices = base + entry.vertexOffset;
+        mesh.vertexCount = entry.vertexCount;
+        mesh.indices = reinterpret_cast<const unsigned int*>(base + entry.indexOffset);
+        mesh.indexCount = entry.indexCount;
+        if(encoded)
+        {
+            unsigned char* vertices = decoded.data() + decodedOffsets[i];
+            unsigned int* indices = reinterpret_cast<unsigned int*>(vertices + AlignCookedOffset(( uint64_t) entry.vertexCount * vertexStride));
+            if(!DecodeVertexBuffer(base + entry.vertexOffset, ( size_t) entry.vertexStoredSize, entry.vertexCount, vertexStride, vertices, scratch)
+               || !DecodeIndexBuffer(base + entry.indexOffset, ( size_t) entry.indexStoredSize, entry.indexCount, entry.vertexCount, indices, scratch))
+            {
+                meshes.clear();
+                nodes.clear();
+                return false;
+            }
+            mesh.vertices = vertices;
+            mesh.indices = indices;
+        }
+        mesh.meshlets = reinterpret_cast<const Meshlet*>(base + entry.meshletOffset);
+        mesh.meshletCount = entry.meshletCount;
+        mesh.lods = reinterpret_cast<const MeshLod*>(base + entry.lodOffset);
+        mesh.lodCount = entry.lodCount;
+
+        // What passed the size checks can still be damaged or stale inside: every mesh has at least its full
+        // resolution level, and levels, clusters and indices must stay within the mesh, or the draws read past its
+        // buffers. The codec already checks the indices it decodes.
+        bool valid = mesh.lodCount > 0;
+        for(uint32_t l = 0; valid && l < mesh.lodCount; l++)
+        {
+            valid = ( uint64_t) mesh.lods[l].indexOffset + mesh.lods[l].indexCount <= mesh.indexCount;
+        }
+        for(uint32_t m = 0; valid && m < mesh.meshletCount; m++)
+        {
+            valid = ( uint64_t) mesh.meshlets[m].indexOffset + mesh.meshlets[m].indexCount <= mesh.indexCount;
+        }
+        for(uint32_t x = 0; valid && !encoded && x < mesh.indexCount; x++)
+        {
+            valid = mesh.indices[x] < mesh.vertexCount;
+        }
+        if(!valid)
+        {
+            meshes.clear();
+            nodes.clear();
+            return false;
+        }
+
+        for(uint32_t t = entry.firstTexture; t < entry.firstTexture + entry.textureCount; t++)
+        {
+            const CookedTextureEntry& texture = textureEntries[t];
+            if(( uint64_t) texture.typeOffset + texture.typeLength > header.stringBytes || ( uint64_t) texture.pathOffset + texture.pathLength > header.stringBytes)
+            {
+                meshes.clear();
+                nodes.clear();
+                return false;
+            }
+            mesh.textures.push_back({ std::string(strings + texture.typeOffset, texture.typeLength), std::string(strings + texture.pathOffset, texture.pathLength) });
+        }
+    }
+    return true;
+}
+
+///
+/// Reads a cooked model from its mapping, which must stay open for as long as the meshes are used.
+///
+inline bool ReadCookedModel(const FileMapping& mapping, uint64_t key, uint32_t vertexStride, std::vector<CookedMesh>& meshes,
+                            std::vector<SceneNodeSource>& nodes, std::vector<unsigned char>& decoded)
+{
+    return ReadCookedModel(mapping.Data(), mapping.Size(), key, vertexStride, meshes, nodes, decoded);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,612 @@
+#ifndef MODELDATA_H
+#define MODELDATA_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <FileMapping/filemapping.h>
+#include <MaterialPacking/materialpacking.h>
+#include <Meshlet/meshlet.h>
+#include <MeshOptimiser/meshoptimiser.h>
+#include <ModelCache/modelcache.h>
+#include <ObjLoader/objloader.h>
+#include <SceneGraph/scenegraph.h>
+#include <TextureData/texturedata.h>
+#include <Simplifier/simplifier.h>
+#include <TangentSpace/tangentspace.h>
+#include <Threading/parallel.h>
+#include <VirtualFileSystem/virtualfilesystem.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Everything about loading a model that happens before GL is involved: importing or reading the cooked model,
+// optimising it and decoding its textures. None of it needs a context, so models can be loaded on any thread, many
+// at once, or in tools and tests with no display at all. Model then uploads the result on the context's thread.
+
+// Stores per vertex data.
+struct Vertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+// Post processing asked of ASSIMP. Part of the cache key, so changing it invalidates cooked models.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+// CPU side mesh data gathered from the importer, kept until it has been optimised and uploaded to the GPU.
+struct MeshSource
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<CookedTextureReference> textures;    // Material textures, loaded when the mesh is uploaded.
+    vector<Meshlet> meshlets;
+    vector<MeshLod> lods;
+    bool needsTangents = false; // Material has a normal or height map but the file had no tangents.
+};
+
+// One of a model's textures, decoded ahead of the upload.
+struct ModelTexture
+{
+    CookedTextureReference reference;
+    DecodedTexture decoded;
+};
+
+// A model read into memory and ready to upload. The meshes point into whichever of the other members the model was
+// read into: a mapped cooked model, a cooked model decompressed from an asset pack, the decoded meshes of a cooked
+// model stored with the mesh codec or freshly imported meshes. Packed cooked models that aren't compressed are used
+// straight from the pack's mapping.
+struct ModelData
+{
+    string path;
+    string directory;
+    FileMapping mapping;
+    vector<unsigned char> unpacked;
+    vector<unsigned char> decoded;
+    vector<MeshSource> imported;
+    vector<CookedMesh> meshes;
+    vector<SceneNodeSource> nodes;
+    vector<ModelTexture> textures;  // Each texture the meshes use once, filled by DecodeModelTextures.
+    string materialLayout;          // Layout the meshes' material maps were packed with, empty if they weren't.
+};
+
+///
+/// Milliseconds elapsed since start, for the load time reports.
+///
+inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+///
+/// Prints the vertex cache efficiency of the whole model before and after optimisation.
+///
+inline void PrintOptimisationReport(string const& path, const vector<MeshOptimisationReport>& reports)
+{
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+    unsigned int degenerates = 0;
+    for(unsigned int i = 0; i < reports.size(); i++)
+    {
+        before.transformed += reports[i].before.transformed;
+        before.triangles += reports[i].before.triangles;
+        before.vertices += reports[i].before.vertices;
+        after.transformed += reports[i].after.transformed;
+        after.triangles += reports[i].after.triangles;
+        after.vertices += reports[i].after.vertices;
+        degenerates += reports[i].degenerates;
+    }
+
+    cout << "MODEL::OPTIMISE:: " << path << ": " << reports.size() << " meshes, "
+         << degenerates << " degenerate triangles removed, "
+         << "ACMR " << ( float) before.transformed / std::max(before.triangles, 1u) << " -> " << ( float) after.transformed / std::max(after.triangles, 1u) << ", "
+         << "ATVR " << ( float) before.transformed / std::max(before.vertices, 1u) << " -> " << ( float) after.transformed / std::max(after.vertices, 1u) << endl;
+}
+
+///
+/// Views of imported meshes in the form the cache stores and the upload reads.
+///
+inline vector<CookedMesh> ViewMeshSources(const vector<MeshSource>& sources)
+{
+    vector<CookedMesh> cooked(sources.size());
+    for(unsigned int i = 0; i < sources.size(); i++)
+    {
+        const MeshSource& source = sources[i];
+        cooked[i].vertices = source.vertices.data();
+        cooked[i].vertexCount = ( uint32_t) source.vertices.size();
+        cooked[i].indices = source.indices.data();
+        cooked[i].indexCount = ( uint32_t) source.indices.size();
+        cooked[i].meshlets = source.meshlets.data();
+        cooked[i].meshletCount = ( uint32_t) source.meshlets.size();
+        cooked[i].lods = source.lods.data();
+        cooked[i].lodCount = ( uint32_t) source.lods.size();
+        cooked[i].textures = source.textures;
+    }
+    return cooked;
+}
+
+///
+/// Lists all material textures of a given type. They're loaded when the mesh is uploaded.
+///
+inline vector<CookedTextureReference> AssimpMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+{
+    vector<CookedTextureReference> textures;
+    for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    {
+        aiString str;
+        mat->GetTexture(type, i, &str);
+
+        textures.push_back({ typeName, str.C_Str() });
+    }
+    return textures;
+}
+
+///
+/// Lists the textures of a mesh's material.
+///
+inline void ProcessAssimpMaterial(const aiMesh* mesh, const aiScene* scene, MeshSource& source)
+{
+    vector<CookedTextureReference>& textures = source.textures;
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    
+    // Assume a convention for sampler names in the shaders. Each diffuse texture should be named
+    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+    // Same applies to other texture as the following list summarizes:
+    // diffuse: texture_diffuseN
+    // specular: texture_specularN
+    // normal: texture_normalN
+
+    // 1. diffuse maps.
+    vector<CookedTextureReference> diffuseMaps = AssimpMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    // 2. specular maps.
+    vector<CookedTextureReference> specularMaps = AssimpMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    // 3. normal maps.
+    vector<CookedTextureReference> normalMaps = AssimpMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    // 4. height maps.
+    vector<CookedTextureReference> heightMaps = AssimpMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+
+    // Tangents are only worth generating when a map will be sampled in tangent space.
+    source.needsTangents = !mesh->HasTangentsAndBitangents() && mesh->mTextureCoords[0] && (!normalMaps.empty() || !heightMaps.empty());
+}
+
+///
+/// Fills a mesh's pre-sized vertex and index arrays from ASSIMP's mesh. Touches no GL state, so it is safe to call
+/// from any thread.
+///
+inline void ProcessAssimpMesh(const aiMesh* mesh, MeshSource& source)
+{
+    // Data to fill
+    vector<Vertex>& vertices = source.vertices;
+    vector<unsigned int>& indices = source.indices;
+
+    // Walk through each of the mesh's vertices. ASSIMP's vectors have the same layout as glm's, but are copied
+    // per component so that doesn't have to be relied on.
+    const bool hasTexCoords = mesh->mTextureCoords[0] != NULL; // Does the mesh contain texture coordinates?
+    const bool hasTangents = mesh->HasTangentsAndBitangents();
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        Vertex& vertex = vertices[i];
+
+        // Positions
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+
+        // Normals
+        vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+
+        // Texture coordinates. A vertex can contain up to 8 different texture coordinates. We thus make the assumption
+        // that we won't use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+        vertex.TexCoords = hasTexCoords ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f, 0.0f);
+
+        // Tangent and bitangent, if the file has them. Otherwise they're generated later for normal mapped materials.
+        if(hasTangents)
+        {
+            vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+            vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+        }
+        else
+        {
+            vertex.Tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+            vertex.Bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+        }
+    }
+
+    // Now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+    size_t next = 0;
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        if(face.mNumIndices == 3)
+        {
+            indices[next++] = face.mIndices[0];
+            indices[next++] = face.mIndices[1];
+            indices[next++] = face.mIndices[2];
+        }
+    }
+}
+
+///
+/// Flattens the node tree depth first into the list of nodes, keeping each node's parent and transform, and the
+/// list of meshes they reference. Each node's meshes are listed together, so a node draws one range of them.
+/// The node object only contains indices to index the actual objects in the scene. The scene contains all the
+/// data, node is just to keep stuff organized (like relations between nodes).
+///
+inline void CollectAssimpNodes(const aiNode* root, vector<SceneNodeSource>& nodes, vector<unsigned int>& meshIndices)
+{
+    vector<std::pair<const aiNode*, int32_t>> stack(1, { root, -1 });
+    while(!stack.empty())
+    {
+        const aiNode* node = stack.back().first;
+        SceneNodeSource flattened;
+        flattened.parent = stack.back().second;
+        flattened.firstMesh = ( uint32_t) meshIndices.size();
+        flattened.meshCount = node->mNumMeshes;
+        flattened.reserved = 0;
+        // ASSIMP's matrices are row major.
+        flattened.local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+        stack.pop_back();
+        nodes.push_back(flattened);
+        meshIndices.insert(meshIndices.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+        // Children are pushed in reverse so the first child is visited next.
+        for(unsigned int i = node->mNumChildren; i > 0; i--)
+        {
+            stack.push_back({ node->mChildren[i - 1], ( int32_t) nodes.size() - 1 });
+        }
+    }
+}
+
+///
+/// Converts every mesh the node tree references. The geometry of each mesh is sized up front and filled in
+/// parallel, along with the list of its material's textures.
+///
+inline void ProcessAssimpNodes(const aiScene* scene, vector<MeshSource>& sources, vector<SceneNodeSource>& nodes)
+{
+    vector<unsigned int> meshIndices;
+    nodes.clear();
+    CollectAssimpNodes(scene->mRootNode, nodes, meshIndices);
+
+    // Count the triangles of each mesh so the conversion can write straight into pre-sized storage.
+    // Points and lines left over after triangulation are dropped, everything after this expects triangle lists.
+    sources.resize(meshIndices.size());
+    for(unsigned int i = 0; i < meshIndices.size(); i++)
+    {
+        const aiMesh* mesh = scene->mMeshes[meshIndices[i]];
+        unsigned int triangles = 0;
+        for(unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            triangles += mesh->mFaces[f].mNumIndices == 3 ? 1 : 0;
+        }
+        sources[i].vertices.resize(mesh->mNumVertices);
+        sources[i].indices.resize(triangles * 3);
+    }
+
+    ParallelFor(meshIndices.size(), [&](size_t i)
+    {
+        ProcessAssimpMesh(scene->mMeshes[meshIndices[i]], sources[i]);
+        ProcessAssimpMaterial(scene->mMeshes[meshIndices[i]], scene, sources[i]);
+    });
+}
+
+///
+/// Reads an OBJ file with the native parser, which fills the vertex and index arrays directly. OBJ files have no
+/// hierarchy, so a single root node draws every mesh.
+/// Returns false if the file isn't an OBJ file or couldn't be read, leaving the import to ASSIMP.
+///
+inline bool ImportObjModel(string const& path, vector<MeshSource>& sources, vector<SceneNodeSource>& nodes)
+{
+    string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    ObjScene<Vertex> scene;
+    if(extension != "obj" || !LoadObj(path, scene, (MODEL_IMPORT_FLAGS & aiProcess_FlipUVs) != 0))
+    {
+        return false;
+    }
+
+    sources.resize(scene.meshes.size());
+    for(unsigned int i = 0; i < scene.meshes.size(); i++)
+    {
+        ObjMesh<Vertex>& mesh = scene.meshes[i];
+        sources[i].vertices.swap(mesh.vertices);
+        sources[i].indices.swap(mesh.indices);
+        if(mesh.material < 0)
+        {
+            continue;
+        }
+
+        // Same texture types as ASSIMP's OBJ importer gives processMaterial.
+        const ObjMaterial& material = scene.materials[mesh.material];
+        vector<CookedTextureReference>& textures = sources[i].textures;
+        for(const string& map : material.diffuseMaps)
+        {
+            textures.push_back({ "texture_diffuse", map });
+        }
+        for(const string& map : material.specularMaps)
+        {
+            textures.push_back({ "texture_specular", map });
+        }
+        for(const string& map : material.normalMaps)
+        {
+            textures.push_back({ "texture_normal", map });
+        }
+        for(const string& map : material.heightMaps)
+        {
+            textures.push_back({ "texture_height", map });
+        }
+        sources[i].needsTangents = mesh.hasTexCoords && (!material.normalMaps.empty() || !material.heightMaps.empty());
+    }
+    nodes.assign(1, { -1, 0, ( uint32_t) sources.size(), 0, glm::mat4(1.0f) });
+    return true;
+}
+
+///
+/// Reads a file via ASSIMP. Returns false, after reporting the error, if ASSIMP couldn't read it.
+///
+inline bool ImportAssimpModel(string const& path, vector<MeshSource>& sources, vector<SceneNodeSource>& nodes)
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+    
+    // Check for errors.
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is not Zero
+    {
+        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        return false;
+    }
+
+    // Convert every mesh referenced by ASSIMP's node tree, keeping the tree itself.
+    ProcessAssimpNodes(scene, sources, nodes);
+    return true;
+}
+
+///
+/// Reads a cooked model from an asset pack. The pack was built from the source, so the cooked model is used with
+/// whatever key it was written with and the source file isn't needed at all.
+///
+inline bool ReadPackedModelData(const AssetPack& pack, const AssetPackEntry& entry, ModelData& data)
+{
+    const unsigned char* stored = pack.Stored(entry);
+    if(entry.flags & ASSET_FLAG_LZ4)
+    {
+        if(!pack.Read(entry, data.unpacked))
+        {
+            return false;
+        }
+        stored = data.unpacked.data();
+    }
+    return ReadCookedModel(stored, entry.size, CookedModelKeyOf(stored, entry.size), sizeof(Vertex), data.meshes, data.nodes, data.decoded);
+}
+
+///
+/// Reads a model's meshes with the material references the file declares, before any packing of their maps is
+/// applied. LoadModelData is this and the packing; the MaterialPacker tool reads the references as they are here.
+/// \param path - the model file.
+/// \param data - receives the model, should be empty.
+/// \return - false if the model couldn't be read.
+///
+inline bool LoadModelMeshes(string const& path, ModelData& data)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    data.path = path;
+    data.directory = path.substr(0, path.find_last_of('/'));
+
+    // A mounted asset pack holds the model already cooked.
+    string cachePath = path + COOKED_MODEL_EXTENSION;
+    const AssetPack* pack = NULL;
+    const AssetPackEntry* packed = FindPackedAsset(cachePath, &pack);
+    if(packed != NULL && ReadPackedModelData(*pack, *packed, data))
+    {
+        cout << "MODEL::CACHE:: " << path << ": read from asset pack in " << MillisecondsSince(start) << " ms" << endl;
+        return true;
+    }
+
+    // The cache is keyed by the source file's contents, so a cache of an edited model is never used.
+    uint64_t cacheKey = 0;
+    {
+        FileMapping sourceFile(path);
+        if(sourceFile.IsOpen())
+        {
+            cacheKey = CookedModelKey(sourceFile, MODEL_IMPORT_FLAGS, sizeof(Vertex));
+        }
+    }
+    if(cacheKey != 0 && data.mapping.Open(cachePath) && ReadCookedModel(data.mapping, cacheKey, sizeof(Vertex), data.meshes, data.nodes, data.decoded))
+    {
+        cout << "MODEL::CACHE:: " << path << ": warm read from " << cachePath << " in " << MillisecondsSince(start) << " ms" << endl;
+        return true;
+    }
+    data.mapping.Close();
+
+    // Convert every mesh of the file.
+    vector<MeshSource>& sources = data.imported;
+    if(!ImportObjModel(path, sources, data.nodes) && !ImportAssimpModel(path, sources, data.nodes))
+    {
+        return false;
+    }
+
+    // Generate tangents only where a normal or height map will use them. One mesh at a time, as the generator
+    // spreads each mesh across the worker threads itself.
+    for(unsigned int i = 0; i < sources.size(); i++)
+    {
+        if(sources[i].needsTangents)
+        {
+            GenerateTangents(sources[i].vertices, sources[i].indices);
+        }
+    }
+
+    // Optimise each mesh for the post-transform vertex cache, overdraw and vertex fetch, then split it into
+    // meshlets for cluster culling. Meshes are independent of each other so they are processed in parallel.
+    vector<MeshOptimisationReport> reports(sources.size());
+    ParallelFor(sources.size(), [&](size_t i)
+    {
+        MeshSource& source = sources[i];
+        reports[i] = OptimiseMesh(source.vertices, source.indices);
+
+        // Meshlet building regroups triangles, so restore the vertex fetch order afterwards.
+        source.meshlets = BuildMeshlets(source.vertices, source.indices);
+        OptimiseVertexFetch(source.indices, source.vertices);
+        reports[i].after = AnalyseVertexCache(source.indices, source.vertices.size());
+
+        // Simplified levels of detail are appended to the same index buffer.
+        source.lods = GenerateLods(source.vertices, source.indices);
+    });
+    PrintOptimisationReport(path, reports);
+
+    data.meshes = ViewMeshSources(sources);
+    bool cached = cacheKey != 0 && WriteCookedModel(cachePath, cacheKey, sizeof(Vertex), data.meshes, data.nodes);
+
+    cout << "MODEL::CACHE:: " << path << ": cold import in " << MillisecondsSince(start) << " ms, "
+         << (cached ? "cache written to " : "failed to write cache ") << cachePath << endl;
+    return true;
+}
+
+///
+/// Swaps the meshes' material references for the packed maps the MaterialPacker tool wrote for the model, if it has.
+/// \param data - a model read by LoadModelMeshes.
+/// \return - false if the model's maps haven't been packed.
+///
+inline bool ApplyModelMaterialPacking(ModelData& data)
+{
+    MaterialPacking packing;
+    if(!ReadMaterialPacking(data.path + MATERIAL_PACKING_EXTENSION, packing))
+    {
+        return false;
+    }
+    size_t before = 0;
+    size_t after = 0;
+    size_t packedMeshes = 0;
+    for(CookedMesh& mesh : data.meshes)
+    {
+        before += mesh.textures.size();
+        packedMeshes += ApplyMaterialPacking(packing, mesh.textures) > 0 ? 1 : 0;
+        after += mesh.textures.size();
+    }
+    data.materialLayout = packing.layout;
+    cout << "MODEL::PACKING:: " << data.path << ": " << packing.layout << " layout, " << packing.maps.size() << " packed maps used by "
+         << packedMeshes << " meshes, " << before << " -> " << after << " textures bound a draw" << endl;
+    return true;
+}
+
+///
+/// Reads a model into memory, doing all the work of loading it that doesn't touch GL, so it is safe to call from
+/// any thread and without a context at all. OBJ files are read by the native parser, anything else, or an OBJ it
+/// can't read, by ASSIMP. A cooked copy of the fully processed model is kept next to the source file and read instead
+/// when it's still current. Material maps the MaterialPacker tool has packed are used in place of the ones they
+/// replace. Textures are left to DecodeModelTextures.
+/// \param path - the model file.
+/// \param data - receives the model, should be empty.
+/// \return - false if the model couldn't be read.
+///
+inline bool LoadModelData(string const& path, ModelData& data)
+{
+    if(!LoadModelMeshes(path, data))
+    {
+        return false;
+    }
+    ApplyModelMaterialPacking(data);
+    return true;
+}
+
+///
+/// Decodes every texture a model's meshes use, each once, spread across the worker threads. Textures that fail are
+/// reported and left empty.
+/// \param data - a model read by LoadModelData.
+///
+inline void DecodeModelTextures(ModelData& data)
+{
+    data.textures.clear();
+    for(const CookedMesh& mesh : data.meshes)
+    {
+        for(const CookedTextureReference& reference : mesh.textures)
+        {
+            bool listed = false;
+            for(const ModelTexture& texture : data.textures)
+            {
+                listed = listed || texture.reference.path == reference.path;
+            }
+            if(!listed)
+            {
+                data.textures.push_back({ reference, DecodedTexture() });
+            }
+        }
+    }
+
+    ParallelFor(data.textures.size(), [&](size_t i)
+    {
+        const string& path = data.textures[i].reference.path;
+        if(!DecodeTexture(data.directory + '/' + path, data.textures[i].decoded))
+        {
+            cout << "Texture failed to load at path: " << path << endl;
+        }
+    });
+}
+
+///
+/// Measures a model's bounding box with its node transforms applied.
+/// \param data - a model read by LoadModelData.
+/// \param minimum - receives the box's minimum corner.
+/// \param maximum - receives the box's maximum corner.
+/// \return - false if the model has no vertices, leaving the corners at the origin.
+///
+inline bool GetModelDataBounds(const ModelData& data, glm::vec3& minimum, glm::vec3& maximum)
+{
+    SceneGraph nodes;
+    nodes.Build(data.nodes.empty() ? vector<SceneNodeSource>(1, { -1, 0, ( uint32_t) data.meshes.size(), 0, glm::mat4(1.0f) }) : data.nodes);
+
+    minimum = glm::vec3(INFINITY);
+    maximum = glm::vec3(-INFINITY);
+    for(size_t node = 0; node < nodes.NodeCount(); node++)
+    {
+        const glm::mat4& world = nodes.World(node);
+        for(uint32_t i = nodes.FirstMesh(node); i < nodes.FirstMesh(node) + nodes.MeshCount(node); i++)
+        {
+            const CookedMesh& mesh = data.meshes[i];
+            const Vertex* vertices = static_cast<const Vertex*>(mesh.vertices);
+            for(uint32_t v = 0; v < mesh.vertexCount; v++)
+            {
+                glm::vec3 position = glm::vec3(world * glm::vec4(vertices[v].Position, 1.0f));
+                minimum = glm::min(minimum, position);
+                maximum = glm::max(maximum, position);
+            }
+        }
+    }
+
+    if(minimum.x > maximum.x)
+    {
+        minimum = glm::vec3(0.0f);
+        maximum = glm::vec3(0.0f);
+        return false;
+    }
+    return true;
+}
+
+///
+/// Frees a model's CPU copy once it has been uploaded. The paths and material layout are kept.
+///
+inline void ReleaseModelData(ModelData& data)
+{
+    data.mapping.Close();
+    vector<unsigned char>().swap(data.unpacked);
+    vector<unsigned char>().swap(data.decoded);
+    vector<MeshSource>().swap(data.imported);
+    vector<CookedMesh>().swap(data.meshes);
+    vector<SceneNodeSource>().swap(data.nodes);
+    vector<ModelTexture>().swap(data.textures);
+}
+
+#endif
\ No newline at end of file
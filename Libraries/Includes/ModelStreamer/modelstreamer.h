@@ -0,0 +1,313 @@
+#ifndef MODELSTREAMER_H
+#define MODELSTREAMER_H
+
+#include <Model/model.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///
+/// A model being streamed in, returned by ModelStreamer::Load straight away.
+///
+class StreamedModel
+{
+public:
+    // The model, filled in as its meshes are uploaded. Only draw it once IsResident.
+    Model model;
+
+    StreamingState State() const
+    {
+        return state.load(std::memory_order_acquire);
+    }
+
+    bool IsResident() const
+    {
+        return State() == STREAMING_RESIDENT;
+    }
+
+    ///
+    /// Gets the model's bounding box, for drawing a placeholder in its place until it's resident.
+    /// \param minimum - receives the box's minimum corner, left as it is while the bounds aren't known yet.
+    /// \param maximum - receives the box's maximum corner, left as it is while the bounds aren't known yet.
+    /// \return - true if the bounds are known, which they are from when the model has been read.
+    ///
+    bool GetBounds(glm::vec3& minimum, glm::vec3& maximum) const
+    {
+        StreamingState current = State();
+        if(current != STREAMING_UPLOADING && current != STREAMING_RESIDENT)
+        {
+            return false;
+        }
+        minimum = boundsMinimum;
+        maximum = boundsMaximum;
+        return true;
+    }
+
+private:
+    friend class ModelStreamer;
+
+    std::string path;
+    std::atomic<StreamingState> state{ STREAMING_QUEUED };
+    glm::vec3 boundsMinimum = glm::vec3(0.0f);
+    glm::vec3 boundsMaximum = glm::vec3(0.0f);
+
+    // Read by a worker, then consumed by the uploads.
+    ModelData data;
+    size_t uploadedTextures = 0;
+    size_t uploadedMeshes = 0;
+
+    // Where the load's time went, reported once the model is resident.
+    std::chrono::high_resolution_clock::time_point queuedAt;
+    double readMilliseconds = 0.0;
+    double decodeMilliseconds = 0.0;
+    double textureUploadMilliseconds = 0.0;
+    double meshUploadMilliseconds = 0.0;
+    size_t uploadFrames = 0;
+    size_t lastUploadFrame = 0;
+};
+
+typedef std::shared_ptr<StreamedModel> ModelHandle;
+
+///
+/// Loads models without blocking the context thread. Worker threads do everything that doesn't touch GL: reading
+/// the cooked model or importing the source, and decoding the textures. The context thread then uploads the
+/// textures and meshes a few at a time in Update, within a per-frame budget, so no frame waits on a whole model.
+///
+class ModelStreamer
+{
+public:
+    ///
+    /// Starts the worker threads.
+    /// \param workerCount - number of models read at once. Each read spreads its own work across threads too.
+    ///
+    explicit ModelStreamer(unsigned int workerCount = 1)
+    {
+        for(unsigned int i = 0; i < std::max(workerCount, 1u); i++)
+        {
+            workers.push_back(std::thread(&ModelStreamer::workerLoop, this));
+        }
+    }
+
+    ///
+    /// Stops the workers once they finish the reads in progress. Models still queued are left unloaded.
+    ///
+    ~ModelStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Workers hold a pointer to the streamer.
+    ModelStreamer(const ModelStreamer&) = delete;
+    ModelStreamer& operator=(const ModelStreamer&) = delete;
+
+    ///
+    /// Queues a model for loading and returns its handle straight away.
+    /// \param path - the model file.
+    /// \return - the handle, check its state or bounds each frame.
+    ///
+    ModelHandle Load(const std::string& path)
+    {
+        ModelHandle handle = std::make_shared<StreamedModel>();
+        handle->path = path;
+        handle->queuedAt = std::chrono::high_resolution_clock::now();
+        handle->model.directory = path.substr(0, path.find_last_of('/'));
+        handle->model.resourceKey = ModelResourceKey(path, handle->model.gammaCorrection);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(handle);
+        }
+        queueChanged.notify_one();
+        return handle;
+    }
+
+    ///
+    /// Makes uploads for models that have been read, oldest first, until the budget is spent. Call once a frame
+    /// on the context's thread.
+    /// \param budget - limits on this frame's uploads.
+    ///
+    void Update(const StreamingBudget& budget = StreamingBudget())
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t bytes = 0;
+        bool uploaded = false;
+        frame++;
+        while(true)
+        {
+            ModelHandle handle;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(uploading.empty())
+                {
+                    return;
+                }
+                handle = uploading.front();
+            }
+
+            size_t itemBytes = nextUploadBytes(*handle);
+            if(uploaded && (bytes + itemBytes > budget.bytes
+                            || std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= budget.milliseconds))
+            {
+                return;
+            }
+            if(handle->lastUploadFrame != frame)
+            {
+                handle->lastUploadFrame = frame;
+                handle->uploadFrames++;
+            }
+            bool finished = uploadNext(*handle);
+            bytes += itemBytes;
+            uploaded = true;
+
+            if(finished)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                uploading.pop_front();
+            }
+        }
+    }
+
+    ///
+    /// Blocks until a model is resident or has failed, making its uploads without a budget. For tools and benchmarks
+    /// that need the model before they can start; call on the context's thread.
+    ///
+    void WaitUntilResident(const ModelHandle& handle)
+    {
+        StreamingBudget unlimited;
+        unlimited.milliseconds = INFINITY;
+        unlimited.bytes = SIZE_MAX;
+        while(handle->State() != STREAMING_RESIDENT && handle->State() != STREAMING_FAILED)
+        {
+            Update(unlimited);
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<ModelHandle> queued;     // Waiting for a worker.
+    std::deque<ModelHandle> uploading;  // Read and waiting for uploads, oldest first.
+    bool stopping = false;
+    size_t frame = 0;                   // Calls to Update, only touched on the context's thread.
+
+    // Takes queued models one at a time and reads them.
+    void workerLoop()
+    {
+        while(true)
+        {
+            ModelHandle handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [this] { return stopping || !queued.empty(); });
+                if(stopping)
+                {
+                    return;
+                }
+                handle = queued.front();
+                queued.pop_front();
+            }
+
+            handle->state.store(STREAMING_READING, std::memory_order_release);
+            if(!read(*handle))
+            {
+                handle->state.store(STREAMING_FAILED, std::memory_order_release);
+                continue;
+            }
+
+            handle->state.store(STREAMING_UPLOADING, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex);
+            uploading.push_back(handle);
+        }
+    }
+
+    // Reads a model and decodes each texture it uses once, and measures its bounds.
+    static bool read(StreamedModel& streamed)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        if(!LoadModelData(streamed.path, streamed.data))
+        {
+            return false;
+        }
+        GetModelDataBounds(streamed.data, streamed.boundsMinimum, streamed.boundsMaximum);
+        streamed.readMilliseconds = MillisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        DecodeModelTextures(streamed.data);
+        streamed.decodeMilliseconds = MillisecondsSince(start);
+        return true;
+    }
+
+    // Size of the next upload of a model, textures first as the meshes refer to them.
+    static size_t nextUploadBytes(const StreamedModel& streamed)
+    {
+        if(streamed.uploadedTextures < streamed.data.textures.size())
+        {
+            return streamed.data.textures[streamed.uploadedTextures].decoded.pixels.size();
+        }
+        if(streamed.uploadedMeshes < streamed.data.meshes.size())
+        {
+            const CookedMesh& mesh = streamed.data.meshes[streamed.uploadedMeshes];
+            return ( size_t) mesh.vertexCount * sizeof(Vertex) + ( size_t) mesh.indexCount * sizeof(unsigned int);
+        }
+        return 0;
+    }
+
+    // Makes a model's next upload. Returns true once the model is resident.
+    static bool uploadNext(StreamedModel& streamed)
+    {
+        Model& model = streamed.model;
+        ModelData& data = streamed.data;
+        auto start = std::chrono::high_resolution_clock::now();
+        if(streamed.uploadedTextures < data.textures.size())
+        {
+            ModelTexture& texture = data.textures[streamed.uploadedTextures++];
+            model.uploadTexture(texture);
+            texture.decoded = DecodedTexture();
+            streamed.textureUploadMilliseconds += MillisecondsSince(start);
+        }
+        else if(streamed.uploadedMeshes < data.meshes.size())
+        {
+            model.uploadMesh(data.meshes[streamed.uploadedMeshes++]);
+            streamed.meshUploadMilliseconds += MillisecondsSince(start);
+        }
+
+        if(streamed.uploadedTextures < data.textures.size() || streamed.uploadedMeshes < data.meshes.size())
+        {
+            return false;
+        }
+        model.computeLodErrors();
+        model.buildNodes(data.nodes, data.meshes.size());
+        model.materialLayout = data.materialLayout;
+
+        cout << "MODEL::STREAM:: " << streamed.path << ": read in " << streamed.readMilliseconds << " ms, "
+             << data.textures.size() << " textures decoded in " << streamed.decodeMilliseconds << " ms, uploaded in "
+             << streamed.textureUploadMilliseconds << " ms, meshes uploaded in " << streamed.meshUploadMilliseconds
+             << " ms, over " << streamed.uploadFrames << " frames, resident after " << MillisecondsSince(streamed.queuedAt)
+             << " ms" << endl;
+
+        // The CPU copy isn't needed any more.
+        ReleaseModelData(data);
+        streamed.state.store(STREAMING_RESIDENT, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
\ No newline at end of file
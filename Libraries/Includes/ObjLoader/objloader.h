@@ -0,0 +1,570 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <glm/glm.hpp>
+
+#include <FileMapping/filemapping.h>
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Size of the line aligned pieces an OBJ file is split into for parsing. Small enough to balance across threads,
+// large enough that the per chunk bookkeeping is negligible.
+const size_t OBJ_CHUNK_SIZE = 256 * 1024;
+
+///
+/// Texture maps of an MTL material, as paths relative to the MTL file. The map types follow ASSIMP's OBJ importer:
+/// map_Bump is the normal map and map_Ka is used as the height map.
+///
+struct ObjMaterial
+{
+    std::string name;
+    std::vector<std::string> diffuseMaps;   // map_Kd
+    std::vector<std::string> specularMaps;  // map_Ks
+    std::vector<std::string> normalMaps;    // map_Bump, bump
+    std::vector<std::string> heightMaps;    // map_Ka
+};
+
+///
+/// One mesh of an OBJ file: the faces of one object or group that share a material, with identical corners welded
+/// into shared vertices.
+///
+template <typename VertexType>
+struct ObjMesh
+{
+    std::string name;
+    int material = -1;          // Index into ObjScene::materials, -1 for none.
+    bool hasTexCoords = false;
+    std::vector<VertexType> vertices;
+    std::vector<unsigned int> indices;
+};
+
+///
+/// Everything read from an OBJ file and its material libraries.
+///
+template <typename VertexType>
+struct ObjScene
+{
+    std::vector<ObjMesh<VertexType>> meshes;
+    std::vector<ObjMaterial> materials;
+};
+
+///
+/// A face corner's 0 based position, texture coordinate and normal indices, -1 where the corner has none.
+///
+struct ObjCorner
+{
+    int position;
+    int texCoord;
+    int normal;
+
+    bool operator==(const ObjCorner& other) const
+    {
+        return position == other.position && texCoord == other.texCoord && normal == other.normal;
+    }
+};
+
+///
+/// A run of triangles within a chunk that starts at an o, g or usemtl statement. A segment only knows what its own
+/// statement changed, the rest carries on from the segments before it, possibly in an earlier chunk.
+///
+struct ObjSegment
+{
+    bool setsName;
+    std::string name;
+    bool setsMaterial;
+    std::string material;
+    size_t firstCorner;
+};
+
+///
+/// What a single chunk of the file parsed to. Faces are triangulated into corner triples.
+///
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+    size_t positionCount = 0;   // Filled by the counting pass.
+    size_t texCoordCount = 0;
+    size_t normalCount = 0;
+    size_t positionBase = 0;    // Elements of each kind before this chunk.
+    size_t texCoordBase = 0;
+    size_t normalBase = 0;
+    std::vector<ObjCorner> corners;
+    std::vector<ObjSegment> segments;
+    std::vector<std::string> materialLibraries;
+};
+
+///
+/// Small helpers working on [cursor, end) ranges of the mapped file.
+///
+inline const char* SkipObjSpaces(const char* cursor, const char* end)
+{
+    while(cursor < end && (*cursor == ' ' || *cursor == '\t'))
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+inline const char* FindObjLineEnd(const char* cursor, const char* end)
+{
+    while(cursor < end && *cursor != '\n' && *cursor != '\r')
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+inline const char* SkipObjLine(const char* cursor, const char* end)
+{
+    cursor = FindObjLineEnd(cursor, end);
+    while(cursor < end && (*cursor == '\n' || *cursor == '\r'))
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+inline float ParseObjFloat(const char*& cursor, const char* end)
+{
+    cursor = SkipObjSpaces(cursor, end);
+    if(cursor < end && *cursor == '+')
+    {
+        cursor++;
+    }
+    float value = 0.0f;
+    std::from_chars_result result = std::from_chars(cursor, end, value);
+    cursor = result.ptr;
+    return value;
+}
+
+inline std::string ParseObjName(const char* cursor, const char* end)
+{
+    cursor = SkipObjSpaces(cursor, end);
+    const char* lineEnd = FindObjLineEnd(cursor, end);
+    while(lineEnd > cursor && (lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+    {
+        lineEnd--;
+    }
+    return std::string(cursor, lineEnd);
+}
+
+///
+/// Parses one index of a face corner, turning OBJ's 1 based and negative (relative) indices into 0 based ones.
+/// \param count - number of elements of this kind defined before the current line, for relative indices.
+///
+inline int ParseObjIndex(const char*& cursor, const char* end, size_t count)
+{
+    bool negative = cursor < end && *cursor == '-';
+    if(negative)
+    {
+        cursor++;
+    }
+    int value = 0;
+    bool any = false;
+    while(cursor < end && *cursor >= '0' && *cursor <= '9')
+    {
+        value = value * 10 + (*cursor - '0');
+        cursor++;
+        any = true;
+    }
+    if(!any)
+    {
+        return -1;
+    }
+    return negative ? ( int) count - value : value - 1;
+}
+
+///
+/// Returns true if the line starting at cursor begins with the given keyword followed by a space.
+///
+inline bool IsObjKeyword(const char* cursor, const char* end, const char* keyword, size_t length)
+{
+    return ( size_t) (end - cursor) > length && std::equal(keyword, keyword + length, cursor) && (cursor[length] == ' ' || cursor[length] == '\t');
+}
+
+///
+/// Counts the vertex elements defined in a chunk, so every chunk knows where its elements start before parsing. Lines
+/// are recognised exactly as ParseObjChunk recognises them, as it writes each element into the space counted here.
+///
+inline void CountObjChunk(ObjChunk& chunk)
+{
+    for(const char* cursor = chunk.begin; cursor < chunk.end; cursor = SkipObjLine(cursor, chunk.end))
+    {
+        cursor = SkipObjSpaces(cursor, chunk.end);
+        const char* lineEnd = FindObjLineEnd(cursor, chunk.end);
+        if(IsObjKeyword(cursor, lineEnd, "v", 1))
+        {
+            chunk.positionCount++;
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "vt", 2))
+        {
+            chunk.texCoordCount++;
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "vn", 2))
+        {
+            chunk.normalCount++;
+        }
+    }
+}
+
+///
+/// Parses a chunk's elements into the shared arrays at the chunk's bases, and its faces into the chunk's corners.
+///
+inline void ParseObjChunk(ObjChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& normals)
+{
+    size_t position = chunk.positionBase;
+    size_t texCoord = chunk.texCoordBase;
+    size_t normal = chunk.normalBase;
+    std::vector<ObjCorner> polygon;
+
+    for(const char* cursor = chunk.begin; cursor < chunk.end; cursor = SkipObjLine(cursor, chunk.end))
+    {
+        cursor = SkipObjSpaces(cursor, chunk.end);
+        const char* lineEnd = FindObjLineEnd(cursor, chunk.end);
+        if(cursor == lineEnd || *cursor == '#')
+        {
+            continue;
+        }
+
+        if(IsObjKeyword(cursor, lineEnd, "v", 1))
+        {
+            cursor += 2;
+            glm::vec3& value = positions[position++];
+            value.x = ParseObjFloat(cursor, lineEnd);
+            value.y = ParseObjFloat(cursor, lineEnd);
+            value.z = ParseObjFloat(cursor, lineEnd);
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "vt", 2))
+        {
+            cursor += 3;
+            glm::vec2& value = texCoords[texCoord++];
+            value.x = ParseObjFloat(cursor, lineEnd);
+            value.y = ParseObjFloat(cursor, lineEnd);
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "vn", 2))
+        {
+            cursor += 3;
+            glm::vec3& value = normals[normal++];
+            value.x = ParseObjFloat(cursor, lineEnd);
+            value.y = ParseObjFloat(cursor, lineEnd);
+            value.z = ParseObjFloat(cursor, lineEnd);
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "f", 1))
+        {
+            cursor += 2;
+            polygon.clear();
+            while(true)
+            {
+                cursor = SkipObjSpaces(cursor, lineEnd);
+                if(cursor >= lineEnd)
+                {
+                    break;
+                }
+
+                ObjCorner corner = { ParseObjIndex(cursor, lineEnd, position), -1, -1 };
+                if(cursor < lineEnd && *cursor == '/')
+                {
+                    cursor++;
+                    corner.texCoord = ParseObjIndex(cursor, lineEnd, texCoord);
+                    if(cursor < lineEnd && *cursor == '/')
+                    {
+                        cursor++;
+                        corner.normal = ParseObjIndex(cursor, lineEnd, normal);
+                    }
+                }
+                if(corner.position < 0)
+                {
+                    break;
+                }
+                polygon.push_back(corner);
+
+                // Skip anything malformed up to the next corner.
+                while(cursor < lineEnd && *cursor != ' ' && *cursor != '\t')
+                {
+                    cursor++;
+                }
+            }
+
+            // Triangulate as a fan, the same as ASSIMP does for the convex polygons OBJ exporters write.
+            if(chunk.segments.empty())
+            {
+                chunk.segments.push_back({ false, std::string(), false, std::string(), 0 });
+            }
+            for(size_t i = 2; i < polygon.size(); i++)
+            {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "o", 1) || IsObjKeyword(cursor, lineEnd, "g", 1))
+        {
+            chunk.segments.push_back({ true, ParseObjName(cursor + 2, lineEnd), false, std::string(), chunk.corners.size() });
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "usemtl", 6))
+        {
+            chunk.segments.push_back({ false, std::string(), true, ParseObjName(cursor + 7, lineEnd), chunk.corners.size() });
+        }
+        else if(IsObjKeyword(cursor, lineEnd, "mtllib", 6))
+        {
+            chunk.materialLibraries.push_back(ParseObjName(cursor + 7, lineEnd));
+        }
+    }
+}
+
+///
+/// Reads the materials of an MTL file. MTL files are tiny so this is a plain line by line read.
+///
+inline void LoadObjMaterials(const std::string& path, std::vector<ObjMaterial>& materials)
+{
+    std::ifstream file(path);
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if(keyword == "newmtl")
+        {
+            materials.push_back(ObjMaterial());
+            materials.back().name = ParseObjName(line.data() + 6, line.data() + line.size());
+            continue;
+        }
+        if(materials.empty())
+        {
+            continue;
+        }
+
+        // Map statements may carry options before the file name, which always comes last.
+        std::string map;
+        for(std::string token; stream >> token;)
+        {
+            map = token;
+        }
+        if(map.empty())
+        {
+            continue;
+        }
+
+        ObjMaterial& material = materials.back();
+        if(keyword == "map_Kd")
+        {
+            material.diffuseMaps.push_back(map);
+        }
+        else if(keyword == "map_Ks")
+        {
+            material.specularMaps.push_back(map);
+        }
+        else if(keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump")
+        {
+            material.normalMaps.push_back(map);
+        }
+        else if(keyword == "map_Ka")
+        {
+            material.heightMaps.push_back(map);
+        }
+    }
+}
+
+///
+/// Builds a mesh's welded vertices and indices from its corners. Corners with the same position, texture
+/// coordinate and normal index share a vertex, found through an open addressing hash table.
+///
+template <typename VertexType>
+void WeldObjMesh(ObjMesh<VertexType>& mesh, const ObjCorner* corners, size_t cornerCount, const std::vector<glm::vec3>& positions,
+                 const std::vector<glm::vec2>& texCoords, const std::vector<glm::vec3>& normals, bool flipTexCoords)
+{
+    size_t tableSize = 1;
+    while(tableSize < cornerCount * 2)
+    {
+        tableSize *= 2;
+    }
+    std::vector<unsigned int> table(tableSize, ~0u);
+    std::vector<ObjCorner> unique;
+    unique.reserve(cornerCount / 2);
+
+    mesh.indices.resize(cornerCount);
+    for(size_t i = 0; i < cornerCount; i++)
+    {
+        const ObjCorner& corner = corners[i];
+        uint32_t hash = ( uint32_t) corner.position * 73856093u ^ ( uint32_t) corner.texCoord * 19349663u ^ ( uint32_t) corner.normal * 83492791u;
+        size_t slot = hash & (tableSize - 1);
+        while(table[slot] != ~0u && !(unique[table[slot]] == corner))
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if(table[slot] == ~0u)
+        {
+            table[slot] = ( unsigned int) unique.size();
+            unique.push_back(corner);
+        }
+        mesh.indices[i] = table[slot];
+    }
+
+    mesh.vertices.resize(unique.size(), VertexType());
+    for(size_t v = 0; v < unique.size(); v++)
+    {
+        const ObjCorner& corner = unique[v];
+        VertexType& vertex = mesh.vertices[v];
+        vertex.Position = ( size_t) corner.position < positions.size() ? positions[corner.position] : glm::vec3(0.0f);
+        vertex.Normal = corner.normal >= 0 && ( size_t) corner.normal < normals.size() ? normals[corner.normal] : glm::vec3(0.0f);
+        vertex.TexCoords = glm::vec2(0.0f);
+        if(corner.texCoord >= 0 && ( size_t) corner.texCoord < texCoords.size())
+        {
+            vertex.TexCoords = texCoords[corner.texCoord];
+            if(flipTexCoords)
+            {
+                vertex.TexCoords.y = 1.0f - vertex.TexCoords.y;
+            }
+            mesh.hasTexCoords = true;
+        }
+    }
+}
+
+///
+/// Loads a Wavefront OBJ file and the MTL libraries it references.
+/// The file is mapped and split into line aligned chunks that are parsed in parallel, first counting the vertex
+/// elements of each chunk so that every chunk can write straight into its own range of the shared arrays. Faces
+/// are triangulated as fans and each mesh's corners are welded into indexed vertices in parallel.
+///
+/// \param path - the OBJ file.
+/// \param scene - filled with the meshes and materials.
+/// \param flipTexCoords - flip texture coordinates vertically, the same as aiProcess_FlipUVs.
+/// \return - false if the file couldn't be read.
+///
+template <typename VertexType>
+bool LoadObj(const std::string& path, ObjScene<VertexType>& scene, bool flipTexCoords)
+{
+    scene = ObjScene<VertexType>();
+    FileMapping mapping(path);
+    if(!mapping.IsOpen())
+    {
+        return false;
+    }
+
+    // Split into chunks that end on line boundaries.
+    const char* data = reinterpret_cast<const char*>(mapping.Data());
+    const char* dataEnd = data + mapping.Size();
+    std::vector<ObjChunk> chunks;
+    for(const char* begin = data; begin < dataEnd;)
+    {
+        const char* end = begin + std::min(OBJ_CHUNK_SIZE, ( size_t) (dataEnd - begin));
+        while(end < dataEnd && end[-1] != '\n')
+        {
+            end++;
+        }
+        ObjChunk chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(chunk);
+        begin = end;
+    }
+
+    // Count, then parse every chunk into its own range of the shared element arrays.
+    ParallelFor(chunks.size(), [&](size_t i)
+    {
+        CountObjChunk(chunks[i]);
+    });
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t normalCount = 0;
+    for(ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.normalBase = normalCount;
+        positionCount += chunk.positionCount;
+        texCoordCount += chunk.texCoordCount;
+        normalCount += chunk.normalCount;
+    }
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    std::vector<glm::vec3> normals(normalCount);
+    ParallelFor(chunks.size(), [&](size_t i)
+    {
+        ParseObjChunk(chunks[i], positions, texCoords, normals);
+    });
+
+    // Materials.
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    for(const ObjChunk& chunk : chunks)
+    {
+        for(const std::string& library : chunk.materialLibraries)
+        {
+            LoadObjMaterials(directory + library, scene.materials);
+        }
+    }
+
+    // Join the chunks' segments into meshes, carrying the current object and material across segments and chunks.
+    // A segment that leaves both unchanged, such as the faces at the start of a chunk, continues the same mesh.
+    struct MeshRange
+    {
+        std::string name;
+        std::string material;
+        std::vector<std::pair<const ObjCorner*, size_t>> pieces;
+    };
+    std::vector<MeshRange> ranges;
+    std::string name;
+    std::string material;
+    for(const ObjChunk& chunk : chunks)
+    {
+        for(size_t s = 0; s < chunk.segments.size(); s++)
+        {
+            const ObjSegment& segment = chunk.segments[s];
+            name = segment.setsName ? segment.name : name;
+            material = segment.setsMaterial ? segment.material : material;
+            size_t end = s + 1 < chunk.segments.size() ? chunk.segments[s + 1].firstCorner : chunk.corners.size();
+            if(end == segment.firstCorner)
+            {
+                continue;
+            }
+            if(ranges.empty() || ranges.back().name != name || ranges.back().material != material)
+            {
+                ranges.push_back({ name, material, {} });
+            }
+            ranges.back().pieces.push_back({ chunk.corners.data() + segment.firstCorner, end - segment.firstCorner });
+        }
+    }
+
+    // Weld each mesh, resolving its material by name.
+    scene.meshes.resize(ranges.size());
+    ParallelFor(ranges.size(), [&](size_t i)
+    {
+        ObjMesh<VertexType>& mesh = scene.meshes[i];
+        mesh.name = ranges[i].name;
+        for(size_t m = 0; m < scene.materials.size(); m++)
+        {
+            if(scene.materials[m].name == ranges[i].material)
+            {
+                mesh.material = ( int) m;
+                break;
+            }
+        }
+
+        std::vector<ObjCorner> corners;
+        const ObjCorner* cornerData = ranges[i].pieces[0].first;
+        size_t cornerCount = ranges[i].pieces[0].second;
+        if(ranges[i].pieces.size() > 1)
+        {
+            for(const std::pair<const ObjCorner*, size_t>& piece : ranges[i].pieces)
+            {
+                corners.insert(corners.end(), piece.first, piece.first + piece.second);
+            }
+            cornerData = corners.data();
+            cornerCount = corners.size();
+        }
+        WeldObjMesh(mesh, cornerData, cornerCount, positions, texCoords, normals, flipTexCoords);
+    });
+    return true;
+}
+
+#endif
\ No newline at end of file
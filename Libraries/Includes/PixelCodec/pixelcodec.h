@@ -0,0 +1,238 @@
+#ifndef PIXELCODEC_H
+#define PIXELCODEC_H
+
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// SSE2 is part of every x64 target, so the vectorised decoder needs no runtime dispatch there.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_CODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Lossless coding of 8 bit images for the decoded image cache. It's meant to decode at memory speed rather than to
+// be as small as it could be: there's no entropy stage, and files come out about a quarter larger than PNG, but
+// decoding is a handful of SIMD instructions for every sixteen bytes.
+//
+// The image is cut into bands of rows. Each byte is replaced by its difference from the byte above, with the band's
+// first row kept as it is, and the difference is zigzagged so small changes either way become small numbers. The
+// bytes are then taken sixteen at a time and stored as only as many bit planes as the largest of them needs, least
+// significant plane first: a plane holds one bit of each of the sixteen bytes, the even bytes' in its low byte and
+// the odd bytes' in its high byte, so a decoder's movemask over one bit of every plane gives two neighbouring bytes.
+// The groups' plane counts, four bits each and two to a byte, lead each band. Smooth areas need two or three planes
+// where the pixels took eight.
+//
+// Bands are independent, so they're decoded alongside each other across the worker threads. Each band is stored as
+// its size in bytes, then its plane counts, then its planes.
+
+// Rows in each band. Large enough that the band sizes cost nothing, small enough that the rows a band reads back
+// while decoding are still in cache.
+const size_t PIXEL_CODEC_BAND_ROWS = 64;
+
+// Bytes taken at a time.
+const size_t PIXEL_CODEC_GROUP_BYTES = 16;
+
+///
+/// Encodes an image for DecodePixelImage.
+/// \param pixels - the pixels, rows tightly packed.
+/// \param width, height - the image's size.
+/// \param components - bytes per pixel.
+/// \param out - has the encoded image appended.
+///
+inline void EncodePixelImage(const unsigned char* pixels, int width, int height, int components, std::vector<unsigned char>& out)
+{
+    size_t rowBytes = ( size_t) width * components;
+    std::vector<unsigned char> band;
+    for(size_t bandStart = 0; bandStart < ( size_t) height; bandStart += PIXEL_CODEC_BAND_ROWS)
+    {
+        size_t bytes = std::min(PIXEL_CODEC_BAND_ROWS, ( size_t) height - bandStart) * rowBytes;
+        size_t groups = (bytes + PIXEL_CODEC_GROUP_BYTES - 1) / PIXEL_CODEC_GROUP_BYTES;
+        const unsigned char* source = pixels + bandStart * rowBytes;
+        band.assign((groups + 1) / 2, 0);
+
+        for(size_t g = 0; g < groups; g++)
+        {
+            // The last group is padded with zeros.
+            unsigned char zigzag[PIXEL_CODEC_GROUP_BYTES] = {};
+            unsigned int all = 0;
+            for(size_t i = 0; i < PIXEL_CODEC_GROUP_BYTES && g * PIXEL_CODEC_GROUP_BYTES + i < bytes; i++)
+            {
+                size_t at = g * PIXEL_CODEC_GROUP_BYTES + i;
+                int difference = ( signed char) (source[at] - (at >= rowBytes ? source[at - rowBytes] : 0));
+                zigzag[i] = ( unsigned char) (difference < 0 ? -2 * difference - 1 : 2 * difference);
+                all |= zigzag[i];
+            }
+            unsigned int planes = 0;
+            while(all >> planes)
+            {
+                planes++;
+            }
+            band[g / 2] |= ( unsigned char) (planes << (g % 2 * 4));
+            for(unsigned int p = 0; p < planes; p++)
+            {
+                unsigned int mask = 0;
+                for(size_t i = 0; i < PIXEL_CODEC_GROUP_BYTES; i++)
+                {
+                    mask |= (( unsigned int) zigzag[i] >> p & 1) << (i / 2 + i % 2 * 8);
+                }
+                band.push_back(( unsigned char) mask);
+                band.push_back(( unsigned char) (mask >> 8));
+            }
+        }
+
+        uint32_t size = ( uint32_t) band.size();
+        for(int b = 0; b < 4; b++)
+        {
+            out.push_back(( unsigned char) (size >> (b * 8)));
+        }
+        out.insert(out.end(), band.begin(), band.end());
+    }
+}
+
+///
+/// Decodes one band, undoing the filter as it goes.
+/// \return - false if the band's planes don't fill it exactly.
+///
+inline bool DecodePixelBand(const unsigned char* band, size_t size, size_t rowBytes, size_t bytes, unsigned char* pixels)
+{
+    size_t groups = (bytes + PIXEL_CODEC_GROUP_BYTES - 1) / PIXEL_CODEC_GROUP_BYTES;
+    size_t countBytes = (groups + 1) / 2;
+    if(size < countBytes)
+    {
+        return false;
+    }
+    const unsigned char* counts = band;
+    const unsigned char* planes = band + countBytes;
+    const unsigned char* end = band + size;
+
+    for(size_t g = 0; g < groups; g++)
+    {
+        unsigned int planeCount = counts[g / 2] >> (g % 2 * 4) & 0xF;
+        if(planeCount > 8 || ( size_t) (end - planes) < planeCount * 2)
+        {
+            return false;
+        }
+        size_t at = g * PIXEL_CODEC_GROUP_BYTES;
+        unsigned char* out = pixels + at;
+        unsigned char group[PIXEL_CODEC_GROUP_BYTES];
+#ifdef PIXEL_CODEC_SSE2
+        if(end - planes >= 16)
+        {
+            // Take all the group's planes at once, clear whatever follows them, and line the planes' low bytes up in
+            // the first half and their high bytes in the second.
+            const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+            __m128i stored = _mm_loadu_si128(( const __m128i*) planes);
+            stored = _mm_and_si128(stored, _mm_cmplt_epi8(lanes, _mm_set1_epi8(( char) (planeCount * 2))));
+            const __m128i lowBytes = _mm_set1_epi16(0xFF);
+            __m128i split = _mm_packus_epi16(_mm_and_si128(stored, lowBytes), _mm_srli_epi16(stored, 8));
+
+            // Bit b of every plane, moved to the top of each byte, is bytes 2b and 2b + 1 of the group.
+            __m128i zigzag = _mm_cvtsi32_si128(_mm_movemask_epi8(_mm_slli_epi16(split, 7)));
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 6)), 1);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 5)), 2);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 4)), 3);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 3)), 4);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 2)), 5);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(_mm_slli_epi16(split, 1)), 6);
+            zigzag = _mm_insert_epi16(zigzag, _mm_movemask_epi8(split), 7);
+            planes += planeCount * 2;
+
+            // (z >> 1) ^ -(z & 1), with the shift done on words and the bits it carries across bytes masked off.
+            const __m128i one = _mm_set1_epi8(1);
+            __m128i difference = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zigzag, 1), _mm_set1_epi8(0x7F)),
+                                               _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzag, one)));
+            // Groups that straddle the start of the band's second row, and the band's last, go through a copy. So does
+            // every group of rows narrower than a group, which reads bytes of the row above it that it writes itself.
+            if(rowBytes >= PIXEL_CODEC_GROUP_BYTES && at + PIXEL_CODEC_GROUP_BYTES <= bytes
+               && (at >= rowBytes || at + PIXEL_CODEC_GROUP_BYTES <= rowBytes))
+            {
+                if(at >= rowBytes)
+                {
+                    difference = _mm_add_epi8(difference, _mm_loadu_si128(( const __m128i*) (out - rowBytes)));
+                }
+                _mm_storeu_si128(( __m128i*) out, difference);
+                continue;
+            }
+            _mm_storeu_si128(( __m128i*) group, difference);
+        }
+        else
+#endif
+        {
+            std::memset(group, 0, sizeof(group));
+            for(unsigned int p = 0; p < planeCount; p++, planes += 2)
+            {
+                unsigned int mask = planes[0] | planes[1] << 8;
+                for(size_t i = 0; i < PIXEL_CODEC_GROUP_BYTES; i++)
+                {
+                    group[i] |= ( unsigned char) ((mask >> (i / 2 + i % 2 * 8) & 1) << p);
+                }
+            }
+            for(size_t i = 0; i < PIXEL_CODEC_GROUP_BYTES; i++)
+            {
+                group[i] = ( unsigned char) ((group[i] >> 1) ^ -(group[i] & 1));
+            }
+        }
+        for(size_t i = 0; i < PIXEL_CODEC_GROUP_BYTES && at + i < bytes; i++)
+        {
+            out[i] = ( unsigned char) (group[i] + (at + i >= rowBytes ? out[i - rowBytes] : 0));
+        }
+    }
+    return planes == end;
+}
+
+///
+/// Decodes an image written by EncodePixelImage, its bands across the worker threads.
+/// \param encoded - the encoded image.
+/// \param size - size of the encoded image.
+/// \param width, height, components - the image's size and bytes per pixel.
+/// \param pixels - receives the pixels, width * height * components bytes.
+/// \return - false if the data is damaged or isn't an image of this size.
+///
+inline bool DecodePixelImage(const unsigned char* encoded, size_t size, int width, int height, int components, unsigned char* pixels)
+{
+    size_t rowBytes = ( size_t) width * components;
+    size_t bandCount = (( size_t) height + PIXEL_CODEC_BAND_ROWS - 1) / PIXEL_CODEC_BAND_ROWS;
+
+    // Find every band first, then decode them alongside each other.
+    std::vector<const unsigned char*> starts(bandCount);
+    std::vector<size_t> sizes(bandCount);
+    const unsigned char* in = encoded;
+    const unsigned char* end = encoded + size;
+    for(size_t b = 0; b < bandCount; b++)
+    {
+        if(end - in < 4)
+        {
+            return false;
+        }
+        sizes[b] = ( size_t) in[0] | ( size_t) in[1] << 8 | ( size_t) in[2] << 16 | ( size_t) in[3] << 24;
+        starts[b] = in + 4;
+        if(( size_t) (end - starts[b]) < sizes[b])
+        {
+            return false;
+        }
+        in = starts[b] + sizes[b];
+    }
+    if(in != end)
+    {
+        return false;
+    }
+
+    std::atomic<bool> decoded(true);
+    ParallelFor(bandCount, [&](size_t b)
+    {
+        size_t rows = std::min(PIXEL_CODEC_BAND_ROWS, ( size_t) height - b * PIXEL_CODEC_BAND_ROWS);
+        if(!DecodePixelBand(starts[b], sizes[b], rowBytes, rows * rowBytes, pixels + b * PIXEL_CODEC_BAND_ROWS * rowBytes))
+        {
+            decoded = false;
+        }
+    });
+    return decoded;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,277 @@
+#ifndef RESOURCEREGISTRY_H
+#define RESOURCEREGISTRY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// GPU resources are owned by reference counted handles and shared process wide. A registry entry only watches its
+// resource, so a resource is freed the moment its last handle is dropped, not when the registry is. Drop handles on
+// the context's thread, as that is where the resource is deleted. Each registry counts its hits and misses.
+
+///
+/// A texture object, deleted with its last handle.
+///
+class GpuTexture
+{
+public:
+    ///
+    /// \param textureID - the texture object to own.
+    /// \param gpuBytes - the memory its levels take, for the registry's totals; 0 if unknown.
+    ///
+    explicit GpuTexture(unsigned int textureID, uint64_t gpuBytes = 0) : id(textureID), bytes(gpuBytes)
+    {
+    }
+
+    ~GpuTexture()
+    {
+        glDeleteTextures(1, &id);
+    }
+
+    // Owns the texture object.
+    GpuTexture(const GpuTexture&) = delete;
+    GpuTexture& operator=(const GpuTexture&) = delete;
+
+    unsigned int ID() const
+    {
+        return id;
+    }
+
+    uint64_t Bytes() const
+    {
+        return bytes;
+    }
+
+private:
+    unsigned int id;
+    uint64_t bytes;
+};
+
+///
+/// A buffer object, deleted with its last handle. Used where several vertex arrays read from one buffer.
+///
+class GpuBuffer
+{
+public:
+    explicit GpuBuffer(unsigned int bufferID) : id(bufferID)
+    {
+    }
+
+    ~GpuBuffer()
+    {
+        glDeleteBuffers(1, &id);
+    }
+
+    // Owns the buffer object.
+    GpuBuffer(const GpuBuffer&) = delete;
+    GpuBuffer& operator=(const GpuBuffer&) = delete;
+
+    unsigned int ID() const
+    {
+        return id;
+    }
+
+private:
+    unsigned int id;
+};
+
+///
+/// A mesh's vertex array and buffers, deleted with its last handle. Names left at 0 weren't created.
+///
+class GpuMeshBuffers
+{
+public:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int indirectBuffer = 0;
+    std::vector<std::shared_ptr<GpuBuffer>> sharedBuffers;  // Buffers the VAO reads that other meshes read too.
+
+    GpuMeshBuffers()
+    {
+    }
+
+    ~GpuMeshBuffers()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &indirectBuffer);
+    }
+
+    // Owns the GL objects.
+    GpuMeshBuffers(const GpuMeshBuffers&) = delete;
+    GpuMeshBuffers& operator=(const GpuMeshBuffers&) = delete;
+};
+
+///
+/// Memory a resource takes, for a registry's totals. Resources that don't track theirs count as nothing.
+///
+template <typename T>
+inline uint64_t ResourceBytes(const T&)
+{
+    return 0;
+}
+
+inline uint64_t ResourceBytes(const GpuTexture& texture)
+{
+    return texture.Bytes();
+}
+
+///
+/// How well a registry is doing.
+///
+struct ResourceCacheStats
+{
+    size_t hits = 0;        // Lookups that found a live resource.
+    size_t misses = 0;      // Lookups that created one.
+    size_t live = 0;        // Distinct resources with live handles. A resource under several keys counts once.
+    uint64_t bytes = 0;     // Memory the live resources take.
+    uint64_t hitBytes = 0;  // Memory hits would have taken had each made its own copy.
+};
+
+///
+/// Hands out shared handles to resources by key, creating a resource only when no handle to it is alive. Entries are
+/// weak, so the cache never keeps a resource alive itself. Safe to use from any thread.
+///
+template <typename T>
+class ResourceCache
+{
+public:
+    ///
+    /// Looks a live resource up.
+    /// \param key - the resource's key.
+    /// \return - a handle to it, or an empty one if it isn't loaded.
+    ///
+    std::shared_ptr<T> Find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entries.find(key);
+        std::shared_ptr<T> resource = entry != entries.end() ? entry->second.lock() : std::shared_ptr<T>();
+        if(resource)
+        {
+            countHit(*resource);
+        }
+        return resource;
+    }
+
+    ///
+    /// Returns the live resource for a key, creating it if there isn't one. The lock isn't held while creating, so
+    /// creating may use the cache itself; if another thread registers the key first, its resource is returned.
+    /// \param key - the resource's key.
+    /// \param create - returns a new handle to the resource, called only if it isn't loaded.
+    /// \return - a handle to the resource.
+    ///
+    template <typename Create>
+    std::shared_ptr<T> Acquire(const std::string& key, Create create)
+    {
+        std::shared_ptr<T> resource = Find(key);
+        if(resource)
+        {
+            return resource;
+        }
+
+        std::shared_ptr<T> created = create();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<T>& entry = entries[key];
+        resource = entry.lock();
+        if(resource)
+        {
+            countHit(*resource);
+            return resource;
+        }
+        entry = created;
+        stats.misses++;
+        pruneExpired();
+        return created;
+    }
+
+    ///
+    /// The number of resources with live handles.
+    ///
+    size_t LiveCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t live = 0;
+        for(const auto& entry : entries)
+        {
+            live += entry.second.expired() ? 0 : 1;
+        }
+        return live;
+    }
+
+    ///
+    /// The hit and miss counts since the registry was made, and what's live now.
+    ///
+    ResourceCacheStats Stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ResourceCacheStats current = stats;
+        std::unordered_set<const T*> counted;
+        for(const auto& entry : entries)
+        {
+            std::shared_ptr<T> resource = entry.second.lock();
+            if(resource && counted.insert(resource.get()).second)
+            {
+                current.live++;
+                current.bytes += ResourceBytes(*resource);
+            }
+        }
+        return current;
+    }
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<T>> entries;
+    size_t pruneAt = 64;
+    ResourceCacheStats stats;   // Only the counters are kept up to date, the totals are gathered by Stats.
+
+    void countHit(const T& resource)
+    {
+        stats.hits++;
+        stats.hitBytes += ResourceBytes(resource);
+    }
+
+    // Drops the entries of freed resources once the map has doubled since the last time, so the map stays in
+    // proportion to what's loaded at a constant cost per insert on average.
+    void pruneExpired()
+    {
+        if(entries.size() < pruneAt)
+        {
+            return;
+        }
+        for(auto entry = entries.begin(); entry != entries.end();)
+        {
+            entry = entry->second.expired() ? entries.erase(entry) : std::next(entry);
+        }
+        pruneAt = std::max<size_t>(64, entries.size() * 2);
+    }
+};
+
+///
+/// The process wide texture registry, keyed by canonical path and colour space. See TextureResourceKey.
+///
+inline ResourceCache<GpuTexture>& SharedTextures()
+{
+    static ResourceCache<GpuTexture> textures;
+    return textures;
+}
+
+///
+/// The process wide mesh buffer registry, keyed by the model's key and the mesh's index in it.
+///
+inline ResourceCache<GpuMeshBuffers>& SharedMeshBuffers()
+{
+    static ResourceCache<GpuMeshBuffers> meshBuffers;
+    return meshBuffers;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+///
+/// A node as imported and cooked: its parent, its transform relative to the parent and the range of the model's
+/// meshes it draws. Nodes are listed depth first, so a parent always comes before its children.
+///
+struct SceneNodeSource
+{
+    int32_t parent;     // -1 for the root.
+    uint32_t firstMesh;
+    uint32_t meshCount;
+    uint32_t reserved;
+    glm::mat4 local;
+};
+
+///
+/// A model's node hierarchy, kept as parallel arrays in depth first order. Every subtree is then one contiguous
+/// range of nodes, so a changed node's world matrices are brought up to date by a single forward pass over its
+/// subtree, where each parent's world matrix is already current by the time its children are reached.
+///
+/// Changing a node's local transform only marks it dirty. UpdateWorld then recomputes just the dirty subtrees, so
+/// the cost follows what changed rather than how many nodes there are.
+///
+class SceneGraph
+{
+public:
+    ///
+    /// Replaces the hierarchy. Every world matrix is computed straight away.
+    /// \param nodes - the nodes, depth first with each parent before its children.
+    ///
+    void Build(const std::vector<SceneNodeSource>& nodes)
+    {
+        const size_t count = nodes.size();
+        parents.resize(count);
+        subtreeEnds.resize(count);
+        firstMeshes.resize(count);
+        meshCounts.resize(count);
+        locals.resize(count);
+        worlds.resize(count);
+        dirty.assign(count, 0);
+        dirtyNodes.clear();
+
+        for(size_t i = 0; i < count; i++)
+        {
+            parents[i] = nodes[i].parent;
+            firstMeshes[i] = nodes[i].firstMesh;
+            meshCounts[i] = nodes[i].meshCount;
+            locals[i] = nodes[i].local;
+            subtreeEnds[i] = ( uint32_t) (i + 1);
+        }
+
+        // A subtree ends where the next node outside it starts. Walking backwards, every node extends its parent's
+        // subtree to cover its own.
+        for(size_t i = count; i > 0; i--)
+        {
+            int32_t parent = parents[i - 1];
+            if(parent >= 0)
+            {
+                subtreeEnds[parent] = std::max(subtreeEnds[parent], subtreeEnds[i - 1]);
+            }
+        }
+
+        updateRange(0, ( uint32_t) count);
+    }
+
+    size_t NodeCount() const
+    {
+        return parents.size();
+    }
+
+    int32_t Parent(size_t node) const
+    {
+        return parents[node];
+    }
+
+    uint32_t FirstMesh(size_t node) const
+    {
+        return firstMeshes[node];
+    }
+
+    uint32_t MeshCount(size_t node) const
+    {
+        return meshCounts[node];
+    }
+
+    const glm::mat4& Local(size_t node) const
+    {
+        return locals[node];
+    }
+
+    ///
+    /// The node's transform relative to the model, as of the last UpdateWorld.
+    ///
+    const glm::mat4& World(size_t node) const
+    {
+        return worlds[node];
+    }
+
+    ///
+    /// Changes a node's transform relative to its parent. Its subtree's world matrices are updated by the next
+    /// UpdateWorld.
+    ///
+    void SetLocal(size_t node, const glm::mat4& local)
+    {
+        locals[node] = local;
+        if(!dirty[node])
+        {
+            dirty[node] = 1;
+            dirtyNodes.push_back(( uint32_t) node);
+        }
+    }
+
+    bool IsDirty() const
+    {
+        return !dirtyNodes.empty();
+    }
+
+    ///
+    /// Recomputes the world matrices of every subtree with a changed node. Nothing is done if nothing changed.
+    ///
+    void UpdateWorld()
+    {
+        if(dirtyNodes.empty())
+        {
+            return;
+        }
+
+        // In depth first order a dirty node inside an already updated subtree has been covered by it.
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+        uint32_t updatedEnd = 0;
+        for(uint32_t node : dirtyNodes)
+        {
+            dirty[node] = 0;
+            if(node >= updatedEnd)
+            {
+                updateRange(node, subtreeEnds[node]);
+                updatedEnd = subtreeEnds[node];
+            }
+        }
+        dirtyNodes.clear();
+    }
+
+private:
+    std::vector<int32_t> parents;
+    std::vector<uint32_t> subtreeEnds;  // One past the last node of each node's subtree.
+    std::vector<uint32_t> firstMeshes;
+    std::vector<uint32_t> meshCounts;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirtyNodes;
+
+    // Recomputes the world matrices of a range of nodes, whose parents outside the range are already current.
+    void updateRange(uint32_t begin, uint32_t end)
+    {
+        for(uint32_t i = begin; i < end; i++)
+        {
+            worlds[i] = parents[i] >= 0 ? worlds[parents[i]] * locals[i] : locals[i];
+        }
+    }
+};
+
+#endif
\ No newline at end of file
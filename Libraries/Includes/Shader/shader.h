@@ -5,6 +5,8 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include <VirtualFileSystem/virtualfilesystem.h>
+
 #include <cstdio>
 #include <string>
 #include <vector>
@@ -216,23 +218,14 @@ private:
     ///
     int CompileShader(const char* shader_path, const GLuint shader_id)
     {
-        // Read shader code from file.
-        std::string shader_code;
-        std::ifstream shader_stream(shader_path, std::ios::in);
-        if(shader_stream.is_open())
-        {
-            std::string line = "";
-            while(getline(shader_stream, line))
-            {
-                shader_code += "\n" + line;
-            }
-            shader_stream.close();
-        }
-        else
+        // Read shader code from a mounted asset pack or the file.
+        std::vector<unsigned char> shader_bytes;
+        if(!ReadAsset(shader_path, shader_bytes))
         {
             std::cerr << "Cannot open " << shader_path << ". Are you in the right directory?" << std::endl;
             return 0;
         }
+        std::string shader_code(shader_bytes.begin(), shader_bytes.end());
 
         // Compile Shader.
         char const* source_pointer = shader_code.c_str();
@@ -0,0 +1,540 @@
+#ifndef SIMPLIFIER_H
+#define SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <MeshOptimiser/meshoptimiser.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Each LOD aims for this fraction of the previous LOD's triangles.
+const float LOD_REDUCTION = 0.5f;
+
+// Maximum number of levels, including the full resolution mesh.
+const unsigned int LOD_MAX_LEVELS = 5;
+
+// A LOD that can't get below this fraction of the previous one isn't worth the index memory, so the chain stops.
+const float LOD_MIN_REDUCTION = 0.85f;
+
+// A LOD is used once its error projects to less than this many pixels on screen.
+const float LOD_PIXEL_THRESHOLD = 1.0f;
+
+// Moving to a coarser LOD needs the error to be this much under the threshold, so LODs don't flicker at the boundary.
+const float LOD_HYSTERESIS = 0.25f;
+
+///
+/// One level of detail, stored as a range of the mesh's shared index buffer.
+///
+struct MeshLod
+{
+    unsigned int indexOffset;   // First index of the level in the mesh's index buffer.
+    unsigned int indexCount;    // Number of indices in the level.
+    float error;                // Largest distance, in model units, the surface moved compared to the full resolution mesh.
+};
+
+///
+/// Symmetric 4x4 error quadric, stored as its 10 unique coefficients.
+///
+struct Quadric
+{
+    float a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    float a11 = 0, a12 = 0, a13 = 0;
+    float a22 = 0, a23 = 0;
+    float a33 = 0;
+    float weight = 0;
+
+    ///
+    /// Adds the squared distance to the plane through point with the given unit normal, scaled by the given factor.
+    ///
+    void AddPlane(const glm::vec3& normal, const glm::vec3& point, float scale)
+    {
+        float d = -glm::dot(normal, point);
+        a00 += scale * normal.x * normal.x; a01 += scale * normal.x * normal.y; a02 += scale * normal.x * normal.z; a03 += scale * normal.x * d;
+        a11 += scale * normal.y * normal.y; a12 += scale * normal.y * normal.z; a13 += scale * normal.y * d;
+        a22 += scale * normal.z * normal.z; a23 += scale * normal.z * d;
+        a33 += scale * d * d;
+        weight += scale;
+    }
+
+    void Add(const Quadric& other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+        weight += other.weight;
+    }
+
+    ///
+    /// Weighted mean of the squared distances from p to all the planes in the quadric.
+    ///
+    float Error(const glm::vec3& p) const
+    {
+        if(weight <= 0.0f)
+        {
+            return 0.0f;
+        }
+
+        float result = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+                     + a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+                     + a22 * p.z * p.z + 2 * a23 * p.z
+                     + a33;
+        return std::max(result / weight, 0.0f);
+    }
+};
+
+///
+/// How a vertex may move during simplification.
+///
+enum SimplifyVertexKind
+{
+    SIMPLIFY_MANIFOLD,  // Interior vertex with a single set of attributes, may collapse onto any neighbour.
+    SIMPLIFY_BORDER,    // On an open edge of the mesh, may only collapse along that edge so the outline is kept.
+    SIMPLIFY_LOCKED     // UV seam, hard normal edge or non-manifold vertex, never moves.
+};
+
+///
+/// Simplifies a triangle mesh by quadric error metric half-edge collapses.
+/// Vertices only ever collapse onto existing vertices, so the result indexes the same vertex buffer as the input.
+/// Vertices shared between several attribute sets (UV seams and hard normal edges) are kept in place, and
+/// collapses that would flip a triangle are rejected, so texturing and shading are preserved.
+///
+/// \param vertices - vertex buffer, vertices must have a glm::vec3 Position member.
+/// \param indices - triangle list index buffer to simplify.
+/// \param targetIndexCount - stop once the index count drops to this.
+/// \param targetError - stop once collapses would move the surface further than this, in model units.
+/// \param resultError - set to the largest distance the surface moved.
+/// \return - the simplified index buffer.
+///
+template <typename VertexType>
+std::vector<unsigned int> SimplifyMesh(const std::vector<VertexType>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t targetIndexCount, float targetError, float& resultError)
+{
+    std::vector<unsigned int> result(indices);
+    resultError = 0.0f;
+    const size_t vertexCount = vertices.size();
+
+    // Vertices at the same position are wedges of one point. Each wedge points at the first vertex of its point.
+    std::vector<unsigned int> positionOf(vertexCount);
+    std::vector<unsigned int> wedgeCount(vertexCount, 0);
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3& p) const
+            {
+                const unsigned int* bits = reinterpret_cast<const unsigned int*>(&p);
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> firstAt;
+        firstAt.reserve(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            positionOf[v] = firstAt.emplace(vertices[v].Position, v).first->second;
+            wedgeCount[positionOf[v]]++;
+        }
+    }
+
+    // Classify each point from the edges around it. An edge with no opposite half-edge is on an open border.
+    std::vector<SimplifyVertexKind> kind(vertexCount, SIMPLIFY_MANIFOLD);
+    {
+        std::unordered_map<unsigned long long, unsigned int> edges;
+        edges.reserve(indices.size());
+        auto edgeKey = [&](unsigned int a, unsigned int b)
+        {
+            return (( unsigned long long) positionOf[a] << 32) | positionOf[b];
+        };
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                edges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+            }
+        }
+
+        std::vector<unsigned int> openEdges(vertexCount, 0);
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k];
+                unsigned int b = indices[i + (k + 1) % 3];
+                unsigned int forward = edges[edgeKey(a, b)];
+                auto backward = edges.find(edgeKey(b, a));
+                if(forward > 1 || (backward != edges.end() && backward->second > 1))
+                {
+                    // Non-manifold edge.
+                    kind[positionOf[a]] = SIMPLIFY_LOCKED;
+                    kind[positionOf[b]] = SIMPLIFY_LOCKED;
+                }
+                else if(backward == edges.end())
+                {
+                    openEdges[positionOf[a]]++;
+                    openEdges[positionOf[b]]++;
+                }
+            }
+        }
+
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            unsigned int p = positionOf[v];
+            if(p != v || kind[p] == SIMPLIFY_LOCKED)
+            {
+                continue;
+            }
+            if(wedgeCount[p] > 1)
+            {
+                kind[p] = SIMPLIFY_LOCKED;
+            }
+            else if(openEdges[p] == 2)
+            {
+                kind[p] = SIMPLIFY_BORDER;
+            }
+            else if(openEdges[p] != 0)
+            {
+                kind[p] = SIMPLIFY_LOCKED;
+            }
+        }
+    }
+
+    // Area weighted plane quadrics per point, plus perpendicular planes along open borders to hold the outline.
+    std::vector<Quadric> quadrics(vertexCount);
+    {
+        std::unordered_map<unsigned long long, unsigned int> edges;
+        edges.reserve(indices.size());
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                edges[(( unsigned long long) positionOf[indices[i + k]] << 32) | positionOf[indices[i + (k + 1) % 3]]]++;
+            }
+        }
+
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            const glm::vec3& p0 = vertices[indices[i + 0]].Position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if(area == 0.0f)
+            {
+                continue;
+            }
+            normal /= area;
+
+            Quadric plane;
+            plane.AddPlane(normal, p0, area);
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                quadrics[positionOf[indices[i + k]]].Add(plane);
+            }
+
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int a = positionOf[indices[i + k]];
+                unsigned int b = positionOf[indices[i + (k + 1) % 3]];
+                if(edges.find((( unsigned long long) b << 32) | a) == edges.end())
+                {
+                    glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+                    float length = glm::length(edge);
+                    if(length > 0.0f)
+                    {
+                        Quadric border;
+                        border.AddPlane(glm::normalize(glm::cross(edge, normal)), vertices[a].Position, length * length);
+                        quadrics[a].Add(border);
+                        quadrics[b].Add(border);
+                    }
+                }
+            }
+        }
+    }
+
+    struct Collapse
+    {
+        unsigned int from;  // Attribute vertex that is removed.
+        unsigned int to;    // Attribute vertex it is replaced with.
+        float cost;
+    };
+
+    const float maxCost = targetError * targetError;
+    float largestCost = 0.0f;
+
+    // Each pass collapses a set of independent edges, cheapest first, until the target is reached or nothing moves.
+    while(result.size() > targetIndexCount)
+    {
+        const size_t triangleCount = result.size() / 3;
+
+        // Point to triangle adjacency for the current index buffer.
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for(unsigned int index : result)
+        {
+            offsets[positionOf[index] + 1]++;
+        }
+        for(size_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+        std::vector<unsigned int> adjacency(result.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < result.size(); i++)
+        {
+            adjacency[fill[positionOf[result[i]]]++] = ( unsigned int) (i / 3);
+        }
+
+        // Candidate collapses along every edge of the mesh.
+        std::vector<Collapse> collapses;
+        collapses.reserve(result.size());
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int from = result[t * 3 + k];
+                unsigned int to = result[t * 3 + (k + 1) % 3];
+                unsigned int fromPoint = positionOf[from];
+                unsigned int toPoint = positionOf[to];
+
+                if(kind[fromPoint] == SIMPLIFY_LOCKED)
+                {
+                    continue;
+                }
+                if(kind[fromPoint] == SIMPLIFY_BORDER && kind[toPoint] != SIMPLIFY_BORDER && kind[toPoint] != SIMPLIFY_LOCKED)
+                {
+                    continue;
+                }
+
+                // Border vertices only slide along the border. Edges along the border have no opposite triangle.
+                if(kind[fromPoint] == SIMPLIFY_BORDER)
+                {
+                    bool opposite = false;
+                    for(unsigned int a = offsets[toPoint]; a < offsets[toPoint + 1] && !opposite; a++)
+                    {
+                        unsigned int other = adjacency[a];
+                        for(unsigned int j = 0; j < 3; j++)
+                        {
+                            if(positionOf[result[other * 3 + j]] == toPoint && positionOf[result[other * 3 + (j + 1) % 3]] == fromPoint)
+                            {
+                                opposite = true;
+                            }
+                        }
+                    }
+                    if(opposite)
+                    {
+                        continue;
+                    }
+                }
+
+                float cost = quadrics[fromPoint].Error(vertices[to].Position);
+                if(cost <= maxCost)
+                {
+                    collapses.push_back({ from, to, cost });
+                }
+            }
+        }
+
+        std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.cost < b.cost;
+        });
+
+        // Apply collapses in cost order. A point touched by one collapse can't take part in another this pass.
+        std::vector<unsigned int> remap(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            remap[v] = v;
+        }
+        std::vector<bool> touched(vertexCount, false);
+        size_t removedTriangles = 0;
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        unsigned int collapsed = 0;
+
+        for(const Collapse& collapse : collapses)
+        {
+            if(removedTriangles >= trianglesToRemove)
+            {
+                break;
+            }
+
+            unsigned int fromPoint = positionOf[collapse.from];
+            unsigned int toPoint = positionOf[collapse.to];
+            if(touched[fromPoint] || touched[toPoint])
+            {
+                continue;
+            }
+
+            // Reject the collapse if any remaining triangle around the removed vertex would flip.
+            const glm::vec3& target = vertices[collapse.to].Position;
+            bool flips = false;
+            size_t removes = 0;
+            for(unsigned int a = offsets[fromPoint]; a < offsets[fromPoint + 1] && !flips; a++)
+            {
+                const unsigned int* triangle = &result[adjacency[a] * 3];
+                glm::vec3 p[3];
+                bool hasTo = false;
+                for(unsigned int j = 0; j < 3; j++)
+                {
+                    p[j] = vertices[triangle[j]].Position;
+                    hasTo |= positionOf[triangle[j]] == toPoint;
+                }
+                if(hasTo)
+                {
+                    removes++;
+                    continue;
+                }
+
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for(unsigned int j = 0; j < 3; j++)
+                {
+                    if(positionOf[triangle[j]] == fromPoint)
+                    {
+                        p[j] = target;
+                    }
+                }
+                glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if(flips)
+            {
+                continue;
+            }
+
+            // The removed point only has one wedge, so every reference to it moves to the target wedge.
+            remap[collapse.from] = collapse.to;
+            touched[fromPoint] = true;
+            touched[toPoint] = true;
+            for(unsigned int a = offsets[fromPoint]; a < offsets[fromPoint + 1]; a++)
+            {
+                for(unsigned int j = 0; j < 3; j++)
+                {
+                    touched[positionOf[result[adjacency[a] * 3 + j]]] = true;
+                }
+            }
+
+            quadrics[toPoint].Add(quadrics[fromPoint]);
+            largestCost = std::max(largestCost, collapse.cost);
+            removedTriangles += removes;
+            collapsed++;
+        }
+
+        if(collapsed == 0)
+        {
+            break;
+        }
+
+        // Rebuild the index buffer, dropping triangles that collapsed to a line.
+        size_t write = 0;
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i + 0]];
+            unsigned int b = remap[result[i + 1]];
+            unsigned int c = remap[result[i + 2]];
+            if(positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[c] == positionOf[a])
+            {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    resultError = std::sqrt(largestCost);
+    return result;
+}
+
+///
+/// Appends a chain of simplified LODs to a mesh's index buffer. The existing indices become LOD 0, and each further
+/// level is simplified from the one before it, optimised for the vertex cache and appended, so all levels share the
+/// one vertex buffer and one index buffer.
+///
+/// \param vertices - vertex buffer, vertices must have a glm::vec3 Position member.
+/// \param indices - triangle list index buffer, LODs are appended in place.
+/// \return - the index range and error of each level, LOD 0 first.
+///
+template <typename VertexType>
+std::vector<MeshLod> GenerateLods(const std::vector<VertexType>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<MeshLod> lods;
+    lods.push_back({ 0, ( unsigned int) indices.size(), 0.0f });
+    if(indices.empty())
+    {
+        return lods;
+    }
+
+    // Errors are limited relative to the size of the mesh, so coarse LODs still resemble it.
+    glm::vec3 minimum(INFINITY);
+    glm::vec3 maximum(-INFINITY);
+    for(const VertexType& vertex : vertices)
+    {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    const float maxError = glm::length(maximum - minimum) * 0.05f;
+
+    std::vector<unsigned int> previous(indices);
+    while(lods.size() < LOD_MAX_LEVELS)
+    {
+        size_t target = ( size_t) (previous.size() / 3 * LOD_REDUCTION) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = SimplifyMesh(vertices, previous, target, maxError, error);
+        if(lod.empty() || lod.size() > previous.size() * LOD_MIN_REDUCTION)
+        {
+            break;
+        }
+
+        OptimiseVertexCache(lod, vertices.size());
+        lods.push_back({ ( unsigned int) indices.size(), ( unsigned int) lod.size(), std::max(error, lods.back().error) });
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+
+    return lods;
+}
+
+///
+/// Picks the coarsest LOD whose error projects to less than the pixel threshold, with hysteresis against the
+/// current LOD so objects near a switching distance don't flicker between levels.
+///
+/// \param errors - the error of each LOD, LOD 0 first, increasing.
+/// \param distance - distance from the camera to the object, in the same units as the LOD errors.
+/// \param projectionScale - pixels covered by one unit at distance one, screenHeight / (2 * tan(fovY / 2)).
+/// \param current - the LOD used last frame.
+/// \return - the LOD to use this frame.
+///
+inline unsigned int SelectLod(const std::vector<float>& errors, float distance, float projectionScale, unsigned int current,
+                              float threshold = LOD_PIXEL_THRESHOLD, float hysteresis = LOD_HYSTERESIS)
+{
+    if(errors.empty())
+    {
+        return 0;
+    }
+    current = std::min(current, ( unsigned int) errors.size() - 1);
+
+    auto pixels = [&](unsigned int lod)
+    {
+        return errors[lod] * projectionScale / std::max(distance, 1e-4f);
+    };
+
+    // Too coarse now, refine straight away.
+    if(pixels(current) > threshold)
+    {
+        while(current > 0 && pixels(current) > threshold)
+        {
+            current--;
+        }
+        return current;
+    }
+
+    // Only coarsen once comfortably under the threshold.
+    while(current + 1 < errors.size() && pixels(current + 1) <= threshold * (1.0f - hysteresis))
+    {
+        current++;
+    }
+    return current;
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef TANGENTSPACE_H
+#define TANGENTSPACE_H
+
+#include <glm/glm.hpp>
+
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Triangles or vertices handed to a worker at a time. Large enough that the per item call overhead disappears,
+// small enough that a big mesh still spreads across every core.
+const size_t TANGENT_CHUNK_SIZE = 4096;
+
+///
+/// Returns a unit vector perpendicular to the given unit normal, used when a vertex has no usable texture mapping.
+///
+inline glm::vec3 AnyPerpendicular(const glm::vec3& normal)
+{
+    glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(glm::cross(normal, axis));
+}
+
+///
+/// Generates per vertex tangents and bitangents from positions, normals and texture coordinates.
+/// Follows the MikkTSpace construction: each triangle's texture space directions are projected into the plane of
+/// every corner's normal and accumulated with the corner's angle as weight, so the result doesn't depend on how the
+/// surface is triangulated or on the order of the triangles. Mirrored texture mapping is kept through the sign of the
+/// bitangent relative to cross(normal, tangent).
+///
+/// Unlike MikkTSpace, vertices aren't split where the tangent space is discontinuous; the importer already splits
+/// vertices on texture seams, which covers the cases that matter for normal mapping.
+///
+/// Work is split into chunks of triangles and then chunks of vertices across the worker threads. Each vertex gathers
+/// from its own corners rather than the triangles scattering into shared vertices, so no locking is needed and the
+/// result is the same for any number of threads.
+///
+/// \param vertices - vertex buffer, vertices must have glm::vec3 Position, Normal, Tangent and Bitangent and a
+///                   glm::vec2 TexCoords member. Tangent and Bitangent are written.
+/// \param indices - triangle list index buffer.
+///
+template <typename VertexType>
+void GenerateTangents(std::vector<VertexType>& vertices, const std::vector<unsigned int>& indices)
+{
+    const size_t triangleCount = indices.size() / 3;
+    const size_t vertexCount = vertices.size();
+
+    // Texture space directions of every triangle, normalised, plus the triangle's orientation in texture space.
+    std::vector<glm::vec3> faceTangents(triangleCount);
+    std::vector<glm::vec3> faceBitangents(triangleCount);
+    std::vector<float> faceOrientations(triangleCount);
+    ParallelFor((triangleCount + TANGENT_CHUNK_SIZE - 1) / TANGENT_CHUNK_SIZE, [&](size_t chunk)
+    {
+        size_t end = std::min(triangleCount, (chunk + 1) * TANGENT_CHUNK_SIZE);
+        for(size_t t = chunk * TANGENT_CHUNK_SIZE; t < end; t++)
+        {
+            const VertexType& v0 = vertices[indices[t * 3 + 0]];
+            const VertexType& v1 = vertices[indices[t * 3 + 1]];
+            const VertexType& v2 = vertices[indices[t * 3 + 2]];
+
+            glm::vec3 edge1 = v1.Position - v0.Position;
+            glm::vec3 edge2 = v2.Position - v0.Position;
+            glm::vec2 deltaUV1 = v1.TexCoords - v0.TexCoords;
+            glm::vec2 deltaUV2 = v2.TexCoords - v0.TexCoords;
+
+            // Twice the signed area in texture space. Only its sign is used, so degenerate mappings don't blow up.
+            float signedArea = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+            float orientation = signedArea < 0.0f ? -1.0f : 1.0f;
+
+            glm::vec3 tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * orientation;
+            glm::vec3 bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * orientation;
+            float tangentLength = glm::length(tangent);
+            float bitangentLength = glm::length(bitangent);
+
+            faceTangents[t] = tangentLength > 0.0f ? tangent / tangentLength : glm::vec3(0.0f);
+            faceBitangents[t] = bitangentLength > 0.0f ? bitangent / bitangentLength : glm::vec3(0.0f);
+            faceOrientations[t] = signedArea != 0.0f ? orientation : 0.0f;
+        }
+    });
+
+    // Vertex to corner adjacency, so each vertex can gather from its own corners.
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<unsigned int> corners(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        corners[fill[indices[i]]++] = ( unsigned int) i;
+    }
+
+    ParallelFor((vertexCount + TANGENT_CHUNK_SIZE - 1) / TANGENT_CHUNK_SIZE, [&](size_t chunk)
+    {
+        size_t end = std::min(vertexCount, (chunk + 1) * TANGENT_CHUNK_SIZE);
+        for(size_t v = chunk * TANGENT_CHUNK_SIZE; v < end; v++)
+        {
+            VertexType& vertex = vertices[v];
+            glm::vec3 normal = vertex.Normal;
+            float normalLength = glm::length(normal);
+            normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+            glm::vec3 tangentSum(0.0f);
+            glm::vec3 bitangentSum(0.0f);
+            float orientationSum = 0.0f;
+            for(unsigned int c = offsets[v]; c < offsets[v + 1]; c++)
+            {
+                unsigned int corner = corners[c];
+                size_t triangle = corner / 3;
+                unsigned int first = ( unsigned int) (triangle * 3);
+
+                // Angle of the triangle at this corner, measured in the plane of the vertex normal.
+                glm::vec3 position = vertices[indices[corner]].Position;
+                glm::vec3 toNext = vertices[indices[first + (corner - first + 1) % 3]].Position - position;
+                glm::vec3 toPrevious = vertices[indices[first + (corner - first + 2) % 3]].Position - position;
+                toNext -= normal * glm::dot(normal, toNext);
+                toPrevious -= normal * glm::dot(normal, toPrevious);
+                float lengths = glm::length(toNext) * glm::length(toPrevious);
+                float angle = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.0f, 1.0f)) : 0.0f;
+
+                // Project the triangle's directions into the normal's plane before accumulating.
+                glm::vec3 tangent = faceTangents[triangle] - normal * glm::dot(normal, faceTangents[triangle]);
+                glm::vec3 bitangent = faceBitangents[triangle] - normal * glm::dot(normal, faceBitangents[triangle]);
+                float tangentLength = glm::length(tangent);
+                float bitangentLength = glm::length(bitangent);
+                if(tangentLength > 0.0f)
+                {
+                    tangentSum += tangent * (angle / tangentLength);
+                }
+                if(bitangentLength > 0.0f)
+                {
+                    bitangentSum += bitangent * (angle / bitangentLength);
+                }
+                orientationSum += faceOrientations[triangle] * angle;
+            }
+
+            float tangentLength = glm::length(tangentSum);
+            glm::vec3 tangent = tangentLength > 0.0f ? tangentSum / tangentLength : AnyPerpendicular(normal);
+
+            // The bitangent is rebuilt orthogonal to the normal and tangent, keeping the accumulated handedness.
+            float handedness = glm::dot(glm::cross(normal, tangent), bitangentSum) < 0.0f ? -1.0f : 1.0f;
+            if(glm::length(bitangentSum) == 0.0f)
+            {
+                handedness = orientationSum < 0.0f ? -1.0f : 1.0f;
+            }
+
+            vertex.Tangent = tangent;
+            vertex.Bitangent = glm::cross(normal, tangent) * handedness;
+        }
+    });
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,453 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <ResourceRegistry/resourceregistry.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Material textures gathered into 2D array textures, so meshes with different materials sample the same texture
+// objects and only the layer changes between them. Textures of one format, size and mip chain length become layers of
+// one array. Small ones are packed into atlas pages the size of the largest array of their format, in arrays of their
+// own so their shorter chains don't cut the others', and found through a scale and offset of their texture
+// coordinates. The textures are copied on the GPU, levels and all, so block compressed ones stay compressed. A mesh's
+// layers and atlas transforms are handed to the shader as constant vertex attributes, which cost no binds, and each
+// class of texture has its own unit where its array stays bound from one mesh to the next.
+
+// Textures no larger than this along either side are packed into atlas pages, when their format has pages to put
+// them in.
+const int TEXTURE_ATLAS_TILE_LIMIT = 256;
+
+// The classes of material texture, each sampled from its own unit: diffuse, specular, normal and height.
+const int MATERIAL_CLASS_COUNT = 4;
+const char* const MATERIAL_CLASS_NAMES[MATERIAL_CLASS_COUNT] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+
+// Vertex attributes a batched shader reads its material from: the layer of each class, -1 where the mesh has no
+// texture of that class, then each class's atlas transform (scale in xy, offset in zw) in the locations after it.
+const GLuint MATERIAL_LAYER_ATTRIBUTE = 5;
+const GLuint MATERIAL_TRANSFORM_ATTRIBUTE = 6;
+
+///
+/// Returns the index of a texture type in MATERIAL_CLASS_NAMES, or -1 if it isn't a material class.
+///
+inline int MaterialClass(const std::string& type)
+{
+    for(int i = 0; i < MATERIAL_CLASS_COUNT; i++)
+    {
+        if(type == MATERIAL_CLASS_NAMES[i])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+///
+/// Where a texture was put.
+///
+struct TextureArraySlot
+{
+    std::shared_ptr<GpuTexture> array;  // Empty if the texture couldn't be placed.
+    int layer = -1;
+    glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+///
+/// A mesh's material textures as array layers, one of each class.
+///
+struct MaterialLayers
+{
+    bool batched = false;   // Whether the mesh samples these rather than binding its own textures.
+    TextureArraySlot slots[MATERIAL_CLASS_COUNT];
+};
+
+///
+/// Gathers textures into arrays. Add every texture to batch, then Build once; the arrays live as long as the slots
+/// that refer to them.
+///
+class TextureArrayPacker
+{
+public:
+    ///
+    /// Queues a texture to be put in an array. Adding the same texture again returns the same index.
+    /// \param textureID - a 2D texture with storage.
+    /// \return - its index, for Slot.
+    ///
+    size_t Add(unsigned int textureID)
+    {
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            if(sources[i].id == textureID)
+            {
+                return i;
+            }
+        }
+        Source source;
+        source.id = textureID;
+        sources.push_back(source);
+        return sources.size() - 1;
+    }
+
+    ///
+    /// Creates the arrays and copies every queued texture into its layer. Call on the context's thread.
+    /// \return - false if the context can't copy between textures (it needs 4.3), when no slot is filled.
+    ///
+    bool Build()
+    {
+        slots.assign(sources.size(), TextureArraySlot());
+        if(!GLAD_GL_VERSION_4_3)
+        {
+            return false;
+        }
+
+        // What's bound is put back afterwards, so SharedTextureArrayBindings stays true to the active unit.
+        GLint boundTexture = 0;
+        GLint boundArray = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &boundArray);
+        for(Source& source : sources)
+        {
+            describe(source);
+        }
+
+        // Textures of one format, size and level count share an array. Atlas pages are keyed with no levels, as their
+        // chains are cut to their tiles.
+        std::map<GroupKey, Group> groups;
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            const Source& source = sources[i];
+            if(source.levels > 0 && !isTile(source))
+            {
+                groups[groupKey(source)].layers.push_back(Layer{ i, {} });
+            }
+        }
+
+        // Small textures go into pages the size of the largest square array of their format, or make arrays of
+        // their own if it hasn't any.
+        std::map<GLint, std::vector<size_t>> tilesByFormat;
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            if(sources[i].levels > 0 && isTile(sources[i]))
+            {
+                tilesByFormat[sources[i].internalFormat].push_back(i);
+            }
+        }
+        for(auto& format : tilesByFormat)
+        {
+            GLint page = 0;
+            for(const auto& group : groups)
+            {
+                GLint width = std::get<1>(group.first);
+                if(std::get<0>(group.first) == format.first && width == std::get<2>(group.first) && std::get<3>(group.first) > 0
+                   && isPowerOfTwo(width))
+                {
+                    page = std::max(page, width);
+                }
+            }
+            if(page == 0)
+            {
+                for(size_t i : format.second)
+                {
+                    groups[groupKey(sources[i])].layers.push_back(Layer{ i, {} });
+                }
+                continue;
+            }
+            packAtlas(format.second, page, groups[std::make_tuple(format.first, page, page, 0)]);
+        }
+
+        GLint maxLayers = 256;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        for(auto& entry : groups)
+        {
+            for(size_t first = 0; first < entry.second.layers.size(); first += ( size_t) maxLayers)
+            {
+                size_t count = std::min(entry.second.layers.size() - first, ( size_t) maxLayers);
+                buildArray(std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first), entry.second.layers.data() + first, count);
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, ( GLuint) boundTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ( GLuint) boundArray);
+        return true;
+    }
+
+    const TextureArraySlot& Slot(size_t index) const
+    {
+        return slots[index];
+    }
+
+    size_t ArrayCount() const
+    {
+        return arrayCount;
+    }
+
+    size_t AtlasTileCount() const
+    {
+        return atlasTiles;
+    }
+
+    uint64_t Bytes() const
+    {
+        return bytes;
+    }
+
+private:
+    struct Source
+    {
+        unsigned int id = 0;
+        GLint width = 0;
+        GLint height = 0;
+        GLint internalFormat = 0;
+        GLint levels = 0;       // 0 for a texture without storage, which isn't placed.
+        bool compressed = false;
+    };
+
+    // A layer of an array: one texture filling it, or the atlas tiles packed into it.
+    struct Tile
+    {
+        size_t source;
+        GLint x;
+        GLint y;
+    };
+    struct Layer
+    {
+        size_t source;          // The texture filling the layer, unused for an atlas page.
+        std::vector<Tile> tiles;
+    };
+    struct Group
+    {
+        std::vector<Layer> layers;
+    };
+    // Format, width, height and level count, 0 for atlas pages.
+    typedef std::tuple<GLint, GLint, GLint, GLint> GroupKey;
+
+    std::vector<Source> sources;
+    std::vector<TextureArraySlot> slots;
+    size_t arrayCount = 0;
+    size_t atlasTiles = 0;
+    uint64_t bytes = 0;
+
+    static bool isPowerOfTwo(GLint value)
+    {
+        return value > 0 && (value & (value - 1)) == 0;
+    }
+
+    static GLint levelCount(GLint width, GLint height)
+    {
+        GLint levels = 1;
+        while((std::max(width, height) >> levels) > 0)
+        {
+            levels++;
+        }
+        return levels;
+    }
+
+    static GroupKey groupKey(const Source& source)
+    {
+        return std::make_tuple(source.internalFormat, source.width, source.height, source.levels);
+    }
+
+    static bool isTile(const Source& source)
+    {
+        return isPowerOfTwo(source.width) && isPowerOfTwo(source.height) && std::max(source.width, source.height) <= TEXTURE_ATLAS_TILE_LIMIT
+               && (!source.compressed || std::min(source.width, source.height) >= 4);
+    }
+
+    // Levels of a tile that can be copied into a page: all of them, or for block compressed formats those still
+    // whole blocks, as a block can't hold parts of two tiles.
+    static GLint tileLevels(const Source& source)
+    {
+        GLint levels = levelCount(std::min(source.width, source.height), std::min(source.width, source.height)) - (source.compressed ? 2 : 0);
+        return std::min(levels, source.levels);
+    }
+
+    // Reads a texture's size, format and the levels it has.
+    void describe(Source& source)
+    {
+        glBindTexture(GL_TEXTURE_2D, source.id);
+        GLint compressed = 0;
+        GLint maxLevel = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &source.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &source.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &source.internalFormat);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        source.compressed = compressed != 0;
+        source.levels = source.width > 0 && source.height > 0 ? std::min(levelCount(source.width, source.height), maxLevel + 1) : 0;
+
+        // Storage needs a sized format, which textures uploaded with a base one may report.
+        if(source.internalFormat == GL_RED)
+        {
+            source.internalFormat = GL_R8;
+        }
+        else if(source.internalFormat == GL_RGB)
+        {
+            source.internalFormat = GL_RGB8;
+        }
+        else if(source.internalFormat == GL_RGBA)
+        {
+            source.internalFormat = GL_RGBA8;
+        }
+    }
+
+    // Places tiles in square pages, largest first, each at the next free cell of its size in Z order. The sizes are
+    // powers of two and never grow, so every cell starts on a multiple of its own size and nothing overlaps.
+    void packAtlas(std::vector<size_t>& tiles, GLint page, Group& group)
+    {
+        std::sort(tiles.begin(), tiles.end(), [&](size_t a, size_t b)
+        {
+            return std::max(sources[a].width, sources[a].height) > std::max(sources[b].width, sources[b].height);
+        });
+        uint64_t cursor = ( uint64_t) page * page;
+        for(size_t i : tiles)
+        {
+            GLint cell = std::max(sources[i].width, sources[i].height);
+            uint64_t area = ( uint64_t) cell * cell;
+            if(cursor + area > ( uint64_t) page * page)
+            {
+                group.layers.push_back(Layer{ 0, {} });
+                cursor = 0;
+            }
+            uint64_t index = cursor / area;
+            GLint x = 0;
+            GLint y = 0;
+            for(int bit = 0; (index >> (bit * 2)) != 0; bit++)
+            {
+                x |= ( GLint) ((index >> (bit * 2)) & 1) << bit;
+                y |= ( GLint) ((index >> (bit * 2 + 1)) & 1) << bit;
+            }
+            group.layers.back().tiles.push_back(Tile{ i, x * cell, y * cell });
+            cursor += area;
+            atlasTiles++;
+        }
+    }
+
+    // Creates one array and copies its layers in. An array of atlas pages has its chain stop where the smallest tile
+    // would stop being whole blocks, or pixels; the textures filling the other arrays' layers all have the same chain.
+    void buildArray(GLint internalFormat, GLint width, GLint height, const Layer* layers, size_t count)
+    {
+        GLint levels = levelCount(width, height);
+        for(size_t l = 0; l < count; l++)
+        {
+            if(layers[l].tiles.empty())
+            {
+                levels = std::min(levels, sources[layers[l].source].levels);
+            }
+            for(const Tile& tile : layers[l].tiles)
+            {
+                levels = std::min(levels, tileLevels(sources[tile.source]));
+            }
+        }
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, ( GLsizei) count);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        GLint compressed = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        uint64_t arrayBytes = 0;
+        for(GLint level = 0; level < levels; level++)
+        {
+            GLint size = 0;
+            if(compressed)
+            {
+                glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            }
+            else
+            {
+                // The size of uncompressed levels isn't reported; assume four bytes a pixel.
+                size = std::max(width >> level, 1) * std::max(height >> level, 1) * ( GLint) count * 4;
+            }
+            arrayBytes += ( uint64_t) size;
+        }
+        std::shared_ptr<GpuTexture> handle = std::make_shared<GpuTexture>(array, arrayBytes);
+        bytes += arrayBytes;
+        arrayCount++;
+
+        for(size_t l = 0; l < count; l++)
+        {
+            if(layers[l].tiles.empty())
+            {
+                const Source& source = sources[layers[l].source];
+                for(GLint level = 0; level < levels; level++)
+                {
+                    glCopyImageSubData(source.id, GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, ( GLint) l,
+                                       std::max(width >> level, 1), std::max(height >> level, 1), 1);
+                }
+                TextureArraySlot& slot = slots[layers[l].source];
+                slot.array = handle;
+                slot.layer = ( int) l;
+                continue;
+            }
+            for(const Tile& tile : layers[l].tiles)
+            {
+                const Source& source = sources[tile.source];
+                for(GLint level = 0; level < levels; level++)
+                {
+                    glCopyImageSubData(source.id, GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, tile.x >> level,
+                                       tile.y >> level, ( GLint) l, source.width >> level, source.height >> level, 1);
+                }
+                TextureArraySlot& slot = slots[tile.source];
+                slot.array = handle;
+                slot.layer = ( int) l;
+                slot.uvTransform = glm::vec4(( float) source.width / width, ( float) source.height / height, ( float) tile.x / width,
+                                             ( float) tile.y / height);
+            }
+        }
+    }
+};
+
+///
+/// The arrays bound to each class's unit, so meshes sharing them don't bind them again.
+///
+struct TextureArrayBindings
+{
+    std::weak_ptr<GpuTexture> bound[MATERIAL_CLASS_COUNT];
+    size_t binds = 0;   // Array binds made, for checking batching works.
+};
+
+inline TextureArrayBindings& SharedTextureArrayBindings()
+{
+    static TextureArrayBindings bindings;
+    return bindings;
+}
+
+///
+/// Makes a mesh's material current: binds the arrays that aren't already bound and sets the layer and atlas
+/// transform attributes. The shader's samplers must be set to the units of their classes.
+///
+inline void BindMaterialLayers(const MaterialLayers& material)
+{
+    TextureArrayBindings& bindings = SharedTextureArrayBindings();
+    float layers[MATERIAL_CLASS_COUNT];
+    for(int c = 0; c < MATERIAL_CLASS_COUNT; c++)
+    {
+        const TextureArraySlot& slot = material.slots[c];
+        layers[c] = ( float) slot.layer;
+        glVertexAttrib4fv(MATERIAL_TRANSFORM_ATTRIBUTE + c, &slot.uvTransform[0]);
+        if(slot.array && bindings.bound[c].lock() != slot.array)
+        {
+            glActiveTexture(GL_TEXTURE0 + c);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, slot.array->ID());
+            bindings.bound[c] = slot.array;
+            bindings.binds++;
+        }
+    }
+    glVertexAttrib4fv(MATERIAL_LAYER_ATTRIBUTE, layers);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,388 @@
+#ifndef TEXTURECODEC_H
+#define TEXTURECODEC_H
+
+#include <BlockCompression/blockcompression.h>
+#include <MeshCodec/meshcodec.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Supercompression of block compressed images for storage, built from the mesh codec's streams and its entropy
+// stage. The blocks stay in the format the GPU samples, so decoding only undoes the filtering and never fits
+// anything.
+//
+// Each block is split into its endpoints and its indices. Endpoints are replaced by their difference from the same
+// endpoint of the block on the left, channel by channel, so smooth areas and runs of blocks that reuse their
+// neighbour's endpoints (see CompressImage's reuse tolerance) turn into streams of zeros. Every row starts from zero,
+// which keeps the rows independent so they're rebuilt across the worker threads. Indices are close to random and go
+// into a stream of their own, where they gain a little.
+//
+// A BC7 block's endpoints can be stored in either order, with its indices inverted to match, so the full 4 bits of
+// the first index are kept. The encoder picks whichever order is closer to the block on the left, which undoes the
+// swap the block's packing makes to keep the first index's top bit clear.
+
+// Parts of a block that are coded alike.
+enum TextureCodecPart
+{
+    TEXTURE_CODEC_PART_BC1,     // Two 5:6:5 colours and 2 bit indices.
+    TEXTURE_CODEC_PART_BC4,     // Two 8 bit values and 3 bit indices.
+    TEXTURE_CODEC_PART_BC7      // A mode 6 block: two 7 bit RGBA endpoints, their low bits and 4 bit indices.
+};
+
+// Channels of each part's endpoints, and the bytes its indices take.
+const int TEXTURE_CODEC_CHANNELS[3] = { 3, 1, 4 };
+const int TEXTURE_CODEC_INDEX_BYTES[3] = { 4, 6, 8 };
+
+// The fields of one part of a block.
+struct TextureCodecFields
+{
+    int endpoints[2][4];
+    int pBits;                  // BC7's low bits, the first endpoint's in bit 0.
+    unsigned char indices[8];   // The indices as packed in the block; two to a byte for BC7, first index in full.
+};
+
+///
+/// Returns the mask of an endpoint channel's bits.
+///
+inline int TextureCodecEndpointMask(TextureCodecPart part, int channel)
+{
+    if(part == TEXTURE_CODEC_PART_BC1)
+    {
+        return channel == 1 ? 0x3F : 0x1F;
+    }
+    return part == TEXTURE_CODEC_PART_BC4 ? 0xFF : 0x7F;
+}
+
+///
+/// Lists the parts a format's blocks are made of.
+/// \param parts - receives the parts.
+/// \param offsets - receives where each part starts in the block.
+/// \return - the number of parts.
+///
+inline int TextureCodecParts(BlockFormat format, TextureCodecPart parts[2], size_t offsets[2])
+{
+    offsets[0] = 0;
+    offsets[1] = 8;
+    switch(format)
+    {
+    case BLOCK_FORMAT_BC1:
+        parts[0] = TEXTURE_CODEC_PART_BC1;
+        return 1;
+    case BLOCK_FORMAT_BC3:
+        parts[0] = TEXTURE_CODEC_PART_BC4;
+        parts[1] = TEXTURE_CODEC_PART_BC1;
+        return 2;
+    case BLOCK_FORMAT_BC4:
+        parts[0] = TEXTURE_CODEC_PART_BC4;
+        return 1;
+    case BLOCK_FORMAT_BC5:
+        parts[0] = TEXTURE_CODEC_PART_BC4;
+        parts[1] = TEXTURE_CODEC_PART_BC4;
+        return 2;
+    case BLOCK_FORMAT_BC7:
+        parts[0] = TEXTURE_CODEC_PART_BC7;
+        return 1;
+    }
+    return 0;
+}
+
+///
+/// Splits a part of a block into its fields.
+/// \return - false for a BC7 block in any mode but 6.
+///
+inline bool UnpackTextureCodecPart(TextureCodecPart part, const unsigned char* block, TextureCodecFields& fields)
+{
+    std::memset(&fields, 0, sizeof(fields));
+    if(part == TEXTURE_CODEC_PART_BC1)
+    {
+        for(int e = 0; e < 2; e++)
+        {
+            int colour = block[e * 2] | block[e * 2 + 1] << 8;
+            fields.endpoints[e][0] = colour >> 11;
+            fields.endpoints[e][1] = (colour >> 5) & 0x3F;
+            fields.endpoints[e][2] = colour & 0x1F;
+        }
+        std::memcpy(fields.indices, block + 4, 4);
+        return true;
+    }
+    if(part == TEXTURE_CODEC_PART_BC4)
+    {
+        fields.endpoints[0][0] = block[0];
+        fields.endpoints[1][0] = block[1];
+        std::memcpy(fields.indices, block + 2, 6);
+        return true;
+    }
+
+    Bc7Mode6Block bc7;
+    if(!UnpackBc7Block(block, bc7))
+    {
+        return false;
+    }
+    std::memcpy(fields.endpoints, bc7.endpoints, sizeof(bc7.endpoints));
+    fields.pBits = bc7.pBits[0] | bc7.pBits[1] << 1;
+    for(int i = 0; i < 8; i++)
+    {
+        fields.indices[i] = ( unsigned char) (bc7.indices[i * 2] | bc7.indices[i * 2 + 1] << 4);
+    }
+    return true;
+}
+
+///
+/// Packs a part of a block from its fields.
+///
+inline void PackTextureCodecPart(TextureCodecPart part, const TextureCodecFields& fields, unsigned char* block)
+{
+    if(part == TEXTURE_CODEC_PART_BC1)
+    {
+        for(int e = 0; e < 2; e++)
+        {
+            int colour = fields.endpoints[e][0] << 11 | fields.endpoints[e][1] << 5 | fields.endpoints[e][2];
+            block[e * 2] = ( unsigned char) colour;
+            block[e * 2 + 1] = ( unsigned char) (colour >> 8);
+        }
+        std::memcpy(block + 4, fields.indices, 4);
+        return;
+    }
+    if(part == TEXTURE_CODEC_PART_BC4)
+    {
+        block[0] = ( unsigned char) fields.endpoints[0][0];
+        block[1] = ( unsigned char) fields.endpoints[1][0];
+        std::memcpy(block + 2, fields.indices, 6);
+        return;
+    }
+
+    Bc7Mode6Block bc7;
+    std::memcpy(bc7.endpoints, fields.endpoints, sizeof(bc7.endpoints));
+    bc7.pBits[0] = fields.pBits & 1;
+    bc7.pBits[1] = (fields.pBits >> 1) & 1;
+    for(int i = 0; i < 8; i++)
+    {
+        bc7.indices[i * 2] = fields.indices[i] & 15;
+        bc7.indices[i * 2 + 1] = fields.indices[i] >> 4;
+    }
+    PackBc7Block(bc7, block);
+}
+
+///
+/// Sum of the differences between two parts' endpoints, each taken the short way round its channel's range.
+///
+inline int TextureCodecEndpointDistance(TextureCodecPart part, const TextureCodecFields& fields, const TextureCodecFields& previous)
+{
+    int distance = 0;
+    for(int e = 0; e < 2; e++)
+    {
+        for(int c = 0; c < TEXTURE_CODEC_CHANNELS[part]; c++)
+        {
+            int mask = TextureCodecEndpointMask(part, c);
+            int difference = (fields.endpoints[e][c] - previous.endpoints[e][c]) & mask;
+            distance += std::min(difference, mask + 1 - difference);
+        }
+    }
+    return distance;
+}
+
+///
+/// Lists the size of each of an image's streams, in the order they're stored.
+///
+inline std::vector<size_t> TextureCodecStreamSizes(BlockFormat format, size_t blockCount)
+{
+    TextureCodecPart parts[2];
+    size_t offsets[2];
+    int partCount = TextureCodecParts(format, parts, offsets);
+    std::vector<size_t> sizes;
+    for(int p = 0; p < partCount; p++)
+    {
+        for(int c = 0; c < TEXTURE_CODEC_CHANNELS[parts[p]]; c++)
+        {
+            sizes.push_back(blockCount * 2);
+        }
+        if(parts[p] == TEXTURE_CODEC_PART_BC7)
+        {
+            sizes.push_back(blockCount);
+        }
+        sizes.push_back(blockCount * TEXTURE_CODEC_INDEX_BYTES[parts[p]]);
+    }
+    return sizes;
+}
+
+///
+/// Encodes a block compressed image. Images compressed with a reuse tolerance encode smallest.
+/// \param blocks - the image, CompressedImageSize bytes.
+/// \param format - its format.
+/// \param out - receives the encoded image.
+/// \return - false if a BC7 block isn't in mode 6.
+///
+inline bool EncodeBlockImage(const unsigned char* blocks, int width, int height, BlockFormat format, std::vector<unsigned char>& out)
+{
+    out.clear();
+    TextureCodecPart parts[2];
+    size_t offsets[2];
+    int partCount = TextureCodecParts(format, parts, offsets);
+    size_t blocksWide = (( size_t) width + 3) / 4;
+    size_t blocksHigh = (( size_t) height + 3) / 4;
+    size_t blockCount = blocksWide * blocksHigh;
+    size_t blockBytes = BlockFormatBytes(format);
+
+    std::vector<size_t> sizes = TextureCodecStreamSizes(format, blockCount);
+    std::vector<std::vector<unsigned char>> streams(sizes.size());
+    for(size_t s = 0; s < sizes.size(); s++)
+    {
+        streams[s].resize(sizes[s]);
+    }
+
+    for(size_t blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        TextureCodecFields previous[2] = {};
+        for(size_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            size_t block = blockY * blocksWide + blockX;
+            size_t stream = 0;
+            for(int p = 0; p < partCount; p++)
+            {
+                TextureCodecPart part = parts[p];
+                TextureCodecFields fields;
+                if(!UnpackTextureCodecPart(part, blocks + block * blockBytes + offsets[p], fields))
+                {
+                    out.clear();
+                    return false;
+                }
+                if(part == TEXTURE_CODEC_PART_BC7)
+                {
+                    TextureCodecFields swapped = fields;
+                    std::swap(swapped.endpoints[0], swapped.endpoints[1]);
+                    swapped.pBits = (fields.pBits >> 1) | (fields.pBits & 1) << 1;
+                    for(int i = 0; i < 8; i++)
+                    {
+                        swapped.indices[i] ^= 0xFF;
+                    }
+                    if(TextureCodecEndpointDistance(part, swapped, previous[p]) < TextureCodecEndpointDistance(part, fields, previous[p]))
+                    {
+                        fields = swapped;
+                    }
+                }
+
+                for(int c = 0; c < TEXTURE_CODEC_CHANNELS[part]; c++, stream++)
+                {
+                    int mask = TextureCodecEndpointMask(part, c);
+                    for(int e = 0; e < 2; e++)
+                    {
+                        streams[stream][block * 2 + e] = ( unsigned char) ((fields.endpoints[e][c] - previous[p].endpoints[e][c]) & mask);
+                    }
+                }
+                if(part == TEXTURE_CODEC_PART_BC7)
+                {
+                    streams[stream++][block] = ( unsigned char) fields.pBits;
+                }
+                int indexBytes = TEXTURE_CODEC_INDEX_BYTES[part];
+                std::memcpy(streams[stream++].data() + block * indexBytes, fields.indices, indexBytes);
+                previous[p] = fields;
+            }
+        }
+    }
+
+    for(const std::vector<unsigned char>& stream : streams)
+    {
+        WriteCodecStream(out, stream.data(), stream.size());
+    }
+    return true;
+}
+
+///
+/// Decodes a block compressed image written by EncodeBlockImage. The streams are decoded alongside each other and
+/// the rows are then rebuilt across the worker threads.
+/// \param encoded - the encoded image.
+/// \param size - size of the encoded image.
+/// \param format - its format.
+/// \param blocks - receives the image, CompressedImageSize bytes.
+/// \param scratch - space for entropy coded streams, reused between calls.
+/// \return - false if the data is damaged or isn't an image of this size.
+///
+inline bool DecodeBlockImage(const unsigned char* encoded, size_t size, int width, int height, BlockFormat format, unsigned char* blocks,
+                             std::vector<unsigned char>& scratch)
+{
+    TextureCodecPart parts[2];
+    size_t offsets[2];
+    int partCount = TextureCodecParts(format, parts, offsets);
+    size_t blocksWide = (( size_t) width + 3) / 4;
+    size_t blocksHigh = (( size_t) height + 3) / 4;
+    size_t blockBytes = BlockFormatBytes(format);
+
+    std::vector<size_t> sizes = TextureCodecStreamSizes(format, blocksWide * blocksHigh);
+    size_t total = 0;
+    for(size_t streamSize : sizes)
+    {
+        total += streamSize;
+    }
+    scratch.resize(total);
+
+    // Find every stream first, then decode them alongside each other.
+    std::vector<const unsigned char*> starts(sizes.size());
+    std::vector<size_t> streamOffsets(sizes.size());
+    const unsigned char* in = encoded;
+    const unsigned char* end = encoded + size;
+    size_t offset = 0;
+    for(size_t s = 0; s < sizes.size(); s++)
+    {
+        starts[s] = in;
+        streamOffsets[s] = offset;
+        offset += sizes[s];
+        if(!SkipCodecStream(in, end))
+        {
+            return false;
+        }
+    }
+    if(in != end)
+    {
+        return false;
+    }
+    std::vector<const unsigned char*> streams(sizes.size());
+    std::atomic<bool> decoded(true);
+    ParallelFor(sizes.size(), [&](size_t s)
+    {
+        if(!ReadCodecStream(starts[s], end, sizes[s], scratch.data() + streamOffsets[s], streams[s]))
+        {
+            decoded = false;
+        }
+    });
+    if(!decoded)
+    {
+        return false;
+    }
+
+    ParallelFor(blocksHigh, [&](size_t blockY)
+    {
+        TextureCodecFields previous[2] = {};
+        for(size_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            size_t block = blockY * blocksWide + blockX;
+            size_t stream = 0;
+            for(int p = 0; p < partCount; p++)
+            {
+                TextureCodecPart part = parts[p];
+                TextureCodecFields& fields = previous[p];
+                for(int c = 0; c < TEXTURE_CODEC_CHANNELS[part]; c++, stream++)
+                {
+                    int mask = TextureCodecEndpointMask(part, c);
+                    for(int e = 0; e < 2; e++)
+                    {
+                        fields.endpoints[e][c] = (fields.endpoints[e][c] + streams[stream][block * 2 + e]) & mask;
+                    }
+                }
+                if(part == TEXTURE_CODEC_PART_BC7)
+                {
+                    fields.pBits = streams[stream++][block] & 3;
+                }
+                int indexBytes = TEXTURE_CODEC_INDEX_BYTES[part];
+                std::memcpy(fields.indices, streams[stream++] + block * indexBytes, indexBytes);
+                PackTextureCodecPart(part, fields, blocks + block * blockBytes + offsets[p]);
+            }
+        }
+    });
+    return true;
+}
+
+#endif
\ No newline at end of file
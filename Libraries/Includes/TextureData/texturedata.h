@@ -0,0 +1,199 @@
+#ifndef TEXTUREDATA_H
+#define TEXTUREDATA_H
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <AssetPack/assetpack.h>
+#include <ImageCache/imagecache.h>
+#include <Ktx/ktx.h>
+#include <VirtualFileSystem/virtualfilesystem.h>
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Everything about loading a texture that happens before GL is involved: reading the image, from an asset pack or
+// the file, and decoding it to pixels, or reading the block compressed KTX2 file the texture cooker made of it.
+// Nothing here touches shared state, stb_image's global flip included, so any number of images can be decoded at once
+// on worker threads.
+
+// An image decoded to 8 bit pixels, or a block compressed one, waiting to be uploaded.
+struct DecodedTexture
+{
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    vector<unsigned char> pixels;   // The pixels, top row first, or the KTX2 file or levels of a compressed image.
+    KtxTexture compressed;          // The mip levels in pixels of a block compressed image, none otherwise.
+};
+
+///
+/// The KTX2 file the texture cooker writes for an image: the same path with a .ktx2 extension.
+///
+inline string KtxPath(const string& filename)
+{
+    size_t extension = filename.find_last_of('.');
+    size_t separator = filename.find_last_of("/\\");
+    if(extension == string::npos || (separator != string::npos && extension < separator))
+    {
+        return filename + ".ktx2";
+    }
+    return filename.substr(0, extension) + ".ktx2";
+}
+
+///
+/// Reads a block compressed KTX2 file, from a mounted asset pack or the file. The file is kept whole and the levels
+/// are uploaded straight out of it, unless they're supercompressed, when they're decompressed here first.
+/// \param filename - the KTX2 file's path.
+/// \param texture - receives the file and its levels.
+/// \return - false if there's no such file, or it couldn't be used, which is reported.
+///
+inline bool ReadKtxTexture(const string& filename, DecodedTexture& texture)
+{
+    vector<unsigned char> file;
+    if(!ReadAsset(filename, file))
+    {
+        return false;
+    }
+    KtxTexture compressed;
+    if(!ParseKtx2(file.data(), file.size(), compressed))
+    {
+        cout << "ERROR::KTX:: " << filename << " is damaged or not a block compressed 2D texture" << endl;
+        return false;
+    }
+    if(compressed.supercompression != KTX_SUPERCOMPRESSION_NONE)
+    {
+        vector<unsigned char> levels;
+        if(!DecompressKtx2Levels(file.data(), compressed, levels))
+        {
+            cout << "ERROR::KTX:: " << filename << " has a damaged supercompressed level" << endl;
+            return false;
+        }
+        file.swap(levels);
+    }
+
+    static const int COMPONENTS[] = { 3, 4, 1, 2, 4 };
+    texture.width = compressed.width;
+    texture.height = compressed.height;
+    texture.components = COMPONENTS[compressed.blockFormat];
+    texture.pixels.swap(file);
+    texture.compressed = compressed;
+    return true;
+}
+
+///
+/// Decodes an image file already in memory, e.g. one embedded in a model. Touches no GL state.
+/// \param bytes - the image file.
+/// \param size - its size in bytes.
+/// \param texture - receives the pixels.
+/// \return - false if the image couldn't be decoded.
+///
+inline bool DecodeTextureMemory(const unsigned char* bytes, size_t size, DecodedTexture& texture)
+{
+    if(size > ( size_t) INT_MAX)
+    {
+        return false;
+    }
+    unsigned char* data = stbi_load_from_memory(bytes, ( int) size, &texture.width, &texture.height, &texture.components, 0);
+    if(!data)
+    {
+        return false;
+    }
+    texture.pixels.assign(data, data + ( size_t) texture.width * texture.height * texture.components);
+    stbi_image_free(data);
+    return true;
+}
+
+///
+/// Reads and decodes an image, from a mounted asset pack or the file. Packs hold images the cooker has already
+/// decoded, and a KTX2 file the texture cooker wrote next to the image takes its place. Loose images are decoded once
+/// and kept next to themselves in the image cache, see ImageCache, which later runs read instead. Touches no GL
+/// state, so it can run on any thread.
+/// \param filename - the image's path.
+/// \param texture - receives the pixels.
+/// \return - false if the image couldn't be read or decoded.
+///
+inline bool DecodeTexture(const string& filename, DecodedTexture& texture)
+{
+    // A block compressed version cooked next to the image is used in its place.
+    if(ReadKtxTexture(KtxPath(filename), texture))
+    {
+        return true;
+    }
+
+    // A loose image's cache is keyed by its size and modification time, so a warm run reads only the cache and an
+    // edited image is decoded again. Packed images are left to the asset cooker.
+    const AssetPack* pack = NULL;
+    bool packed = FindPackedAsset(filename, &pack) != NULL;
+    string cachePath = filename + IMAGE_CACHE_EXTENSION;
+    uint64_t key = 0;
+    bool keyed = !packed && ImageCacheKey(filename, key);
+    if(keyed && ReadImageCache(cachePath, key, texture.width, texture.height, texture.components, texture.pixels))
+    {
+        return true;
+    }
+
+    vector<unsigned char> file;
+    uint32_t flags = 0;
+    if(!ReadAsset(filename, file, &flags))
+    {
+        return false;
+    }
+
+    if(flags & ASSET_FLAG_DECODED_TEXTURE)
+    {
+        DecodedTextureHeader decoded;
+        if(file.size() < sizeof(decoded))
+        {
+            return false;
+        }
+        std::memcpy(&decoded, file.data(), sizeof(decoded));
+        if(( uint64_t) decoded.width * decoded.height * decoded.components != file.size() - sizeof(decoded))
+        {
+            return false;
+        }
+        texture.width = ( int) decoded.width;
+        texture.height = ( int) decoded.height;
+        texture.components = ( int) decoded.components;
+        texture.pixels.assign(file.begin() + sizeof(decoded), file.end());
+        return true;
+    }
+
+    if(!DecodeTextureMemory(file.data(), file.size(), texture))
+    {
+        return false;
+    }
+    // Where the cache can't be written, e.g. a read only directory, the image is simply decoded again next time.
+    if(keyed)
+    {
+        WriteImageCache(cachePath, key, texture.pixels.data(), texture.width, texture.height, texture.components);
+    }
+    return true;
+}
+
+///
+/// Flips an image upside down in place, for images drawn with texture coordinates that start at the bottom. Done
+/// here rather than with stbi_set_flip_vertically_on_load, which is global and so races with other decodes. Block
+/// compressed images are left as they are, the texture cooker flips those before compressing them.
+/// \param texture - the image to flip.
+///
+inline void FlipTextureRows(DecodedTexture& texture)
+{
+    size_t rowSize = ( size_t) texture.width * texture.components;
+    if(!texture.compressed.levels.empty() || texture.pixels.size() != rowSize * texture.height)
+    {
+        return;
+    }
+    for(int top = 0, bottom = texture.height - 1; top < bottom; top++, bottom--)
+    {
+        std::swap_ranges(texture.pixels.begin() + top * rowSize, texture.pixels.begin() + (top + 1) * rowSize,
+                         texture.pixels.begin() + bottom * rowSize);
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,712 @@
+#ifndef TEXTURERESIDENCY_H
+#define TEXTURERESIDENCY_H
+
+#include <glad/glad.h>
+
+#include <MipChain/mipchain.h>
+#include <Model/model.h>
+#include <TextureStreamer/texturestreamer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Textures are loaded with their whole mip chain, so the memory they take grows with the scene and has no ceiling.
+// The residency manager keeps each texture it tracks only as fine as the frame needs and the budget allows. Levels
+// finer than a texture is drawn at are dropped when room is needed, least recently used texture first, and levels
+// that are needed again are read back on worker threads and uploaded a few a frame. GL_TEXTURE_BASE_LEVEL hides the
+// levels that aren't resident, and GL_TEXTURE_MIN_LOD fades in the ones that arrive rather than letting them pop.
+
+// Default memory the tracked textures may take.
+const uint64_t TEXTURE_RESIDENCY_BUDGET_BYTES = 64 * 1024 * 1024;
+
+// Levels this size or smaller are never dropped, so a texture can always be drawn.
+const int TEXTURE_RESIDENCY_TAIL_SIZE = 64;
+
+// How far GL_TEXTURE_MIN_LOD moves towards the finest resident level each Update, in levels.
+const float TEXTURE_RESIDENCY_FADE_STEP = 0.125f;
+
+///
+/// The finest mip level a texture needs where it's drawn, i.e. the one minified to about a texel a pixel.
+/// \param width, height - the texture's size.
+/// \param worldSize - the distance its UV range spans in world units, e.g. the diameter of the mesh it covers.
+/// \param distance - from the camera to the nearest point of the surface.
+/// \param projectionScale - pixels a world unit covers one unit from the camera: viewport height / (2 tan(fovy / 2)).
+/// \return - the level, 0 for the image itself.
+///
+inline unsigned int RequiredMipLevel(int width, int height, float worldSize, float distance, float projectionScale)
+{
+    if(distance <= 0.0f)
+    {
+        return 0;
+    }
+    float pixels = worldSize * projectionScale / distance;
+    float texels = ( float) std::max(width, height);
+    if(pixels >= texels)
+    {
+        return 0;
+    }
+    return ( unsigned int) std::floor(std::log2(texels / std::max(pixels, 1.0f)));
+}
+
+///
+/// Memory and traffic of a TextureResidency, for its telemetry.
+///
+struct TextureResidencyStats
+{
+    size_t textures = 0;            // Textures tracked.
+    size_t starved = 0;             // Textures drawn last frame with coarser levels than they need.
+    size_t pendingReads = 0;        // Textures having dropped levels read back.
+    uint64_t budgetBytes = 0;       // Memory the tracked textures may take.
+    uint64_t residentBytes = 0;     // Memory their resident levels take.
+    uint64_t wantedBytes = 0;       // Memory the levels last frame needed would take.
+    uint64_t fullBytes = 0;         // Memory every level of every texture would take.
+    size_t levelsLoaded = 0;        // Levels read back and uploaded.
+    uint64_t bytesLoaded = 0;
+    size_t levelsEvicted = 0;       // Levels dropped to make room.
+    uint64_t bytesEvicted = 0;
+    double readMilliseconds = 0;    // Reading and decoding, summed over the workers.
+    double uploadMilliseconds = 0;  // Uploading and evicting on the context thread.
+};
+
+///
+/// Keeps the textures it tracks within a memory budget by streaming their finest mip levels in and out. Each frame,
+/// tell it which textures are drawn and how large, with RequestModel or Request, then call Update. Textures keep
+/// their IDs throughout, dropped levels are respecified empty and the base level raised past them, so nothing that
+/// holds a texture notices. Only use it on the context's thread; the reads happen on its own workers.
+///
+class TextureResidency
+{
+public:
+    ///
+    /// Starts the worker threads.
+    /// \param budgetBytes - memory the tracked textures may take.
+    /// \param workerCount - number of images read back at once.
+    ///
+    explicit TextureResidency(uint64_t budgetBytes = TEXTURE_RESIDENCY_BUDGET_BYTES, unsigned int workerCount = 1) : budget(budgetBytes)
+    {
+        for(unsigned int i = 0; i < std::max(workerCount, 1u); i++)
+        {
+            workers.push_back(std::thread(&TextureResidency::workerLoop, this));
+        }
+    }
+
+    ///
+    /// Stops the workers once they finish the reads in progress. Textures are left with whatever levels they have.
+    ///
+    ~TextureResidency()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Workers hold a pointer to the manager.
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+    ///
+    /// Starts managing a texture's mip chain. Only a weak reference is kept, the texture is forgotten once freed.
+    /// \param texture - a 2D texture with its whole chain resident.
+    /// \param path - the image it was loaded from, read again for levels that were dropped.
+    /// \param flags - the TextureLoadFlags it was loaded with.
+    /// \return - false if it's already tracked or has no levels to drop.
+    ///
+    bool Track(const std::shared_ptr<GpuTexture>& texture, const std::string& path, uint32_t flags = 0)
+    {
+        if(!texture || entries.count(texture.get()) != 0)
+        {
+            return false;
+        }
+
+        std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+        glBindTexture(GL_TEXTURE_2D, texture->ID());
+        GLint width = 0, height = 0, internalFormat = 0, compressed = 0, maxLevel = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        for(GLint level = 0; level <= maxLevel; level++)
+        {
+            GLint levelWidth = 0, levelHeight = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &levelWidth);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &levelHeight);
+            if(levelWidth == 0 || levelHeight == 0)
+            {
+                break;
+            }
+
+            GLint bytes = 0;
+            if(compressed)
+            {
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+            }
+            else
+            {
+                GLint bits = 0;
+                for(GLenum size : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE })
+                {
+                    GLint componentBits = 0;
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, size, &componentBits);
+                    bits += componentBits;
+                }
+                bytes = levelWidth * levelHeight * (bits / 8);
+            }
+            entry->levelBytes.push_back(( uint64_t) bytes);
+            if(std::max(levelWidth, levelHeight) <= TEXTURE_RESIDENCY_TAIL_SIZE && entry->tail == 0)
+            {
+                entry->tail = ( unsigned int) level;
+            }
+            if(levelWidth == 1 && levelHeight == 1)
+            {
+                break;
+            }
+        }
+        if(entry->levelBytes.size() < 2 || entry->tail == 0)
+        {
+            return false;
+        }
+
+        entry->texture = texture;
+        entry->id = texture->ID();
+        entry->path = path;
+        entry->flags = flags;
+        entry->internalFormat = ( GLenum) internalFormat;
+        entry->compressed = compressed != 0;
+        entry->width = width;
+        entry->height = height;
+        entry->wanted = entry->tail;
+        for(uint64_t bytes : entry->levelBytes)
+        {
+            resident += bytes;
+        }
+        entries[texture.get()] = entry;
+        return true;
+    }
+
+    ///
+    /// Tracks every texture a model loaded from a file, and measures its meshes for RequestModel. Images embedded in
+    /// a binary glTF file can't be read again on their own, so those stay whole.
+    ///
+    void TrackModel(const Model& model)
+    {
+        for(const Texture& texture : model.textures_loaded)
+        {
+            if(texture.resource && !texture.path.empty() && texture.path[0] != '#')
+            {
+                Track(texture.resource, model.directory + '/' + texture.path);
+            }
+        }
+
+        vector<MeshSphere>& spheres = models[&model];
+        spheres.clear();
+        for(const Mesh& mesh : model.meshes)
+        {
+            spheres.push_back(measureMesh(mesh));
+        }
+    }
+
+    ///
+    /// Stops measuring a model for RequestModel, e.g. before it's destroyed. Its textures stay tracked while they live.
+    ///
+    void UntrackModel(const Model& model)
+    {
+        models.erase(&model);
+    }
+
+    ///
+    /// Records that a texture is drawn this frame, and the finest level it needs.
+    ///
+    void Request(const GpuTexture* texture, unsigned int level)
+    {
+        auto found = entries.find(texture);
+        if(found != entries.end())
+        {
+            Entry& entry = *found->second;
+            entry.wanted = std::min(entry.wanted, level);
+            entry.lastUsed = frame;
+        }
+    }
+
+    ///
+    /// Records the levels a tracked model's textures need where it's drawn this frame. Each texture is taken to span
+    /// the bounding sphere of its mesh once. Node transforms are left out, which suits models whose nodes don't scale.
+    /// \param model - the model, tracked with TrackModel.
+    /// \param modelMatrix - its transform.
+    /// \param eye - the camera's position.
+    /// \param projectionScale - viewport height in pixels / (2 tan(fovy / 2)).
+    ///
+    void RequestModel(const Model& model, const glm::mat4& modelMatrix, const glm::vec3& eye, float projectionScale)
+    {
+        auto found = models.find(&model);
+        if(found == models.end())
+        {
+            return;
+        }
+
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        for(size_t i = 0; i < model.meshes.size() && i < found->second.size(); i++)
+        {
+            const MeshSphere& sphere = found->second[i];
+            float radius = sphere.radius * scale;
+            float distance = glm::length(eye - glm::vec3(modelMatrix * glm::vec4(sphere.centre, 1.0f))) - radius;
+            for(const Texture& texture : model.meshes[i].textures)
+            {
+                auto entry = entries.find(texture.resource.get());
+                if(entry != entries.end())
+                {
+                    // A mesh that couldn't be measured needs its textures whole.
+                    unsigned int level = radius > 0.0f ? RequiredMipLevel(entry->second->width, entry->second->height, 2.0f * radius, distance, projectionScale) : 0;
+                    Request(texture.resource.get(), level);
+                }
+            }
+        }
+    }
+
+    ///
+    /// Brings the tracked textures towards the levels this frame's requests need: uploads levels that have been read
+    /// back until the frame's budget is spent, drops levels to stay within the memory budget, queues reads for
+    /// textures that need finer levels than they have, and eases in levels that arrived earlier. Call once a frame,
+    /// after the requests.
+    /// \param frameBudget - limits on this frame's uploads.
+    ///
+    void Update(const StreamingBudget& frameBudget = StreamingBudget())
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // Forget textures nothing holds any more.
+        for(auto i = entries.begin(); i != entries.end();)
+        {
+            if(i->second->texture.expired())
+            {
+                resident -= residentBytes(*i->second);
+                i = entries.erase(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        for(auto& tracked : entries)
+        {
+            Entry& entry = *tracked.second;
+            if(entry.minLod > 0.0f)
+            {
+                setMinLod(entry, std::max(entry.minLod - TEXTURE_RESIDENCY_FADE_STEP, 0.0f));
+            }
+        }
+
+        size_t bytes = 0;
+        bool uploaded = false;
+        while(true)
+        {
+            std::shared_ptr<Read> read;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(finished.empty())
+                {
+                    break;
+                }
+                read = finished.front();
+            }
+
+            Entry& entry = *read->entry;
+            size_t itemBytes = entry.base > entry.wanted ? ( size_t) levelRangeBytes(entry, entry.wanted, entry.base) : 0;
+            if(uploaded && itemBytes > 0
+               && (bytes + itemBytes > frameBudget.bytes
+                   || std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= frameBudget.milliseconds))
+            {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.pop_front();
+            }
+            entry.reading = false;
+            if(read->failed)
+            {
+                // Don't try again, the texture keeps what it has.
+                std::cout << "ERROR::TEXTURE::RESIDENCY:: couldn't read levels back from " << entry.path << std::endl;
+                entry.path.clear();
+                continue;
+            }
+            if(!entry.texture.expired() && itemBytes > 0)
+            {
+                bytes += upload(entry, *read);
+                uploaded = true;
+            }
+        }
+
+        // Textures that need finer levels than they have get them read back, as long as there's room for at least
+        // the next level, or levels that aren't needed that could make room. Otherwise it would only be read to be
+        // thrown away.
+        uint64_t droppable = 0;
+        for(auto& tracked : entries)
+        {
+            droppable += levelRangeBytes(*tracked.second, tracked.second->base, tracked.second->wanted);
+        }
+        uint64_t room = (resident < budget ? budget - resident : 0) + droppable;
+        size_t queuedReads = 0;
+        for(auto& tracked : entries)
+        {
+            Entry& entry = *tracked.second;
+            if(entry.wanted < entry.base && !entry.reading && !entry.path.empty() && entry.levelBytes[entry.base - 1] <= room)
+            {
+                std::shared_ptr<Read> read = std::make_shared<Read>();
+                read->entry = tracked.second;
+                read->path = entry.path;
+                read->flags = entry.flags;
+                entry.reading = true;
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.push_back(read);
+                queuedReads++;
+            }
+        }
+        if(queuedReads > 0)
+        {
+            queueChanged.notify_all();
+        }
+
+        // Textures tracked, or a budget lowered, since the last frame can leave too much resident.
+        makeRoom(0, NULL, true);
+
+        // Gather this frame's telemetry and start the next frame's requests afresh.
+        lastFrame = TextureResidencyStats();
+        for(auto& tracked : entries)
+        {
+            Entry& entry = *tracked.second;
+            lastFrame.starved += entry.base > entry.wanted ? 1 : 0;
+            lastFrame.pendingReads += entry.reading ? 1 : 0;
+            lastFrame.wantedBytes += levelRangeBytes(entry, entry.wanted, ( unsigned int) entry.levelBytes.size());
+            lastFrame.fullBytes += levelRangeBytes(entry, 0, ( unsigned int) entry.levelBytes.size());
+            entry.wanted = entry.tail;
+        }
+        totals.uploadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        frame++;
+    }
+
+    ///
+    /// Changes the memory budget. Levels are dropped to meet a lower one on the next Update.
+    ///
+    void SetBudget(uint64_t budgetBytes)
+    {
+        budget = budgetBytes;
+    }
+
+    TextureResidencyStats Stats()
+    {
+        TextureResidencyStats stats = lastFrame;
+        stats.textures = entries.size();
+        stats.budgetBytes = budget;
+        stats.residentBytes = resident;
+        stats.levelsLoaded = totals.levelsLoaded;
+        stats.bytesLoaded = totals.bytesLoaded;
+        stats.levelsEvicted = totals.levelsEvicted;
+        stats.bytesEvicted = totals.bytesEvicted;
+        stats.uploadMilliseconds = totals.uploadMilliseconds;
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.readMilliseconds = totals.readMilliseconds;
+        return stats;
+    }
+
+private:
+    // A tracked texture and how much of its chain is resident.
+    struct Entry
+    {
+        std::weak_ptr<GpuTexture> texture;
+        unsigned int id = 0;
+        std::string path;               // Where dropped levels are read back from, empty once that has failed.
+        uint32_t flags = 0;
+        GLenum internalFormat = 0;
+        bool compressed = false;
+        int width = 0;
+        int height = 0;
+        vector<uint64_t> levelBytes;    // Memory each level of the whole chain takes.
+        unsigned int tail = 0;          // Finest level that's never dropped.
+        unsigned int base = 0;          // Finest resident level.
+        unsigned int wanted = 0;        // Finest level this frame's requests need.
+        float minLod = 0.0f;            // GL_TEXTURE_MIN_LOD, easing towards 0 after levels arrive.
+        size_t lastUsed = 0;            // Frame it was last requested in.
+        bool reading = false;           // Levels are being read back.
+    };
+
+    // An image being read back for a texture's dropped levels.
+    struct Read
+    {
+        std::shared_ptr<Entry> entry;
+        std::string path;
+        uint32_t flags = 0;
+        DecodedTexture decoded;
+        vector<vector<unsigned char>> levels;   // An uncompressed image's chain, four components a pixel.
+        bool failed = false;
+    };
+
+    // Bounding sphere of a mesh in model space, with a radius of 0 if it couldn't be measured.
+    struct MeshSphere
+    {
+        glm::vec3 centre = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<std::shared_ptr<Read>> queued;       // Waiting for a worker.
+    std::deque<std::shared_ptr<Read>> finished;     // Read and waiting to be uploaded, oldest first.
+    bool stopping = false;
+
+    // Only touched on the context's thread.
+    std::unordered_map<const GpuTexture*, std::shared_ptr<Entry>> entries;
+    std::unordered_map<const Model*, vector<MeshSphere>> models;
+    uint64_t budget;
+    uint64_t resident = 0;
+    size_t frame = 1;
+    TextureResidencyStats lastFrame;
+    TextureResidencyStats totals;
+
+    // Memory levels [first, last) of a texture take.
+    static uint64_t levelRangeBytes(const Entry& entry, unsigned int first, unsigned int last)
+    {
+        uint64_t bytes = 0;
+        for(unsigned int level = first; level < last && level < entry.levelBytes.size(); level++)
+        {
+            bytes += entry.levelBytes[level];
+        }
+        return bytes;
+    }
+
+    static uint64_t residentBytes(const Entry& entry)
+    {
+        return levelRangeBytes(entry, entry.base, ( unsigned int) entry.levelBytes.size());
+    }
+
+    // Encloses a mesh's meshlets, or its vertices if it kept them, in a sphere.
+    static MeshSphere measureMesh(const Mesh& mesh)
+    {
+        MeshSphere sphere;
+        if(!mesh.meshlets.empty())
+        {
+            for(const Meshlet& meshlet : mesh.meshlets)
+            {
+                sphere.centre += meshlet.center;
+            }
+            sphere.centre /= ( float) mesh.meshlets.size();
+            for(const Meshlet& meshlet : mesh.meshlets)
+            {
+                sphere.radius = std::max(sphere.radius, glm::length(meshlet.center - sphere.centre) + meshlet.radius);
+            }
+        }
+        else if(!mesh.vertices.empty())
+        {
+            glm::vec3 minimum = mesh.vertices[0].Position;
+            glm::vec3 maximum = minimum;
+            for(const Vertex& vertex : mesh.vertices)
+            {
+                minimum = glm::min(minimum, vertex.Position);
+                maximum = glm::max(maximum, vertex.Position);
+            }
+            sphere.centre = (minimum + maximum) * 0.5f;
+            sphere.radius = glm::length(maximum - minimum) * 0.5f;
+        }
+        return sphere;
+    }
+
+    void setMinLod(Entry& entry, float minLod)
+    {
+        entry.minLod = minLod;
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, minLod);
+    }
+
+    // Frees a texture's finest resident level and raises its base level past it.
+    void dropLevel(Entry& entry)
+    {
+        unsigned int level = entry.base;
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        if(entry.compressed)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, ( GLint) level, entry.internalFormat, 0, 0, 0, 0, NULL);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, ( GLint) level, ( GLint) entry.internalFormat, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        entry.base++;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, ( GLint) entry.base);
+        // The clamp is relative to the base level, so it keeps the same absolute level.
+        setMinLod(entry, std::max(entry.minLod - 1.0f, 0.0f));
+
+        resident -= entry.levelBytes[level];
+        totals.levelsEvicted++;
+        totals.bytesEvicted += entry.levelBytes[level];
+    }
+
+    // Drops levels until another `bytes` fit in the budget. First goes whatever is finer than its texture needs,
+    // least recently used texture first. If that isn't enough and `wantedToo` is set, the finest level of the
+    // largest texture goes, one at a time, needed or not. The texture being loaded into is left alone.
+    // Returns the room there is.
+    uint64_t makeRoom(uint64_t bytes, const Entry* keep, bool wantedToo)
+    {
+        if(resident + bytes > budget)
+        {
+            vector<Entry*> byAge;
+            for(auto& tracked : entries)
+            {
+                if(tracked.second.get() != keep)
+                {
+                    byAge.push_back(tracked.second.get());
+                }
+            }
+            std::sort(byAge.begin(), byAge.end(), [](const Entry* a, const Entry* b) { return a->lastUsed < b->lastUsed; });
+            for(Entry* entry : byAge)
+            {
+                while(resident + bytes > budget && entry->base < entry->wanted && !entry->path.empty())
+                {
+                    dropLevel(*entry);
+                }
+            }
+
+            while(wantedToo && resident + bytes > budget)
+            {
+                Entry* largest = NULL;
+                for(Entry* entry : byAge)
+                {
+                    if(entry->base < entry->tail && !entry->path.empty()
+                       && (largest == NULL || entry->levelBytes[entry->base] > largest->levelBytes[largest->base]))
+                    {
+                        largest = entry;
+                    }
+                }
+                if(largest == NULL)
+                {
+                    break;
+                }
+                dropLevel(*largest);
+            }
+        }
+        return resident < budget ? budget - resident : 0;
+    }
+
+    // Uploads the levels a texture needs from an image read back for it, as many as fit in the budget, coarsest
+    // first. Returns the bytes uploaded.
+    size_t upload(Entry& entry, const Read& read)
+    {
+        unsigned int target = entry.wanted;
+        uint64_t room = makeRoom(levelRangeBytes(entry, target, entry.base), &entry, false);
+        while(target < entry.base && levelRangeBytes(entry, target, entry.base) > room)
+        {
+            target++;
+        }
+        if(target == entry.base)
+        {
+            return 0;
+        }
+
+        size_t bytes = 0;
+        unsigned int previousBase = entry.base;
+        TextureStaging& staging = SharedTextureStaging();
+        for(unsigned int level = entry.base; level-- > target;)
+        {
+            if(entry.compressed)
+            {
+                staging.UploadCompressedLevel(entry.id, level, entry.internalFormat, read.decoded);
+            }
+            else
+            {
+                int levelWidth = std::max(entry.width >> level, 1);
+                int levelHeight = std::max(entry.height >> level, 1);
+                staging.UploadLevel(entry.id, ( GLint) level, entry.internalFormat, levelWidth, levelHeight, GL_RGBA, read.levels[level].data());
+            }
+            entry.base = level;
+            resident += entry.levelBytes[level];
+            bytes += ( size_t) entry.levelBytes[level];
+            totals.levelsLoaded++;
+            totals.bytesLoaded += entry.levelBytes[level];
+        }
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, ( GLint) entry.base);
+        // Start from the level that was drawn until now and ease into the new ones over the next frames.
+        setMinLod(entry, entry.minLod + ( float) (previousBase - entry.base));
+        return bytes;
+    }
+
+    // Takes queued reads one at a time, decodes the image and, for an uncompressed one, builds its chain the way
+    // glGenerateMipmap did when it was first loaded.
+    void workerLoop()
+    {
+        while(true)
+        {
+            std::shared_ptr<Read> read;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [this] { return stopping || !queued.empty(); });
+                if(stopping)
+                {
+                    return;
+                }
+                read = queued.front();
+                queued.pop_front();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            const Entry& entry = *read->entry;
+            DecodedTexture& decoded = read->decoded;
+            if(!DecodeTexture(read->path, decoded) || decoded.width != entry.width || decoded.height != entry.height
+               || decoded.compressed.levels.empty() == entry.compressed)
+            {
+                read->failed = true;
+            }
+            else if(entry.compressed)
+            {
+                read->failed = decoded.compressed.levels.size() < entry.levelBytes.size();
+            }
+            else
+            {
+                if(read->flags & TEXTURE_LOAD_FLIP_VERTICALLY)
+                {
+                    FlipTextureRows(decoded);
+                }
+                size_t pixelCount = ( size_t) decoded.width * decoded.height;
+                vector<unsigned char> rgba(pixelCount * 4);
+                for(size_t i = 0; i < pixelCount; i++)
+                {
+                    const unsigned char* pixel = decoded.pixels.data() + i * decoded.components;
+                    for(int c = 0; c < 4; c++)
+                    {
+                        rgba[i * 4 + c] = c < decoded.components ? pixel[c] : c == 3 ? 255 : pixel[0];
+                    }
+                }
+                decoded = DecodedTexture();
+                // Gamma corrected textures are averaged in linear light, as the driver does for their mipmaps.
+                bool srgb = entry.internalFormat == GL_SRGB8 || entry.internalFormat == GL_SRGB8_ALPHA8 || entry.internalFormat == GL_SRGB
+                            || entry.internalFormat == GL_SRGB_ALPHA;
+                read->levels = BuildMipChain(rgba.data(), entry.width, entry.height, srgb ? MIP_CONTENT_COLOUR : MIP_CONTENT_DATA, MIP_FILTER_BOX);
+            }
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(read);
+            totals.readMilliseconds += milliseconds;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,810 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+
+#include <Hash/hash.h>
+#include <ResourceRegistry/resourceregistry.h>
+#include <TextureData/texturedata.h>
+#include <Threading/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Default GL work done per frame by the streamers' Update.
+const double STREAMING_FRAME_MILLISECONDS = 2.0;
+const size_t STREAMING_FRAME_BYTES = 16 * 1024 * 1024;
+
+// Pixel unpack buffers texture uploads are staged through, used in turn.
+const unsigned int TEXTURE_STAGING_BUFFERS = 4;
+
+// S3TC formats come from an extension, so the loader doesn't define them.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+///
+/// Limits on the uploads made in one frame. Uploads are whole items, e.g. a texture or a mesh, and at least one is
+/// made every frame so loading always progresses, so a single large item can go over the budget.
+///
+struct StreamingBudget
+{
+    double milliseconds = STREAMING_FRAME_MILLISECONDS;
+    size_t bytes = STREAMING_FRAME_BYTES;
+};
+
+///
+/// Where a streamed asset is in its load.
+///
+enum StreamingState
+{
+    STREAMING_QUEUED,       // Waiting for a worker.
+    STREAMING_READING,      // A worker is reading and decoding it.
+    STREAMING_UPLOADING,    // Read, waiting for or part way through its uploads.
+    STREAMING_RESIDENT,     // Fully uploaded, draw it.
+    STREAMING_FAILED        // Couldn't be read.
+};
+
+///
+/// Whether the current context has an extension.
+///
+inline bool HasGlExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for(GLint i = 0; i < count; i++)
+    {
+        const char* extension = ( const char*) glGetStringi(GL_EXTENSIONS, ( GLuint) i);
+        if(extension != NULL && std::strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Whether the current context can sample a block format. RGTC is core from 3.0 and BPTC from 4.2, S3TC is always an
+/// extension, if a universal one on desktop drivers.
+///
+inline bool IsBlockFormatSupported(BlockFormat format)
+{
+    switch(format)
+    {
+    case BLOCK_FORMAT_BC1:
+    case BLOCK_FORMAT_BC3:
+        return GLAD_GL_VERSION_3_0 && HasGlExtension("GL_EXT_texture_compression_s3tc");
+    case BLOCK_FORMAT_BC4:
+    case BLOCK_FORMAT_BC5:
+        return GLAD_GL_VERSION_3_0;
+    case BLOCK_FORMAT_BC7:
+        return GLAD_GL_VERSION_4_2 || (GLAD_GL_VERSION_3_0 && HasGlExtension("GL_ARB_texture_compression_bptc"));
+    }
+    return false;
+}
+
+///
+/// The GL internal format of a block format.
+///
+inline GLenum BlockInternalFormat(BlockFormat format, bool srgb)
+{
+    switch(format)
+    {
+    case BLOCK_FORMAT_BC1:
+        return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_FORMAT_BC3:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_FORMAT_BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BLOCK_FORMAT_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case BLOCK_FORMAT_BC7:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+///
+/// Stages texture uploads through pixel unpack buffers. The pixels are copied into a mapped buffer and the texture
+/// is filled from it, so glTexImage2D returns without the driver copying client memory first and the transfer
+/// overlaps with rendering. The buffers are used in turn and each is invalidated as it's mapped, so an upload never
+/// waits for the GPU to finish reading the one before.
+///
+class TextureStaging
+{
+public:
+    TextureStaging()
+    {
+    }
+
+    ~TextureStaging()
+    {
+        for(unsigned int i = 0; i < TEXTURE_STAGING_BUFFERS; i++)
+        {
+            if(buffers[i] != 0)
+            {
+                glDeleteBuffers(1, &buffers[i]);
+            }
+        }
+    }
+
+    // Owns the buffer objects.
+    TextureStaging(const TextureStaging&) = delete;
+    TextureStaging& operator=(const TextureStaging&) = delete;
+
+    ///
+    /// Creates a texture from a decoded image, with mipmaps. An empty image leaves the texture without storage.
+    /// Contexts older than 3.0, which can't map buffer ranges, upload from client memory instead.
+    /// \return - the texture's ID.
+    ///
+    unsigned int Upload(const DecodedTexture& texture)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        if(texture.pixels.empty())
+        {
+            return textureID;
+        }
+        if(!texture.compressed.levels.empty())
+        {
+            uploadCompressed(texture, textureID);
+            return textureID;
+        }
+
+        // The internal format is sized, so texture arrays can copy from it; GL only calls sized formats compatible.
+        GLenum format = GL_RGB;
+        GLenum internalFormat = GL_RGB8;
+        if(texture.components == 1)
+        {
+            format = GL_RED;
+            internalFormat = GL_R8;
+        }
+        else if(texture.components == 3)
+        {
+            format = GL_RGB;
+            internalFormat = GL_RGB8;
+        }
+        else if(texture.components == 4)
+        {
+            format = GL_RGBA;
+            internalFormat = GL_RGBA8;
+        }
+
+        UploadLevel(textureID, 0, internalFormat, texture.width, texture.height, format, texture.pixels.data());
+        // Only images the texture cooker hasn't been run on get here. Its KTX2 files carry a chain filtered in linear
+        // light, where the driver's box filter works on the sRGB values as they are.
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return textureID;
+    }
+
+    ///
+    /// Fills one level of an existing texture with 8 bit pixels, replacing whatever storage the level had.
+    /// \param textureID - the texture.
+    /// \param level - the level to fill.
+    /// \param internalFormat - the texture's internal format, which every level has to share.
+    /// \param width, height - the level's size.
+    /// \param format - the pixels' components, e.g. GL_RGBA.
+    /// \param pixels - the pixels, top row first.
+    ///
+    void UploadLevel(unsigned int textureID, GLint level, GLenum internalFormat, int width, int height, GLenum format, const unsigned char* pixels)
+    {
+        // Rows are tightly packed, which only matches the default alignment of four when they're a multiple of it.
+        size_t components = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+        bool aligned = (( size_t) width * components) % 4 == 0;
+        if(!aligned)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        }
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const void* staged = stage(pixels, ( size_t) width * height * components);
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, staged);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if(!aligned)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+    }
+
+    ///
+    /// Fills a rectangle of an existing texture's first level with 8 bit pixels, leaving the rest as it is.
+    /// \param textureID - the texture.
+    /// \param x, y - the rectangle's corner in texels.
+    /// \param width, height - the rectangle's size.
+    /// \param format - the pixels' components, e.g. GL_RGBA.
+    /// \param pixels - the pixels, top row first.
+    ///
+    void UploadRegion(unsigned int textureID, int x, int y, int width, int height, GLenum format, const unsigned char* pixels)
+    {
+        size_t components = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+        bool aligned = (( size_t) width * components) % 4 == 0;
+        if(!aligned)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        }
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const void* staged = stage(pixels, ( size_t) width * height * components);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, staged);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if(!aligned)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+    }
+
+    ///
+    /// Fills one level of an existing texture from a block compressed image, in the internal format the texture was
+    /// made with: the image's own, BC1 or BC3 for a transcoded BC7 image, or 8 bit RGBA for a decompressed one.
+    /// \param textureID - the texture.
+    /// \param level - the level to fill, and the image's level to fill it from.
+    /// \param internalFormat - the texture's internal format.
+    /// \param texture - the image.
+    ///
+    void UploadCompressedLevel(unsigned int textureID, size_t level, GLenum internalFormat, const DecodedTexture& texture)
+    {
+        const KtxTexture& compressed = texture.compressed;
+        const KtxLevel& source = compressed.levels[level];
+        const unsigned char* blocks = texture.pixels.data() + source.offset;
+        if(internalFormat == GL_RGBA8 || internalFormat == GL_SRGB8_ALPHA8)
+        {
+            std::vector<unsigned char> rgba(( size_t) source.width * source.height * 4);
+            DecompressImage(blocks, source.width, source.height, compressed.blockFormat, rgba.data());
+            UploadLevel(textureID, ( GLint) level, internalFormat, source.width, source.height, GL_RGBA, rgba.data());
+            return;
+        }
+
+        std::vector<unsigned char> transcoded;
+        size_t size = source.size;
+        if(internalFormat != BlockInternalFormat(compressed.blockFormat, compressed.srgb))
+        {
+            BlockFormat format = internalFormat == BlockInternalFormat(BLOCK_FORMAT_BC1, compressed.srgb) ? BLOCK_FORMAT_BC1 : BLOCK_FORMAT_BC3;
+            transcoded.assign(CompressedImageSize(format, source.width, source.height), 0);
+            TranscodeBc7Image(blocks, source.width, source.height, format, transcoded.data());
+            blocks = transcoded.data();
+            size = transcoded.size();
+        }
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const void* staged = stage(blocks, size);
+        glCompressedTexImage2D(GL_TEXTURE_2D, ( GLint) level, internalFormat, source.width, source.height, 0, ( GLsizei) size, staged);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+private:
+    unsigned int buffers[TEXTURE_STAGING_BUFFERS] = {};
+    size_t capacities[TEXTURE_STAGING_BUFFERS] = {};
+    unsigned int next = 0;
+
+    // Uploads a block compressed image's mip chain as it is. The whole file is staged in one go and each level is
+    // read from its offset in it. BC7 images on contexts without BC7 are transcoded to BC1 or BC3, and contexts that
+    // can't sample either format get the levels decompressed instead.
+    void uploadCompressed(const DecodedTexture& texture, unsigned int textureID)
+    {
+        const KtxTexture& compressed = texture.compressed;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        if(IsBlockFormatSupported(compressed.blockFormat))
+        {
+            const unsigned char* staged = ( const unsigned char*) stage(texture.pixels.data(), texture.pixels.size());
+            GLenum internalFormat = BlockInternalFormat(compressed.blockFormat, compressed.srgb);
+            for(size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                const KtxLevel& source = compressed.levels[level];
+                glCompressedTexImage2D(GL_TEXTURE_2D, ( GLint) level, internalFormat, source.width, source.height, 0, ( GLsizei) source.size,
+                                       staged + source.offset);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else if(compressed.blockFormat == BLOCK_FORMAT_BC7 && IsBlockFormatSupported(BLOCK_FORMAT_BC3))
+        {
+            // Opaque images lose nothing going to BC1, at half the size of BC3.
+            BlockFormat format = BLOCK_FORMAT_BC1;
+            for(const KtxLevel& source : compressed.levels)
+            {
+                if(!IsBc7ImageOpaque(texture.pixels.data() + source.offset, source.width, source.height))
+                {
+                    format = BLOCK_FORMAT_BC3;
+                    break;
+                }
+            }
+            for(size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                UploadCompressedLevel(textureID, level, BlockInternalFormat(format, compressed.srgb), texture);
+            }
+        }
+        else
+        {
+            for(size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                UploadCompressedLevel(textureID, level, compressed.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, texture);
+            }
+        }
+
+        // The chain is whatever the file holds, which needn't go all the way down to 1x1.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ( GLint) compressed.levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, compressed.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // Copies pixels into the next staging buffer and leaves it bound. Returns what to pass glTexImage2D as its
+    // pixels: an offset into the bound buffer, or the pixels themselves if they couldn't be staged.
+    const void* stage(const unsigned char* pixels, size_t size)
+    {
+        if(!GLAD_GL_VERSION_3_0)
+        {
+            return pixels;
+        }
+
+        unsigned int slot = next;
+        next = (next + 1) % TEXTURE_STAGING_BUFFERS;
+        if(buffers[slot] == 0)
+        {
+            glGenBuffers(1, &buffers[slot]);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[slot]);
+
+        // Buffers only grow, so after the first few textures staging allocates nothing.
+        if(capacities[slot] < size)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+            capacities[slot] = size;
+        }
+
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if(mapped != NULL)
+        {
+            std::memcpy(mapped, pixels, size);
+            if(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
+            {
+                return ( const void*) 0;
+            }
+        }
+
+        // The buffer's contents were lost, so upload from client memory this once.
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return pixels;
+    }
+};
+
+///
+/// The process wide staging buffers. Only use it on the context's thread.
+///
+inline TextureStaging& SharedTextureStaging()
+{
+    static TextureStaging staging;
+    return staging;
+}
+
+///
+/// Creates a texture from a decoded image, with mipmaps, staged through the shared pixel unpack buffers. An empty
+/// image leaves the texture without storage.
+/// \return - the texture's ID.
+///
+inline unsigned int UploadTexture(const DecodedTexture& texture)
+{
+    return SharedTextureStaging().Upload(texture);
+}
+
+///
+/// Key a texture is shared under in the registry: its canonical path, see CanonicalAssetPath, and whether it's gamma
+/// corrected.
+///
+inline std::string TextureResourceKey(const std::string& filename, bool gamma)
+{
+    return CanonicalAssetPath(filename) + (gamma ? "|srgb" : "|linear");
+}
+
+///
+/// Estimates the memory a decoded image takes once uploaded: block compressed levels as they're stored, or 8 bit
+/// pixels with a third more for their mipmaps.
+///
+inline uint64_t TextureGpuBytes(const DecodedTexture& texture)
+{
+    if(!texture.compressed.levels.empty())
+    {
+        uint64_t bytes = 0;
+        for(const KtxLevel& level : texture.compressed.levels)
+        {
+            bytes += level.size;
+        }
+        return bytes;
+    }
+    return ( uint64_t) texture.width * texture.height * texture.components * 4 / 3;
+}
+
+///
+/// Hashes a decoded image's size, layout and pixels, eight bytes at a time, so the same image stored under two
+/// names can be told apart from every other.
+///
+inline uint64_t TextureContentHash(const DecodedTexture& texture)
+{
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t header[4] = { ( uint64_t) texture.width, ( uint64_t) texture.height, ( uint64_t) texture.components,
+                           ( uint64_t) texture.compressed.levels.size() };
+    uint64_t hash = HashBytes(header, sizeof(header));
+    const unsigned char* bytes = texture.pixels.data();
+    size_t size = texture.pixels.size();
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash += word * PRIME2;
+        hash = (hash << 31) | (hash >> 33);
+        hash *= PRIME1;
+    }
+    hash = HashBytes(bytes + i, size - i, hash);
+
+    // Mix the last words into every bit.
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME1;
+    return hash ^ (hash >> 32);
+}
+
+///
+/// Whether textures are shared by their contents as well as their paths. Hashing costs about a millisecond for a
+/// 1024x1024 image, so it can be turned off where no two names hold the same image.
+///
+inline std::atomic<bool>& TextureContentSharing()
+{
+    static std::atomic<bool> enabled(true);
+    return enabled;
+}
+
+///
+/// The process wide registry of textures by their contents. Textures loaded under one path are found under another
+/// through it when the images are the same.
+///
+inline ResourceCache<GpuTexture>& SharedTextureContents()
+{
+    static ResourceCache<GpuTexture> contents;
+    return contents;
+}
+
+///
+/// Uploads a decoded image, or hands back the live texture of an identical image loaded under another name. Call
+/// on the context's thread, typically from the path registry's create function.
+/// \param texture - the decoded image.
+/// \param gamma - whether it's gamma corrected, which keeps the same pixels in two colour spaces apart.
+/// \return - a handle to the texture.
+///
+inline std::shared_ptr<GpuTexture> ShareDecodedTexture(const DecodedTexture& texture, bool gamma)
+{
+    auto upload = [&]()
+    {
+        return std::make_shared<GpuTexture>(UploadTexture(texture), TextureGpuBytes(texture));
+    };
+    if(texture.pixels.empty() || !TextureContentSharing().load(std::memory_order_relaxed))
+    {
+        return upload();
+    }
+
+    char key[40];
+    snprintf(key, sizeof(key), "%016llx|%s", ( unsigned long long) TextureContentHash(texture), gamma ? "srgb" : "linear");
+    return SharedTextureContents().Acquire(key, upload);
+}
+
+///
+/// How much loading the shared texture registries have saved.
+///
+struct TextureCacheStats
+{
+    size_t pathHits = 0;        // Loads that found the texture already loaded under their path.
+    size_t contentHits = 0;     // Loads of a new path whose image was already loaded under another.
+    size_t uploads = 0;         // Textures actually uploaded.
+    size_t live = 0;            // Distinct textures with live handles.
+    uint64_t liveBytes = 0;     // Memory they take.
+    uint64_t savedBytes = 0;    // Memory the hits would have taken as copies of their own.
+};
+
+inline TextureCacheStats SharedTextureCacheStats()
+{
+    ResourceCacheStats paths = SharedTextures().Stats();
+    ResourceCacheStats contents = SharedTextureContents().Stats();
+    TextureCacheStats stats;
+    stats.pathHits = paths.hits;
+    stats.contentHits = contents.hits;
+    stats.uploads = paths.misses - contents.hits;
+    stats.live = paths.live;
+    stats.liveBytes = paths.bytes;
+    stats.savedBytes = paths.hitBytes + contents.hitBytes;
+    return stats;
+}
+
+// Options for TextureStreamer::Load.
+enum TextureLoadFlags
+{
+    TEXTURE_LOAD_FLIP_VERTICALLY = 1 << 0   // Bottom row first, for texture coordinates that start at the bottom.
+};
+
+///
+/// A texture being streamed in, returned by TextureStreamer::Load straight away.
+///
+class StreamedTexture
+{
+public:
+    StreamingState State() const
+    {
+        return state.load(std::memory_order_acquire);
+    }
+
+    bool IsResident() const
+    {
+        return State() == STREAMING_RESIDENT;
+    }
+
+    ///
+    /// The texture's ID, 0 until it's resident and for a texture that failed to load.
+    ///
+    unsigned int ID() const
+    {
+        return IsResident() ? texture->ID() : 0;
+    }
+
+    ///
+    /// The texture object, empty until it's resident. Keep a copy to keep the texture alive without the handle.
+    ///
+    std::shared_ptr<GpuTexture> Resource() const
+    {
+        return IsResident() ? texture : std::shared_ptr<GpuTexture>();
+    }
+
+private:
+    friend class TextureStreamer;
+
+    std::string path;
+    std::string key;    // What it's shared under in the texture registry.
+    uint32_t flags = 0;
+    std::atomic<StreamingState> state{ STREAMING_QUEUED };
+    DecodedTexture decoded;
+    std::shared_ptr<GpuTexture> texture;
+};
+
+typedef std::shared_ptr<StreamedTexture> TextureHandle;
+
+///
+/// Times and sizes of everything a TextureStreamer has loaded, for the load time reports.
+///
+struct TextureStreamingStats
+{
+    size_t textures = 0;            // Textures made resident.
+    size_t bytes = 0;               // Decoded pixels uploaded.
+    double decodeMilliseconds = 0;  // Reading and decoding, summed over the workers.
+    double uploadMilliseconds = 0;  // GL work on the context thread.
+    size_t uploadFrames = 0;        // Calls to Update that made at least one upload.
+    size_t shared = 0;              // Loads of a texture already loaded or loading, which weren't read again.
+};
+
+///
+/// Loads textures without blocking the context thread. A pool of workers reads and decodes the images, and the
+/// context thread uploads the decoded ones a few at a time in Update, within a per-frame budget, staged through
+/// pixel unpack buffers. Textures are shared through the process wide registries, so an image that's already loaded,
+/// by this streamer or anything else, or being loaded by this one, is neither read nor uploaded again.
+///
+class TextureStreamer
+{
+public:
+    ///
+    /// Starts the worker threads.
+    /// \param workerCount - number of images decoded at once.
+    ///
+    explicit TextureStreamer(unsigned int workerCount = WorkerThreadCount())
+    {
+        for(unsigned int i = 0; i < std::max(workerCount, 1u); i++)
+        {
+            workers.push_back(std::thread(&TextureStreamer::workerLoop, this));
+        }
+    }
+
+    ///
+    /// Stops the workers once they finish the decodes in progress. Textures still queued are left unloaded.
+    ///
+    ~TextureStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Workers hold a pointer to the streamer.
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    ///
+    /// Queues an image for loading and returns its handle straight away.
+    /// \param path - the image file, or its path in a mounted asset pack.
+    /// \param flags - TextureLoadFlags.
+    /// \return - the handle, check its state each frame.
+    ///
+    TextureHandle Load(const std::string& path, uint32_t flags = 0)
+    {
+        std::string key = TextureResourceKey(path, false) + (flags & TEXTURE_LOAD_FLIP_VERTICALLY ? "|flipped" : "");
+        TextureHandle handle = std::make_shared<StreamedTexture>();
+        handle->path = path;
+        handle->key = key;
+        handle->flags = flags;
+
+        std::shared_ptr<GpuTexture> loaded = SharedTextures().Find(key);
+        if(loaded)
+        {
+            handle->texture = loaded;
+            handle->state.store(STREAMING_RESIDENT, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.shared++;
+            return handle;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            TextureHandle loading = inFlight[key].lock();
+            if(loading)
+            {
+                stats.shared++;
+                return loading;
+            }
+            inFlight[key] = handle;
+            queued.push_back(handle);
+        }
+        queueChanged.notify_one();
+        return handle;
+    }
+
+    ///
+    /// Uploads decoded textures, in the order they finished decoding, until the budget is spent. Call once a frame
+    /// on the context's thread.
+    /// \param budget - limits on this frame's uploads.
+    ///
+    void Update(const StreamingBudget& budget = StreamingBudget())
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t bytes = 0;
+        bool uploaded = false;
+        while(true)
+        {
+            TextureHandle handle;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(decoded.empty())
+                {
+                    break;
+                }
+                handle = decoded.front();
+            }
+
+            size_t itemBytes = handle->decoded.pixels.size();
+            if(uploaded && (bytes + itemBytes > budget.bytes
+                            || std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= budget.milliseconds))
+            {
+                break;
+            }
+            handle->texture = SharedTextures().Acquire(handle->key, [&]() { return ShareDecodedTexture(handle->decoded, false); });
+            handle->decoded = DecodedTexture();
+            handle->state.store(STREAMING_RESIDENT, std::memory_order_release);
+            bytes += itemBytes;
+            uploaded = true;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight.erase(handle->key);
+            decoded.pop_front();
+            stats.textures++;
+            stats.bytes += itemBytes;
+        }
+
+        if(uploaded)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.uploadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            stats.uploadFrames++;
+        }
+    }
+
+    ///
+    /// Blocks until a texture is resident or has failed, making uploads without a budget. For setup code that needs
+    /// the texture before it can start; call on the context's thread.
+    ///
+    void WaitUntilResident(const TextureHandle& handle)
+    {
+        StreamingBudget unlimited;
+        unlimited.milliseconds = INFINITY;
+        unlimited.bytes = SIZE_MAX;
+        while(handle->State() != STREAMING_RESIDENT && handle->State() != STREAMING_FAILED)
+        {
+            Update(unlimited);
+            std::this_thread::yield();
+        }
+    }
+
+    TextureStreamingStats Stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<TextureHandle> queued;   // Waiting for a worker.
+    std::deque<TextureHandle> decoded;  // Decoded and waiting for an upload, oldest first.
+    std::unordered_map<std::string, std::weak_ptr<StreamedTexture>> inFlight;  // Queued to uploading, by key.
+    TextureStreamingStats stats;
+    bool stopping = false;
+
+    // Takes queued images one at a time and decodes them.
+    void workerLoop()
+    {
+        while(true)
+        {
+            TextureHandle handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [this] { return stopping || !queued.empty(); });
+                if(stopping)
+                {
+                    return;
+                }
+                handle = queued.front();
+                queued.pop_front();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            handle->state.store(STREAMING_READING, std::memory_order_release);
+            if(!DecodeTexture(handle->path, handle->decoded))
+            {
+                std::cout << "Texture failed to load at path: " << handle->path << std::endl;
+                handle->state.store(STREAMING_FAILED, std::memory_order_release);
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight.erase(handle->key);
+                continue;
+            }
+            if(handle->flags & TEXTURE_LOAD_FLIP_VERTICALLY)
+            {
+                FlipTextureRows(handle->decoded);
+            }
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            handle->state.store(STREAMING_UPLOADING, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(handle);
+            stats.decodeMilliseconds += milliseconds;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
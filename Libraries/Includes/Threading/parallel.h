@@ -0,0 +1,118 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+///
+/// Returns the number of worker threads to use for CPU side loading work.
+/// Always at least one.
+///
+inline unsigned int WorkerThreadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+///
+/// Whether the calling thread is running a ParallelFor work item, or the loop around them.
+///
+inline bool& InsideParallelFor()
+{
+    thread_local bool inside = false;
+    return inside;
+}
+
+///
+/// Runs func(i) for every i in [0, count) spread across the available cores.
+/// Work items are handed out one at a time so uneven items (e.g. one huge mesh and many small ones) still balance.
+/// Each index is processed exactly once, so writing results into slot i of a pre-sized array is deterministic.
+/// A ParallelFor inside a work item runs on its own thread, as the outer loop already has every core busy.
+/// If a work item throws, no more items are started and the first exception is rethrown once every thread is done.
+///
+/// \param count - number of work items.
+/// \param func - function to run for each work item index.
+///
+inline void ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+    size_t threadCount = std::min<size_t>(WorkerThreadCount(), count);
+    if(threadCount <= 1 || InsideParallelFor())
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+    auto worker = [&]()
+    {
+        InsideParallelFor() = true;
+        try
+        {
+            for(size_t i = next++; i < count; i = next++)
+            {
+                func(i);
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(failureMutex);
+            if(!failure)
+            {
+                failure = std::current_exception();
+            }
+            next = count;
+        }
+    };
+
+    {
+        // Joins the threads however the calling thread leaves, as destroying a joinable thread terminates the program.
+        struct ThreadJoiner
+        {
+            std::vector<std::thread> threads;
+
+            ~ThreadJoiner()
+            {
+                for(std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+                InsideParallelFor() = false;
+            }
+        } joiner;
+
+        // The calling thread does its share of the work as well, so if no more threads can be started the ones that
+        // were still finish the work.
+        joiner.threads.reserve(threadCount - 1);
+        for(size_t t = 1; t < threadCount; t++)
+        {
+            try
+            {
+                joiner.threads.emplace_back(worker);
+            }
+            catch(const std::system_error&)
+            {
+                break;
+            }
+        }
+        worker();
+    }
+
+    if(failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef TILEDTEXTURE_H
+#define TILEDTEXTURE_H
+
+#include <AtomicFile/atomicfile.h>
+#include <Compression/lz4.h>
+#include <FileMapping/filemapping.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A tiled texture is an image's mip chain cut into square pages, each stored on its own so any one can be read
+// without the others. Every page carries a border of texels from its neighbours, wrapping at the image's edges, so
+// filtering inside a page never needs the pages around it. Pages are 8 bit RGBA, LZ4 compressed where that makes
+// them smaller. The TextureTiler tool writes them next to the images and the virtual texture system reads their
+// pages as the frame asks for them.
+
+const uint32_t TILED_TEXTURE_MAGIC = 0x58455456;   // "VTEX"
+const uint32_t TILED_TEXTURE_VERSION = 1;
+
+// Default page layout: texels a side, and texels of border around each side.
+const int TILED_TEXTURE_PAGE_SIZE = 128;
+const int TILED_TEXTURE_BORDER = 4;
+
+// Start of a tiled texture file, followed by one TiledTexturePage for each page and then the pages themselves.
+struct TiledTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;         // Size of the finest level.
+    uint32_t height;
+    uint32_t pageSize;      // Texels a side of each page, not counting its border.
+    uint32_t border;        // Texels added around each side.
+    uint32_t levels;        // Mip levels, down to the first that's a single page along its shorter side.
+    uint32_t pageCount;     // Pages of every level, finest level first and each level row by row.
+};
+
+// Where a page is in a tiled texture file.
+struct TiledTexturePage
+{
+    uint64_t offset;        // From the start of the file.
+    uint32_t size;          // Bytes stored, LZ4 compressed unless it's the size of the page's pixels.
+    uint32_t reserved;
+};
+
+///
+/// The tiled texture the TextureTiler tool writes for an image: the same path with a .vtex extension.
+///
+inline std::string TiledTexturePath(const std::string& filename)
+{
+    size_t extension = filename.find_last_of('.');
+    size_t separator = filename.find_last_of("/\\");
+    if(extension == std::string::npos || (separator != std::string::npos && extension < separator))
+    {
+        return filename + ".vtex";
+    }
+    return filename.substr(0, extension) + ".vtex";
+}
+
+///
+/// Number of levels a tiled texture of the given size has: every level whose shorter side is at least a page.
+///
+inline int TiledTextureLevelCount(int width, int height, int pageSize)
+{
+    int levels = 0;
+    while((std::min(width, height) >> levels) >= pageSize)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+///
+/// Cuts an image's mip chain into bordered pages and writes them as a tiled texture. It's written to a temporary
+/// file that's renamed into place, so a reader never sees half of it.
+/// \param path - the file to write.
+/// \param width, height - size of the finest level, both powers of two and at least a page.
+/// \param levels - the chain as BuildMipChain makes it, four 8 bit components a pixel. Levels smaller than a page
+///                 are left out.
+/// \param pageSize - texels a side of each page.
+/// \param border - texels of border around each side.
+/// \param storedBytes - receives the file's size, if not NULL.
+/// \return - false if the sizes don't tile, or the file couldn't be written.
+///
+inline bool WriteTiledTexture(const std::string& path, int width, int height, const std::vector<std::vector<unsigned char>>& levels,
+                              int pageSize, int border, uint64_t* storedBytes = NULL)
+{
+    int levelCount = TiledTextureLevelCount(width, height, pageSize);
+    if(levelCount == 0 || ( size_t) levelCount > levels.size() || (width & (width - 1)) != 0 || (height & (height - 1)) != 0
+       || (pageSize & (pageSize - 1)) != 0 || border < 0 || border > pageSize)
+    {
+        return false;
+    }
+
+    int slotSize = pageSize + 2 * border;
+    std::vector<unsigned char> pixels(( size_t) slotSize * slotSize * 4);
+    std::vector<unsigned char> compressed(Lz4CompressBound(pixels.size()));
+    std::vector<TiledTexturePage> index;
+    std::vector<unsigned char> data;
+    for(int level = 0; level < levelCount; level++)
+    {
+        int levelWidth = width >> level;
+        int levelHeight = height >> level;
+        const unsigned char* source = levels[level].data();
+        for(int pageY = 0; pageY < levelHeight / pageSize; pageY++)
+        {
+            for(int pageX = 0; pageX < levelWidth / pageSize; pageX++)
+            {
+                // Both sizes are powers of two, so wrapping is a mask.
+                for(int y = 0; y < slotSize; y++)
+                {
+                    int sourceY = (pageY * pageSize + y - border) & (levelHeight - 1);
+                    for(int x = 0; x < slotSize; x++)
+                    {
+                        int sourceX = (pageX * pageSize + x - border) & (levelWidth - 1);
+                        std::memcpy(&pixels[(( size_t) y * slotSize + x) * 4], source + (( size_t) sourceY * levelWidth + sourceX) * 4, 4);
+                    }
+                }
+
+                TiledTexturePage page = {};
+                page.offset = data.size();
+                size_t size = Lz4Compress(pixels.data(), pixels.size(), compressed.data(), compressed.size());
+                if(size > 0 && size < pixels.size())
+                {
+                    data.insert(data.end(), compressed.begin(), compressed.begin() + size);
+                }
+                else
+                {
+                    data.insert(data.end(), pixels.begin(), pixels.end());
+                }
+                page.size = ( uint32_t) (data.size() - page.offset);
+                index.push_back(page);
+            }
+        }
+    }
+
+    TiledTextureHeader header = { TILED_TEXTURE_MAGIC, TILED_TEXTURE_VERSION, ( uint32_t) width, ( uint32_t) height,
+                                  ( uint32_t) pageSize, ( uint32_t) border, ( uint32_t) levelCount, ( uint32_t) index.size() };
+    uint64_t dataOffset = sizeof(header) + index.size() * sizeof(TiledTexturePage);
+    for(TiledTexturePage& page : index)
+    {
+        page.offset += dataOffset;
+    }
+
+    if(storedBytes != NULL)
+    {
+        *storedBytes = dataOffset + data.size();
+    }
+    return WriteFileAtomically(path, { { &header, sizeof(header) }, { index.data(), index.size() * sizeof(TiledTexturePage) },
+                                       { data.data(), data.size() } });
+}
+
+///
+/// A tiled texture file, mapped so its pages are read straight out of the file cache. Reading pages touches no
+/// shared state, so any number of threads can read at once.
+///
+class TiledTexture
+{
+public:
+    ///
+    /// Maps a tiled texture file and checks its header and page index, so reading a page can't go past its end.
+    /// \return - false if there's no such file or it's damaged.
+    ///
+    bool Open(const std::string& path)
+    {
+        if(!file.Open(path) || file.Size() < sizeof(header))
+        {
+            file.Close();
+            return false;
+        }
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if(header.magic != TILED_TEXTURE_MAGIC || header.version != TILED_TEXTURE_VERSION || header.pageSize == 0
+           || header.border > header.pageSize || header.levels == 0 || header.levels > 16
+           || ( int) header.levels != TiledTextureLevelCount(( int) header.width, ( int) header.height, ( int) header.pageSize))
+        {
+            file.Close();
+            return false;
+        }
+
+        levelStarts.clear();
+        uint32_t pageCount = 0;
+        for(uint32_t level = 0; level < header.levels; level++)
+        {
+            levelStarts.push_back(pageCount);
+            pageCount += ( uint32_t) (PagesAcross(( int) level) * PagesDown(( int) level));
+        }
+        if(pageCount != header.pageCount || file.Size() < sizeof(header) + ( uint64_t) pageCount * sizeof(TiledTexturePage))
+        {
+            file.Close();
+            return false;
+        }
+        pages.resize(pageCount);
+        std::memcpy(pages.data(), file.Data() + sizeof(header), pageCount * sizeof(TiledTexturePage));
+        for(const TiledTexturePage& page : pages)
+        {
+            if(page.offset > file.Size() || page.size > file.Size() - page.offset)
+            {
+                file.Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int Width() const
+    {
+        return ( int) header.width;
+    }
+
+    int Height() const
+    {
+        return ( int) header.height;
+    }
+
+    int PageSize() const
+    {
+        return ( int) header.pageSize;
+    }
+
+    int Border() const
+    {
+        return ( int) header.border;
+    }
+
+    int Levels() const
+    {
+        return ( int) header.levels;
+    }
+
+    int PageCount() const
+    {
+        return ( int) header.pageCount;
+    }
+
+    int PagesAcross(int level) const
+    {
+        return ( int) (header.width >> level) / ( int) header.pageSize;
+    }
+
+    int PagesDown(int level) const
+    {
+        return ( int) (header.height >> level) / ( int) header.pageSize;
+    }
+
+    ///
+    /// Position of a page in the file's index, which numbers the pages of every level in turn.
+    ///
+    int PageIndex(int level, int x, int y) const
+    {
+        return ( int) levelStarts[level] + y * PagesAcross(level) + x;
+    }
+
+    ///
+    /// Size of a page's pixels, border included.
+    ///
+    size_t PageBytes() const
+    {
+        size_t slotSize = header.pageSize + 2 * header.border;
+        return slotSize * slotSize * 4;
+    }
+
+    ///
+    /// Reads a page's pixels, border included, four 8 bit components a pixel.
+    /// \param index - the page, from PageIndex.
+    /// \param pixels - receives PageBytes bytes.
+    /// \return - false if the page is damaged.
+    ///
+    bool ReadPage(int index, unsigned char* pixels) const
+    {
+        const TiledTexturePage& page = pages[index];
+        const unsigned char* stored = file.Data() + page.offset;
+        if(page.size == PageBytes())
+        {
+            std::memcpy(pixels, stored, page.size);
+            return true;
+        }
+        return Lz4Decompress(stored, page.size, pixels, PageBytes());
+    }
+
+private:
+    FileMapping file;
+    TiledTextureHeader header = {};
+    std::vector<TiledTexturePage> pages;
+    std::vector<uint32_t> levelStarts;  // Index of each level's first page.
+};
+
+#endif
\ No newline at end of file
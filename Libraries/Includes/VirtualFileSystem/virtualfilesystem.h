@@ -0,0 +1,158 @@
+#ifndef VIRTUALFILESYSTEM_H
+#define VIRTUALFILESYSTEM_H
+
+#include <AssetPack/assetpack.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cstdlib>
+#endif
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A single view of the assets whether they're packed or loose. Mounted packs are searched first, most recently
+// mounted first, then the path is opened as a loose file. Mount packs at startup, before any other thread reads
+// assets; lookups are safe from any thread after that.
+
+///
+/// The mounted packs, in mount order.
+///
+inline std::vector<std::unique_ptr<AssetPack>>& MountedAssetPacks()
+{
+    static std::vector<std::unique_ptr<AssetPack>> packs;
+    return packs;
+}
+
+///
+/// Mounts an asset pack so its entries are found before loose files.
+/// \param path - the pack file.
+/// \return - false if the pack is missing or can't be used.
+///
+inline bool MountAssetPack(const std::string& path)
+{
+    std::unique_ptr<AssetPack> pack(new AssetPack());
+    if(!pack->Open(path))
+    {
+        return false;
+    }
+    MountedAssetPacks().push_back(std::move(pack));
+    return true;
+}
+
+///
+/// Unmounts every pack. Pointers into packs are invalid afterwards.
+///
+inline void UnmountAssetPacks()
+{
+    MountedAssetPacks().clear();
+}
+
+///
+/// Looks an asset up in the mounted packs only.
+/// \param path - the asset's path.
+/// \param pack - receives the pack holding the entry.
+/// \return - the entry, or NULL if no mounted pack holds the asset.
+///
+inline const AssetPackEntry* FindPackedAsset(const std::string& path, const AssetPack** pack)
+{
+    std::vector<std::unique_ptr<AssetPack>>& packs = MountedAssetPacks();
+    for(size_t i = packs.size(); i > 0; i--)
+    {
+        const AssetPackEntry* entry = packs[i - 1]->Find(path);
+        if(entry != NULL)
+        {
+            *pack = packs[i - 1].get();
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+///
+/// Name an asset is shared under, so that every spelling of its path finds the same resource. Packed assets keep
+/// their pack relative name; loose files get their absolute path with "." and ".." resolved, and on POSIX links too.
+/// \param path - the asset's path.
+/// \param packedSuffix - appended to the path to look the asset up in the packs, for assets packed cooked.
+///
+inline std::string CanonicalAssetPath(const std::string& path, const std::string& packedSuffix = "")
+{
+    std::string normalised = NormaliseAssetPath(path);
+    const AssetPack* pack = NULL;
+    if(FindPackedAsset(path + packedSuffix, &pack) != NULL)
+    {
+        return normalised;
+    }
+#ifdef _WIN32
+    DWORD length = GetFullPathNameA(normalised.c_str(), 0, NULL, NULL);
+    if(length == 0)
+    {
+        return normalised;
+    }
+    std::string canonical(length, '\0');
+    length = GetFullPathNameA(normalised.c_str(), length, &canonical[0], NULL);
+    canonical.resize(length);
+    for(size_t i = 0; i < canonical.size(); i++)
+    {
+        canonical[i] = canonical[i] == '\\' ? '/' : canonical[i];
+    }
+    return canonical;
+#else
+    // Only files that exist resolve; anything else keeps its normalised spelling and fails to load anyway.
+    char* resolved = realpath(normalised.c_str(), NULL);
+    if(resolved == NULL)
+    {
+        return normalised;
+    }
+    std::string canonical(resolved);
+    free(resolved);
+    return canonical;
+#endif
+}
+
+///
+/// Reads a whole asset, from a mounted pack if one holds it or else from the loose file.
+/// \param path - the asset's path.
+/// \param data - receives the asset's bytes.
+/// \param flags - if given, receives the pack entry's flags, ASSET_FLAG_DECODED_TEXTURE for example. 0 for loose files.
+/// \return - false if the asset can't be found or read.
+///
+inline bool ReadAsset(const std::string& path, std::vector<unsigned char>& data, uint32_t* flags = NULL)
+{
+    const AssetPack* pack = NULL;
+    const AssetPackEntry* entry = FindPackedAsset(path, &pack);
+    if(entry != NULL)
+    {
+        if(flags != NULL)
+        {
+            *flags = entry->flags & ~ASSET_FLAG_LZ4;
+        }
+        return pack->Read(*entry, data);
+    }
+
+    if(flags != NULL)
+    {
+        *flags = 0;
+    }
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    data.resize(( size_t) size);
+    return size == 0 || file.read(reinterpret_cast<char*>(data.data()), size);
+}
+
+#endif
\ No newline at end of file
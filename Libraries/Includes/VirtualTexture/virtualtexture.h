@@ -0,0 +1,744 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <glad/glad.h>
+
+#include <Model/model.h>
+#include <Shader/shader.h>
+#include <TextureStreamer/texturestreamer.h>
+#include <TiledTexture/tiledtexture.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Virtual texturing keeps only the pages of a texture's mip chain that the frame actually samples, so texture sets
+// far larger than memory can be drawn. Every page of every virtual texture shares one physical page cache texture.
+// Each virtual texture has an indirection texture, a texel per page of each level, that says where in the cache the
+// page is, or the finest page above it that is. A small feedback pass draws the scene writing the page and level
+// each fragment wants instead of its colour; it's read back a few frames later without stalling, and the pages it
+// names are read from the tiled texture files on worker threads and uploaded into the least recently used slots.
+//
+// Shaders take the indirection texture where the diffuse map would be, as texture_diffuseN, so meshes bind their
+// virtual textures through Mesh::Draw like any other. See Shaders/virtualTextureShader.frag in the ModelLoading
+// chapter for the lookup.
+
+// The page cache is this many pages a side.
+const int VIRTUAL_TEXTURE_CACHE_PAGES = 16;
+
+// The feedback pass is this many times smaller than the frame a side.
+const int VIRTUAL_TEXTURE_FEEDBACK_DIVISOR = 8;
+
+// Feedback readbacks in flight at once. The oldest is read once the GPU has written it, so this is how many frames
+// feedback can trail by before a frame's feedback is skipped.
+const unsigned int VIRTUAL_TEXTURE_FEEDBACK_BUFFERS = 3;
+
+// Texture unit the page cache is bound to, clear of the units meshes bind their own textures to.
+const unsigned int VIRTUAL_TEXTURE_CACHE_UNIT = 15;
+
+// Page reads queued at once. Pages wanted beyond this wait for the next feedback.
+const size_t VIRTUAL_TEXTURE_MAX_READS = 64;
+
+// Virtual textures are told apart in the feedback by an 8 bit ID, 0 being none.
+const size_t VIRTUAL_TEXTURE_LIMIT = 255;
+
+// The feedback names pages, and the indirection textures name cache slots, by 8 bit coordinates, so a virtual texture
+// can be at most this many pages across and down, and the page cache this many pages a side.
+const int VIRTUAL_TEXTURE_MAX_PAGES = 256;
+
+///
+/// What a VirtualTextureSystem holds and has done, for its telemetry.
+///
+struct VirtualTextureStats
+{
+    size_t textures = 0;                // Virtual textures loaded.
+    size_t cachePages = 0;              // Slots in the page cache.
+    size_t residentPages = 0;           // Slots holding a page.
+    size_t requestedPages = 0;          // Distinct pages the last feedback asked for.
+    size_t missingPages = 0;            // Of those, pages that weren't resident.
+    size_t pendingReads = 0;            // Pages being read or waiting to be uploaded.
+    size_t pagesLoaded = 0;             // Pages uploaded into the cache.
+    size_t pagesEvicted = 0;            // Pages whose slot was taken for another.
+    size_t cacheFull = 0;               // Pages read but dropped as every slot was in use.
+    size_t feedbackReadbacks = 0;       // Feedback passes read back.
+    size_t feedbackSkipped = 0;         // Feedback passes dropped as every readback was still in flight.
+    double readMilliseconds = 0;        // Reading and decompressing pages, summed over the workers.
+    double updateMilliseconds = 0;      // Reading feedback, uploading and updating indirection on the context thread.
+};
+
+///
+/// Streams the pages of tiled textures into a shared page cache as the feedback pass asks for them. Each frame:
+/// draw the scene into the feedback pass between BeginFeedback and EndFeedback, draw it for real, then call Update.
+/// Only use it on the context's thread, the page reads happen on its own workers.
+///
+class VirtualTextureSystem
+{
+public:
+    ///
+    /// Creates the page cache and starts the worker threads. Every virtual texture must use the same page layout.
+    /// \param pageTexels - texels a side of each page, not counting its border.
+    /// \param borderTexels - texels of border around each side.
+    /// \param requestedCachePages - pages a side of the page cache, at most VIRTUAL_TEXTURE_MAX_PAGES and as many as
+    /// fit in the largest texture the driver allows.
+    /// \param workerCount - number of pages read at once.
+    ///
+    explicit VirtualTextureSystem(int pageTexels = TILED_TEXTURE_PAGE_SIZE, int borderTexels = TILED_TEXTURE_BORDER,
+                                  int requestedCachePages = VIRTUAL_TEXTURE_CACHE_PAGES, unsigned int workerCount = 2)
+        : pageSize(pageTexels), border(borderTexels), cachePages(std::min(std::max(requestedCachePages, 1), VIRTUAL_TEXTURE_MAX_PAGES)),
+          slotSize(pageTexels + 2 * borderTexels)
+    {
+        int maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        cachePages = std::max(std::min(cachePages, maxTextureSize / slotSize), 1);
+        if(requestedCachePages != cachePages)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: a page cache of " << requestedCachePages << " pages a side can't be used, using "
+                      << cachePages << std::endl;
+        }
+        unsigned int cacheID;
+        glGenTextures(1, &cacheID);
+        glBindTexture(GL_TEXTURE_2D, cacheID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cachePages * slotSize, cachePages * slotSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        cache = std::make_shared<GpuTexture>(cacheID, ( uint64_t) cachePages * cachePages * slotSize * slotSize * 4);
+        slots.resize(( size_t) cachePages * cachePages);
+
+        for(unsigned int i = 0; i < std::max(workerCount, 1u); i++)
+        {
+            workers.push_back(std::thread(&VirtualTextureSystem::workerLoop, this));
+        }
+    }
+
+    ///
+    /// Stops the workers once they finish the reads in progress, and frees the feedback pass.
+    ///
+    ~VirtualTextureSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+
+        for(unsigned int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++)
+        {
+            if(fences[i] != 0)
+            {
+                glDeleteSync(fences[i]);
+            }
+        }
+        glDeleteBuffers(VIRTUAL_TEXTURE_FEEDBACK_BUFFERS, readbackBuffers);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &feedbackColour);
+        glDeleteRenderbuffers(1, &feedbackDepth);
+    }
+
+    // Workers hold a pointer to the system.
+    VirtualTextureSystem(const VirtualTextureSystem&) = delete;
+    VirtualTextureSystem& operator=(const VirtualTextureSystem&) = delete;
+
+    ///
+    /// Loads the virtual texture the TextureTiler tool made of an image, unless it's loaded already. The pages of its
+    /// coarsest level are read straight away and never leave the cache, so it can always be drawn.
+    /// \param filename - the image, whose tiled texture is next to it with a .vtex extension.
+    /// \return - its indirection texture, to bind as texture_diffuseN; empty if there's no tiled texture, it doesn't
+    ///           use this system's page layout, or there's no room left for it.
+    ///
+    std::shared_ptr<GpuTexture> Load(const std::string& filename)
+    {
+        std::string path = TiledTexturePath(NormaliseAssetPath(filename));
+        auto found = byPath.find(path);
+        if(found != byPath.end())
+        {
+            return textures[found->second].indirection;
+        }
+
+        std::shared_ptr<TiledTexture> file = std::make_shared<TiledTexture>();
+        if(!file->Open(path))
+        {
+            return std::shared_ptr<GpuTexture>();
+        }
+        if(file->PageSize() != pageSize || file->Border() != border)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: " << path << " has pages of " << file->PageSize() << "+" << file->Border() << ", not "
+                      << pageSize << "+" << border << std::endl;
+            return std::shared_ptr<GpuTexture>();
+        }
+        if(file->PagesAcross(0) > VIRTUAL_TEXTURE_MAX_PAGES || file->PagesDown(0) > VIRTUAL_TEXTURE_MAX_PAGES)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: " << path << " is " << file->PagesAcross(0) << "x" << file->PagesDown(0) << " pages, more than "
+                      << VIRTUAL_TEXTURE_MAX_PAGES << " a side can't be addressed" << std::endl;
+            return std::shared_ptr<GpuTexture>();
+        }
+        int coarsest = file->Levels() - 1;
+        size_t pinned = ( size_t) file->PagesAcross(coarsest) * file->PagesDown(coarsest);
+        size_t freeSlots = ( size_t) std::count_if(slots.begin(), slots.end(), [](const CacheSlot& slot) { return !slot.pinned; });
+        if(textures.size() >= VIRTUAL_TEXTURE_LIMIT || pinned >= freeSlots)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: no room in the page cache for " << path << std::endl;
+            return std::shared_ptr<GpuTexture>();
+        }
+
+        VirtualTexture texture;
+        texture.path = path;
+        texture.file = file;
+        texture.slots.assign(( size_t) file->PageCount(), -1);
+        texture.reading.assign(( size_t) file->PageCount(), 0);
+        texture.entries.resize(( size_t) file->Levels());
+
+        unsigned int indirectionID;
+        glGenTextures(1, &indirectionID);
+        glBindTexture(GL_TEXTURE_2D, indirectionID);
+        for(int level = 0; level < file->Levels(); level++)
+        {
+            texture.entries[level].resize(( size_t) file->PagesAcross(level) * file->PagesDown(level) * 4);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, file->PagesAcross(level), file->PagesDown(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, coarsest);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture.indirection = std::make_shared<GpuTexture>(indirectionID);
+
+        int id = ( int) textures.size();
+        textures.push_back(texture);
+        byPath[path] = id;
+
+        std::vector<unsigned char> pixels(file->PageBytes());
+        for(int y = 0; y < file->PagesDown(coarsest); y++)
+        {
+            for(int x = 0; x < file->PagesAcross(coarsest); x++)
+            {
+                int page = file->PageIndex(coarsest, x, y);
+                if(!file->ReadPage(page, pixels.data()))
+                {
+                    std::cout << "ERROR::VIRTUAL_TEXTURE:: " << path << " has a damaged page" << std::endl;
+                }
+                place(id, page, pixels.data(), true);
+            }
+        }
+        updateIndirection(textures[id], id);
+        return textures[id].indirection;
+    }
+
+    ///
+    /// Swaps every diffuse map of a model for its virtual texture. It's all or nothing: if any diffuse map has no
+    /// tiled texture the model is left as it is, as the shader can't tell the two apart.
+    /// \return - true if the model's diffuse maps are now virtual.
+    ///
+    bool VirtualiseModel(Model& model)
+    {
+        std::unordered_map<std::string, std::shared_ptr<GpuTexture>> virtualised;
+        auto find = [&](const Texture& texture)
+        {
+            std::shared_ptr<GpuTexture>& indirection = virtualised[texture.path];
+            if(!indirection)
+            {
+                indirection = Load(model.directory + '/' + texture.path);
+            }
+            return indirection;
+        };
+        for(Mesh& mesh : model.meshes)
+        {
+            for(Texture& texture : mesh.textures)
+            {
+                if(texture.type == "texture_diffuse" && !find(texture))
+                {
+                    return false;
+                }
+            }
+        }
+
+        // The images themselves are freed with their last handles.
+        auto swap = [&](Texture& texture)
+        {
+            if(texture.type == "texture_diffuse")
+            {
+                texture.resource = find(texture);
+                texture.id = texture.resource->ID();
+            }
+        };
+        for(Mesh& mesh : model.meshes)
+        {
+            std::for_each(mesh.textures.begin(), mesh.textures.end(), swap);
+        }
+        std::for_each(model.textures_loaded.begin(), model.textures_loaded.end(), swap);
+        return true;
+    }
+
+    ///
+    /// Starts the feedback pass: binds a target a fraction of the frame's size and clears it. Draw what uses virtual
+    /// textures with the shader's feedback set, see Bind, then call EndFeedback.
+    /// \param width, height - the frame's size.
+    ///
+    void BeginFeedback(int width, int height)
+    {
+        int feedbackWidth = std::max(width / VIRTUAL_TEXTURE_FEEDBACK_DIVISOR, 1);
+        int feedbackHeight = std::max(height / VIRTUAL_TEXTURE_FEEDBACK_DIVISOR, 1);
+        if(feedbackWidth != targetWidth || feedbackHeight != targetHeight)
+        {
+            createFeedbackTarget(feedbackWidth, feedbackHeight);
+        }
+
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, savedClearColour);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, targetWidth, targetHeight);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    ///
+    /// Ends the feedback pass: starts reading it back into a pixel pack buffer, which Update looks at once the GPU
+    /// has written it, and restores the framebuffer and viewport.
+    ///
+    void EndFeedback()
+    {
+        if(fences[nextReadback] != 0)
+        {
+            // Every readback is still in flight.
+            feedbackSkipped++;
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[nextReadback]);
+            glReadPixels(0, 0, targetWidth, targetHeight, GL_RGBA, GL_UNSIGNED_BYTE, ( void*) 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            fences[nextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            nextReadback = (nextReadback + 1) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, ( GLuint) savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+        glClearColor(savedClearColour[0], savedClearColour[1], savedClearColour[2], savedClearColour[3]);
+    }
+
+    ///
+    /// Binds the page cache and sets the uniforms virtual texture lookups need. Call with the shader in use.
+    /// \param shader - a shader that samples virtual textures.
+    /// \param feedback - whether this is the feedback pass, which writes the pages wanted rather than colour.
+    ///
+    void Bind(const Shader& shader, bool feedback)
+    {
+        glActiveTexture(GL_TEXTURE0 + VIRTUAL_TEXTURE_CACHE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, cache->ID());
+        glActiveTexture(GL_TEXTURE0);
+        shader.SetUniformInt("virtualTextureCache", ( int) VIRTUAL_TEXTURE_CACHE_UNIT);
+        // The feedback pass is smaller, so its fragments are further apart; the bias takes it back to the frame's levels.
+        float levelBias = feedback ? -std::log2(( float) VIRTUAL_TEXTURE_FEEDBACK_DIVISOR) : 0.0f;
+        shader.SetUniformVec4("virtualTextureLayout", glm::vec4(( float) pageSize, ( float) border, ( float) (cachePages * slotSize), levelBias));
+        shader.SetUniformBool("virtualTextureFeedback", feedback);
+    }
+
+    ///
+    /// Reads any feedback the GPU has finished writing and queues reads for the pages it wants that aren't resident,
+    /// coarsest first. Uploads pages that have been read until the frame's budget is spent, into free slots or those
+    /// of the least recently wanted pages, and points the indirection textures at them. Call once a frame, after
+    /// EndFeedback.
+    /// \param budget - limits on this frame's uploads.
+    ///
+    void Update(const StreamingBudget& budget = StreamingBudget())
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        frame++;
+
+        while(fences[oldestReadback] != 0)
+        {
+            GLenum status = glClientWaitSync(fences[oldestReadback], 0, 0);
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            {
+                break;
+            }
+            glDeleteSync(fences[oldestReadback]);
+            fences[oldestReadback] = 0;
+            readFeedback(readbackBuffers[oldestReadback]);
+            oldestReadback = (oldestReadback + 1) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS;
+        }
+
+        size_t bytes = 0;
+        bool uploaded = false;
+        while(true)
+        {
+            std::shared_ptr<PageRead> read;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(finished.empty())
+                {
+                    break;
+                }
+                read = finished.front();
+            }
+            if(uploaded && (bytes + read->pixels.size() > budget.bytes
+                            || std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= budget.milliseconds))
+            {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.pop_front();
+            }
+
+            VirtualTexture& texture = textures[read->texture];
+            texture.reading[read->page] = 0;
+            if(read->failed)
+            {
+                std::cout << "ERROR::VIRTUAL_TEXTURE:: " << texture.path << " has a damaged page" << std::endl;
+                continue;
+            }
+            if(texture.slots[read->page] < 0)
+            {
+                place(read->texture, read->page, read->pixels.data(), false);
+                bytes += read->pixels.size();
+                uploaded = true;
+            }
+        }
+
+        for(size_t id = 0; id < textures.size(); id++)
+        {
+            if(textures[id].dirty)
+            {
+                updateIndirection(textures[id], ( int) id);
+            }
+        }
+        updateMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    VirtualTextureStats Stats()
+    {
+        VirtualTextureStats stats = counters;
+        stats.textures = textures.size();
+        stats.cachePages = slots.size();
+        stats.residentPages = ( size_t) std::count_if(slots.begin(), slots.end(), [](const CacheSlot& slot) { return slot.texture >= 0; });
+        stats.pendingReads = pendingReads;
+        stats.feedbackSkipped = feedbackSkipped;
+        stats.updateMilliseconds = updateMilliseconds;
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.readMilliseconds = readMilliseconds;
+        return stats;
+    }
+
+private:
+    // A tiled texture and where its pages are in the cache.
+    struct VirtualTexture
+    {
+        std::string path;
+        std::shared_ptr<TiledTexture> file;
+        std::shared_ptr<GpuTexture> indirection;
+        std::vector<int> slots;                         // Cache slot of each page, -1 if it isn't resident.
+        std::vector<unsigned char> reading;             // Whether each page is being read.
+        std::vector<std::vector<unsigned char>> entries;  // Each level of the indirection texture.
+        bool dirty = false;                             // The indirection texture is out of date.
+    };
+
+    // A slot of the page cache and the page it holds.
+    struct CacheSlot
+    {
+        int texture = -1;       // -1 if it's free.
+        int page = -1;
+        size_t lastUsed = 0;    // Frame the page was last wanted in.
+        bool pinned = false;    // A coarsest level page, never evicted.
+    };
+
+    // A page being read for the cache.
+    struct PageRead
+    {
+        int texture = 0;
+        int page = 0;
+        std::shared_ptr<TiledTexture> file;
+        std::vector<unsigned char> pixels;
+        bool failed = false;
+    };
+
+    int pageSize;
+    int border;
+    int cachePages;
+    int slotSize;
+    std::shared_ptr<GpuTexture> cache;
+    std::vector<CacheSlot> slots;
+    std::vector<VirtualTexture> textures;
+    std::unordered_map<std::string, int> byPath;
+    size_t frame = 0;
+
+    // The feedback pass and its readbacks.
+    unsigned int framebuffer = 0;
+    unsigned int feedbackColour = 0;
+    unsigned int feedbackDepth = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    unsigned int readbackBuffers[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS] = {};
+    GLsync fences[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS] = {};
+    unsigned int nextReadback = 0;
+    unsigned int oldestReadback = 0;
+    GLint savedViewport[4] = {};
+    GLint savedFramebuffer = 0;
+    GLfloat savedClearColour[4] = {};
+
+    VirtualTextureStats counters;
+    size_t pendingReads = 0;
+    size_t feedbackSkipped = 0;
+    double updateMilliseconds = 0.0;
+
+    // Shared with the workers.
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<std::shared_ptr<PageRead>> queued;
+    std::deque<std::shared_ptr<PageRead>> finished;
+    double readMilliseconds = 0.0;
+    bool stopping = false;
+
+    // (Re)creates the feedback target and the buffers it's read back into.
+    void createFeedbackTarget(int width, int height)
+    {
+        if(framebuffer == 0)
+        {
+            glGenFramebuffers(1, &framebuffer);
+            glGenTextures(1, &feedbackColour);
+            glGenRenderbuffers(1, &feedbackDepth);
+            glGenBuffers(VIRTUAL_TEXTURE_FEEDBACK_BUFFERS, readbackBuffers);
+        }
+        targetWidth = width;
+        targetHeight = height;
+
+        glBindTexture(GL_TEXTURE_2D, feedbackColour);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        GLint previous = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColour, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: the feedback framebuffer is incomplete" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, ( GLuint) previous);
+
+        // Readbacks of the old size are dropped.
+        for(unsigned int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++)
+        {
+            if(fences[i] != 0)
+            {
+                glDeleteSync(fences[i]);
+                fences[i] = 0;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, ( GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        nextReadback = 0;
+        oldestReadback = 0;
+    }
+
+    // Gathers the distinct pages a feedback readback asks for. Each wanted page and every page above it is marked as
+    // used this frame, and those that aren't resident are queued for reading, coarsest first so the fallbacks
+    // improve soonest.
+    void readFeedback(unsigned int buffer)
+    {
+        size_t size = ( size_t) targetWidth * targetHeight * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        const unsigned char* pixels = ( const unsigned char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, ( GLsizeiptr) size, GL_MAP_READ_BIT);
+        std::unordered_set<uint32_t> requests;
+        if(pixels != NULL)
+        {
+            for(size_t i = 0; i < size; i += 4)
+            {
+                if(pixels[i + 3] != 0)
+                {
+                    requests.insert(( uint32_t) pixels[i + 3] << 24 | ( uint32_t) pixels[i + 2] << 16 | ( uint32_t) pixels[i + 1] << 8 | pixels[i]);
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        counters.feedbackReadbacks++;
+
+        std::vector<std::pair<int, std::pair<int, int>>> missing;    // Level, then texture and page.
+        counters.requestedPages = requests.size();
+        counters.missingPages = 0;
+        for(uint32_t request : requests)
+        {
+            int id = ( int) (request >> 24) - 1;
+            if(id >= ( int) textures.size())
+            {
+                continue;
+            }
+            VirtualTexture& texture = textures[id];
+            const TiledTexture& file = *texture.file;
+            int level = std::min(( int) (request >> 16 & 0xFF), file.Levels() - 1);
+            int x = std::min(( int) (request & 0xFF), file.PagesAcross(level) - 1);
+            int y = std::min(( int) (request >> 8 & 0xFF), file.PagesDown(level) - 1);
+            counters.missingPages += texture.slots[file.PageIndex(level, x, y)] < 0 ? 1 : 0;
+            for(; level < file.Levels(); level++, x /= 2, y /= 2)
+            {
+                int page = file.PageIndex(level, x, y);
+                int slot = texture.slots[page];
+                if(slot >= 0)
+                {
+                    slots[slot].lastUsed = frame;
+                }
+                else if(!texture.reading[page])
+                {
+                    texture.reading[page] = 1;
+                    missing.push_back(std::make_pair(level, std::make_pair(id, page)));
+                }
+            }
+        }
+
+        std::sort(missing.begin(), missing.end(), [](const std::pair<int, std::pair<int, int>>& a, const std::pair<int, std::pair<int, int>>& b)
+        {
+            return a.first > b.first;
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const std::pair<int, std::pair<int, int>>& page : missing)
+        {
+            VirtualTexture& texture = textures[page.second.first];
+            if(queued.size() >= VIRTUAL_TEXTURE_MAX_READS)
+            {
+                // Left for a later feedback to ask for again.
+                texture.reading[page.second.second] = 0;
+                continue;
+            }
+            std::shared_ptr<PageRead> read = std::make_shared<PageRead>();
+            read->texture = page.second.first;
+            read->page = page.second.second;
+            read->file = texture.file;
+            queued.push_back(read);
+        }
+        pendingReads = queued.size() + finished.size();
+        queueChanged.notify_all();
+    }
+
+    // Puts a page into a free slot, or the slot of the page wanted least recently, unless every page was wanted this
+    // frame. Returns false if there was no slot to take.
+    bool place(int id, int page, const unsigned char* pixels, bool pinned)
+    {
+        int chosen = -1;
+        for(int i = 0; i < ( int) slots.size(); i++)
+        {
+            const CacheSlot& slot = slots[i];
+            if(slot.texture < 0)
+            {
+                chosen = i;
+                break;
+            }
+            if(!slot.pinned && slot.lastUsed < frame && (chosen < 0 || slot.lastUsed < slots[chosen].lastUsed))
+            {
+                chosen = i;
+            }
+        }
+        if(chosen < 0)
+        {
+            counters.cacheFull++;
+            return false;
+        }
+
+        CacheSlot& slot = slots[chosen];
+        if(slot.texture >= 0)
+        {
+            textures[slot.texture].slots[slot.page] = -1;
+            textures[slot.texture].dirty = true;
+            counters.pagesEvicted++;
+        }
+        slot.texture = id;
+        slot.page = page;
+        slot.lastUsed = frame;
+        slot.pinned = pinned;
+        textures[id].slots[page] = chosen;
+        textures[id].dirty = true;
+
+        SharedTextureStaging().UploadRegion(cache->ID(), (chosen % cachePages) * slotSize, (chosen / cachePages) * slotSize, slotSize, slotSize,
+                                            GL_RGBA, pixels);
+        counters.pagesLoaded++;
+        return true;
+    }
+
+    // Rewrites a virtual texture's indirection texture: each page points at its own slot if it's resident, otherwise
+    // at the slot of the page above it, coarsest level first so that's already known.
+    void updateIndirection(VirtualTexture& texture, int id)
+    {
+        const TiledTexture& file = *texture.file;
+        glBindTexture(GL_TEXTURE_2D, texture.indirection->ID());
+        for(int level = file.Levels() - 1; level >= 0; level--)
+        {
+            std::vector<unsigned char>& entries = texture.entries[level];
+            int across = file.PagesAcross(level);
+            for(int y = 0; y < file.PagesDown(level); y++)
+            {
+                for(int x = 0; x < across; x++)
+                {
+                    unsigned char* entry = &entries[(( size_t) y * across + x) * 4];
+                    int slot = texture.slots[file.PageIndex(level, x, y)];
+                    if(slot >= 0)
+                    {
+                        entry[0] = ( unsigned char) (slot % cachePages);
+                        entry[1] = ( unsigned char) (slot / cachePages);
+                        entry[2] = ( unsigned char) level;
+                    }
+                    else if(level + 1 < file.Levels())
+                    {
+                        std::memcpy(entry, &texture.entries[level + 1][(( size_t) (y / 2) * file.PagesAcross(level + 1) + x / 2) * 4], 3);
+                    }
+                    entry[3] = ( unsigned char) (id + 1);
+                }
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, across, file.PagesDown(level), GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+        }
+        texture.dirty = false;
+    }
+
+    // Takes queued pages one at a time and reads them.
+    void workerLoop()
+    {
+        while(true)
+        {
+            std::shared_ptr<PageRead> read;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [this] { return stopping || !queued.empty(); });
+                if(stopping)
+                {
+                    return;
+                }
+                read = queued.front();
+                queued.pop_front();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            read->pixels.resize(read->file->PageBytes());
+            read->failed = !read->file->ReadPage(read->page, read->pixels.data());
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(read);
+            readMilliseconds += milliseconds;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,705 @@
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Utility code to load models without a GL context, which also brings in the OBJ reader and tangent generation.
+#include <ModelData/modeldata.h>
+
+// The native binary glTF reader, compared against importing the same file with assimp.
+#include <GltfLoader/gltfloader.h>
+
+// The mesh codec cooked models are packed with, and LZ4 to compare it against.
+#include <Compression/lz4.h>
+#include <MeshCodec/meshcodec.h>
+
+// The image cache and its pixel codec, compared against decoding the images with stb_image.
+#include <ImageCache/imagecache.h>
+#include <PixelCodec/pixelcodec.h>
+
+// Headless load time benchmarks for the model loading utilities. Nothing here needs a window or a GL context,
+// so it can be run on any machine against any set of models.
+
+// Each measurement is repeated and the fastest run kept, which filters out disk cache and scheduling noise.
+const int RUNS = 5;
+
+// Attributes are compared in steps of this size when checking two loaders agree, so rounding differences in float
+// parsing don't count as mismatches.
+const float CONFORMANCE_QUANTUM = 1.0f / 4096.0f;
+
+// Number of copies of a model loaded at once when measuring how loading scales across threads.
+const int MODEL_BATCH_SIZE = 16;
+
+// Models measured when none are given on the command line.
+const char* DEFAULT_MODELS[] = { "../../../12-ModelLoading/ModelLoading/Models/nanosuit/nanosuit.obj" };
+
+///
+/// Returns true if the mesh's material has a normal or height map, using the same texture types as the Model utility.
+///
+bool HasTangentSpaceMaps(const aiScene* scene, const aiMesh* mesh)
+{
+    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    return material->GetTextureCount(aiTextureType_HEIGHT) > 0 || material->GetTextureCount(aiTextureType_AMBIENT) > 0;
+}
+
+///
+/// Copies an assimp mesh into the benchmark's vertex and index buffers.
+///
+void ExtractMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.resize(mesh->mNumVertices);
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        Vertex& vertex = vertices[i];
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        vertex.Normal = mesh->mNormals ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f);
+        vertex.TexCoords = mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+        vertex.Tangent = glm::vec3(0.0f);
+        vertex.Bitangent = glm::vec3(0.0f);
+    }
+
+    indices.clear();
+    indices.reserve(mesh->mNumFaces * 3);
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        indices.insert(indices.end(), mesh->mFaces[i].mIndices, mesh->mFaces[i].mIndices + mesh->mFaces[i].mNumIndices);
+    }
+}
+
+///
+/// Compares loading with assimp's aiProcess_CalcTangentSpace against loading without it and generating tangents
+/// in-house for the meshes that have normal or height maps.
+///
+/// \param path - the model file to load.
+///
+void RunTangentBenchmark(const std::string& path)
+{
+    double assimpBest = INFINITY;
+    double importBest = INFINITY;
+    double generateBest = INFINITY;
+    size_t generatedVertices = 0;
+    size_t totalVertices = 0;
+
+    for(int run = 0; run < RUNS; run++)
+    {
+        // Assimp generates tangents for every mesh as part of the import.
+        {
+            Assimp::Importer importer;
+            auto start = std::chrono::high_resolution_clock::now();
+            const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+            assimpBest = std::min(assimpBest, MillisecondsSince(start));
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+            {
+                std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+                return;
+            }
+        }
+
+        // Plain import, then tangents only where a map needs them.
+        Assimp::Importer importer;
+        auto start = std::chrono::high_resolution_clock::now();
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        importBest = std::min(importBest, MillisecondsSince(start));
+
+        std::vector<std::vector<Vertex>> vertices(scene->mNumMeshes);
+        std::vector<std::vector<unsigned int>> indices(scene->mNumMeshes);
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            ExtractMesh(scene->mMeshes[i], vertices[i], indices[i]);
+        }
+
+        generatedVertices = 0;
+        totalVertices = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            totalVertices += vertices[i].size();
+            if(scene->mMeshes[i]->mTextureCoords[0] && HasTangentSpaceMaps(scene, scene->mMeshes[i]))
+            {
+                GenerateTangents(vertices[i], indices[i]);
+                generatedVertices += vertices[i].size();
+            }
+        }
+        generateBest = std::min(generateBest, MillisecondsSince(start));
+    }
+
+    std::cout << "TANGENT BENCHMARK:: " << path << ": "
+              << "assimp with aiProcess_CalcTangentSpace " << assimpBest << " ms, "
+              << "assimp without " << importBest << " ms + GenerateTangents " << generateBest << " ms "
+              << "(" << generatedVertices << " of " << totalVertices << " vertices, " << WorkerThreadCount() << " threads)" << std::endl;
+}
+
+///
+/// One triangle's corner positions, normals and texture coordinates, quantised so that triangles from different
+/// loaders can be sorted and compared.
+///
+typedef std::array<int, 24> QuantisedTriangle;
+
+///
+/// Appends the quantised triangles of an indexed mesh.
+///
+void QuantiseTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, std::vector<QuantisedTriangle>& triangles)
+{
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        QuantisedTriangle triangle;
+        for(int corner = 0; corner < 3; corner++)
+        {
+            const Vertex& vertex = vertices[indices[i + corner]];
+            const float attributes[8] = { vertex.Position.x, vertex.Position.y, vertex.Position.z, vertex.Normal.x, vertex.Normal.y, vertex.Normal.z,
+                                          vertex.TexCoords.x, vertex.TexCoords.y };
+            for(int a = 0; a < 8; a++)
+            {
+                triangle[corner * 8 + a] = ( int) std::lround(attributes[a] / CONFORMANCE_QUANTUM);
+            }
+        }
+        triangles.push_back(triangle);
+    }
+}
+
+///
+/// Compares the native OBJ parser with ASSIMP, first for throughput and then for conformance: both must produce the
+/// same meshes holding the same triangles, with the same attributes at every corner. Welding makes the vertex and
+/// index order differ, so the triangles are compared as sorted sets.
+///
+/// \param path - the OBJ file to load.
+///
+void RunObjBenchmark(const std::string& path)
+{
+    const unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs;
+    double assimpBest = INFINITY;
+    double nativeBest = INFINITY;
+    ObjScene<Vertex> objScene;
+    Assimp::Importer importer;
+    const aiScene* scene = NULL;
+
+    for(int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        scene = importer.ReadFile(path, flags);
+        assimpBest = std::min(assimpBest, MillisecondsSince(start));
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        if(!LoadObj(path, objScene, true))
+        {
+            std::cout << "ERROR::OBJ:: failed to read " << path << std::endl;
+            return;
+        }
+        nativeBest = std::min(nativeBest, MillisecondsSince(start));
+    }
+
+    FileMapping mapping(path);
+    double megabytes = mapping.Size() / (1024.0 * 1024.0);
+    std::cout << "OBJ BENCHMARK:: " << path << ": " << megabytes << " MB, "
+              << "assimp " << assimpBest << " ms (" << megabytes / (assimpBest / 1000.0) << " MB/s), "
+              << "LoadObj " << nativeBest << " ms (" << megabytes / (nativeBest / 1000.0) << " MB/s, " << WorkerThreadCount() << " threads)" << std::endl;
+
+    // Conformance.
+    std::vector<QuantisedTriangle> expected;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+    {
+        ExtractMesh(scene->mMeshes[i], vertices, indices);
+        QuantiseTriangles(vertices, indices, expected);
+    }
+    std::vector<QuantisedTriangle> actual;
+    size_t weldedVertices = 0;
+    for(const ObjMesh<Vertex>& mesh : objScene.meshes)
+    {
+        QuantiseTriangles(mesh.vertices, mesh.indices, actual);
+        weldedVertices += mesh.vertices.size();
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+
+    bool conforms = scene->mNumMeshes == objScene.meshes.size() && expected == actual;
+    std::cout << "OBJ CONFORMANCE:: " << path << ": " << (conforms ? "PASS" : "FAIL") << ", "
+              << objScene.meshes.size() << " meshes (assimp " << scene->mNumMeshes << "), "
+              << actual.size() << " triangles (assimp " << expected.size() << "), "
+              << weldedVertices << " welded vertices" << std::endl;
+}
+
+///
+/// Loads a batch of copies of a model through the Model utility's CPU path, textures included, first one after
+/// another and then all at once. Runs warm, from the cooked model the first load leaves behind.
+///
+void RunModelDataBenchmark(const std::string& path)
+{
+    {
+        ModelData warmUp;
+        if(!LoadModelData(path, warmUp))
+        {
+            std::cout << "ERROR::BENCHMARK:: couldn't load " << path << std::endl;
+            return;
+        }
+    }
+
+    double serialMs = INFINITY;
+    double concurrentMs = INFINITY;
+    for(int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < MODEL_BATCH_SIZE; i++)
+        {
+            ModelData data;
+            LoadModelData(path, data);
+            DecodeModelTextures(data);
+        }
+        serialMs = std::min(serialMs, MillisecondsSince(start));
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<ModelData> batch(MODEL_BATCH_SIZE);
+        ParallelFor(batch.size(), [&](size_t i)
+        {
+            LoadModelData(path, batch[i]);
+            DecodeModelTextures(batch[i]);
+        });
+        concurrentMs = std::min(concurrentMs, MillisecondsSince(start));
+    }
+
+    std::cout << "MODEL DATA:: " << path << ": " << MODEL_BATCH_SIZE << " loads, "
+              << serialMs << " ms one at a time, " << concurrentMs << " ms at once (" << serialMs / concurrentMs << "x)" << std::endl;
+}
+
+///
+/// Decodes every texture of a model the way the chapters used to, one after another on one thread with stb_image's
+/// global flip, and then as the texture streamer does, spread across the workers and flipped by hand. Uploads need
+/// a context, so their time is reported by the streamers themselves.
+///
+void RunTextureDecodeBenchmark(const std::string& path)
+{
+    ModelData data;
+    if(!LoadModelData(path, data))
+    {
+        std::cout << "ERROR::BENCHMARK:: couldn't load " << path << std::endl;
+        return;
+    }
+    DecodeModelTextures(data);
+    if(data.textures.empty())
+    {
+        return;
+    }
+    size_t bytes = 0;
+    for(const ModelTexture& texture : data.textures)
+    {
+        bytes += texture.decoded.pixels.size();
+    }
+
+    double serialMs = INFINITY;
+    double concurrentMs = INFINITY;
+    for(int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        stbi_set_flip_vertically_on_load(true);
+        for(const ModelTexture& texture : data.textures)
+        {
+            int width, height, components;
+            unsigned char* pixels = stbi_load((data.directory + '/' + texture.reference.path).c_str(), &width, &height, &components, 0);
+            stbi_image_free(pixels);
+        }
+        stbi_set_flip_vertically_on_load(false);
+        serialMs = std::min(serialMs, MillisecondsSince(start));
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<DecodedTexture> decoded(data.textures.size());
+        ParallelFor(decoded.size(), [&](size_t i)
+        {
+            DecodeTexture(data.directory + '/' + data.textures[i].reference.path, decoded[i]);
+            FlipTextureRows(decoded[i]);
+        });
+        concurrentMs = std::min(concurrentMs, MillisecondsSince(start));
+    }
+
+    std::cout << "TEXTURE DECODE:: " << path << ": " << data.textures.size() << " textures, " << bytes / (1024 * 1024)
+              << " MB decoded, " << serialMs << " ms one at a time, " << concurrentMs << " ms on " << WorkerThreadCount()
+              << " workers (" << serialMs / concurrentMs << "x)" << std::endl;
+}
+
+///
+/// Round trips images of awkward shapes through the pixel codec: rows narrower than a group of bytes, widths that
+/// aren't a multiple of it and bands cut short, which the model's textures don't cover.
+/// \return - true if every image decodes to what was encoded.
+///
+bool CheckPixelCodecShapes()
+{
+    const int shapes[][3] = { { 1, 1, 1 }, { 2, 16, 4 }, { 3, 40, 3 }, { 1, 64, 4 }, { 7, 33, 1 }, { 5, 100, 3 }, { 17, 9, 2 },
+                              { 4, 130, 4 }, { 301, 70, 3 } };
+    bool matches = true;
+    uint32_t random = 1;
+    for(const int* shape : shapes)
+    {
+        std::vector<unsigned char> pixels(( size_t) shape[0] * shape[1] * shape[2]);
+        for(size_t i = 0; i < pixels.size(); i++)
+        {
+            random = random * 1664525 + 1013904223;
+            pixels[i] = ( unsigned char) (i * 7 / 5 + (random >> 29));
+        }
+        std::vector<unsigned char> encoded;
+        EncodePixelImage(pixels.data(), shape[0], shape[1], shape[2], encoded);
+        std::vector<unsigned char> decoded(pixels.size());
+        matches &= DecodePixelImage(encoded.data(), encoded.size(), shape[0], shape[1], shape[2], decoded.data()) && decoded == pixels;
+    }
+    return matches;
+}
+
+///
+/// Decodes every texture of a model from its image file with stb_image, and from the pixel codec the image cache
+/// stores it with, and reports the throughput of each in decoded bytes a second. The warm figure is what DecodeTexture
+/// pays on a later run: checking the image's size and modification time for the cache's key, then mapping and
+/// decoding the cache.
+///
+void RunImageCacheBenchmark(const std::string& path)
+{
+    ModelData data;
+    if(!LoadModelData(path, data))
+    {
+        std::cout << "ERROR::BENCHMARK:: couldn't load " << path << std::endl;
+        return;
+    }
+
+    size_t sourceBytes = 0;
+    size_t encodedBytes = 0;
+    size_t decodedBytes = 0;
+    double stbMs = 0.0;
+    double encodeMs = 0.0;
+    double codecMs = 0.0;
+    double warmMs = 0.0;
+    bool matches = CheckPixelCodecShapes();
+    std::vector<std::string> images;
+    for(const CookedMesh& mesh : data.meshes)
+    {
+        for(const CookedTextureReference& reference : mesh.textures)
+        {
+            std::string image = data.directory + '/' + reference.path;
+            if(std::find(images.begin(), images.end(), image) == images.end())
+            {
+                images.push_back(image);
+            }
+        }
+    }
+
+    std::vector<std::string> done;
+    for(const std::string& image : images)
+    {
+        std::vector<unsigned char> file;
+        if(!ReadAsset(image, file))
+        {
+            continue;
+        }
+
+        int width, height, components;
+        double stbBest = INFINITY;
+        std::vector<unsigned char> reference;
+        for(int run = 0; run < RUNS; run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            unsigned char* pixels = stbi_load_from_memory(file.data(), ( int) file.size(), &width, &height, &components, 0);
+            stbBest = std::min(stbBest, MillisecondsSince(start));
+            if(!pixels)
+            {
+                break;
+            }
+            reference.assign(pixels, pixels + ( size_t) width * height * components);
+            stbi_image_free(pixels);
+        }
+        if(reference.empty())
+        {
+            continue;
+        }
+        done.push_back(image);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<unsigned char> encoded;
+        EncodePixelImage(reference.data(), width, height, components, encoded);
+        encodeMs += MillisecondsSince(start);
+
+        double codecBest = INFINITY;
+        std::vector<unsigned char> decoded(reference.size());
+        for(int run = 0; run < RUNS; run++)
+        {
+            start = std::chrono::high_resolution_clock::now();
+            matches &= DecodePixelImage(encoded.data(), encoded.size(), width, height, components, decoded.data());
+            codecBest = std::min(codecBest, MillisecondsSince(start));
+        }
+        matches &= decoded == reference;
+
+        // The cache DecodeTexture leaves next to the image.
+        std::string cachePath = image + IMAGE_CACHE_EXTENSION;
+        uint64_t key = 0;
+        matches &= ImageCacheKey(image, key) && WriteImageCache(cachePath, key, reference.data(), width, height, components);
+        double warmBest = INFINITY;
+        for(int run = 0; run < RUNS; run++)
+        {
+            start = std::chrono::high_resolution_clock::now();
+            int cachedWidth, cachedHeight, cachedComponents;
+            matches &= ImageCacheKey(image, key) && ReadImageCache(cachePath, key, cachedWidth, cachedHeight, cachedComponents, decoded);
+            warmBest = std::min(warmBest, MillisecondsSince(start));
+        }
+        matches &= decoded == reference;
+
+        sourceBytes += file.size();
+        encodedBytes += encoded.size();
+        decodedBytes += reference.size();
+        stbMs += stbBest;
+        codecMs += codecBest;
+        warmMs += warmBest;
+    }
+    if(done.empty())
+    {
+        return;
+    }
+
+    const double megabyte = 1024.0 * 1024.0;
+    std::cout << "IMAGE CACHE:: " << path << ": " << (matches ? "PASS" : "FAIL") << ", " << done.size() << " images, " << decodedBytes / megabyte
+              << " MB decoded from " << sourceBytes / megabyte << " MB of images, cached in " << encodedBytes / megabyte << " MB; stb_image "
+              << decodedBytes / megabyte / (stbMs / 1000.0) << " MB/s, pixel codec " << decodedBytes / megabyte / (codecMs / 1000.0)
+              << " MB/s on " << WorkerThreadCount() << " workers (" << stbMs / codecMs << "x), warm cache read "
+              << decodedBytes / megabyte / (warmMs / 1000.0) << " MB/s (" << stbMs / warmMs << "x), encoded at "
+              << decodedBytes / megabyte / (encodeMs / 1000.0) << " MB/s" << std::endl;
+}
+
+///
+/// Encodes every mesh of a model with the mesh codec, as the asset cooker packs them, and reports how small the
+/// vertices and indices get next to storing them raw or LZ4 compressed, and how fast they decode. Decoding has to
+/// outrun the disk by a wide margin for the smaller file to load faster.
+///
+void RunMeshCodecBenchmark(const std::string& path)
+{
+    ModelData data;
+    if(!LoadModelData(path, data))
+    {
+        std::cout << "ERROR::BENCHMARK:: couldn't load " << path << std::endl;
+        return;
+    }
+
+    size_t rawBytes = 0;
+    size_t lz4Bytes = 0;
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    std::vector<std::vector<unsigned char>> encodedVertices(data.meshes.size());
+    std::vector<std::vector<unsigned char>> encodedIndices(data.meshes.size());
+    for(size_t i = 0; i < data.meshes.size(); i++)
+    {
+        const CookedMesh& mesh = data.meshes[i];
+        size_t meshVertexBytes = ( size_t) mesh.vertexCount * sizeof(Vertex);
+        size_t meshIndexBytes = ( size_t) mesh.indexCount * sizeof(unsigned int);
+        EncodeVertexBuffer(mesh.vertices, mesh.vertexCount, sizeof(Vertex), encodedVertices[i]);
+        EncodeIndexBuffer(mesh.indices, mesh.indexCount, encodedIndices[i]);
+        rawBytes += meshVertexBytes + meshIndexBytes;
+        vertexBytes += encodedVertices[i].size();
+        indexBytes += encodedIndices[i].size();
+
+        std::vector<unsigned char> compressed(Lz4CompressBound(std::max(meshVertexBytes, meshIndexBytes)));
+        lz4Bytes += Lz4Compress(static_cast<const unsigned char*>(mesh.vertices), meshVertexBytes, compressed.data(), compressed.size());
+        lz4Bytes += Lz4Compress(reinterpret_cast<const unsigned char*>(mesh.indices), meshIndexBytes, compressed.data(), compressed.size());
+    }
+
+    double vertexBest = INFINITY;
+    double indexBest = INFINITY;
+    bool matches = true;
+    std::vector<unsigned char> scratch;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned int> indices;
+    for(int run = 0; run < RUNS; run++)
+    {
+        double vertexMs = 0.0;
+        double indexMs = 0.0;
+        for(size_t i = 0; i < data.meshes.size(); i++)
+        {
+            const CookedMesh& mesh = data.meshes[i];
+            vertices.resize(( size_t) mesh.vertexCount * sizeof(Vertex));
+            indices.resize(mesh.indexCount);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            matches &= DecodeVertexBuffer(encodedVertices[i].data(), encodedVertices[i].size(), mesh.vertexCount, sizeof(Vertex), vertices.data(), scratch);
+            vertexMs += MillisecondsSince(start);
+
+            start = std::chrono::high_resolution_clock::now();
+            matches &= DecodeIndexBuffer(encodedIndices[i].data(), encodedIndices[i].size(), mesh.indexCount, mesh.vertexCount, indices.data(), scratch);
+            indexMs += MillisecondsSince(start);
+
+            matches &= std::memcmp(vertices.data(), mesh.vertices, vertices.size()) == 0
+                       && std::equal(indices.begin(), indices.end(), mesh.indices);
+        }
+        vertexBest = std::min(vertexBest, vertexMs);
+        indexBest = std::min(indexBest, indexMs);
+    }
+
+    size_t rawVertexBytes = rawBytes;
+    for(const CookedMesh& mesh : data.meshes)
+    {
+        rawVertexBytes -= ( size_t) mesh.indexCount * sizeof(unsigned int);
+    }
+    const double megabyte = 1024.0 * 1024.0;
+    std::cout << "MESH CODEC:: " << path << ": " << (matches ? "PASS" : "FAIL") << ", " << rawBytes / megabyte << " MB raw, "
+              << (vertexBytes + indexBytes) / megabyte << " MB encoded (" << ( double) rawBytes / (vertexBytes + indexBytes) << ":1), "
+              << lz4Bytes / megabyte << " MB LZ4 (" << ( double) rawBytes / lz4Bytes << ":1); "
+              << "vertices " << ( double) rawVertexBytes / vertexBytes << ":1 decoded at " << rawVertexBytes / megabyte / (vertexBest / 1000.0) << " MB/s, "
+              << "indices " << ( double) (rawBytes - rawVertexBytes) / indexBytes << ":1 decoded at "
+              << (rawBytes - rawVertexBytes) / megabyte / (indexBest / 1000.0) << " MB/s" << std::endl;
+}
+
+///
+/// The most memory the process has had resident so far, in bytes. Only ever grows, so measure the lighter of two
+/// routes first and take the growth of each.
+///
+size_t PeakMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    return ( size_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+///
+/// Compares reading a binary glTF file natively with importing it through assimp, up to the point where the data is
+/// ready for glBufferData. The native reader leaves every vertex and index where it is in the mapped file, while
+/// assimp expands them into its scene and then into the Model utility's vertices. Reports the fastest of RUNS, the
+/// bytes each route holds on the heap for the upload, and how far each raised the process's peak memory.
+///
+/// \param path - the .glb file to load.
+///
+void RunGlbBenchmark(const std::string& path)
+{
+    // Native first, as the peak only grows.
+    size_t peakBefore = PeakMemoryBytes();
+    double nativeBest = INFINITY;
+    size_t nativeBytes = 0;
+    size_t primitives = 0;
+    bool quantized = false;
+    for(int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        GltfAsset asset;
+        if(!LoadGlb(path, asset))
+        {
+            return;
+        }
+        nativeBest = std::min(nativeBest, MillisecondsSince(start));
+
+        // Uploads read the buffer views straight from the mapping.
+        std::vector<bool> used(asset.bufferViews.size(), false);
+        nativeBytes = 0;
+        for(const GltfPrimitive& primitive : asset.primitives)
+        {
+            for(int a = 0; a < GLTF_ATTRIBUTE_COUNT; a++)
+            {
+                if(primitive.attributes[a] >= 0)
+                {
+                    used[asset.accessors[primitive.attributes[a]].bufferView] = true;
+                }
+            }
+            if(primitive.indices >= 0)
+            {
+                used[asset.accessors[primitive.indices].bufferView] = true;
+            }
+        }
+        for(size_t i = 0; i < used.size(); i++)
+        {
+            nativeBytes += used[i] ? asset.bufferViews[i].byteLength : 0;
+        }
+        primitives = asset.primitives.size();
+        quantized = asset.quantized;
+    }
+    size_t nativePeak = PeakMemoryBytes() - peakBefore;
+
+    peakBefore = PeakMemoryBytes();
+    double assimpBest = INFINITY;
+    size_t assimpBytes = 0;
+    size_t meshes = 0;
+    for(int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<MeshSource> sources;
+        std::vector<SceneNodeSource> nodes;
+        if(!ImportAssimpModel(path, sources, nodes))
+        {
+            return;
+        }
+        assimpBest = std::min(assimpBest, MillisecondsSince(start));
+
+        assimpBytes = 0;
+        for(const MeshSource& source : sources)
+        {
+            assimpBytes += source.vertices.size() * sizeof(Vertex) + source.indices.size() * sizeof(unsigned int);
+        }
+        meshes = sources.size();
+    }
+    size_t assimpPeak = PeakMemoryBytes() - peakBefore;
+
+    const double kilobyte = 1024.0;
+    std::cout << "GLTF BENCHMARK:: " << path << ": " << primitives << " primitives" << (quantized ? " (quantized)" : "") << ", "
+              << "LoadGlb " << nativeBest << " ms, " << nativeBytes / kilobyte << " KB mapped for upload, peak +" << nativePeak / kilobyte << " KB; "
+              << "assimp " << assimpBest << " ms, " << meshes << " meshes, " << assimpBytes / kilobyte << " KB copied for upload, peak +"
+              << assimpPeak / kilobyte << " KB (" << assimpBest / nativeBest << "x)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> models;
+    for(int i = 1; i < argc; i++)
+    {
+        models.push_back(argv[i]);
+    }
+    if(models.empty())
+    {
+        models.assign(std::begin(DEFAULT_MODELS), std::end(DEFAULT_MODELS));
+    }
+
+    for(const std::string& model : models)
+    {
+        RunTangentBenchmark(model);
+        RunModelDataBenchmark(model);
+        RunTextureDecodeBenchmark(model);
+        RunImageCacheBenchmark(model);
+        RunMeshCodecBenchmark(model);
+
+        std::string extension = model.substr(model.find_last_of('.') + 1);
+        if(extension == "obj" || extension == "OBJ")
+        {
+            RunObjBenchmark(model);
+        }
+        if(extension == "glb" || extension == "GLB")
+        {
+            RunGlbBenchmark(model);
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Utility code to read models and decode images without a GL context.
+#include <ModelData/modeldata.h>
+// Utility code to block compress images and write them as KTX2 files.
+#include <Ktx/ktx.h>
+// Utility code to build mip chains in linear light.
+#include <MipChain/mipchain.h>
+// Utility code to declare material layouts and record what's been packed.
+#include <MaterialPacking/materialpacking.h>
+
+// Packs the channels of each material's maps into fewer textures, as a material layout declares: specular intensity
+// into the diffuse map's alpha, say, or height into a normal map's blue. Each packed map is block compressed with its
+// whole mip chain and written as a KTX2 file next to the map it replaces, and a packing file next to the model lists
+// what each one replaces. LoadModelData then loads the packed maps in their place, and shaders written for the
+// layout sample one texture where they sampled several.
+//
+// Usage: MaterialPacker [model]... [--layout file] [--bc7] [--srgb] [--flip] [--no-supercompress] [--reuse tolerance]
+//                       [--filter kaiser|box]
+// The maps are read as they are, not from any KTX2 file the texture cooker made of them. Maps packed together must be
+// the same size; a map a material doesn't have reads as 0. Packed maps are BC7, supercompressed, unless
+// --no-supercompress is given, and then BC3 unless --bc7 is too. --srgb marks maps that replace a diffuse map as sRGB
+// encoded and --flip stores the rows bottom first, as the texture cooker does. Maps that replace a diffuse map are
+// filtered in linear light, and ones that replace a normal map are renormalised if their RGB is the normal map's.
+//
+// The packing file is only written once every map of the model has been packed, so a model is never drawn with
+// some of its materials packed and others not.
+//
+// Virtual texturing streams the packed diffuse maps in place of the originals, so run the TextureTiler tool on the
+// model's directory again after packing it.
+
+// Model packed, and the layout used, when none are given on the command line.
+const char* DEFAULT_MODEL = "../../../12-ModelLoading/ModelLoading/Models/nanosuit/nanosuit.obj";
+const char* DEFAULT_LAYOUT = "Layouts/diffuse_specular.json";
+
+const char* BLOCK_FORMAT_NAMES[] = { "bc1", "bc3", "bc4", "bc5", "bc7" };
+
+const char* MIP_FILTER_NAMES[] = { "box", "kaiser" };
+
+// Extra squared error per channel a block may take on to reuse its neighbour's endpoints, when supercompressing.
+const float DEFAULT_REUSE_TOLERANCE = 4.0f;
+
+// How maps are packed, from the command line.
+struct MaterialPackOptions
+{
+    std::string layoutPath = DEFAULT_LAYOUT;
+    bool bc7 = false;           // Whether packed maps are BC7 rather than BC3 when they aren't supercompressed.
+    bool srgb = false;          // Whether maps that replace a diffuse map are marked sRGB encoded.
+    bool flip = false;          // Whether rows are stored bottom first.
+    bool supercompress = true;
+    MipFilter filter = MIP_FILTER_KAISER;
+    float reuseTolerance = DEFAULT_REUSE_TOLERANCE;
+};
+
+// One packed map to make: which of the layout's maps it is, and the material's maps it reads.
+struct MaterialPackJob
+{
+    size_t layoutMap = 0;
+    CookedTextureReference sources[MATERIAL_MAP_COUNT];    // Empty where the material doesn't have the map.
+    PackedMaterialMap record;
+};
+
+// What's been packed, for the summary.
+struct MaterialPackTotals
+{
+    size_t maps = 0;
+    size_t texturesBefore = 0;  // Distinct textures the models' meshes use.
+    size_t texturesAfter = 0;
+    size_t bindsBefore = 0;     // Textures bound drawing each model once.
+    size_t bindsAfter = 0;
+    uint64_t fileBytes = 0;     // KTX2 files, as they're stored.
+};
+
+///
+/// The packed map's path, relative to the model like the map it replaces: the base map's with the suffix added and a
+/// .ktx2 extension.
+///
+std::string PackedMapPath(const std::string& basePath, const std::string& suffix)
+{
+    std::string ktxPath = KtxPath(basePath);
+    return ktxPath.insert(ktxPath.size() - std::strlen(".ktx2"), suffix);
+}
+
+///
+/// Measures how close a compressed image is to the original, over all four channels.
+/// \return - the peak signal to noise ratio in dB, infinite if they're the same.
+///
+double MeasurePsnr(const std::vector<unsigned char>& original, const std::vector<unsigned char>& decoded)
+{
+    double squaredError = 0.0;
+    for(size_t i = 0; i < original.size(); i++)
+    {
+        double difference = ( double) original[i] - decoded[i];
+        squaredError += difference * difference;
+    }
+    if(squaredError == 0.0)
+    {
+        return INFINITY;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 * original.size() / squaredError);
+}
+
+///
+/// Lists the packed maps a model's materials need: one for each of the layout's maps whose base map a mesh has.
+/// \param data - the model, with its references as the file declares them.
+/// \param layout - the layout to pack with.
+/// \param jobs - receives each packed map once, however many meshes share it.
+/// \return - false if two meshes would pack the same base map with different maps.
+///
+bool ListPackJobs(const ModelData& data, const MaterialLayout& layout, std::vector<MaterialPackJob>& jobs)
+{
+    for(const CookedMesh& mesh : data.meshes)
+    {
+        for(size_t l = 0; l < layout.maps.size(); l++)
+        {
+            const PackedMapLayout& map = layout.maps[l];
+            MaterialPackJob job;
+            job.layoutMap = l;
+            for(int m = 0; m < MATERIAL_MAP_COUNT; m++)
+            {
+                bool read = m == map.base;
+                for(const MaterialChannelSource& channel : map.channels)
+                {
+                    read = read || channel.map == m;
+                }
+                for(size_t t = 0; read && t < mesh.textures.size() && job.sources[m].path.empty(); t++)
+                {
+                    if(mesh.textures[t].type == MaterialMapType(m))
+                    {
+                        job.sources[m] = mesh.textures[t];
+                        job.record.replaces.push_back(mesh.textures[t]);
+                    }
+                }
+            }
+            const CookedTextureReference& base = job.sources[map.base];
+            if(base.path.empty())
+            {
+                continue;
+            }
+            job.record.packed = { base.type, PackedMapPath(base.path, map.suffix) };
+
+            auto listed = std::find_if(jobs.begin(), jobs.end(), [&](const MaterialPackJob& other) { return other.record.packed.path == job.record.packed.path; });
+            if(listed == jobs.end())
+            {
+                jobs.push_back(job);
+                continue;
+            }
+            for(int m = 0; m < MATERIAL_MAP_COUNT; m++)
+            {
+                if(listed->sources[m].path != job.sources[m].path)
+                {
+                    std::cout << "ERROR::PACKER:: " << base.path << " is packed with " << (listed->sources[m].path.empty() ? "no map" : listed->sources[m].path)
+                              << " by one mesh and " << (job.sources[m].path.empty() ? "no map" : job.sources[m].path) << " by another" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+///
+/// Packs one map, compresses it and its mip chain and writes them as a KTX2 file, then reads the file back the way
+/// DecodeTexture would to check it.
+/// \param directory - the model's directory, which the references are relative to.
+/// \param job - the map to pack.
+/// \param map - its layout.
+/// \param options - how to pack it.
+/// \param totals - has the file's size added to it.
+/// \return - false if a map couldn't be decoded, the sizes don't match, or the file couldn't be written or read back.
+///
+bool PackMap(const std::string& directory, const MaterialPackJob& job, const PackedMapLayout& map, const MaterialPackOptions& options,
+             MaterialPackTotals& totals)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<unsigned char> pixels[MATERIAL_MAP_COUNT];
+    const unsigned char* maps[MATERIAL_MAP_COUNT] = {};
+    int width = 0;
+    int height = 0;
+    std::string sourceNames;
+    for(int m = 0; m < MATERIAL_MAP_COUNT; m++)
+    {
+        if(job.sources[m].path.empty())
+        {
+            continue;
+        }
+        std::string path = directory + '/' + job.sources[m].path;
+        stbi_set_flip_vertically_on_load(options.flip);
+        int mapWidth, mapHeight, components;
+        unsigned char* decoded = stbi_load(path.c_str(), &mapWidth, &mapHeight, &components, 4);
+        if(!decoded)
+        {
+            std::cout << "ERROR::PACKER:: can't decode " << path << std::endl;
+            return false;
+        }
+        pixels[m].assign(decoded, decoded + ( size_t) mapWidth * mapHeight * 4);
+        stbi_image_free(decoded);
+        if(width != 0 && (mapWidth != width || mapHeight != height))
+        {
+            std::cout << "ERROR::PACKER:: " << path << " is " << mapWidth << "x" << mapHeight << ", the maps packed with it are "
+                      << width << "x" << height << std::endl;
+            return false;
+        }
+        width = mapWidth;
+        height = mapHeight;
+        maps[m] = pixels[m].data();
+        sourceNames += (sourceNames.empty() ? "" : " + ") + job.sources[m].path;
+    }
+
+    std::vector<unsigned char> packed(( size_t) width * height * 4);
+    PackMaterialMaps(map, maps, width, height, packed.data());
+    for(std::vector<unsigned char>& source : pixels)
+    {
+        std::vector<unsigned char>().swap(source);
+    }
+
+    // Only a normal map's own RGB can be renormalised; anything else packed with its X and Y is filtered as data.
+    bool normal = map.base == FindMaterialMap("normal");
+    for(int c = 0; c < 3; c++)
+    {
+        normal = normal && map.channels[c].map == map.base && map.channels[c].channel == c;
+    }
+    bool colour = map.base == FindMaterialMap("diffuse");
+    MipContent content = normal ? MIP_CONTENT_NORMAL : colour ? MIP_CONTENT_COLOUR : MIP_CONTENT_DATA;
+    BlockFormat format = options.supercompress || options.bc7 ? BLOCK_FORMAT_BC7 : BLOCK_FORMAT_BC3;
+    float reuseTolerance = options.supercompress ? options.reuseTolerance : 0.0f;
+
+    std::vector<std::vector<unsigned char>> mips = BuildMipChain(packed.data(), width, height, content, options.filter);
+    std::vector<std::vector<unsigned char>> levels;
+    double psnr = 0.0;
+    int levelWidth = width;
+    int levelHeight = height;
+    for(const std::vector<unsigned char>& level : mips)
+    {
+        std::vector<unsigned char> blocks(CompressedImageSize(format, levelWidth, levelHeight));
+        CompressImage(level.data(), levelWidth, levelHeight, format, blocks.data(), reuseTolerance);
+        if(levels.empty())
+        {
+            std::vector<unsigned char> decoded(packed.size());
+            DecompressImage(blocks.data(), width, height, format, decoded.data());
+            psnr = MeasurePsnr(packed, decoded);
+        }
+        levels.push_back(std::move(blocks));
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    std::string ktxPath = directory + '/' + job.record.packed.path;
+    if(!WriteKtx2(ktxPath, format, options.srgb && colour, width, height, levels, options.supercompress))
+    {
+        return false;
+    }
+
+    // Read it back as a model load would.
+    DecodedTexture texture;
+    if(!DecodeTexture(ktxPath, texture) || texture.compressed.levels.size() != levels.size())
+    {
+        return false;
+    }
+    for(size_t i = 0; i < levels.size(); i++)
+    {
+        const KtxLevel& read = texture.compressed.levels[i];
+        if(read.size != levels[i].size() || memcmp(texture.pixels.data() + read.offset, levels[i].data(), read.size) != 0)
+        {
+            std::cout << "ERROR::PACKER:: " << ktxPath << " level " << i << " doesn't read back as it was written" << std::endl;
+            return false;
+        }
+    }
+
+    uint64_t fileBytes = std::filesystem::file_size(ktxPath);
+    totals.fileBytes += fileBytes;
+    totals.maps++;
+    std::cout << "MATERIAL::PACKER:: " << ktxPath << ": " << sourceNames << ", " << width << "x" << height << " " << BLOCK_FORMAT_NAMES[format]
+              << (options.srgb && colour ? " srgb" : "") << ", " << levels.size() << " levels, " << fileBytes << " bytes stored, PSNR " << psnr
+              << " dB, " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+    return true;
+}
+
+///
+/// Packs every material of a model with a layout, and writes the model's packing file once they're all packed.
+/// \param path - the model file.
+/// \param layout - the layout to pack with.
+/// \param options - how to pack the maps.
+/// \param totals - has the model's maps and textures added to it.
+/// \return - false if the model couldn't be read, or a map couldn't be packed or the packing file written.
+///
+bool PackModel(const std::string& path, const MaterialLayout& layout, const MaterialPackOptions& options, MaterialPackTotals& totals)
+{
+    ModelData data;
+    if(!LoadModelMeshes(path, data))
+    {
+        return false;
+    }
+    std::vector<MaterialPackJob> jobs;
+    if(!ListPackJobs(data, layout, jobs))
+    {
+        return false;
+    }
+
+    // Each map is spread across every thread, so they're packed one at a time.
+    MaterialPacking packing;
+    packing.layout = layout.name;
+    size_t failures = 0;
+    for(const MaterialPackJob& job : jobs)
+    {
+        if(!PackMap(data.directory, job, layout.maps[job.layoutMap], options, totals))
+        {
+            std::cout << "ERROR::PACKER:: failed to pack " << job.record.packed.path << std::endl;
+            failures++;
+            continue;
+        }
+        packing.maps.push_back(job.record);
+    }
+    if(failures > 0 || jobs.empty())
+    {
+        std::cout << "ERROR::PACKER:: " << path << ": " << (jobs.empty() ? "no material has a map the layout packs" : "not every map was packed")
+                  << ", the packing file isn't written" << std::endl;
+        return false;
+    }
+
+    // What binding the model's meshes costs, as the file declares them and packed.
+    std::set<std::string> before;
+    std::set<std::string> after;
+    for(const CookedMesh& mesh : data.meshes)
+    {
+        std::vector<CookedTextureReference> textures = mesh.textures;
+        totals.bindsBefore += textures.size();
+        for(const CookedTextureReference& texture : textures)
+        {
+            before.insert(texture.path);
+        }
+        ApplyMaterialPacking(packing, textures);
+        totals.bindsAfter += textures.size();
+        for(const CookedTextureReference& texture : textures)
+        {
+            after.insert(texture.path);
+        }
+    }
+    totals.texturesBefore += before.size();
+    totals.texturesAfter += after.size();
+
+    std::string packingPath = path + MATERIAL_PACKING_EXTENSION;
+    if(!WriteMaterialPacking(packingPath, packing))
+    {
+        std::cout << "ERROR::PACKER:: can't write " << packingPath << std::endl;
+        return false;
+    }
+    std::cout << "MATERIAL::PACKER:: " << packingPath << ": " << layout.name << " layout, " << packing.maps.size() << " packed maps, "
+              << before.size() << " -> " << after.size() << " textures" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> models;
+    MaterialPackOptions options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+        {
+            options.layoutPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--bc7") == 0)
+        {
+            options.bc7 = true;
+        }
+        else if(strcmp(argv[i], "--srgb") == 0)
+        {
+            options.srgb = true;
+        }
+        else if(strcmp(argv[i], "--flip") == 0)
+        {
+            options.flip = true;
+        }
+        else if(strcmp(argv[i], "--no-supercompress") == 0)
+        {
+            options.supercompress = false;
+        }
+        else if(strcmp(argv[i], "--reuse") == 0 && i + 1 < argc)
+        {
+            options.reuseTolerance = std::max(( float) atof(argv[++i]), 0.0f);
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_BOX]) == 0)
+            {
+                options.filter = MIP_FILTER_BOX;
+            }
+            else if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_KAISER]) == 0)
+            {
+                options.filter = MIP_FILTER_KAISER;
+            }
+            else
+            {
+                std::cout << "ERROR::PACKER:: unknown filter " << name << std::endl;
+                return -1;
+            }
+        }
+        else
+        {
+            models.push_back(argv[i]);
+        }
+    }
+    if(models.empty())
+    {
+        models.push_back(DEFAULT_MODEL);
+    }
+
+    MaterialLayout layout;
+    if(!ReadMaterialLayout(options.layoutPath, layout))
+    {
+        return -1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MaterialPackTotals totals;
+    size_t failures = 0;
+    for(const std::string& model : models)
+    {
+        if(!PackModel(model, layout, options, totals))
+        {
+            std::cout << "ERROR::PACKER:: failed to pack " << model << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "MATERIAL::PACKER:: " << models.size() - failures << " models, " << totals.maps << " packed maps, " << totals.texturesBefore
+              << " -> " << totals.texturesAfter << " textures, " << totals.bindsBefore << " -> " << totals.bindsAfter << " textures bound a draw, "
+              << totals.fileBytes << " bytes stored, " << failures << " failures, "
+              << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Utility code to decode images without a GL context.
+#include <TextureData/texturedata.h>
+// Utility code to block compress images and write them as KTX2 files.
+#include <Ktx/ktx.h>
+// Utility code to build mip chains in linear light.
+#include <MipChain/mipchain.h>
+
+// Compresses images into GPU block formats with their whole mip chain, and writes each one as a KTX2 file next to
+// the image. TextureFromFile loads the KTX2 file in the image's place and uploads its levels as they are.
+//
+// Usage: TextureCooker [image or directory]... [--format bc1|bc3|bc4|bc5|bc7] [--bc7] [--srgb] [--flip]
+//                      [--no-supercompress] [--reuse tolerance] [--filter kaiser|box]
+// Directories are searched recursively. Without --format each image's format is picked from its name: normal maps
+// (_ddn) are BC5, specular maps (_spec) BC4, and the rest BC1, or BC3 if they use their alpha channel. --bc7 uses BC7
+// instead of BC1 and BC3 for those. --flip stores the rows bottom first, for textures that are loaded flipped.
+//
+// The levels are supercompressed unless --no-supercompress is given, and then colour maps are BC7 too: it's the one
+// format every context can use, sampled as it is where BC7 is supported and transcoded to BC1 or BC3 at load where
+// it isn't. --reuse sets the extra squared error per channel a block may take on to share its neighbour's endpoints,
+// which is what makes the levels supercompress well; 0 keeps every block's own fit.
+//
+// The mip chain is filtered with a Kaiser windowed sinc unless --filter box is given. Colour maps are filtered in
+// linear light, and normal maps are renormalised at every level, so nothing is left for the driver to generate.
+
+// Images cooked when none are given on the command line.
+const char* DEFAULT_IMAGE_DIRECTORY = "../../../12-ModelLoading/ModelLoading/Models";
+
+const char* IMAGE_EXTENSIONS[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+const char* BLOCK_FORMAT_NAMES[] = { "bc1", "bc3", "bc4", "bc5", "bc7" };
+
+const char* MIP_FILTER_NAMES[] = { "box", "kaiser" };
+
+// Extra squared error per channel a block may take on to reuse its neighbour's endpoints, when supercompressing.
+const float DEFAULT_REUSE_TOLERANCE = 4.0f;
+
+// How images are cooked, from the command line.
+struct TextureCookOptions
+{
+    int format = -1;            // The format to use, or -1 to pick one for each image.
+    bool bc7 = false;           // Whether colour maps use BC7 rather than BC1 or BC3.
+    bool srgb = false;          // Whether colour channels are marked sRGB encoded.
+    bool flip = false;          // Whether rows are stored bottom first.
+    bool supercompress = true;
+    MipFilter filter = MIP_FILTER_KAISER;
+    float reuseTolerance = DEFAULT_REUSE_TOLERANCE;
+};
+
+// What's been cooked, for the summary.
+struct TextureCookTotals
+{
+    uint64_t sourceBytes = 0;       // Uncompressed top levels.
+    uint64_t compressedBytes = 0;   // Block compressed levels, as the GPU holds them.
+    uint64_t fileBytes = 0;         // KTX2 files, as they're stored.
+};
+
+///
+/// Returns the file's extension in lower case, including the dot.
+///
+std::string LowerExtension(const std::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    return extension;
+}
+
+///
+/// Returns true if the extension is in the list.
+///
+template <size_t N>
+bool IsOneOf(const std::string& extension, const char* (&extensions)[N])
+{
+    for(size_t i = 0; i < N; i++)
+    {
+        if(extension == extensions[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Returns true if the image's name marks it as a tangent space normal map.
+///
+bool IsNormalMap(const std::string& path)
+{
+    std::string name = std::filesystem::path(path).stem().string();
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    return name.find("_ddn") != std::string::npos || name.find("_normal") != std::string::npos;
+}
+
+///
+/// Picks an image's format from its name and contents.
+/// \param path - the image file.
+/// \param rgba - its pixels, four components each.
+/// \param pixelCount - number of pixels.
+/// \param bc7 - whether colour images use BC7 rather than BC1 or BC3.
+///
+BlockFormat ChooseBlockFormat(const std::string& path, const std::vector<unsigned char>& rgba, size_t pixelCount, bool bc7)
+{
+    if(IsNormalMap(path))
+    {
+        return BLOCK_FORMAT_BC5;
+    }
+    std::string name = std::filesystem::path(path).stem().string();
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    if(name.find("_spec") != std::string::npos)
+    {
+        return BLOCK_FORMAT_BC4;
+    }
+    if(bc7)
+    {
+        return BLOCK_FORMAT_BC7;
+    }
+    for(size_t i = 0; i < pixelCount; i++)
+    {
+        if(rgba[i * 4 + 3] != 255)
+        {
+            return BLOCK_FORMAT_BC3;
+        }
+    }
+    return BLOCK_FORMAT_BC1;
+}
+
+///
+/// Measures how close a compressed image is to the original, over the channels its format stores.
+/// \return - the peak signal to noise ratio in dB, infinite if they're the same.
+///
+double MeasurePsnr(const std::vector<unsigned char>& original, const std::vector<unsigned char>& decoded, BlockFormat format)
+{
+    int channels = format == BLOCK_FORMAT_BC1 ? 3 : format == BLOCK_FORMAT_BC4 ? 1 : format == BLOCK_FORMAT_BC5 ? 2 : 4;
+    double squaredError = 0.0;
+    size_t samples = 0;
+    for(size_t i = 0; i < original.size(); i += 4)
+    {
+        for(int c = 0; c < channels; c++)
+        {
+            double difference = ( double) original[i + c] - decoded[i + c];
+            squaredError += difference * difference;
+            samples++;
+        }
+    }
+    if(squaredError == 0.0)
+    {
+        return INFINITY;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+}
+
+///
+/// Compresses an image and its mip chain and writes them next to it as a KTX2 file, then reads the file back the way
+/// TextureFromFile would to check it.
+/// \param path - the image file.
+/// \param options - how to cook it.
+/// \param totals - has the image's sizes added to it.
+/// \return - false if the image couldn't be decoded or the file couldn't be written or read back.
+///
+bool CookTexture(const std::string& path, const TextureCookOptions& options, TextureCookTotals& totals)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    stbi_set_flip_vertically_on_load(options.flip);
+    int width, height, components;
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+    if(!pixels)
+    {
+        return false;
+    }
+    size_t pixelCount = ( size_t) width * height;
+    std::vector<unsigned char> rgba(pixels, pixels + pixelCount * 4);
+    stbi_image_free(pixels);
+
+    BlockFormat format = options.format >= 0 ? ( BlockFormat) options.format
+                                             : ChooseBlockFormat(path, rgba, pixelCount, options.bc7 || options.supercompress);
+    bool colour = format == BLOCK_FORMAT_BC1 || format == BLOCK_FORMAT_BC3 || format == BLOCK_FORMAT_BC7;
+    float reuseTolerance = options.supercompress ? options.reuseTolerance : 0.0f;
+
+    MipContent content = IsNormalMap(path) ? MIP_CONTENT_NORMAL : colour ? MIP_CONTENT_COLOUR : MIP_CONTENT_DATA;
+    auto mipStart = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<unsigned char>> mips = BuildMipChain(rgba.data(), width, height, content, options.filter);
+    double mipMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mipStart).count();
+
+    std::vector<std::vector<unsigned char>> levels;
+    double psnr = 0.0;
+    int levelWidth = width;
+    int levelHeight = height;
+    for(const std::vector<unsigned char>& level : mips)
+    {
+        std::vector<unsigned char> blocks(CompressedImageSize(format, levelWidth, levelHeight));
+        CompressImage(level.data(), levelWidth, levelHeight, format, blocks.data(), reuseTolerance);
+        if(levels.empty())
+        {
+            std::vector<unsigned char> decoded(pixelCount * 4);
+            DecompressImage(blocks.data(), width, height, format, decoded.data());
+            psnr = MeasurePsnr(rgba, decoded, format);
+        }
+        levels.push_back(std::move(blocks));
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    std::string ktxPath = KtxPath(path);
+    if(!WriteKtx2(ktxPath, format, options.srgb && colour, width, height, levels, options.supercompress))
+    {
+        return false;
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // Read it back as a chapter would, which times the supercompressed levels' decoding too.
+    auto readStart = std::chrono::high_resolution_clock::now();
+    DecodedTexture texture;
+    if(!ReadKtxTexture(ktxPath, texture) || texture.compressed.levels.size() != levels.size())
+    {
+        return false;
+    }
+    double readMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - readStart).count();
+    size_t levelBytes = 0;
+    for(size_t i = 0; i < levels.size(); i++)
+    {
+        const KtxLevel& read = texture.compressed.levels[i];
+        if(read.size != levels[i].size() || memcmp(texture.pixels.data() + read.offset, levels[i].data(), read.size) != 0)
+        {
+            std::cout << "ERROR::COOKER:: " << ktxPath << " level " << i << " doesn't read back as it was written" << std::endl;
+            return false;
+        }
+        levelBytes += levels[i].size();
+    }
+
+    uint64_t fileBytes = std::filesystem::file_size(ktxPath);
+    totals.sourceBytes += pixelCount * components;
+    totals.compressedBytes += levelBytes;
+    totals.fileBytes += fileBytes;
+    std::cout << "TEXTURE::COOKER:: " << ktxPath << ": " << width << "x" << height << " " << BLOCK_FORMAT_NAMES[format]
+              << (options.srgb && colour ? " srgb" : "") << ", " << levels.size() << " levels, " << levelBytes << " bytes ("
+              << ( double) pixelCount * components / levelBytes << ":1), " << fileBytes << " bytes stored, PSNR " << psnr << " dB, "
+              << milliseconds << " ms (" << pixelCount / (milliseconds * 1000.0) << " MP/s, " << MIP_FILTER_NAMES[options.filter] << " mipmaps in "
+              << mipMilliseconds << " ms), read back in " << readMilliseconds << " ms"
+              << std::endl;
+    return true;
+}
+
+///
+/// Adds an image, or every image under a directory, to the list to cook.
+///
+void FindImages(const std::string& path, std::vector<std::string>& images)
+{
+    std::error_code error;
+    if(!std::filesystem::is_directory(path, error))
+    {
+        images.push_back(path);
+        return;
+    }
+    for(std::filesystem::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+    {
+        if(it->is_regular_file() && IsOneOf(LowerExtension(it->path()), IMAGE_EXTENSIONS))
+        {
+            images.push_back(it->path().generic_string());
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    TextureCookOptions options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            for(int format = 0; format < ( int) (sizeof(BLOCK_FORMAT_NAMES) / sizeof(BLOCK_FORMAT_NAMES[0])); format++)
+            {
+                if(strcmp(name, BLOCK_FORMAT_NAMES[format]) == 0)
+                {
+                    options.format = format;
+                }
+            }
+            if(options.format < 0)
+            {
+                std::cout << "ERROR::COOKER:: unknown format " << name << std::endl;
+                return -1;
+            }
+        }
+        else if(strcmp(argv[i], "--bc7") == 0)
+        {
+            options.bc7 = true;
+        }
+        else if(strcmp(argv[i], "--srgb") == 0)
+        {
+            options.srgb = true;
+        }
+        else if(strcmp(argv[i], "--flip") == 0)
+        {
+            options.flip = true;
+        }
+        else if(strcmp(argv[i], "--no-supercompress") == 0)
+        {
+            options.supercompress = false;
+        }
+        else if(strcmp(argv[i], "--reuse") == 0 && i + 1 < argc)
+        {
+            options.reuseTolerance = std::max(( float) atof(argv[++i]), 0.0f);
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_BOX]) == 0)
+            {
+                options.filter = MIP_FILTER_BOX;
+            }
+            else if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_KAISER]) == 0)
+            {
+                options.filter = MIP_FILTER_KAISER;
+            }
+            else
+            {
+                std::cout << "ERROR::COOKER:: unknown filter " << name << std::endl;
+                return -1;
+            }
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if(paths.empty())
+    {
+        paths.push_back(DEFAULT_IMAGE_DIRECTORY);
+    }
+
+    std::vector<std::string> images;
+    for(const std::string& path : paths)
+    {
+        FindImages(path, images);
+    }
+
+    // Each image is spread across every thread, so they're cooked one at a time.
+    auto start = std::chrono::high_resolution_clock::now();
+    TextureCookTotals totals;
+    size_t failures = 0;
+    for(const std::string& image : images)
+    {
+        if(!CookTexture(image, options, totals))
+        {
+            std::cout << "ERROR::COOKER:: failed to cook " << image << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "TEXTURE::COOKER:: " << images.size() - failures << " textures, " << totals.sourceBytes << " bytes uncompressed, "
+              << totals.compressedBytes << " bytes compressed with mipmaps, " << totals.fileBytes << " bytes stored, " << failures << " failures, "
+              << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Utility code to decode images and read KTX2 files without a GL context.
+#include <TextureData/texturedata.h>
+// Utility code to build mip chains in linear light.
+#include <MipChain/mipchain.h>
+// Utility code to write and read tiled textures.
+#include <TiledTexture/tiledtexture.h>
+
+// Cuts images and their mip chains into bordered pages and writes each one as a tiled texture next to the image,
+// for the virtual texture system to stream a page at a time.
+//
+// Usage: TextureTiler [image or directory]... [--page size] [--border texels] [--flip] [--filter kaiser|box]
+// Directories are searched recursively. Images must be powers of two and at least a page on each side; the chain
+// stops at the first level that's a single page along its shorter side. --flip stores the rows bottom first, for
+// textures that are loaded flipped. Colour maps are filtered in linear light and normal maps (_ddn) renormalised,
+// as the texture cooker does.
+//
+// KTX2 files are tiled too, decompressed level by level, with the mip chain and row order they were cooked with.
+// Directories give only those without an image of their own, such as the packed maps the MaterialPacker tool writes,
+// since a KTX2 file cooked from an image would write the same tiled texture as the image.
+
+// Images tiled when none are given on the command line.
+const char* DEFAULT_IMAGE_DIRECTORY = "../../../12-ModelLoading/ModelLoading/Models";
+
+const char* IMAGE_EXTENSIONS[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+const char* KTX_EXTENSION = ".ktx2";
+
+const char* MIP_FILTER_NAMES[] = { "box", "kaiser" };
+
+// How images are tiled, from the command line.
+struct TextureTileOptions
+{
+    int pageSize = TILED_TEXTURE_PAGE_SIZE;
+    int border = TILED_TEXTURE_BORDER;
+    bool flip = false;
+    MipFilter filter = MIP_FILTER_KAISER;
+};
+
+// What's been tiled, for the summary.
+struct TextureTileTotals
+{
+    uint64_t sourceBytes = 0;   // Uncompressed top levels.
+    uint64_t pageBytes = 0;     // Pages as they're held in the page cache, borders included.
+    uint64_t fileBytes = 0;     // Tiled texture files, as they're stored.
+    size_t pages = 0;
+};
+
+///
+/// Returns the file's extension in lower case, including the dot.
+///
+std::string LowerExtension(const std::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    return extension;
+}
+
+///
+/// Returns true if the extension is in the list.
+///
+template <size_t N>
+bool IsOneOf(const std::string& extension, const char* (&extensions)[N])
+{
+    for(size_t i = 0; i < N; i++)
+    {
+        if(extension == extensions[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Picks what an image holds from its name: normal maps (_ddn, _normal), other data maps (_spec), or colour.
+///
+MipContent ChooseMipContent(const std::string& path)
+{
+    std::string name = std::filesystem::path(path).stem().string();
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return ( char) std::tolower(c); });
+    if(name.find("_ddn") != std::string::npos || name.find("_normal") != std::string::npos)
+    {
+        return MIP_CONTENT_NORMAL;
+    }
+    if(name.find("_spec") != std::string::npos)
+    {
+        return MIP_CONTENT_DATA;
+    }
+    return MIP_CONTENT_COLOUR;
+}
+
+///
+/// Reads a KTX2 file and decompresses the levels a tiled texture of it needs to 8 bit RGBA.
+/// \param path - the KTX2 file.
+/// \param pageSize - the page size it's tiled with.
+/// \param texture - receives its size and components.
+/// \param levels - receives the levels.
+/// \return - false if the file couldn't be read, or has too few levels to tile.
+///
+bool DecompressKtxLevels(const std::string& path, int pageSize, DecodedTexture& texture, std::vector<std::vector<unsigned char>>& levels)
+{
+    if(!ReadKtxTexture(path, texture))
+    {
+        return false;
+    }
+    size_t levelCount = ( size_t) TiledTextureLevelCount(texture.width, texture.height, pageSize);
+    if(texture.compressed.levels.size() < levelCount)
+    {
+        std::cout << "ERROR::TILER:: " << path << " has " << texture.compressed.levels.size() << " levels, tiling it needs " << levelCount
+                  << std::endl;
+        return false;
+    }
+    levels.resize(levelCount);
+    for(size_t level = 0; level < levelCount; level++)
+    {
+        const KtxLevel& stored = texture.compressed.levels[level];
+        levels[level].resize(( size_t) stored.width * stored.height * 4);
+        if(!DecompressImage(texture.pixels.data() + stored.offset, stored.width, stored.height, texture.compressed.blockFormat, levels[level].data()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+/// Tiles an image and its mip chain and writes them next to it as a tiled texture, then reads every page back the
+/// way the virtual texture system would to check it.
+/// \param path - the image or KTX2 file.
+/// \param options - how to tile it.
+/// \param totals - has the image's sizes added to it.
+/// \return - false if the image couldn't be decoded or doesn't tile, or the file couldn't be written or read back.
+///
+bool TileTexture(const std::string& path, const TextureTileOptions& options, TextureTileTotals& totals)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    int width, height, components;
+    std::vector<unsigned char> rgba;
+    std::vector<std::vector<unsigned char>> levels;
+    bool ktx = LowerExtension(path) == KTX_EXTENSION;
+    if(ktx)
+    {
+        DecodedTexture texture;
+        if(!DecompressKtxLevels(path, options.pageSize, texture, levels))
+        {
+            return false;
+        }
+        width = texture.width;
+        height = texture.height;
+        components = texture.components;
+    }
+    else
+    {
+        stbi_set_flip_vertically_on_load(options.flip);
+        unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+        if(!pixels)
+        {
+            return false;
+        }
+        rgba.assign(pixels, pixels + ( size_t) width * height * 4);
+        stbi_image_free(pixels);
+    }
+
+    if((width & (width - 1)) != 0 || (height & (height - 1)) != 0 || std::min(width, height) < options.pageSize)
+    {
+        std::cout << "ERROR::TILER:: " << path << " is " << width << "x" << height << ", tiled textures need powers of two of at least "
+                  << options.pageSize << std::endl;
+        return false;
+    }
+
+    if(!ktx)
+    {
+        levels = BuildMipChain(rgba.data(), width, height, ChooseMipContent(path), options.filter);
+    }
+    std::string tiledPath = TiledTexturePath(path);
+    uint64_t fileBytes = 0;
+    if(!WriteTiledTexture(tiledPath, width, height, levels, options.pageSize, options.border, &fileBytes))
+    {
+        return false;
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // Read every page back and check it against the level it was cut from.
+    auto readStart = std::chrono::high_resolution_clock::now();
+    TiledTexture tiled;
+    if(!tiled.Open(tiledPath))
+    {
+        return false;
+    }
+    std::vector<unsigned char> page(tiled.PageBytes());
+    int slotSize = options.pageSize + 2 * options.border;
+    for(int level = 0; level < tiled.Levels(); level++)
+    {
+        int levelWidth = width >> level;
+        for(int y = 0; y < tiled.PagesDown(level); y++)
+        {
+            for(int x = 0; x < tiled.PagesAcross(level); x++)
+            {
+                if(!tiled.ReadPage(tiled.PageIndex(level, x, y), page.data()))
+                {
+                    std::cout << "ERROR::TILER:: " << tiledPath << " level " << level << " page " << x << "," << y << " doesn't read back" << std::endl;
+                    return false;
+                }
+                for(int row = 0; row < options.pageSize; row++)
+                {
+                    const unsigned char* read = &page[(( size_t) (row + options.border) * slotSize + options.border) * 4];
+                    const unsigned char* source = &levels[level][(( size_t) (y * options.pageSize + row) * levelWidth + x * options.pageSize) * 4];
+                    if(memcmp(read, source, ( size_t) options.pageSize * 4) != 0)
+                    {
+                        std::cout << "ERROR::TILER:: " << tiledPath << " level " << level << " page " << x << "," << y << " doesn't match the image" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    double readMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - readStart).count();
+
+    uint64_t pageBytes = ( uint64_t) tiled.PageCount() * tiled.PageBytes();
+    totals.sourceBytes += ( uint64_t) width * height * components;
+    totals.pageBytes += pageBytes;
+    totals.fileBytes += fileBytes;
+    totals.pages += ( size_t) tiled.PageCount();
+    std::cout << "TEXTURE::TILER:: " << tiledPath << ": " << width << "x" << height << ", " << tiled.Levels() << " levels, "
+              << tiled.PageCount() << " pages of " << options.pageSize << "+" << options.border << ", " << pageBytes << " bytes paged, "
+              << fileBytes << " bytes stored (" << ( double) pageBytes / fileBytes << ":1), " << milliseconds << " ms, read back in "
+              << readMilliseconds << " ms" << std::endl;
+    return true;
+}
+
+///
+/// Returns true if there's an image next to a KTX2 file that it could have been cooked from.
+///
+bool HasSourceImage(const std::filesystem::path& ktxPath)
+{
+    std::error_code error;
+    for(const char* extension : IMAGE_EXTENSIONS)
+    {
+        std::filesystem::path image = ktxPath;
+        if(std::filesystem::exists(image.replace_extension(extension), error))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Adds an image, or every image under a directory and the KTX2 files without one, to the list to tile.
+///
+void FindImages(const std::string& path, std::vector<std::string>& images)
+{
+    std::error_code error;
+    if(!std::filesystem::is_directory(path, error))
+    {
+        images.push_back(path);
+        return;
+    }
+    for(std::filesystem::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+    {
+        if(!it->is_regular_file())
+        {
+            continue;
+        }
+        std::string extension = LowerExtension(it->path());
+        if(IsOneOf(extension, IMAGE_EXTENSIONS) || (extension == KTX_EXTENSION && !HasSourceImage(it->path())))
+        {
+            images.push_back(it->path().generic_string());
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    TextureTileOptions options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--page") == 0 && i + 1 < argc)
+        {
+            options.pageSize = atoi(argv[++i]);
+            if(options.pageSize < 4 || (options.pageSize & (options.pageSize - 1)) != 0)
+            {
+                std::cout << "ERROR::TILER:: the page size must be a power of two of at least 4" << std::endl;
+                return -1;
+            }
+        }
+        else if(strcmp(argv[i], "--border") == 0 && i + 1 < argc)
+        {
+            options.border = std::max(atoi(argv[++i]), 0);
+        }
+        else if(strcmp(argv[i], "--flip") == 0)
+        {
+            options.flip = true;
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_BOX]) == 0)
+            {
+                options.filter = MIP_FILTER_BOX;
+            }
+            else if(strcmp(name, MIP_FILTER_NAMES[MIP_FILTER_KAISER]) == 0)
+            {
+                options.filter = MIP_FILTER_KAISER;
+            }
+            else
+            {
+                std::cout << "ERROR::TILER:: unknown filter " << name << std::endl;
+                return -1;
+            }
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if(options.border > options.pageSize)
+    {
+        std::cout << "ERROR::TILER:: the border can't be wider than a page" << std::endl;
+        return -1;
+    }
+    if(paths.empty())
+    {
+        paths.push_back(DEFAULT_IMAGE_DIRECTORY);
+    }
+
+    std::vector<std::string> images;
+    for(const std::string& path : paths)
+    {
+        FindImages(path, images);
+    }
+
+    // Each image's mip chain is spread across every thread, so they're tiled one at a time.
+    auto start = std::chrono::high_resolution_clock::now();
+    TextureTileTotals totals;
+    size_t failures = 0;
+    for(const std::string& image : images)
+    {
+        if(!TileTexture(image, options, totals))
+        {
+            std::cout << "ERROR::TILER:: failed to tile " << image << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "TEXTURE::TILER:: " << images.size() - failures << " textures, " << totals.pages << " pages, " << totals.sourceBytes
+              << " bytes uncompressed, " << totals.pageBytes << " bytes paged, " << totals.fileBytes << " bytes stored, " << failures
+              << " failures, " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms"
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file